@@ -0,0 +1,149 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "agg/funcs.h"
+#include "agg/types.h"
+#include "common/log.h"
+#include "common/parse.h"
+
+
+// Default values.
+#define DEF_BUCKET      60000000000ULL ///< One minute.
+#define DEF_PERCENTILES "50,90,99"
+
+/// Print the usage information to the standard output stream.
+static void
+print_usage(void)
+{
+  (void)printf(
+    "About:\n"
+    "  Aggregation of the ureq reports by requester, responder and time.\n\n"
+
+    "Usage:\n"
+    "  nemo-agg [OPTIONS] file...\n\n"
+
+    "Arguments:\n"
+    "  file    Report produced by ureq in the CSV format.\n\n"
+
+    "Options:\n"
+    "  -b DUR  Width of a time bucket. (def=1m)\n"
+    "  -h      Print this help message.\n"
+    "  -j CNT  Number of parsing threads. (def=number of CPUs)\n"
+    "  -q LIST Comma-separated percentiles of round-trip times. (def="
+               DEF_PERCENTILES ")\n"
+    "  -v      Report the processing throughput.\n");
+}
+
+/// Parse a comma-separated list of percentiles.
+/// @return success/failure indication
+///
+/// @param[out] cf  configuration
+/// @param[in]  inp input string
+static bool
+parse_percentiles(struct config* cf, const char* inp)
+{
+  char* str;
+  char* tok;
+  char* save;
+  bool retb;
+
+  str = strdup(inp);
+  if (str == NULL) {
+    log(LL_WARN, true, "unable to copy the list");
+    return false;
+  }
+
+  cf->cf_nq = 0;
+  retb      = true;
+  for (tok = strtok_r(str, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+    if (cf->cf_nq == AGG_QUANT_MAX) {
+      log(LL_WARN, false, "list has more than %d values", AGG_QUANT_MAX);
+      retb = false;
+      break;
+    }
+
+    retb = parse_uint64(&cf->cf_q[cf->cf_nq], tok, 0, 100);
+    if (retb == false) {
+      break;
+    }
+
+    cf->cf_nq++;
+  }
+
+  free(str);
+  return retb;
+}
+
+/// Parse the command-line options.
+/// @return success/failure indication
+///
+/// @param[out] cf   configuration
+/// @param[in]  argc argument count
+/// @param[in]  argv argument vector
+bool
+parse_config(struct config* cf, int argc, char* argv[])
+{
+  const char* pct;
+  long ncpu;
+  int opt;
+  bool retb;
+
+  // Use all available processors by default.
+  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpu < 1) {
+    ncpu = 1;
+  }
+
+  (void)memset(cf, 0, sizeof(*cf));
+  cf->cf_bkt  = DEF_BUCKET;
+  cf->cf_nthr = ncpu > AGG_THREAD_MAX ? AGG_THREAD_MAX : (uint64_t)ncpu;
+  cf->cf_verb = false;
+
+  pct = DEF_PERCENTILES;
+
+  while ((opt = getopt(argc, argv, "b:hj:q:v")) != -1) {
+    retb = true;
+
+    if (opt == 'b') {
+      retb = parse_scalar(&cf->cf_bkt, optarg, "ns", 1, UINT64_MAX, parse_time_unit);
+    } else if (opt == 'j') {
+      retb = parse_uint64(&cf->cf_nthr, optarg, 1, AGG_THREAD_MAX);
+    } else if (opt == 'q') {
+      pct = optarg;
+    } else if (opt == 'v') {
+      cf->cf_verb = true;
+    } else {
+      print_usage();
+      exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (retb == false) {
+      log(LL_WARN, false, "invalid value of option '%c'", opt);
+      return false;
+    }
+  }
+
+  retb = parse_percentiles(cf, pct);
+  if (retb == false) {
+    log(LL_WARN, false, "invalid list of percentiles");
+    return false;
+  }
+
+  if (optind == argc) {
+    log(LL_WARN, false, "no report files");
+    return false;
+  }
+
+  cf->cf_file  = argv + optind;
+  cf->cf_nfile = (uint64_t)(argc - optind);
+
+  return true;
+}
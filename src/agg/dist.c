@@ -0,0 +1,192 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "agg/funcs.h"
+#include "agg/types.h"
+#include "common/log.h"
+
+
+/// Select the bin of a value. The bins of each power of two are indexed by
+/// the bits that follow the most significant one.
+/// @return index of the bin
+///
+/// @param[in] val value
+static uint32_t
+index_dist(const uint64_t val)
+{
+  uint32_t msb;
+
+  if (val < (1ULL << DIST_SUB)) {
+    return (uint32_t)val;
+  }
+
+  msb = 63 - (uint32_t)__builtin_clzll(val);
+  return ((msb - DIST_SUB + 1) << DIST_SUB)
+       + (uint32_t)((val >> (msb - DIST_SUB)) - (1ULL << DIST_SUB));
+}
+
+/// Compute the largest value of a bin.
+/// @return upper inclusive bound of the bin
+///
+/// @param[in] idx index of the bin
+static uint64_t
+bound_dist(const uint32_t idx)
+{
+  uint64_t top;
+  uint32_t exp;
+
+  if (idx < (1U << DIST_SUB)) {
+    return idx;
+  }
+
+  exp = (idx >> DIST_SUB) - 1;
+  top = (idx & ((1U << DIST_SUB) - 1)) + (1ULL << DIST_SUB) + 1;
+  return (top << exp) - 1;
+}
+
+/// Ensure that a range of bins is allocated. The range is extended by one
+/// power of two on each side, so that nearby values do not cause further
+/// reallocations.
+/// @return success/failure indication
+///
+/// @param[in] dt distribution
+/// @param[in] lo index of the first required bin
+/// @param[in] hi index of the last required bin
+static bool
+widen_dist(struct dist* dt, uint32_t lo, uint32_t hi)
+{
+  uint64_t* bin;
+
+  if (dt->dt_bin != NULL) {
+    if (lo >= dt->dt_lo && hi < dt->dt_lo + dt->dt_len) {
+      return true;
+    }
+
+    if (dt->dt_lo < lo) {
+      lo = dt->dt_lo;
+    }
+    if (dt->dt_lo + dt->dt_len - 1 > hi) {
+      hi = dt->dt_lo + dt->dt_len - 1;
+    }
+  }
+
+  lo = lo > (1U << DIST_SUB) ? lo - (1U << DIST_SUB) : 0;
+  hi = hi + (1U << DIST_SUB) < DIST_BINS ? hi + (1U << DIST_SUB) : DIST_BINS - 1;
+
+  bin = calloc((size_t)(hi - lo + 1), sizeof(*bin));
+  if (bin == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the round-trip times");
+    return false;
+  }
+
+  if (dt->dt_bin != NULL) {
+    (void)memcpy(bin + (dt->dt_lo - lo), dt->dt_bin, dt->dt_len * sizeof(*bin));
+    free(dt->dt_bin);
+  }
+
+  dt->dt_bin = bin;
+  dt->dt_lo  = lo;
+  dt->dt_len = hi - lo + 1;
+
+  return true;
+}
+
+/// Account for a value in the distribution.
+/// @return success/failure indication
+///
+/// @param[in] dt  distribution
+/// @param[in] val value in nanoseconds
+bool
+add_dist(struct dist* dt, const uint64_t val)
+{
+  uint32_t idx;
+  bool retb;
+
+  idx  = index_dist(val);
+  retb = widen_dist(dt, idx, idx);
+  if (retb == false) {
+    return false;
+  }
+
+  dt->dt_bin[idx - dt->dt_lo]++;
+  dt->dt_cnt++;
+  dt->dt_sum += val;
+
+  return true;
+}
+
+/// Add the values of a distribution to an aggregate.
+/// @return success/failure indication
+///
+/// @param[in] dst aggregated distribution
+/// @param[in] src distribution
+bool
+merge_dist(struct dist* dst, const struct dist* src)
+{
+  uint32_t i;
+  bool retb;
+
+  if (src->dt_bin == NULL) {
+    return true;
+  }
+
+  retb = widen_dist(dst, src->dt_lo, src->dt_lo + src->dt_len - 1);
+  if (retb == false) {
+    return false;
+  }
+
+  for (i = 0; i < src->dt_len; i++) {
+    dst->dt_bin[src->dt_lo + i - dst->dt_lo] += src->dt_bin[i];
+  }
+  dst->dt_cnt += src->dt_cnt;
+  dst->dt_sum += src->dt_sum;
+
+  return true;
+}
+
+/// Estimate a percentile of the values as the upper bound of the bin that
+/// contains it, which exceeds the actual value by less than 2^-DIST_SUB of it.
+/// @return upper bound in nanoseconds
+///
+/// @param[in] dt  distribution
+/// @param[in] pct percentile (0-100)
+uint64_t
+quantile_dist(const struct dist* dt, const uint64_t pct)
+{
+  uint64_t need;
+  uint64_t seen;
+  uint32_t i;
+
+  // Ceiling of the rank, so that the percentile is never underestimated.
+  need = (dt->dt_cnt * pct + 99) / 100;
+  if (need == 0) {
+    need = 1;
+  }
+
+  seen = 0;
+  for (i = 0; i < dt->dt_len; i++) {
+    seen += dt->dt_bin[i];
+    if (seen >= need) {
+      return bound_dist(dt->dt_lo + i);
+    }
+  }
+
+  return 0;
+}
+
+/// Release the bins of a distribution.
+///
+/// @param[in] dt distribution
+void
+free_dist(struct dist* dt)
+{
+  free(dt->dt_bin);
+  (void)memset(dt, 0, sizeof(*dt));
+}
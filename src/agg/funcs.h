@@ -0,0 +1,37 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_AGG_FUNCS_H
+#define NEMO_AGG_FUNCS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "agg/types.h"
+
+
+// Configuration.
+bool parse_config(struct config* cf, int argc, char* argv[]);
+
+// Parsing.
+bool parse_line(struct line* ln, const char* beg, const char* end);
+
+// Distribution.
+bool add_dist(struct dist* dt, const uint64_t val);
+bool merge_dist(struct dist* dst, const struct dist* src);
+uint64_t quantile_dist(const struct dist* dt, const uint64_t pct);
+void free_dist(struct dist* dt);
+
+// Aggregation.
+bool create_table(struct table* tb);
+void clear_table(struct table* tb);
+void delete_table(struct table* tb);
+bool aggregate_line(struct table* tb, const struct line* ln, const struct config* cf);
+bool merge_table(struct table* dst, const struct table* src);
+bool write_table(FILE* fp, const struct table* tb, const struct config* cf);
+
+#endif
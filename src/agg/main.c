@@ -0,0 +1,326 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+#include "agg/funcs.h"
+#include "agg/types.h"
+#include "common/log.h"
+#include "common/now.h"
+
+
+/// Aggregate all lines of a part of a report.
+///
+/// @param[in] pt part
+static void
+process_part(struct part* pt)
+{
+  struct line ln;
+  const char* cur;
+  const char* eol;
+  bool retb;
+
+  pt->pt_ret = true;
+  for (cur = pt->pt_beg; cur < pt->pt_end; cur = eol + 1) {
+    eol = memchr(cur, '\n', (size_t)(pt->pt_end - cur));
+    if (eol == NULL) {
+      eol = pt->pt_end;
+    }
+
+    // Skip the header and the empty lines.
+    if (eol == cur || *cur < '0' || *cur > '9') {
+      continue;
+    }
+
+    retb = parse_line(&ln, cur, eol);
+    if (retb == false) {
+      pt->pt_nbad++;
+      continue;
+    }
+
+    retb = aggregate_line(&pt->pt_tb, &ln, pt->pt_cf);
+    if (retb == false) {
+      pt->pt_ret = false;
+      return;
+    }
+
+    pt->pt_nlin++;
+  }
+}
+
+/// Starting point of a parsing thread.
+/// @return NULL
+///
+/// @param[in] arg part
+static void*
+part_main(void* arg)
+{
+  process_part(arg);
+  return NULL;
+}
+
+/// Find the start of the line that contains a position.
+/// @return first byte of the following line
+///
+/// @param[in] beg first byte of the report
+/// @param[in] end byte after the last one
+/// @param[in] pos position
+static const char*
+align_line(const char* beg, const char* end, const char* pos)
+{
+  const char* eol;
+
+  if (pos == beg) {
+    return beg;
+  }
+
+  // A position right after a line feed already starts a line.
+  eol = memchr(pos - 1, '\n', (size_t)(end - pos + 1));
+  if (eol == NULL) {
+    return end;
+  }
+
+  return eol + 1;
+}
+
+/// Split a report into parts of whole lines, one for each thread. Small
+/// reports are split into fewer parts, so that the threads do not cost more
+/// than they save.
+/// @return number of parts
+///
+/// @param[out] pt   parts
+/// @param[in]  beg  first byte of the report
+/// @param[in]  len  length of the report
+/// @param[in]  cf   configuration
+static uint64_t
+split_report(struct part* pt,
+             const char* beg,
+             const uint64_t len,
+             const struct config* cf)
+{
+  uint64_t npt;
+  uint64_t i;
+
+  npt = len / AGG_PART_MIN + 1;
+  if (npt > cf->cf_nthr) {
+    npt = cf->cf_nthr;
+  }
+
+  for (i = 0; i < npt; i++) {
+    pt[i].pt_beg = align_line(beg, beg + len, beg + len * i / npt);
+  }
+  for (i = 0; i < npt; i++) {
+    pt[i].pt_end = i + 1 < npt ? pt[i + 1].pt_beg : beg + len;
+    pt[i].pt_cf  = cf;
+  }
+
+  return npt;
+}
+
+/// Aggregate the parts of a report in parallel.
+/// @return success/failure indication
+///
+/// @param[in] pt  parts
+/// @param[in] npt number of parts
+static bool
+process_parts(struct part* pt, const uint64_t npt)
+{
+  uint64_t nthr;
+  uint64_t i;
+  int reti;
+  bool retb;
+
+  // Avoid the overhead of threads in the basic case.
+  if (npt == 1) {
+    process_part(&pt[0]);
+    return pt[0].pt_ret;
+  }
+
+  for (nthr = 0; nthr < npt; nthr++) {
+    // The function returns the error number directly instead of using errno.
+    reti = pthread_create(&pt[nthr].pt_thr, NULL, part_main, &pt[nthr]);
+    if (reti != 0) {
+      log(LL_WARN, false, "unable to start thread %" PRIu64 ": %s", nthr, strerror(reti));
+      break;
+    }
+  }
+
+  retb = nthr == npt;
+  for (i = 0; i < nthr; i++) {
+    reti = pthread_join(pt[i].pt_thr, NULL);
+    if (reti != 0) {
+      log(LL_WARN, false, "unable to join thread %" PRIu64 ": %s", i, strerror(reti));
+      retb = false;
+      continue;
+    }
+
+    if (pt[i].pt_ret == false) {
+      retb = false;
+    }
+  }
+
+  return retb;
+}
+
+/// Aggregate a report file. The file is mapped into memory and its parts are
+/// parsed in parallel, each into its own table. The tables are merged in the
+/// order of the parts, so that the aggregates do not depend on the number of
+/// threads.
+/// @return success/failure indication
+///
+/// @param[out] tb   aggregates
+/// @param[out] nlin number of aggregated lines
+/// @param[out] nbad number of malformed lines
+/// @param[out] nbyt number of processed bytes
+/// @param[in]  pt   parts with their tables
+/// @param[in]  path path to the report
+/// @param[in]  cf   configuration
+static bool
+aggregate_file(struct table* tb,
+               uint64_t* nlin,
+               uint64_t* nbad,
+               uint64_t* nbyt,
+               struct part* pt,
+               const char* path,
+               const struct config* cf)
+{
+  struct stat sb;
+  void* map;
+  uint64_t npt;
+  uint64_t i;
+  int fd;
+  int reti;
+  bool retb;
+
+  fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    log(LL_WARN, true, "unable to open the report %s", path);
+    return false;
+  }
+
+  reti = fstat(fd, &sb);
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to obtain the size of the report %s", path);
+    (void)close(fd);
+    return false;
+  }
+
+  if (sb.st_size == 0) {
+    (void)close(fd);
+    return true;
+  }
+
+  map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  (void)close(fd);
+  if (map == MAP_FAILED) {
+    log(LL_WARN, true, "unable to map the report %s", path);
+    return false;
+  }
+
+  // Each part is read from the start to the end exactly once.
+  (void)posix_madvise(map, (size_t)sb.st_size, POSIX_MADV_SEQUENTIAL);
+
+  npt  = split_report(pt, map, (uint64_t)sb.st_size, cf);
+  retb = process_parts(pt, npt);
+
+  for (i = 0; i < npt; i++) {
+    if (retb == true) {
+      retb = merge_table(tb, &pt[i].pt_tb);
+    }
+
+    *nlin += pt[i].pt_nlin;
+    *nbad += pt[i].pt_nbad;
+    pt[i].pt_nlin = 0;
+    pt[i].pt_nbad = 0;
+    clear_table(&pt[i].pt_tb);
+  }
+  *nbyt += (uint64_t)sb.st_size;
+
+  (void)munmap(map, (size_t)sb.st_size);
+  return retb;
+}
+
+/// Aggregation of the requester reports. All files are aggregated together
+/// and the aggregates are printed to the standard output.
+int
+main(int argc, char* argv[])
+{
+  struct config cf;
+  struct table tb;
+  struct part* pt;
+  uint64_t nlin;
+  uint64_t nbad;
+  uint64_t nbyt;
+  uint64_t beg;
+  uint64_t dur;
+  uint64_t i;
+  bool retb;
+
+  log_lvl = LL_WARN;
+  log_col = isatty(STDERR_FILENO) == 1;
+
+  retb = parse_config(&cf, argc, argv);
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to parse the configuration");
+    return EXIT_FAILURE;
+  }
+
+  if (cf.cf_verb == true) {
+    log_lvl = LL_INFO;
+  }
+
+  pt = calloc((size_t)cf.cf_nthr, sizeof(*pt));
+  if (pt == NULL) {
+    log(LL_ERROR, true, "unable to allocate memory for the parts");
+    return EXIT_FAILURE;
+  }
+
+  retb = create_table(&tb);
+  for (i = 0; i < cf.cf_nthr && retb == true; i++) {
+    retb = create_table(&pt[i].pt_tb);
+  }
+
+  nlin = 0;
+  nbad = 0;
+  nbyt = 0;
+  beg  = mono_now();
+  for (i = 0; i < cf.cf_nfile && retb == true; i++) {
+    retb = aggregate_file(&tb, &nlin, &nbad, &nbyt, pt, cf.cf_file[i], &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to aggregate the report %s", cf.cf_file[i]);
+    }
+  }
+  dur = mono_now() - beg;
+
+  if (retb == true) {
+    if (nbad > 0) {
+      log(LL_WARN, false, "skipped %" PRIu64 " malformed lines", nbad);
+    }
+
+    log(LL_INFO, false, "aggregated %" PRIu64 " lines of %" PRIu64 " bytes into %"
+        PRIu64 " records in %.3fs (%.1f MB/s)", nlin, nbyt, tb.tb_cnt,
+        (double)dur / 1e9, dur == 0 ? 0.0 : (double)nbyt * 1e3 / (double)dur);
+
+    retb = write_table(stdout, &tb, &cf);
+  }
+
+  for (i = 0; i < cf.cf_nthr; i++) {
+    delete_table(&pt[i].pt_tb);
+  }
+  delete_table(&tb);
+  free(pt);
+
+  return retb == true ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "agg/funcs.h"
+#include "agg/types.h"
+#include "common/field.h"
+
+// Columns of the requester report that are aggregated.
+#define COL_HOST_REQ     4
+#define COL_ADDR_RES     6
+#define COL_REAL_DEP_REQ 12
+#define COL_RTT          18
+#define COL_STATUS       19
+
+/// Parse the status of a request.
+/// @return success/failure indication
+///
+/// @param[out] stat status (one of STATUS_*)
+/// @param[in]  beg  first byte of the field
+/// @param[in]  end  byte after the last one
+static bool
+parse_status(uint8_t* stat, const char* beg, const char* end)
+{
+  size_t len;
+
+  len = (size_t)(end - beg);
+  if (len == 2 && memcmp(beg, "ok", 2) == 0) {
+    *stat = STATUS_OK;
+  } else if (len == 4 && memcmp(beg, "late", 4) == 0) {
+    *stat = STATUS_LATE;
+  } else if (len == 3 && memcmp(beg, "dup", 3) == 0) {
+    *stat = STATUS_DUP;
+  } else if (len == 4 && memcmp(beg, "lost", 4) == 0) {
+    *stat = STATUS_LOST;
+  } else if (len == 7 && memcmp(beg, "unknown", 7) == 0) {
+    *stat = STATUS_UNKNOWN;
+  } else if (len == 7 && memcmp(beg, "dropped", 7) == 0) {
+    *stat = STATUS_DROPPED;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/// Parse a line of the requester report. Only the columns needed by the
+/// aggregation are converted, the remaining ones are skipped by searching
+/// for the separators.
+/// @return success/failure indication
+///
+/// @param[out] ln  relevant fields of the line
+/// @param[in]  beg first byte of the line
+/// @param[in]  end byte after the last one, excluding the line feed
+bool
+parse_line(struct line* ln, const char* beg, const char* end)
+{
+  const char* sep[COL_STATUS];
+  uint8_t nsep;
+  bool retb;
+
+  nsep = find_separators(sep, COL_STATUS, beg, end);
+  if (nsep != COL_STATUS) {
+    return false;
+  }
+
+  ln->ln_host = sep[COL_HOST_REQ - 1] + 1;
+  ln->ln_hlen = (size_t)(sep[COL_HOST_REQ] - ln->ln_host);
+  if (ln->ln_hlen > NEMO_HOST_NAME_SIZE) {
+    return false;
+  }
+
+  ln->ln_addr = sep[COL_ADDR_RES - 1] + 1;
+  ln->ln_alen = (size_t)(sep[COL_ADDR_RES] - ln->ln_addr);
+  if (ln->ln_alen >= AGG_ADDR_SIZE) {
+    return false;
+  }
+
+  retb = parse_digits(&ln->ln_dep, sep[COL_REAL_DEP_REQ - 1] + 1, sep[COL_REAL_DEP_REQ]);
+  if (retb == false) {
+    return false;
+  }
+
+  // Lost requests and unknown responses have no round-trip time.
+  ln->ln_rtt = 0;
+  if (sep[COL_RTT] - sep[COL_RTT - 1] != 4 || memcmp(sep[COL_RTT - 1] + 1, "N/A", 3) != 0) {
+    retb = parse_digits(&ln->ln_rtt, sep[COL_RTT - 1] + 1, sep[COL_RTT]);
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  return parse_status(&ln->ln_stat, sep[COL_STATUS - 1] + 1, end);
+}
@@ -0,0 +1,441 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "agg/funcs.h"
+#include "agg/types.h"
+#include "common/log.h"
+
+
+/// Allocate an empty table.
+/// @return success/failure indication
+///
+/// @param[out] tb table
+bool
+create_table(struct table* tb)
+{
+  tb->tb_cap = AGG_TABLE_INIT;
+  tb->tb_cnt = 0;
+  tb->tb_rec = calloc((size_t)tb->tb_cap, sizeof(*tb->tb_rec));
+  if (tb->tb_rec == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the aggregates");
+    return false;
+  }
+
+  return true;
+}
+
+/// Release the round-trip times of all records of a table.
+///
+/// @param[in] tb table
+static void
+free_records(struct table* tb)
+{
+  uint64_t i;
+
+  for (i = 0; i < tb->tb_cap; i++) {
+    free_dist(&tb->tb_rec[i].rc_rtt);
+  }
+}
+
+/// Remove all records from a table, retaining its capacity.
+///
+/// @param[in] tb table
+void
+clear_table(struct table* tb)
+{
+  free_records(tb);
+  (void)memset(tb->tb_rec, 0, (size_t)tb->tb_cap * sizeof(*tb->tb_rec));
+  tb->tb_cnt = 0;
+}
+
+/// Release the resources of a table.
+///
+/// @param[in] tb table
+void
+delete_table(struct table* tb)
+{
+  if (tb->tb_rec != NULL) {
+    free_records(tb);
+  }
+  free(tb->tb_rec);
+  tb->tb_rec = NULL;
+  tb->tb_cap = 0;
+  tb->tb_cnt = 0;
+}
+
+/// Hash the identity of an aggregate.
+/// @return hash value
+///
+/// @param[in] ky identity
+static uint64_t
+hash_key(const struct key* ky)
+{
+  const uint8_t* b;
+  uint64_t word;
+  uint64_t h;
+  size_t i;
+
+  // The key is a multiple of eight bytes, so that it is mixed word by word.
+  b = (const uint8_t*)ky;
+  h = 0;
+  for (i = 0; i < sizeof(*ky); i += sizeof(word)) {
+    __builtin_memcpy(&word, b + i, sizeof(word));
+    h = (h ^ word) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+
+  return h;
+}
+
+/// Find the slot of an identity.
+/// @return slot of the record or the empty slot for its insertion
+///
+/// @param[in] tb   table
+/// @param[in] ky   identity
+/// @param[in] hash hash of the identity
+static struct record*
+find_slot(const struct table* tb, const struct key* ky, const uint64_t hash)
+{
+  struct record* rc;
+  uint64_t i;
+
+  // The table is never full, so that the probing always terminates.
+  for (i = hash;; i++) {
+    rc = &tb->tb_rec[i & (tb->tb_cap - 1)];
+    if (rc->rc_used == false) {
+      return rc;
+    }
+
+    if (rc->rc_hash == hash && memcmp(&rc->rc_key, ky, sizeof(*ky)) == 0) {
+      return rc;
+    }
+  }
+}
+
+/// Double the capacity of a table.
+/// @return success/failure indication
+///
+/// @param[in] tb table
+static bool
+grow_table(struct table* tb)
+{
+  struct table old;
+  struct record* rc;
+  uint64_t i;
+
+  old = *tb;
+  tb->tb_cap = old.tb_cap * 2;
+  tb->tb_rec = calloc((size_t)tb->tb_cap, sizeof(*tb->tb_rec));
+  if (tb->tb_rec == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the aggregates");
+    *tb = old;
+    return false;
+  }
+
+  for (i = 0; i < old.tb_cap; i++) {
+    if (old.tb_rec[i].rc_used == false) {
+      continue;
+    }
+
+    rc  = find_slot(tb, &old.tb_rec[i].rc_key, old.tb_rec[i].rc_hash);
+    *rc = old.tb_rec[i];
+  }
+
+  free(old.tb_rec);
+  return true;
+}
+
+/// Find the record of an identity, adding an empty one if not present.
+/// @return record (or NULL)
+///
+/// @param[in] tb   table
+/// @param[in] ky   identity
+/// @param[in] hash hash of the identity
+static struct record*
+find_record(struct table* tb, const struct key* ky, const uint64_t hash)
+{
+  struct record* rc;
+  bool retb;
+
+  rc = find_slot(tb, ky, hash);
+  if (rc->rc_used == true) {
+    return rc;
+  }
+
+  // Keep the load factor at most one half, so that the probes remain short.
+  if (2 * (tb->tb_cnt + 1) > tb->tb_cap) {
+    retb = grow_table(tb);
+    if (retb == false) {
+      return NULL;
+    }
+
+    rc = find_slot(tb, ky, hash);
+  }
+
+  rc->rc_key  = *ky;
+  rc->rc_hash = hash;
+  rc->rc_used = true;
+  tb->tb_cnt++;
+
+  return rc;
+}
+
+/// Account for the round-trip time of a timely response.
+/// @return success/failure indication
+///
+/// @param[in] rc  record
+/// @param[in] rtt round-trip time
+static bool
+add_rtt(struct record* rc, const uint64_t rtt)
+{
+  if (rc->rc_nok == 0) {
+    rc->rc_first = rtt;
+  } else {
+    rc->rc_jsum += rtt > rc->rc_last ? rtt - rc->rc_last : rc->rc_last - rtt;
+    rc->rc_njit++;
+  }
+
+  rc->rc_last = rtt;
+  rc->rc_nok++;
+  return add_dist(&rc->rc_rtt, rtt);
+}
+
+/// Account for a report line in its aggregate.
+/// @return success/failure indication
+///
+/// @param[in] tb table
+/// @param[in] ln relevant fields of the line
+/// @param[in] cf configuration
+bool
+aggregate_line(struct table* tb, const struct line* ln, const struct config* cf)
+{
+  struct key ky;
+  struct record* rc;
+
+  // Lost requests and their late responses are assigned to the bucket of
+  // their departure, so that they are accounted for together.
+  (void)memset(&ky, 0, sizeof(ky));
+  (void)memcpy(ky.ky_host, ln->ln_host, ln->ln_hlen);
+  (void)memcpy(ky.ky_addr, ln->ln_addr, ln->ln_alen);
+  ky.ky_bkt = ln->ln_dep - ln->ln_dep % cf->cf_bkt;
+
+  rc = find_record(tb, &ky, hash_key(&ky));
+  if (rc == NULL) {
+    return false;
+  }
+
+  switch (ln->ln_stat) {
+    case STATUS_OK:      return add_rtt(rc, ln->ln_rtt);
+    case STATUS_LATE:    rc->rc_nlate++;          break;
+    case STATUS_DUP:     rc->rc_ndup++;           break;
+    case STATUS_LOST:    rc->rc_nlost++;          break;
+    case STATUS_DROPPED: rc->rc_ndrop++;          break;
+    default:                                      break;
+  }
+
+  return true;
+}
+
+/// Add a record to the aggregate of the same identity. The source record must
+/// follow the destination one in the report, so that the jitter includes the
+/// difference across their boundary.
+/// @return success/failure indication
+///
+/// @param[in] dst aggregate
+/// @param[in] src record
+static bool
+merge_record(struct record* dst, const struct record* src)
+{
+  uint64_t a;
+  uint64_t b;
+
+  if (dst->rc_nok > 0 && src->rc_nok > 0) {
+    a = dst->rc_last;
+    b = src->rc_first;
+    dst->rc_jsum += a > b ? a - b : b - a;
+    dst->rc_njit++;
+  }
+
+  if (dst->rc_nok == 0) {
+    dst->rc_first = src->rc_first;
+  }
+  if (src->rc_nok > 0) {
+    dst->rc_last = src->rc_last;
+  }
+
+  dst->rc_nok   += src->rc_nok;
+  dst->rc_nlate += src->rc_nlate;
+  dst->rc_ndup  += src->rc_ndup;
+  dst->rc_nlost += src->rc_nlost;
+  dst->rc_ndrop += src->rc_ndrop;
+  dst->rc_jsum  += src->rc_jsum;
+  dst->rc_njit  += src->rc_njit;
+  return merge_dist(&dst->rc_rtt, &src->rc_rtt);
+}
+
+/// Add all records of a table to the aggregates. The source table must
+/// follow all previously merged ones in the report.
+/// @return success/failure indication
+///
+/// @param[in] dst aggregates
+/// @param[in] src table
+bool
+merge_table(struct table* dst, const struct table* src)
+{
+  struct record* rc;
+  bool retb;
+  uint64_t i;
+
+  for (i = 0; i < src->tb_cap; i++) {
+    if (src->tb_rec[i].rc_used == false) {
+      continue;
+    }
+
+    rc = find_record(dst, &src->tb_rec[i].rc_key, src->tb_rec[i].rc_hash);
+    if (rc == NULL) {
+      return false;
+    }
+
+    retb = merge_record(rc, &src->tb_rec[i]);
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Order the records by their time bucket, requester and responder.
+/// @return ordering of the records
+///
+/// @param[in] a first record
+/// @param[in] b second record
+static int
+compare_records(const void* a, const void* b)
+{
+  const struct record* x;
+  const struct record* y;
+  int reti;
+
+  x = *(const struct record* const*)a;
+  y = *(const struct record* const*)b;
+
+  if (x->rc_key.ky_bkt != y->rc_key.ky_bkt) {
+    return (x->rc_key.ky_bkt > y->rc_key.ky_bkt) - (x->rc_key.ky_bkt < y->rc_key.ky_bkt);
+  }
+
+  reti = strncmp(x->rc_key.ky_host, y->rc_key.ky_host, sizeof(x->rc_key.ky_host));
+  if (reti != 0) {
+    return reti;
+  }
+
+  return strncmp(x->rc_key.ky_addr, y->rc_key.ky_addr, sizeof(x->rc_key.ky_addr));
+}
+
+/// Write a percentile of the round-trip times.
+///
+/// @param[in] fp  output stream
+/// @param[in] rc  record
+/// @param[in] pct percentile
+static void
+write_quantile(FILE* fp, const struct record* rc, const uint64_t pct)
+{
+  if (rc->rc_nok == 0) {
+    (void)fprintf(fp, ",N/A");
+    return;
+  }
+
+  (void)fprintf(fp, ",%" PRIu64, quantile_dist(&rc->rc_rtt, pct));
+}
+
+/// Write a single aggregate in the CSV format.
+///
+/// @param[in] fp output stream
+/// @param[in] rc record
+/// @param[in] cf configuration
+static void
+write_record(FILE* fp, const struct record* rc, const struct config* cf)
+{
+  uint64_t nsent;
+  uint64_t i;
+
+  // Responses that arrived after their deadline were reported as lost first.
+  // Dropped requests were never sent and do not count towards the loss.
+  nsent = rc->rc_nok + rc->rc_nlost;
+
+  (void)fprintf(fp, "%" PRIu64 ",%.*s,%.*s,%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                    ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.3f",
+                rc->rc_key.ky_bkt,
+                (int)sizeof(rc->rc_key.ky_host), rc->rc_key.ky_host,
+                (int)sizeof(rc->rc_key.ky_addr), rc->rc_key.ky_addr,
+                nsent + rc->rc_ndrop, rc->rc_nok, rc->rc_nlate, rc->rc_ndup,
+                rc->rc_nlost, rc->rc_ndrop,
+                nsent == 0 ? 0.0 : 100.0 * (double)rc->rc_nlost / (double)nsent);
+
+  if (rc->rc_nok == 0) {
+    (void)fprintf(fp, ",N/A");
+  } else {
+    (void)fprintf(fp, ",%" PRIu64, rc->rc_rtt.dt_sum / rc->rc_nok);
+  }
+
+  for (i = 0; i < cf->cf_nq; i++) {
+    write_quantile(fp, rc, cf->cf_q[i]);
+  }
+
+  if (rc->rc_njit == 0) {
+    (void)fprintf(fp, ",N/A\n");
+  } else {
+    (void)fprintf(fp, ",%" PRIu64 "\n", rc->rc_jsum / rc->rc_njit);
+  }
+}
+
+/// Write all aggregates in the CSV format, ordered by their time bucket,
+/// requester and responder.
+/// @return success/failure indication
+///
+/// @param[in] fp output stream
+/// @param[in] tb aggregates
+/// @param[in] cf configuration
+bool
+write_table(FILE* fp, const struct table* tb, const struct config* cf)
+{
+  const struct record** ord;
+  uint64_t n;
+  uint64_t i;
+
+  ord = calloc((size_t)tb->tb_cnt + 1, sizeof(*ord));
+  if (ord == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the ordering");
+    return false;
+  }
+
+  n = 0;
+  for (i = 0; i < tb->tb_cap; i++) {
+    if (tb->tb_rec[i].rc_used == true) {
+      ord[n++] = &tb->tb_rec[i];
+    }
+  }
+  qsort(ord, (size_t)n, sizeof(*ord), compare_records);
+
+  (void)fprintf(fp, "bucket,host_req,addr_res,requests,ok,late,dup,lost,"
+                    "dropped,loss_pct,rtt_mean");
+  for (i = 0; i < cf->cf_nq; i++) {
+    (void)fprintf(fp, ",rtt_p%" PRIu64, cf->cf_q[i]);
+  }
+  (void)fprintf(fp, ",jitter\n");
+
+  for (i = 0; i < n; i++) {
+    write_record(fp, ord[i], cf);
+  }
+
+  free(ord);
+  return true;
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_AGG_TYPES_H
+#define NEMO_AGG_TYPES_H
+
+#include <pthread.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "common/payload.h"
+
+
+// Maximal number of reported percentiles.
+#define AGG_QUANT_MAX 8
+
+// Maximal number of parsing threads.
+#define AGG_THREAD_MAX 256
+
+// Minimal size of the part of a file assigned to a single thread.
+#define AGG_PART_MIN (1ULL << 20)
+
+// Initial number of records of a table.
+#define AGG_TABLE_INIT 1024
+
+// Size of the textual responder address, including the terminating byte.
+#define AGG_ADDR_SIZE 48
+
+// Precision of the round-trip time distribution. Each power of two is split
+// into 2^DIST_SUB bins, which bounds the relative error of a percentile by
+// 2^-DIST_SUB. Values below 2^DIST_SUB have a bin each.
+#define DIST_SUB  5
+#define DIST_BINS ((64 - DIST_SUB + 1) << DIST_SUB)
+
+// Status of a report line.
+#define STATUS_OK      0
+#define STATUS_LATE    1
+#define STATUS_DUP     2
+#define STATUS_LOST    3
+#define STATUS_UNKNOWN 4
+#define STATUS_DROPPED 5
+
+/// Aggregation configuration.
+struct config {
+  uint64_t cf_bkt;                 ///< Width of a time bucket.
+  uint64_t cf_nthr;                ///< Number of parsing threads.
+  uint64_t cf_q[AGG_QUANT_MAX];    ///< Reported percentiles.
+  uint64_t cf_nq;                  ///< Number of reported percentiles.
+  char**   cf_file;                ///< Report files.
+  uint64_t cf_nfile;               ///< Number of report files.
+  bool     cf_verb;                ///< Report the processing throughput.
+  uint8_t  cf_pad[7];              ///< Padding (unused).
+};
+
+/// Relevant fields of a report line. The strings point into the report and
+/// are not terminated.
+struct line {
+  const char* ln_host; ///< Host name of the requester.
+  const char* ln_addr; ///< Address of the responder.
+  size_t      ln_hlen; ///< Length of the host name.
+  size_t      ln_alen; ///< Length of the address.
+  uint64_t    ln_dep;  ///< Real-time departure of the request.
+  uint64_t    ln_rtt;  ///< Round-trip time (0 if not available).
+  uint8_t     ln_stat; ///< Status of the request (one of STATUS_*).
+  uint8_t     ln_pad[7]; ///< Padding (unused).
+};
+
+/// Identity of an aggregate. The strings are padded with zero bytes, so that
+/// keys can be compared as a whole.
+struct key {
+  char     ky_host[NEMO_HOST_NAME_SIZE]; ///< Host name of the requester.
+  char     ky_addr[AGG_ADDR_SIZE];       ///< Address of the responder.
+  uint64_t ky_bkt;                       ///< Start of the time bucket.
+};
+
+/// Log-linear distribution of round-trip times. Only the range of bins
+/// between the smallest and the largest value is allocated, along with some
+/// room for the nearby values.
+struct dist {
+  uint64_t* dt_bin; ///< Number of values in each allocated bin (or NULL).
+  uint64_t  dt_cnt; ///< Number of all values.
+  uint64_t  dt_sum; ///< Sum of all values.
+  uint32_t  dt_lo;  ///< Index of the first allocated bin.
+  uint32_t  dt_len; ///< Number of allocated bins.
+};
+
+/// Aggregate of the requests of a requester to a responder within a time
+/// bucket. All values are mergeable, so that parts of a report can be
+/// aggregated separately. The jitter is the mean absolute difference of the
+/// round-trip times of consecutive responses, and therefore the first and the
+/// last round-trip time are retained to join the adjacent parts.
+struct record {
+  struct key  rc_key;   ///< Identity.
+  struct dist rc_rtt;   ///< Round-trip times of timely responses.
+  uint64_t    rc_hash;  ///< Hash of the identity.
+  uint64_t    rc_nok;   ///< Number of timely responses.
+  uint64_t    rc_nlate; ///< Number of late responses.
+  uint64_t    rc_ndup;  ///< Number of duplicate responses.
+  uint64_t    rc_nlost; ///< Number of lost requests.
+  uint64_t    rc_ndrop; ///< Number of requests dropped by the requester.
+  uint64_t    rc_first; ///< First round-trip time.
+  uint64_t    rc_last;  ///< Last round-trip time.
+  uint64_t    rc_jsum;  ///< Sum of the round-trip time differences.
+  uint64_t    rc_njit;  ///< Number of the round-trip time differences.
+  bool        rc_used;  ///< Slot occupancy.
+  uint8_t     rc_pad[7]; ///< Padding (unused).
+};
+
+/// Open-addressing hash table of aggregates.
+struct table {
+  struct record* tb_rec; ///< Records.
+  uint64_t       tb_cap; ///< Number of slots (power of two).
+  uint64_t       tb_cnt; ///< Number of used slots.
+};
+
+/// Part of a report file processed by a single thread.
+struct part {
+  pthread_t            pt_thr;  ///< Thread handle.
+  const char*          pt_beg;  ///< First byte.
+  const char*          pt_end;  ///< Byte after the last one.
+  struct table         pt_tb;   ///< Aggregates of the part.
+  uint64_t             pt_nlin; ///< Number of aggregated lines.
+  uint64_t             pt_nbad; ///< Number of malformed lines.
+  const struct config* pt_cf;   ///< Configuration.
+  bool                 pt_ret;  ///< Return value.
+  uint8_t              pt_pad[7]; ///< Padding (unused).
+};
+
+#endif
@@ -0,0 +1,209 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench/funcs.h"
+#include "bench/types.h"
+#include "common/log.h"
+#include "common/parse.h"
+#include "common/payload.h"
+
+
+// Default values.
+#define DEF_TARGETS   "1,16"
+#define DEF_INTERVALS "10ms,1ms"
+#define DEF_LENGTHS   "128,1400"
+#define DEF_DURATION  2000000000ULL ///< Two seconds per point.
+#define DEF_INSTANCES 1             ///< Single requester.
+#define DEF_PORT      24000         ///< UDP port of the first point.
+#define DEF_THRESHOLD 25            ///< Tolerate a 25% deterioration.
+#define DEF_BIN       "bin"         ///< Directory with the executables.
+
+/// Print the usage information to the standard output stream.
+static void
+print_usage(void)
+{
+  (void)printf(
+    "About:\n"
+    "  End-to-end benchmark of ureq and ures on the loopback interface.\n\n"
+
+    "Usage:\n"
+    "  nemo-bench [OPTIONS]\n\n"
+
+    "Options:\n"
+    "  -b FILE Baseline to compare the results against.\n"
+    "  -d DUR  Duration of each measurement point. (def=2s)\n"
+    "  -h      Print this help message.\n"
+    "  -i LIST Comma-separated round intervals. (def=" DEF_INTERVALS ")\n"
+    "  -l LIST Comma-separated payload lengths. (def=" DEF_LENGTHS ")\n"
+    "  -n CNT  Number of requester instances. (def=%d)\n"
+    "  -o FILE Store the results in a file.\n"
+    "  -p NUM  UDP port of the first point. (def=%d)\n"
+    "  -r PCT  Regression threshold in percent. (def=%d)\n"
+    "  -t LIST Comma-separated target counts. (def=" DEF_TARGETS ")\n"
+    "  -v      Pass through the logging output of the processes.\n"
+    "  -x DIR  Directory with the ureq and ures executables. (def=" DEF_BIN ")\n",
+    DEF_INSTANCES, DEF_PORT, DEF_THRESHOLD);
+}
+
+/// Parse a comma-separated list of values.
+/// @return success/failure indication
+///
+/// @param[out] out  values
+/// @param[out] nout number of values
+/// @param[in]  inp  input string
+/// @param[in]  name default unit
+/// @param[in]  min  minimal value
+/// @param[in]  max  maximal value
+/// @param[in]  func unit conversion function
+static bool
+parse_list(uint64_t out[static BENCH_SWEEP_MAX],
+           uint64_t* nout,
+           const char* inp,
+           const char* name,
+           const uint64_t min,
+           const uint64_t max,
+           bool (*func) (uint64_t*, const char*))
+{
+  char* str;
+  char* tok;
+  char* save;
+  bool retb;
+
+  str = strdup(inp);
+  if (str == NULL) {
+    log(LL_WARN, true, "unable to copy the list");
+    return false;
+  }
+
+  *nout = 0;
+  retb  = true;
+  for (tok = strtok_r(str, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+    if (*nout == BENCH_SWEEP_MAX) {
+      log(LL_WARN, false, "list has more than %d values", BENCH_SWEEP_MAX);
+      retb = false;
+      break;
+    }
+
+    if (func == NULL) {
+      retb = parse_uint64(&out[*nout], tok, min, max);
+    } else {
+      retb = parse_scalar(&out[*nout], tok, name, min, max, func);
+    }
+
+    if (retb == false) {
+      break;
+    }
+
+    (*nout)++;
+  }
+
+  free(str);
+
+  if (retb == true && *nout == 0) {
+    log(LL_WARN, false, "list is empty");
+    return false;
+  }
+
+  return retb;
+}
+
+/// Parse the command-line options.
+/// @return success/failure indication
+///
+/// @param[out] cf   configuration
+/// @param[in]  argc argument count
+/// @param[in]  argv argument vector
+bool
+parse_config(struct config* cf, int argc, char* argv[])
+{
+  const char* ntg;
+  const char* itv;
+  const char* len;
+  int opt;
+  bool retb;
+
+  (void)memset(cf, 0, sizeof(*cf));
+  cf->cf_dur  = DEF_DURATION;
+  cf->cf_inst = DEF_INSTANCES;
+  cf->cf_port = DEF_PORT;
+  cf->cf_thr  = DEF_THRESHOLD;
+  cf->cf_bin  = DEF_BIN;
+  cf->cf_out  = NULL;
+  cf->cf_base = NULL;
+  cf->cf_verb = false;
+
+  ntg = DEF_TARGETS;
+  itv = DEF_INTERVALS;
+  len = DEF_LENGTHS;
+
+  while ((opt = getopt(argc, argv, "b:d:hi:l:n:o:p:r:t:vx:")) != -1) {
+    retb = true;
+
+    if (opt == 'b') {
+      cf->cf_base = optarg;
+    } else if (opt == 'd') {
+      retb = parse_scalar(&cf->cf_dur, optarg, "ns", 1, UINT64_MAX, parse_time_unit);
+    } else if (opt == 'i') {
+      itv = optarg;
+    } else if (opt == 'l') {
+      len = optarg;
+    } else if (opt == 'n') {
+      retb = parse_uint64(&cf->cf_inst, optarg, 1, BENCH_INST_MAX);
+    } else if (opt == 'o') {
+      cf->cf_out = optarg;
+    } else if (opt == 'p') {
+      retb = parse_uint64(&cf->cf_port, optarg, 1, 65535);
+    } else if (opt == 'r') {
+      retb = parse_uint64(&cf->cf_thr, optarg, 0, 1000);
+    } else if (opt == 't') {
+      ntg = optarg;
+    } else if (opt == 'v') {
+      cf->cf_verb = true;
+    } else if (opt == 'x') {
+      cf->cf_bin = optarg;
+    } else {
+      print_usage();
+      exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (retb == false) {
+      log(LL_WARN, false, "invalid value of option '%c'", opt);
+      return false;
+    }
+  }
+
+  retb = parse_list(cf->cf_ntg, &cf->cf_nntg, ntg, NULL, 1, 65534, NULL);
+  if (retb == false) {
+    log(LL_WARN, false, "invalid list of target counts");
+    return false;
+  }
+
+  retb = parse_list(cf->cf_int, &cf->cf_nint, itv, "ns", 1, UINT64_MAX, parse_time_unit);
+  if (retb == false) {
+    log(LL_WARN, false, "invalid list of round intervals");
+    return false;
+  }
+
+  retb = parse_list(cf->cf_len, &cf->cf_nlen, len, NULL, NEMO_PAYLOAD_SIZE, 64436, NULL);
+  if (retb == false) {
+    log(LL_WARN, false, "invalid list of payload lengths");
+    return false;
+  }
+
+  // Each point uses its own port, so that late datagrams of one point do not
+  // reach the processes of the next one.
+  if (cf->cf_port + cf->cf_nntg * cf->cf_nint * cf->cf_nlen > 65536) {
+    log(LL_WARN, false, "not enough ports for all points");
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_BENCH_FUNCS_H
+#define NEMO_BENCH_FUNCS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bench/types.h"
+
+
+// Configuration.
+bool parse_config(struct config* cf, int argc, char* argv[]);
+
+// Measurement.
+bool run_point(struct result* rs,
+               const struct point* pt,
+               const uint64_t port,
+               const struct config* cf);
+
+// Results.
+void write_header(FILE* fp);
+void write_result(FILE* fp, const struct result* rs);
+bool compare_results(bool* regr,
+                     const struct result* rs,
+                     const uint64_t nrs,
+                     const struct config* cf);
+
+#endif
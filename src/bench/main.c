@@ -0,0 +1,109 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "bench/funcs.h"
+#include "bench/types.h"
+#include "common/log.h"
+
+
+/// End-to-end benchmark of the requester and the responder. All combinations
+/// of the swept parameters are measured one after another, the results are
+/// printed to the standard output and optionally stored in a file, and then
+/// compared against the baseline.
+int
+main(int argc, char* argv[])
+{
+  struct config cf;
+  struct result* rs;
+  struct point pt;
+  FILE* fp;
+  uint64_t nrs;
+  uint64_t i;
+  uint64_t j;
+  uint64_t k;
+  bool retb;
+  bool regr;
+
+  log_lvl = LL_WARN;
+  log_col = isatty(STDERR_FILENO) == 1;
+
+  retb = parse_config(&cf, argc, argv);
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to parse the configuration");
+    return EXIT_FAILURE;
+  }
+
+  rs = calloc((size_t)(cf.cf_nntg * cf.cf_nint * cf.cf_nlen), sizeof(*rs));
+  if (rs == NULL) {
+    log(LL_ERROR, true, "unable to allocate memory for results");
+    return EXIT_FAILURE;
+  }
+
+  write_header(stdout);
+
+  nrs = 0;
+  for (i = 0; i < cf.cf_nntg; i++) {
+    for (j = 0; j < cf.cf_nint; j++) {
+      for (k = 0; k < cf.cf_nlen; k++) {
+        pt.pt_ntg  = cf.cf_ntg[i];
+        pt.pt_int  = cf.cf_int[j];
+        pt.pt_len  = cf.cf_len[k];
+        pt.pt_inst = cf.cf_inst;
+
+        retb = run_point(&rs[nrs], &pt, cf.cf_port + nrs, &cf);
+        if (retb == false) {
+          log(LL_ERROR, false, "measurement of point %" PRIu64 " has failed", nrs + 1);
+          free(rs);
+          return EXIT_FAILURE;
+        }
+
+        write_result(stdout, &rs[nrs]);
+        (void)fflush(stdout);
+        nrs++;
+      }
+    }
+  }
+
+  // Store the results, so that they can serve as a future baseline.
+  if (cf.cf_out != NULL) {
+    fp = fopen(cf.cf_out, "w");
+    if (fp == NULL) {
+      log(LL_ERROR, true, "unable to open the results file %s", cf.cf_out);
+      free(rs);
+      return EXIT_FAILURE;
+    }
+
+    write_header(fp);
+    for (i = 0; i < nrs; i++) {
+      write_result(fp, &rs[i]);
+    }
+    (void)fclose(fp);
+  }
+
+  regr = false;
+  if (cf.cf_base != NULL) {
+    retb = compare_results(&regr, rs, nrs, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to compare the results against the baseline");
+      free(rs);
+      return EXIT_FAILURE;
+    }
+  }
+
+  free(rs);
+
+  if (regr == true) {
+    log(LL_ERROR, false, "performance has regressed beyond %" PRIu64 "%%", cf.cf_thr);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,559 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "bench/funcs.h"
+#include "bench/types.h"
+#include "common/convert.h"
+#include "common/log.h"
+
+
+/// Start a process with its standard output redirected.
+/// @return success/failure indication
+///
+/// @param[out] pid  process identifier
+/// @param[in]  argv argument vector
+/// @param[in]  out  standard output descriptor (-1 to discard the output)
+/// @param[in]  cf   configuration
+static bool
+spawn_process(pid_t* pid, char* argv[], const int out, const struct config* cf)
+{
+  int null;
+
+  *pid = fork();
+  if (*pid == -1) {
+    log(LL_WARN, true, "unable to create a process for %s", argv[0]);
+    return false;
+  }
+
+  if (*pid > 0) {
+    return true;
+  }
+
+  // The child process only redirects its streams and executes the program.
+  null = open("/dev/null", O_WRONLY);
+  if (null == -1) {
+    _exit(127);
+  }
+
+  (void)dup2(out == -1 ? null : out, STDOUT_FILENO);
+  if (cf->cf_verb == false) {
+    (void)dup2(null, STDERR_FILENO);
+  }
+
+  (void)execv(argv[0], argv);
+  _exit(127);
+}
+
+/// Forcibly terminate a process and collect its resource usage.
+/// @return success/failure indication of the process
+///
+/// @param[out] ru  resource usage (can be NULL)
+/// @param[in]  pid process identifier
+/// @param[in]  sig signal to send (0 to wait for the natural exit)
+static bool
+reap_process(struct rusage* ru, const pid_t pid, const int sig)
+{
+  struct rusage tmp;
+  pid_t retp;
+  int st;
+
+  if (sig != 0) {
+    (void)kill(pid, sig);
+  }
+
+  do {
+    retp = wait4(pid, &st, 0, ru == NULL ? &tmp : ru);
+  } while (retp == -1 && errno == EINTR);
+
+  if (retp == -1) {
+    log(LL_WARN, true, "unable to wait for process %d", (int)pid);
+    return false;
+  }
+
+  // Processes terminated by the harness are expected to die by the signal.
+  if (sig != 0) {
+    return true;
+  }
+
+  return WIFEXITED(st) && WEXITSTATUS(st) == 0;
+}
+
+/// Convert the resource usage into the consumed CPU time.
+/// @return user and system time in nanoseconds
+///
+/// @param[in] ru resource usage
+static uint64_t
+cpu_time(const struct rusage* ru)
+{
+  return ((uint64_t)ru->ru_utime.tv_sec + (uint64_t)ru->ru_stime.tv_sec) * 1000000000ULL
+       + ((uint64_t)ru->ru_utime.tv_usec + (uint64_t)ru->ru_stime.tv_usec) * 1000ULL;
+}
+
+/// Start the responder of the point.
+/// @return success/failure indication
+///
+/// @param[out] pid  process identifier
+/// @param[in]  port UDP port
+/// @param[in]  cf   configuration
+static bool
+start_responder(pid_t* pid, const uint64_t port, const struct config* cf)
+{
+  char path[256];
+  char pstr[8];
+  char* argv[7];
+  struct timespec ts;
+  pid_t retp;
+  int st;
+  bool retb;
+
+  (void)snprintf(path, sizeof(path), "%s/ures", cf->cf_bin);
+  (void)snprintf(pstr, sizeof(pstr), "%" PRIu64, port);
+
+  argv[0] = path;
+  argv[1] = "-n";
+  argv[2] = "-q";
+  argv[3] = "-p";
+  argv[4] = pstr;
+  argv[5] = NULL;
+
+  retb = spawn_process(pid, argv, -1, cf);
+  if (retb == false) {
+    return false;
+  }
+
+  // Give the responder time to bind its socket, and make sure it did.
+  fnanos(&ts, BENCH_SETTLE);
+  (void)nanosleep(&ts, NULL);
+
+  retp = waitpid(*pid, &st, WNOHANG);
+  if (retp != 0) {
+    if (retp == *pid) {
+      *pid = -1;
+    }
+    log(LL_WARN, false, "responder has terminated prematurely");
+    return false;
+  }
+
+  return true;
+}
+
+/// Start a requester instance of the point.
+/// @return success/failure indication
+///
+/// @param[out] sm   report stream
+/// @param[in]  pt   measurement point
+/// @param[in]  port UDP port
+/// @param[in]  key  key of the instance
+/// @param[in]  cf   configuration
+static bool
+start_requester(struct stream* sm,
+                const struct point* pt,
+                const uint64_t port,
+                const uint64_t key,
+                const struct config* cf)
+{
+  char path[256];
+  char opts[6][32];
+  char (*tgs)[16];
+  char** argv;
+  uint64_t cnt;
+  uint64_t addr;
+  uint64_t i;
+  int pfd[2];
+  int reti;
+  bool retb;
+
+  argv = calloc((size_t)pt->pt_ntg + 18, sizeof(*argv));
+  tgs  = calloc((size_t)pt->pt_ntg, sizeof(*tgs));
+  if (argv == NULL || tgs == NULL) {
+    log(LL_WARN, true, "unable to allocate the arguments of the requester");
+    free(argv);
+    free(tgs);
+    return false;
+  }
+
+  // The number of rounds is selected so that the point lasts the requested
+  // duration.
+  cnt = cf->cf_dur / pt->pt_int;
+  if (cnt == 0) {
+    cnt = 1;
+  }
+
+  (void)snprintf(path,    sizeof(path),    "%s/ureq", cf->cf_bin);
+  (void)snprintf(opts[0], sizeof(opts[0]), "%" PRIu64, port);
+  (void)snprintf(opts[1], sizeof(opts[1]), "%" PRIu64, cnt);
+  (void)snprintf(opts[2], sizeof(opts[2]), "%" PRIu64 "ns", pt->pt_int);
+  (void)snprintf(opts[3], sizeof(opts[3]), "%" PRIu64 "b", pt->pt_len);
+  (void)snprintf(opts[4], sizeof(opts[4]), "%" PRIu64, key);
+  (void)snprintf(opts[5], sizeof(opts[5]), "%" PRIu64, pt->pt_ntg);
+
+  argv[0]  = path;
+  argv[1]  = "-n";
+  argv[2]  = "-p"; argv[3]  = opts[0];
+  argv[4]  = "-c"; argv[5]  = opts[1];
+  argv[6]  = "-i"; argv[7]  = opts[2];
+  argv[8]  = "-l"; argv[9]  = opts[3];
+  argv[10] = "-k"; argv[11] = opts[4];
+  argv[12] = "-j"; argv[13] = opts[5];
+  argv[14] = "-w"; argv[15] = "500ms";
+
+  // Each target is a distinct address of the loopback network.
+  for (i = 0; i < pt->pt_ntg; i++) {
+    addr = i + 1;
+    (void)snprintf(tgs[i], sizeof(tgs[i]), "127.%" PRIu64 ".%" PRIu64 ".%" PRIu64,
+                   (addr >> 16) & 0xff, (addr >> 8) & 0xff, addr & 0xff);
+    argv[16 + i] = tgs[i];
+  }
+  argv[16 + pt->pt_ntg] = NULL;
+
+  retb = false;
+  reti = pipe(pfd);
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to create a pipe");
+  } else {
+    // Prevent other requesters from inheriting the pipe, as that would delay
+    // the end of the stream.
+    (void)fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+    (void)fcntl(pfd[1], F_SETFD, FD_CLOEXEC);
+
+    retb = spawn_process(&sm->sm_pid, argv, pfd[1], cf);
+    (void)close(pfd[1]);
+    if (retb == false) {
+      (void)close(pfd[0]);
+    } else {
+      sm->sm_fd  = pfd[0];
+      sm->sm_len = 0;
+    }
+  }
+
+  free(argv);
+  free(tgs);
+
+  return retb;
+}
+
+/// Extract the round-trip time from a line of the requester report. The last
+/// five columns are the departure of the request, the arrivals of the request
+/// and the response, the round-trip time and the status of the request. Only
+/// the requests that received their response are taken into account.
+/// @return success/failure indication
+///
+/// @param[out] rtt  round-trip time
+/// @param[out] dep  departure of the request
+/// @param[out] arr  arrival of the response
+/// @param[in]  line report line
+static bool
+parse_line(uint64_t* rtt, uint64_t* dep, uint64_t* arr, char* line)
+{
+  char* col[5];
+  uint8_t i;
+
+  // Skip the header of the report.
+  if (line[0] < '0' || line[0] > '9') {
+    return false;
+  }
+
+  for (i = 0; i < 5; i++) {
+    col[i] = strrchr(line, ',');
+    if (col[i] == NULL) {
+      return false;
+    }
+    *col[i] = '\0';
+  }
+
+  // Responses after the deadline also count, as their requests were not lost
+  // by the network.
+  if (strcmp(col[0] + 1, "ok") != 0 && strcmp(col[0] + 1, "late") != 0) {
+    return false;
+  }
+
+  *rtt = strtoull(col[1] + 1, NULL, 10);
+  *arr = strtoull(col[2] + 1, NULL, 10);
+  *dep = strtoull(col[4] + 1, NULL, 10);
+  if (*arr < *dep) {
+    return false;
+  }
+
+  return true;
+}
+
+/// Consume the available report lines of a requester.
+///
+/// @param[out] rs  result
+/// @param[out] rtt round-trip times
+/// @param[in]  cap capacity of the round-trip times
+/// @param[out] beg first departure
+/// @param[out] end last arrival
+/// @param[in]  sm  report stream
+static void
+read_stream(struct result* rs,
+            uint64_t* rtt,
+            const uint64_t cap,
+            uint64_t* beg,
+            uint64_t* end,
+            struct stream* sm)
+{
+  ssize_t n;
+  char* eol;
+  char* line;
+  uint64_t val;
+  uint64_t dep;
+  uint64_t arr;
+  bool retb;
+
+  n = read(sm->sm_fd, sm->sm_buf + sm->sm_len, sizeof(sm->sm_buf) - sm->sm_len - 1);
+  if (n == -1 && errno == EINTR) {
+    return;
+  }
+
+  if (n <= 0) {
+    (void)close(sm->sm_fd);
+    sm->sm_fd = -1;
+    return;
+  }
+
+  sm->sm_len += (size_t)n;
+  sm->sm_buf[sm->sm_len] = '\0';
+
+  line = sm->sm_buf;
+  while ((eol = strchr(line, '\n')) != NULL) {
+    *eol = '\0';
+
+    retb = parse_line(&val, &dep, &arr, line);
+    if (retb == true && rs->rs_recv < cap) {
+      rtt[rs->rs_recv++] = val;
+      if (*beg == 0 || dep < *beg) {
+        *beg = dep;
+      }
+      if (arr > *end) {
+        *end = arr;
+      }
+    }
+
+    line = eol + 1;
+  }
+
+  // Retain the partial line, unless it can never be completed.
+  sm->sm_len -= (size_t)(line - sm->sm_buf);
+  if (sm->sm_len == sizeof(sm->sm_buf) - 1) {
+    log(LL_WARN, false, "dropping an overly long report line");
+    sm->sm_len = 0;
+  }
+  (void)memmove(sm->sm_buf, line, sm->sm_len);
+}
+
+/// Comparison of two round-trip times.
+/// @return ordering of the values
+///
+/// @param[in] a first value
+/// @param[in] b second value
+static int
+compare_rtt(const void* a, const void* b)
+{
+  uint64_t x;
+  uint64_t y;
+
+  x = *(const uint64_t*)a;
+  y = *(const uint64_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+/// Select a percentile from the sorted round-trip times.
+/// @return percentile
+///
+/// @param[in] rtt round-trip times
+/// @param[in] n   number of round-trip times
+/// @param[in] pct percentile
+static uint64_t
+percentile(const uint64_t* rtt, const uint64_t n, const uint64_t pct)
+{
+  if (n == 0) {
+    return 0;
+  }
+
+  return rtt[((n - 1) * pct) / 100];
+}
+
+/// Compute the result of a point from the collected measurements.
+///
+/// @param[out] rs  result
+/// @param[in]  rtt round-trip times
+/// @param[in]  beg first departure
+/// @param[in]  end last arrival
+/// @param[in]  req requester CPU time
+/// @param[in]  res responder CPU time
+static void
+compute_result(struct result* rs,
+               uint64_t* rtt,
+               const uint64_t beg,
+               const uint64_t end,
+               const uint64_t req,
+               const uint64_t res)
+{
+  qsort(rtt, (size_t)rs->rs_recv, sizeof(*rtt), compare_rtt);
+
+  rs->rs_p50 = percentile(rtt, rs->rs_recv, 50);
+  rs->rs_p90 = percentile(rtt, rs->rs_recv, 90);
+  rs->rs_p99 = percentile(rtt, rs->rs_recv, 99);
+  rs->rs_max = percentile(rtt, rs->rs_recv, 100);
+
+  rs->rs_loss = 100.0 * (double)(rs->rs_sent - rs->rs_recv) / (double)rs->rs_sent;
+  rs->rs_cpq  = (double)req / (double)rs->rs_sent;
+  rs->rs_cps  = (double)res / (double)rs->rs_sent;
+
+  rs->rs_pps = 0.0;
+  if (end > beg) {
+    rs->rs_pps = (double)rs->rs_recv * 1e9 / (double)(end - beg);
+  }
+}
+
+/// Measure a single point of the sweep. The responder and all requesters are
+/// started, the reports of the requesters are collected until they exit, and
+/// the responder is terminated afterwards.
+/// @return success/failure indication
+///
+/// @param[out] rs   result
+/// @param[in]  pt   measurement point
+/// @param[in]  port UDP port
+/// @param[in]  cf   configuration
+bool
+run_point(struct result* rs,
+          const struct point* pt,
+          const uint64_t port,
+          const struct config* cf)
+{
+  struct stream sm[BENCH_INST_MAX];
+  struct pollfd pfd[BENCH_INST_MAX];
+  struct rusage ru;
+  uint64_t* rtt;
+  uint64_t cnt;
+  uint64_t req;
+  uint64_t res;
+  uint64_t beg;
+  uint64_t end;
+  uint64_t nopen;
+  uint64_t nsm;
+  uint64_t i;
+  uint64_t k;
+  pid_t rpid;
+  int reti;
+  bool retb;
+  bool fail;
+
+  (void)memset(rs, 0, sizeof(*rs));
+  rs->rs_pt = *pt;
+
+  cnt = cf->cf_dur / pt->pt_int;
+  if (cnt == 0) {
+    cnt = 1;
+  }
+  rs->rs_sent = cnt * pt->pt_ntg * pt->pt_inst;
+
+  rtt = malloc((size_t)rs->rs_sent * sizeof(*rtt));
+  if (rtt == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for round-trip times");
+    return false;
+  }
+
+  rpid = -1;
+  retb = start_responder(&rpid, port, cf);
+  if (retb == false) {
+    if (rpid > 0) {
+      (void)reap_process(NULL, rpid, SIGKILL);
+    }
+    free(rtt);
+    return false;
+  }
+
+  fail = false;
+  for (nsm = 0; nsm < pt->pt_inst; nsm++) {
+    retb = start_requester(&sm[nsm], pt, port, nsm + 1, cf);
+    if (retb == false) {
+      fail = true;
+      break;
+    }
+  }
+
+  // Collect the reports until all requesters close their output.
+  beg = 0;
+  end = 0;
+  while (fail == false) {
+    nopen = 0;
+    for (i = 0; i < nsm; i++) {
+      if (sm[i].sm_fd != -1) {
+        pfd[nopen].fd     = sm[i].sm_fd;
+        pfd[nopen].events = POLLIN;
+        nopen++;
+      }
+    }
+
+    if (nopen == 0) {
+      break;
+    }
+
+    reti = poll(pfd, (nfds_t)nopen, -1);
+    if (reti == -1 && errno != EINTR) {
+      log(LL_WARN, true, "unable to wait for the requester reports");
+      fail = true;
+      break;
+    }
+
+    // Read only the ready streams, as a read of an idle pipe would block the
+    // collection of the other reports.
+    k = 0;
+    for (i = 0; i < nsm; i++) {
+      if (sm[i].sm_fd == -1) {
+        continue;
+      }
+
+      if (reti > 0 && (pfd[k].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+        read_stream(rs, rtt, rs->rs_sent, &beg, &end, &sm[i]);
+      }
+      k++;
+    }
+  }
+
+  req = 0;
+  for (i = 0; i < nsm; i++) {
+    if (sm[i].sm_fd != -1) {
+      (void)close(sm[i].sm_fd);
+    }
+
+    retb = reap_process(&ru, sm[i].sm_pid, fail == true ? SIGKILL : 0);
+    if (retb == false) {
+      log(LL_WARN, false, "requester %" PRIu64 " has failed", i + 1);
+      fail = true;
+    }
+    req += cpu_time(&ru);
+  }
+
+  (void)reap_process(&ru, rpid, SIGTERM);
+  res = cpu_time(&ru);
+
+  if (fail == false) {
+    compute_result(rs, rtt, beg, end, req, res);
+  }
+
+  free(rtt);
+  return fail == false;
+}
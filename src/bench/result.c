@@ -0,0 +1,180 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "bench/funcs.h"
+#include "bench/types.h"
+#include "common/log.h"
+
+
+/// Write the header of the results.
+///
+/// @param[in] fp output stream
+void
+write_header(FILE* fp)
+{
+  (void)fprintf(fp, "targets,interval_ns,length,instances,sent,received,"
+                    "loss_pct,pps,req_cpu_ns,res_cpu_ns,"
+                    "rtt_p50_ns,rtt_p90_ns,rtt_p99_ns,rtt_max_ns\n");
+}
+
+/// Write the result of a measurement point.
+///
+/// @param[in] fp output stream
+/// @param[in] rs result
+void
+write_result(FILE* fp, const struct result* rs)
+{
+  (void)fprintf(fp, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ","
+                    "%" PRIu64 ",%" PRIu64 ",%.3f,%.1f,%.1f,%.1f,"
+                    "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                rs->rs_pt.pt_ntg, rs->rs_pt.pt_int, rs->rs_pt.pt_len, rs->rs_pt.pt_inst,
+                rs->rs_sent, rs->rs_recv, rs->rs_loss, rs->rs_pps, rs->rs_cpq, rs->rs_cps,
+                rs->rs_p50, rs->rs_p90, rs->rs_p99, rs->rs_max);
+}
+
+/// Parse a line of stored results.
+/// @return success/failure indication
+///
+/// @param[out] rs   result
+/// @param[in]  line line of the results file
+static bool
+read_result(struct result* rs, const char* line)
+{
+  int reti;
+
+  reti = sscanf(line, "%" SCNu64 ",%" SCNu64 ",%" SCNu64 ",%" SCNu64 ","
+                      "%" SCNu64 ",%" SCNu64 ",%lf,%lf,%lf,%lf,"
+                      "%" SCNu64 ",%" SCNu64 ",%" SCNu64 ",%" SCNu64,
+                &rs->rs_pt.pt_ntg, &rs->rs_pt.pt_int, &rs->rs_pt.pt_len, &rs->rs_pt.pt_inst,
+                &rs->rs_sent, &rs->rs_recv, &rs->rs_loss, &rs->rs_pps, &rs->rs_cpq, &rs->rs_cps,
+                &rs->rs_p50, &rs->rs_p90, &rs->rs_p99, &rs->rs_max);
+
+  return reti == 14;
+}
+
+/// Report a regression of a metric.
+/// @return regression indication
+///
+/// @param[in] rs   result
+/// @param[in] name name of the metric
+/// @param[in] cur  current value
+/// @param[in] base baseline value
+/// @param[in] lim  limit of the current value
+/// @param[in] up   higher values are worse
+static bool
+check_metric(const struct result* rs,
+             const char* name,
+             const double cur,
+             const double base,
+             const double lim,
+             const bool up)
+{
+  if ((up == true && cur <= lim) || (up == false && cur >= lim)) {
+    return false;
+  }
+
+  log(LL_WARN, false, "regression of %s at targets=%" PRIu64 " interval=%" PRIu64
+      "ns length=%" PRIu64 " instances=%" PRIu64 ": %.1f vs. baseline %.1f",
+      name, rs->rs_pt.pt_ntg, rs->rs_pt.pt_int, rs->rs_pt.pt_len, rs->rs_pt.pt_inst,
+      cur, base);
+
+  return true;
+}
+
+/// Compare the result of a point against its baseline.
+/// @return regression indication
+///
+/// @param[in] rs  result
+/// @param[in] bs  baseline
+/// @param[in] thr regression threshold in percent
+static bool
+compare_result(const struct result* rs, const struct result* bs, const uint64_t thr)
+{
+  double up;
+  double dn;
+  bool regr;
+
+  up = 1.0 + (double)thr / 100.0;
+  dn = 1.0 - (double)thr / 100.0;
+
+  regr = false;
+  regr |= check_metric(rs, "pps", rs->rs_pps, bs->rs_pps, bs->rs_pps * dn, false);
+  regr |= check_metric(rs, "loss_pct", rs->rs_loss, bs->rs_loss,
+                       bs->rs_loss + BENCH_LOSS_SLACK, true);
+  regr |= check_metric(rs, "req_cpu_ns", rs->rs_cpq, bs->rs_cpq, bs->rs_cpq * up, true);
+  regr |= check_metric(rs, "res_cpu_ns", rs->rs_cps, bs->rs_cps, bs->rs_cps * up, true);
+  regr |= check_metric(rs, "rtt_p50_ns", (double)rs->rs_p50, (double)bs->rs_p50,
+                       (double)bs->rs_p50 * up, true);
+  regr |= check_metric(rs, "rtt_p99_ns", (double)rs->rs_p99, (double)bs->rs_p99,
+                       (double)bs->rs_p99 * up, true);
+
+  return regr;
+}
+
+/// Compare all results against the baseline file. Points that are missing
+/// from the baseline are not compared.
+/// @return success/failure indication
+///
+/// @param[out] regr regression indication
+/// @param[in]  rs   results
+/// @param[in]  nrs  number of results
+/// @param[in]  cf   configuration
+bool
+compare_results(bool* regr,
+                const struct result* rs,
+                const uint64_t nrs,
+                const struct config* cf)
+{
+  struct result bs;
+  char line[512];
+  FILE* fp;
+  uint64_t ncmp;
+  uint64_t i;
+  bool retb;
+
+  *regr = false;
+
+  fp = fopen(cf->cf_base, "r");
+  if (fp == NULL) {
+    if (errno == ENOENT) {
+      log(LL_WARN, false, "baseline %s does not exist, skipping the comparison",
+          cf->cf_base);
+      return true;
+    }
+
+    log(LL_WARN, true, "unable to open the baseline %s", cf->cf_base);
+    return false;
+  }
+
+  ncmp = 0;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    retb = read_result(&bs, line);
+    if (retb == false) {
+      continue;
+    }
+
+    for (i = 0; i < nrs; i++) {
+      if (memcmp(&rs[i].rs_pt, &bs.rs_pt, sizeof(bs.rs_pt)) == 0) {
+        *regr |= compare_result(&rs[i], &bs, cf->cf_thr);
+        ncmp++;
+      }
+    }
+  }
+
+  (void)fclose(fp);
+
+  if (ncmp < nrs) {
+    log(LL_WARN, false, "%" PRIu64 " out of %" PRIu64 " points have no baseline",
+        nrs - ncmp, nrs);
+  }
+
+  return true;
+}
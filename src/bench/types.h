@@ -0,0 +1,81 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_BENCH_TYPES_H
+#define NEMO_BENCH_TYPES_H
+
+#include <sys/types.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Maximal number of values of a swept parameter.
+#define BENCH_SWEEP_MAX 16
+
+// Maximal number of requester instances.
+#define BENCH_INST_MAX 16
+
+// Maximal length of a line of the requester report.
+#define BENCH_LINE_MAX 1024
+
+// Time given to the responder to bind its socket.
+#define BENCH_SETTLE 200000000ULL
+
+// Allowed increase of the loss ratio in percentage points.
+#define BENCH_LOSS_SLACK 1.0
+
+/// Benchmark configuration.
+struct config {
+  uint64_t    cf_ntg[BENCH_SWEEP_MAX]; ///< Swept target counts.
+  uint64_t    cf_int[BENCH_SWEEP_MAX]; ///< Swept round intervals.
+  uint64_t    cf_len[BENCH_SWEEP_MAX]; ///< Swept payload lengths.
+  uint64_t    cf_nntg;  ///< Number of target counts.
+  uint64_t    cf_nint;  ///< Number of round intervals.
+  uint64_t    cf_nlen;  ///< Number of payload lengths.
+  uint64_t    cf_dur;   ///< Duration of a single point.
+  uint64_t    cf_inst;  ///< Number of requester instances.
+  uint64_t    cf_port;  ///< UDP port of the first point.
+  uint64_t    cf_thr;   ///< Regression threshold in percent.
+  const char* cf_bin;   ///< Directory with the executables.
+  const char* cf_out;   ///< Results file.
+  const char* cf_base;  ///< Baseline file.
+  bool        cf_verb;  ///< Pass through the logging of the processes.
+  uint8_t     cf_pad[7]; ///< Padding (unused).
+};
+
+/// Measurement point of the sweep.
+struct point {
+  uint64_t pt_ntg;  ///< Number of targets of each requester.
+  uint64_t pt_int;  ///< Duration of a request round.
+  uint64_t pt_len;  ///< Payload length.
+  uint64_t pt_inst; ///< Number of requester instances.
+};
+
+/// Result of a measurement point.
+struct result {
+  struct point rs_pt;   ///< Measurement point.
+  uint64_t     rs_sent; ///< Number of issued requests.
+  uint64_t     rs_recv; ///< Number of received responses.
+  double       rs_loss; ///< Loss ratio in percent.
+  double       rs_pps;  ///< Achieved responses per second.
+  double       rs_cpq;  ///< Requester CPU time per request in nanoseconds.
+  double       rs_cps;  ///< Responder CPU time per request in nanoseconds.
+  uint64_t     rs_p50;  ///< Median round-trip time.
+  uint64_t     rs_p90;  ///< 90th percentile round-trip time.
+  uint64_t     rs_p99;  ///< 99th percentile round-trip time.
+  uint64_t     rs_max;  ///< Maximal round-trip time.
+};
+
+/// Report stream of a requester instance.
+struct stream {
+  pid_t    sm_pid;   ///< Process identifier.
+  int      sm_fd;    ///< Reading end of the standard output (-1 if closed).
+  size_t   sm_len;   ///< Length of the buffered partial line.
+  char     sm_buf[BENCH_LINE_MAX]; ///< Partial line.
+};
+
+#endif
@@ -0,0 +1,308 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/batch.h"
+#include "common/log.h"
+#include "common/packet.h"
+#include "common/payload.h"
+
+// The byte shuffles are only supported on the x86 architecture.
+#if defined(__x86_64__) || defined(__i386__)
+  #define BATCH_HAVE_SIMD 1
+  #include <immintrin.h>
+#else
+  #define BATCH_HAVE_SIMD 0
+#endif
+
+
+// Codec used by all subsequent batch conversions.
+static uint8_t batch_cdc = BATCH_CODEC_SCALAR;
+
+/// Verify the magic identifier and the format version of a decoded payload.
+/// @return verification outcome
+///
+/// @param[in] pl payload in host byte order
+static uint8_t
+verify_entry(const struct payload* pl)
+{
+  if (pl->pl_mgic != NEMO_PAYLOAD_MAGIC) {
+    return BATCH_MAGIC;
+  }
+
+  if (pl->pl_fver != NEMO_PAYLOAD_VERSION_FULL) {
+    return BATCH_VERSION;
+  }
+
+  return BATCH_VALID;
+}
+
+#if BATCH_HAVE_SIMD == 1
+
+// The conversion between the host and the network byte order is the same
+// permutation of bytes in both directions. The 64-bit fields follow htonll(),
+// which converts each of their 32-bit halves separately, without exchanging
+// them. The full-size payload is processed in 16-byte blocks, each with its own
+// shuffle mask:
+//   [  0,  16) two 16-bit fields, four single bytes, sequence number
+//   [ 16,  64) six 64-bit fields
+//   [ 64, 112) host name, copied as-is
+//   [112, 128) host identifier, followed by the padding
+
+/// Convert payloads between the byte orders using 128-bit shuffles and
+/// optionally verify the converted ones.
+/// @return number of valid payloads
+///
+/// @param[out] dst converted payloads
+/// @param[out] st  verification outcome of each payload (or NULL)
+/// @param[in]  src original payloads
+/// @param[in]  n   number of payloads
+__attribute__((target("ssse3")))
+static uint64_t
+swap_ssse3(struct payload* dst,
+           uint8_t* st,
+           const struct payload* src,
+           const uint64_t n)
+{
+  const uint8_t* s;
+  uint8_t* d;
+  __m128i head;
+  __m128i quad;
+  __m128i tail;
+  uint64_t nval;
+  uint64_t i;
+
+  head = _mm_setr_epi8(1, 0, 3, 2, 4, 5, 6, 7, 11, 10, 9, 8, 15, 14, 13, 12);
+  quad = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  tail = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 8, 9, 10, 11, 12, 13, 14, 15);
+
+  nval = 0;
+  for (i = 0; i < n; i++) {
+    s = (const uint8_t*)&src[i];
+    d = (uint8_t*)&dst[i];
+
+    _mm_storeu_si128((__m128i*)(d +   0),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s +   0)), head));
+    _mm_storeu_si128((__m128i*)(d +  16),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s +  16)), quad));
+    _mm_storeu_si128((__m128i*)(d +  32),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s +  32)), quad));
+    _mm_storeu_si128((__m128i*)(d +  48),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s +  48)), quad));
+    _mm_storeu_si128((__m128i*)(d +  64),
+      _mm_loadu_si128((const __m128i*)(s +  64)));
+    _mm_storeu_si128((__m128i*)(d +  80),
+      _mm_loadu_si128((const __m128i*)(s +  80)));
+    _mm_storeu_si128((__m128i*)(d +  96),
+      _mm_loadu_si128((const __m128i*)(s +  96)));
+    _mm_storeu_si128((__m128i*)(d + 112),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 112)), tail));
+
+    if (st != NULL) {
+      st[i] = verify_entry(&dst[i]);
+      if (st[i] == BATCH_VALID) {
+        nval++;
+      }
+    }
+  }
+
+  return nval;
+}
+
+/// Convert payloads between the byte orders using 256-bit shuffles. The
+/// shuffle operates on each 128-bit lane separately, so the masks are the
+/// pairs of the 128-bit ones.
+/// @return number of valid payloads
+///
+/// @param[out] dst converted payloads
+/// @param[out] st  verification outcome of each payload (or NULL)
+/// @param[in]  src original payloads
+/// @param[in]  n   number of payloads
+__attribute__((target("avx2")))
+static uint64_t
+swap_avx2(struct payload* dst,
+          uint8_t* st,
+          const struct payload* src,
+          const uint64_t n)
+{
+  const uint8_t* s;
+  uint8_t* d;
+  __m256i head;
+  __m256i quad;
+  __m256i tail;
+  uint64_t nval;
+  uint64_t i;
+
+  head = _mm256_setr_epi8(1, 0, 3, 2, 4, 5, 6, 7, 11, 10, 9, 8, 15, 14, 13, 12,
+                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  quad = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  tail = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                          3, 2, 1, 0, 7, 6, 5, 4, 8, 9, 10, 11, 12, 13, 14, 15);
+
+  nval = 0;
+  for (i = 0; i < n; i++) {
+    s = (const uint8_t*)&src[i];
+    d = (uint8_t*)&dst[i];
+
+    _mm256_storeu_si256((__m256i*)(d +  0),
+      _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(s +  0)), head));
+    _mm256_storeu_si256((__m256i*)(d + 32),
+      _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(s + 32)), quad));
+    _mm256_storeu_si256((__m256i*)(d + 64),
+      _mm256_loadu_si256((const __m256i*)(s + 64)));
+    _mm256_storeu_si256((__m256i*)(d + 96),
+      _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(s + 96)), tail));
+
+    if (st != NULL) {
+      st[i] = verify_entry(&dst[i]);
+      if (st[i] == BATCH_VALID) {
+        nval++;
+      }
+    }
+  }
+
+  return nval;
+}
+
+#endif
+
+/// Select the fastest codec supported by the CPU.
+/// @return codec
+uint8_t
+best_codec(void)
+{
+#if BATCH_HAVE_SIMD == 1
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    return BATCH_CODEC_AVX2;
+  }
+
+  if (__builtin_cpu_supports("ssse3")) {
+    return BATCH_CODEC_SSSE3;
+  }
+#endif
+
+  return BATCH_CODEC_SCALAR;
+}
+
+/// Obtain the name of a codec.
+/// @return codec name
+///
+/// @param[in] cdc codec
+const char*
+codec_name(const uint8_t cdc)
+{
+  if (cdc == BATCH_CODEC_AVX2) {
+    return "avx2";
+  }
+
+  if (cdc == BATCH_CODEC_SSSE3) {
+    return "ssse3";
+  }
+
+  return "scalar";
+}
+
+/// Select the codec for all subsequent batch conversions. This function must
+/// be called before any threads are started.
+/// @return success/failure indication
+///
+/// @param[in] cdc codec
+bool
+select_codec(const uint8_t cdc)
+{
+  if (cdc > best_codec()) {
+    log(LL_WARN, false, "codec %s is not supported by the CPU", codec_name(cdc));
+    return false;
+  }
+
+  batch_cdc = cdc;
+  return true;
+}
+
+/// Encode payloads to the on-wire format. The arrays must not overlap, unless
+/// they are identical.
+///
+/// @param[out] dst encoded payloads
+/// @param[in]  src original payloads
+/// @param[in]  n   number of payloads
+void
+encode_batch(struct payload* dst, const struct payload* src, const uint64_t n)
+{
+  uint8_t cdc;
+  uint64_t i;
+
+  cdc = __atomic_load_n(&batch_cdc, __ATOMIC_RELAXED);
+
+#if BATCH_HAVE_SIMD == 1
+  if (cdc == BATCH_CODEC_AVX2) {
+    (void)swap_avx2(dst, NULL, src, n);
+    return;
+  }
+
+  if (cdc == BATCH_CODEC_SSSE3) {
+    (void)swap_ssse3(dst, NULL, src, n);
+    return;
+  }
+#endif
+
+  (void)cdc;
+  for (i = 0; i < n; i++) {
+    encode_payload(&dst[i], &src[i]);
+  }
+}
+
+/// Decode payloads from the on-wire format and verify their magic identifier
+/// and format version in the same pass. Only the full-size format is
+/// supported, compact payloads are reported with the version outcome. The
+/// arrays must not overlap, unless they are identical.
+/// @return number of valid payloads
+///
+/// @param[out] dst decoded payloads
+/// @param[out] st  verification outcome of each payload
+/// @param[in]  src original payloads
+/// @param[in]  n   number of payloads
+uint64_t
+decode_batch(struct payload* dst,
+             uint8_t* st,
+             const struct payload* src,
+             const uint64_t n)
+{
+  uint8_t cdc;
+  uint64_t nval;
+  uint64_t i;
+
+  cdc = __atomic_load_n(&batch_cdc, __ATOMIC_RELAXED);
+
+#if BATCH_HAVE_SIMD == 1
+  if (cdc == BATCH_CODEC_AVX2) {
+    return swap_avx2(dst, st, src, n);
+  }
+
+  if (cdc == BATCH_CODEC_SSSE3) {
+    return swap_ssse3(dst, st, src, n);
+  }
+#endif
+
+  // The scalar codec is the reference implementation of the conversion.
+  (void)cdc;
+  nval = 0;
+  for (i = 0; i < n; i++) {
+    decode_payload(&dst[i], &src[i]);
+
+    st[i] = verify_entry(&dst[i]);
+    if (st[i] == BATCH_VALID) {
+      nval++;
+    }
+  }
+
+  return nval;
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_BATCH_H
+#define NEMO_COMMON_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/payload.h"
+
+
+// Batch codec implementations.
+#define BATCH_CODEC_SCALAR 0 ///< Portable byte swaps.
+#define BATCH_CODEC_SSSE3  1 ///< 128-bit byte shuffles.
+#define BATCH_CODEC_AVX2   2 ///< 256-bit byte shuffles.
+
+// Verification outcome of a decoded payload.
+#define BATCH_VALID   0 ///< Payload is correct.
+#define BATCH_MAGIC   1 ///< Unknown magic identifier.
+#define BATCH_VERSION 2 ///< Not a full-size payload.
+
+uint8_t best_codec(void);
+bool select_codec(const uint8_t cdc);
+const char* codec_name(const uint8_t cdc);
+
+void encode_batch(struct payload* dst,
+                  const struct payload* src,
+                  const uint64_t n);
+uint64_t decode_batch(struct payload* dst,
+                      uint8_t* st,
+                      const struct payload* src,
+                      const uint64_t n);
+
+#endif
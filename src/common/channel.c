@@ -5,8 +5,14 @@
 // license is in the file LICENSE, distributed as part of this software.
 
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 
 #include <netinet/in.h>
+#include <arpa/inet.h>
+
+#if defined(__linux__)
+  #include <linux/sock_diag.h>
+#endif
 
 #include <unistd.h>
 #include <string.h>
@@ -42,10 +48,10 @@ get_assigned_port(const struct channel* ch)
   // Obtain the address details based on the protocol family.
   if (ss.ss_family == PF_INET) {
     s4 = (struct sockaddr_in*)&ss;
-    return s4->sin_port;
+    return ntohs(s4->sin_port);
   } else {
     s6 = (struct sockaddr_in6*)&ss;
-    return s6->sin6_port;
+    return ntohs(s6->sin6_port);
   }
 }
 
@@ -61,24 +67,33 @@ reset_stats(struct channel* ch)
   ch->ch_remg = 0;
   ch->ch_repv = 0;
   ch->ch_rety = 0;
+  ch->ch_rdrop = 0;
   ch->ch_sall = 0;
   ch->ch_seni = 0;
+  ch->ch_sdef = 0;
+  ch->ch_rqmx = 0;
+  ch->ch_rqlm = 0;
+  ch->ch_sqlm = 0;
 }
 
 /// Initialise the local address.
+/// @return success/failure indication
 ///
 /// @param[out] ss   socket address
 /// @param[out] len  address length
+/// @param[in]  addr local address (or NULL for any)
 /// @param[in]  port UDP port
 /// @param[in]  ipv4 usage of the IPv4 protocol
-static void
+static bool
 init_address(struct sockaddr_storage* ss,
              size_t* len,
+             const char* addr,
              const uint16_t port,
              const bool ipv4)
 {
   struct sockaddr_in* s4;
   struct sockaddr_in6* s6;
+  int reti;
 
   (void)memset(ss, 0, sizeof(*ss));
 
@@ -89,6 +104,10 @@ init_address(struct sockaddr_storage* ss,
     s4->sin_family      = AF_INET;
     s4->sin_port        = htons(port);
     s4->sin_addr.s_addr = INADDR_ANY;
+    reti = 1;
+    if (addr != NULL) {
+      reti = inet_pton(AF_INET, addr, &s4->sin_addr);
+    }
   } else {
     *len = sizeof(*s6);
     s6   = (struct sockaddr_in6*)ss;
@@ -96,7 +115,18 @@ init_address(struct sockaddr_storage* ss,
     s6->sin6_family     = AF_INET6;
     s6->sin6_port       = htons(port);
     s6->sin6_addr       = in6addr_any;
+    reti = 1;
+    if (addr != NULL) {
+      reti = inet_pton(AF_INET6, addr, &s6->sin6_addr);
+    }
   }
+
+  if (reti != 1) {
+    log(LL_WARN, false, "invalid local address %s", addr);
+    return false;
+  }
+
+  return true;
 }
 
 /// Create a IPv4/IPv6 UDP socket.
@@ -130,13 +160,18 @@ create_socket(struct channel* ch, const bool ipv4)
 /// @return success/failure indication
 ///
 /// @param[in] ch   channel
+/// @param[in] addr local address (or NULL for any)
 /// @param[in] port UDP port number
 /// @param[in] ipv4 usage of the IPv4 protocol
 static bool
-assign_name(struct channel* ch, const uint16_t port, const bool ipv4)
+assign_name(struct channel* ch,
+            const char* addr,
+            const uint16_t port,
+            const bool ipv4)
 {
   int val;
   int reti;
+  bool retb;
   struct sockaddr_storage ss;
   size_t len;
 
@@ -151,7 +186,10 @@ assign_name(struct channel* ch, const uint16_t port, const bool ipv4)
   }
 
   // Initialise the appropriate local address.
-  init_address(&ss, &len, port, ipv4);
+  retb = init_address(&ss, &len, addr, port, ipv4);
+  if (retb == false) {
+    return false;
+  }
 
   // Bind the socket to the address.
   reti = bind(ch->ch_sock, (struct sockaddr*)&ss, (socklen_t)len);
@@ -177,6 +215,7 @@ set_buffer_sizes(struct channel* ch, const uint64_t rbuf, const uint64_t sbuf)
 {
   int val;
   int reti;
+  socklen_t len;
 
   // Set the socket receive buffer size.
   val = (int)rbuf;
@@ -194,6 +233,20 @@ set_buffer_sizes(struct channel* ch, const uint64_t rbuf, const uint64_t sbuf)
     return false;
   }
 
+  // Retrieve the buffer sizes granted by the kernel, which can differ from
+  // the requested ones, so that the queue occupancy can be related to them.
+  len  = sizeof(val);
+  reti = getsockopt(ch->ch_sock, SOL_SOCKET, SO_RCVBUF, &val, &len);
+  if (reti == 0 && val > 0) {
+    ch->ch_rqlm = (uint64_t)val;
+  }
+
+  len  = sizeof(val);
+  reti = getsockopt(ch->ch_sock, SOL_SOCKET, SO_SNDBUF, &val, &len);
+  if (reti == 0 && val > 0) {
+    ch->ch_sqlm = (uint64_t)val;
+  }
+
   return true;
 }
 
@@ -242,11 +295,57 @@ apply_ttl_prefs(struct channel* ch, const uint8_t ttl, const bool ipv4)
   return true;
 }
 
-/// Create the channel.
+/// Request the kernel to timestamp the arrival of each datagram, so that the
+/// time until its receipt by the process can be measured. The measurement is
+/// not essential, and therefore failures are only reported.
+///
+/// @param[in] ch channel
+static void
+request_timestamps(struct channel* ch)
+{
+#if defined(SO_TIMESTAMPNS)
+  int val;
+  int reti;
+
+  val  = 1;
+  reti = setsockopt(ch->ch_sock, SOL_SOCKET, SO_TIMESTAMPNS, &val, sizeof(val));
+  if (reti == -1) {
+    log(LL_DEBUG, true, "unable to request arrival timestamps on the socket");
+  }
+#else
+  (void)ch;
+#endif
+}
+
+/// Request the kernel to report the number of datagrams that were dropped due
+/// to a full receive queue along with each received datagram. The counter is
+/// not essential, and therefore failures are only reported.
+///
+/// @param[in] ch channel
+static void
+request_drops(struct channel* ch)
+{
+#if defined(SO_RXQ_OVFL)
+  int val;
+  int reti;
+
+  val  = 1;
+  reti = setsockopt(ch->ch_sock, SOL_SOCKET, SO_RXQ_OVFL, &val, sizeof(val));
+  if (reti == -1) {
+    log(LL_DEBUG, true, "unable to request drop counts on the socket");
+  }
+#else
+  (void)ch;
+#endif
+}
+
+/// Create the channel. The channel is bound to the wildcard address of the
+/// protocol, unless a particular local address is selected.
 /// @return success/failure indication
 ///
 /// @param[in] ch   channel
 /// @param[in] ipv4 IPv4 protocol usage
+/// @param[in] addr local address (or NULL for any)
 /// @param[in] port UDP port
 /// @param[in] rbuf receive buffer size in bytes
 /// @param[in] sbuf send buffer size in bytes
@@ -254,6 +353,7 @@ apply_ttl_prefs(struct channel* ch, const uint8_t ttl, const bool ipv4)
 bool
 open_channel(struct channel* ch,
              const bool ipv4,
+             const char* addr,
              const uint16_t port,
              const uint64_t rbuf,
              const uint64_t sbuf,
@@ -261,7 +361,13 @@ open_channel(struct channel* ch,
 {
   int retb;
 
-  if (ipv4 == true) {
+  (void)memset(ch, 0, sizeof(*ch));
+  reset_stats(ch);
+
+  ch->ch_ipv4 = ipv4;
+  if (addr != NULL) {
+    ch->ch_name = addr;
+  } else if (ipv4 == true) {
     ch->ch_name = "IPv4";
   } else {
     ch->ch_name = "IPv6";
@@ -269,9 +375,6 @@ open_channel(struct channel* ch,
 
   log(LL_INFO, false, "creating the %s channel", ch->ch_name);
 
-  (void)memset(ch, 0, sizeof(*ch));
-  reset_stats(ch);
-
   // Create a UDP socket.
   retb = create_socket(ch, ipv4);
   if (retb == false) {
@@ -279,7 +382,7 @@ open_channel(struct channel* ch,
   }
 
   // Bind the socket to a local address and port.
-  retb = assign_name(ch, port, ipv4);
+  retb = assign_name(ch, addr, port, ipv4);
   if (retb == false) {
     return false;
   }
@@ -296,24 +399,313 @@ open_channel(struct channel* ch,
     return false;
   }
 
+  request_timestamps(ch);
+  request_drops(ch);
+
   return true;
 }
 
-/// Log all channel information.
+/// Warn about a socket buffer that can not adapt, as its initial size already
+/// reaches its ceiling.
+///
+/// @param[in] ch   channel
+/// @param[in] name name of the buffer
+/// @param[in] lim  current size of the buffer
+/// @param[in] cap  ceiling of the buffer
+static void
+check_ceiling(const struct channel* ch,
+              const char* name,
+              const uint64_t lim,
+              const uint64_t cap)
+{
+  if (cap == 0 || lim < cap * CHANNEL_KERNEL_SCALE) {
+    return;
+  }
+
+  log(LL_WARN, false, "%s buffer of the %s socket starts at its ceiling of %"
+      PRIu64 "B and will not adapt", name, ch->ch_name, cap);
+}
+
+/// Enable the adaptive sizing of the socket buffers, starting from the sizes
+/// selected upon the creation of the channel.
+///
+/// @param[in] ch   channel
+/// @param[in] rcap ceiling of the receive buffer (0 for a fixed size)
+/// @param[in] scap ceiling of the send buffer (0 for a fixed size)
+void
+auto_size_channel(struct channel* ch, const uint64_t rcap, const uint64_t scap)
+{
+  ch->ch_rcap = rcap;
+  ch->ch_scap = scap;
+  check_ceiling(ch, "receive", ch->ch_rqlm, rcap);
+  check_ceiling(ch, "send", ch->ch_sqlm, scap);
+  ch->ch_rdpv = __atomic_load_n(&ch->ch_rdrop, __ATOMIC_RELAXED);
+  ch->ch_sepv = __atomic_load_n(&ch->ch_seni, __ATOMIC_RELAXED)
+              + __atomic_load_n(&ch->ch_sdef, __ATOMIC_RELAXED);
+}
+
+/// Grow a socket buffer to at least double its current size. The privileged
+/// variant of the option is attempted first, as it is not limited by the
+/// system-wide maximum. The sizes are compared in the units reported by the
+/// kernel, while the ceiling and the requests are in the units of the socket
+/// options. The adaptation of the buffer stops once it reaches its ceiling or
+/// the system refuses to grow it further.
+///
+/// @param[in]  ch   channel
+/// @param[in]  opt  socket option
+/// @param[in]  fopt privileged socket option (or -1)
+/// @param[in]  name name of the buffer
+/// @param[out] lim  current size of the buffer
+/// @param[out] cap  ceiling of the buffer
+/// @param[in]  want minimal desired size of the buffer
+/// @param[in]  rsn  reason of the growth
+static void
+grow_buffer(struct channel* ch,
+            const int opt,
+            const int fopt,
+            const char* name,
+            uint64_t* lim,
+            uint64_t* cap,
+            const uint64_t want,
+            const char* rsn)
+{
+  uint64_t old;
+  uint64_t req;
+  uint64_t top;
+  int val;
+  int reti;
+  socklen_t len;
+
+  old = __atomic_load_n(lim, __ATOMIC_RELAXED);
+  top = *cap * CHANNEL_KERNEL_SCALE;
+  if (old >= top) {
+    return;
+  }
+
+  req = old * 2;
+  if (req < want) {
+    req = want;
+  }
+  if (req > top) {
+    req = top;
+  }
+
+  val  = (int)(req / CHANNEL_KERNEL_SCALE);
+  reti = -1;
+  if (fopt != -1) {
+    reti = setsockopt(ch->ch_sock, SOL_SOCKET, fopt, &val, sizeof(val));
+  }
+  if (reti == -1) {
+    (void)setsockopt(ch->ch_sock, SOL_SOCKET, opt, &val, sizeof(val));
+  }
+
+  // The kernel can round the size or account for its own overhead.
+  len  = sizeof(val);
+  reti = getsockopt(ch->ch_sock, SOL_SOCKET, opt, &val, &len);
+  if (reti == -1 || val <= 0 || (uint64_t)val <= old) {
+    log(LL_WARN, false, "unable to grow the %s buffer of the %s socket beyond %"
+        PRIu64 "B", name, ch->ch_name, old);
+    *cap = 0;
+    return;
+  }
+
+  __atomic_store_n(lim, (uint64_t)val, __ATOMIC_RELAXED);
+  log(LL_INFO, false, "%s buffer of the %s socket grown from %" PRIu64 "B to %"
+      PRIu64 "B due to %s", name, ch->ch_name, old, (uint64_t)val, rsn);
+}
+
+/// Grow the socket buffers that are sized adaptively, if the kernel dropped
+/// datagrams, the receive queue came close to its limit, sending failed, or
+/// either buffer can not hold two expected bursts of datagrams.
+///
+/// @param[in] ch    channel
+/// @param[in] burst expected size of a burst of datagrams in bytes
+void
+adapt_channel(struct channel* ch, const uint64_t burst)
+{
+  uint64_t drop;
+  uint64_t serr;
+  uint64_t peak;
+  uint64_t rlim;
+  int fopt;
+
+  if (ch->ch_rcap != 0) {
+    drop = __atomic_load_n(&ch->ch_rdrop, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&ch->ch_rqmx, __ATOMIC_RELAXED);
+    rlim = __atomic_load_n(&ch->ch_rqlm, __ATOMIC_RELAXED);
+
+#if defined(SO_RCVBUFFORCE)
+    fopt = SO_RCVBUFFORCE;
+#else
+    fopt = -1;
+#endif
+
+    if (drop != ch->ch_rdpv) {
+      ch->ch_rdpv = drop;
+      grow_buffer(ch, SO_RCVBUF, fopt, "receive", &ch->ch_rqlm, &ch->ch_rcap,
+                  burst * 2, "dropped datagrams");
+    } else if (rlim != 0 && peak * 4 >= rlim * 3) {
+      grow_buffer(ch, SO_RCVBUF, fopt, "receive", &ch->ch_rqlm, &ch->ch_rcap,
+                  burst * 2, "queue occupancy");
+    } else if (burst * 2 > rlim) {
+      grow_buffer(ch, SO_RCVBUF, fopt, "receive", &ch->ch_rqlm, &ch->ch_rcap,
+                  burst * 2, "burst size");
+    }
+  }
+
+  if (ch->ch_scap != 0) {
+    // Deferred sends signal the same shortage of the send buffer as failed
+    // ones, albeit without a loss of the datagram.
+    serr = __atomic_load_n(&ch->ch_seni, __ATOMIC_RELAXED)
+         + __atomic_load_n(&ch->ch_sdef, __ATOMIC_RELAXED);
+
+#if defined(SO_SNDBUFFORCE)
+    fopt = SO_SNDBUFFORCE;
+#else
+    fopt = -1;
+#endif
+
+    if (serr != ch->ch_sepv) {
+      ch->ch_sepv = serr;
+      grow_buffer(ch, SO_SNDBUF, fopt, "send", &ch->ch_sqlm, &ch->ch_scap,
+                  burst * 2, "send errors or deferrals");
+    } else if (burst * 2 > ch->ch_sqlm) {
+      grow_buffer(ch, SO_SNDBUF, fopt, "send", &ch->ch_sqlm, &ch->ch_scap,
+                  burst * 2, "burst size");
+    }
+  }
+}
+
+/// Sample the occupancy of the receive queue and retain its peak. On Linux,
+/// the memory allocated to the queued datagrams is compared against the
+/// current buffer limit, as the SIOCINQ request only reports the size of the
+/// first datagram in the queue. Other systems report all queued bytes through
+/// the FIONREAD request.
+///
+/// @param[in] ch channel
+void
+sample_channel(struct channel* ch)
+{
+  uint64_t occ;
+  int reti;
+#if defined(__linux__) && defined(SO_MEMINFO)
+  uint32_t mem[SK_MEMINFO_VARS];
+  socklen_t len;
+
+  len  = sizeof(mem);
+  reti = getsockopt(ch->ch_sock, SOL_SOCKET, SO_MEMINFO, mem, &len);
+  if (reti == -1 || len < sizeof(mem)) {
+    return;
+  }
+
+  occ = mem[SK_MEMINFO_RMEM_ALLOC];
+  __atomic_store_n(&ch->ch_rqlm, (uint64_t)mem[SK_MEMINFO_RCVBUF], __ATOMIC_RELAXED);
+#else
+  int val;
+
+  reti = ioctl(ch->ch_sock, FIONREAD, &val);
+  if (reti == -1 || val < 0) {
+    return;
+  }
+
+  occ = (uint64_t)val;
+#endif
+
+  if (occ > ch->ch_rqmx) {
+    __atomic_store_n(&ch->ch_rqmx, occ, __ATOMIC_RELAXED);
+  }
+}
+
+/// Let the kernel busy-poll the device queue for new datagrams when the
+/// socket is empty, instead of waiting for the interrupt. Raising the time
+/// above the system-wide default requires the CAP_NET_ADMIN capability.
+/// @return success/failure indication
+///
+/// @param[in] ch   channel
+/// @param[in] usec busy-polling time in microseconds
+bool
+busy_poll_channel(struct channel* ch, const uint64_t usec)
+{
+#if defined(SO_BUSY_POLL)
+  int val;
+  int reti;
+
+  val  = (int)usec;
+  reti = setsockopt(ch->ch_sock, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val));
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to set the busy-polling time of the %s socket", ch->ch_name);
+    return false;
+  }
+
+  return true;
+#else
+  (void)ch;
+  (void)usec;
+
+  log(LL_WARN, false, "busy-polling is not supported on this platform");
+  return false;
+#endif
+}
+
+/// Log all channel information. Aggregated statistics of multiple channels
+/// have no local port assigned.
 ///
 /// @param[in] ch channel
 void
 log_channel(const struct channel* ch)
 {
-  log(LL_DEBUG, false, "local UDP port: %" PRIu16, ch->ch_port);
+  log(LL_DEBUG, false, "channel: %s", ch->ch_name);
+  if (ch->ch_port != 0) {
+    log(LL_DEBUG, false, "local UDP port: %" PRIu16, ch->ch_port);
+  }
   log(LL_DEBUG, false, "overall received: %" PRIu64, ch->ch_rall);
   log(LL_DEBUG, false, "receive network-related errors: %" PRIu64, ch->ch_reni);
   log(LL_DEBUG, false, "receive packet size mismatches: %" PRIu64, ch->ch_resz);
   log(LL_DEBUG, false, "receive payload magic mismatches: %" PRIu64, ch->ch_remg);
   log(LL_DEBUG, false, "receive payload version mismatches: %" PRIu64, ch->ch_repv);
   log(LL_DEBUG, false, "receive payload type mismatches: %" PRIu64, ch->ch_rety);
+  log(LL_DEBUG, false, "receive queue overflows: %" PRIu64, ch->ch_rdrop);
+  log(LL_DEBUG, false, "receive queue peak: %" PRIu64 "B of %" PRIu64 "B",
+      ch->ch_rqmx, ch->ch_rqlm);
   log(LL_DEBUG, false, "overall sent: %" PRIu64, ch->ch_sall);
   log(LL_DEBUG, false, "send network-related errors: %" PRIu64, ch->ch_seni);
+  log(LL_DEBUG, false, "send deferrals: %" PRIu64, ch->ch_sdef);
+
+  // Time from the arrival of a datagram to its receipt by the process.
+  if (ch->ch_wake.hs_cnt != 0) {
+    log(LL_DEBUG, false, "wakeup-to-receive latency: mean %" PRIu64 "ns, "
+      "p50 <= %" PRIu64 "ns, p99 <= %" PRIu64 "ns",
+      ch->ch_wake.hs_sum / ch->ch_wake.hs_cnt,
+      quantile_hist(&ch->ch_wake, 50),
+      quantile_hist(&ch->ch_wake, 99));
+  }
+}
+
+/// Add the statistics of a channel to an aggregate. The source channel can be
+/// concurrently updated by its owning thread, and therefore each counter is
+/// read atomically, albeit without a consistent snapshot across counters.
+///
+/// @param[out] dst aggregated statistics
+/// @param[in]  src channel
+void
+merge_channel(struct channel* dst, const struct channel* src)
+{
+  dst->ch_rall += __atomic_load_n(&src->ch_rall, __ATOMIC_RELAXED);
+  dst->ch_reni += __atomic_load_n(&src->ch_reni, __ATOMIC_RELAXED);
+  dst->ch_resz += __atomic_load_n(&src->ch_resz, __ATOMIC_RELAXED);
+  dst->ch_remg += __atomic_load_n(&src->ch_remg, __ATOMIC_RELAXED);
+  dst->ch_repv += __atomic_load_n(&src->ch_repv, __ATOMIC_RELAXED);
+  dst->ch_rety += __atomic_load_n(&src->ch_rety, __ATOMIC_RELAXED);
+  dst->ch_rdrop += __atomic_load_n(&src->ch_rdrop, __ATOMIC_RELAXED);
+  dst->ch_sall += __atomic_load_n(&src->ch_sall, __ATOMIC_RELAXED);
+  dst->ch_seni += __atomic_load_n(&src->ch_seni, __ATOMIC_RELAXED);
+  dst->ch_sdef += __atomic_load_n(&src->ch_sdef, __ATOMIC_RELAXED);
+
+  // The peaks of the queues are summed along with their limits, which bounds
+  // the overall occupancy from above.
+  dst->ch_rqmx += __atomic_load_n(&src->ch_rqmx, __ATOMIC_RELAXED);
+  dst->ch_rqlm += __atomic_load_n(&src->ch_rqlm, __ATOMIC_RELAXED);
+  merge_hist(&dst->ch_wake, &src->ch_wake);
 }
 
 /// Close the channel.
@@ -10,6 +10,28 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "common/hist.h"
+#include "common/host.h"
+
+
+// Size of the datagram receive buffer.
+#define CHANNEL_BUFFER_SIZE 65536
+
+// Number of received datagrams between two samples of the receive queue.
+#define CHANNEL_QUEUE_SAMPLE 64
+
+// Default ceiling of the adaptive socket buffer sizing.
+#define CHANNEL_AUTO_CEILING (64 * 1024 * 1024)
+
+// Ratio of the socket buffer size reported by the kernel to the requested
+// one. Linux doubles the requested size to account for its bookkeeping.
+#if defined(__linux__)
+  #define CHANNEL_KERNEL_SCALE 2
+#else
+  #define CHANNEL_KERNEL_SCALE 1
+#endif
+
+struct sim;
 
 /// Communication channel.
 struct channel {
@@ -19,21 +41,41 @@ struct channel {
   uint64_t    ch_remg;   ///< Received errors due to magic number mismatch.
   uint64_t    ch_repv;   ///< Received errors due to payload version mismatch.
   uint64_t    ch_rety;   ///< Received errors due to payload type.
+  uint64_t    ch_rdrop;  ///< Datagrams dropped due to a full receive queue.
   uint64_t    ch_sall;   ///< Number of overall sent datagrams.
   uint64_t    ch_seni;   ///< Sent errors due to network issues.
+  uint64_t    ch_sdef;   ///< Sends deferred due to a full send buffer.
+  uint64_t    ch_rqmx;   ///< Peak occupancy of the receive queue in bytes.
+  uint64_t    ch_rqlm;   ///< Limit of the receive queue in bytes.
+  uint64_t    ch_sqlm;   ///< Limit of the send queue in bytes.
+  uint64_t    ch_rcap;   ///< Ceiling of the receive buffer (0 if fixed).
+  uint64_t    ch_scap;   ///< Ceiling of the send buffer (0 if fixed).
+  uint64_t    ch_rdpv;   ///< Drops observed by the last adaptation.
+  uint64_t    ch_sepv;   ///< Send errors and deferrals observed by the last adaptation.
   const char* ch_name;   ///< Human-readable name.
+  struct sim* ch_sim;    ///< Simulated network (NULL if backed by a socket).
   int         ch_sock;   ///< Network socket.
   uint16_t    ch_port;   ///< Local UDP port.
-  uint8_t     ch_pad[2]; ///< Padding (unused).
+  bool        ch_ipv4;   ///< Usage of Internet Protocol version 4.
+  uint8_t     ch_pad[1]; ///< Padding (unused).
+  struct host_cache ch_hc; ///< Host names of the peers.
+  struct hist ch_wake;   ///< Time from the arrival of a datagram to its receipt.
+  uint8_t     ch_buf[CHANNEL_BUFFER_SIZE]; ///< Receive buffer.
 };
 
 bool open_channel(struct channel* ch,
                   const bool ipv4,
+                  const char* addr,
                   const uint16_t port,
                   const uint64_t rbuf,
                   const uint64_t sbuf,
                   const uint8_t ttl);
+bool busy_poll_channel(struct channel* ch, const uint64_t usec);
+void auto_size_channel(struct channel* ch, const uint64_t rcap, const uint64_t scap);
+void adapt_channel(struct channel* ch, const uint64_t burst);
+void sample_channel(struct channel* ch);
 void log_channel(const struct channel* ch);
+void merge_channel(struct channel* dst, const struct channel* src);
 void close_channel(const struct channel* ch);
 
 #endif
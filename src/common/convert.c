@@ -6,6 +6,8 @@
 
 #include <arpa/inet.h>
 
+#include <string.h>
+
 #include "common/convert.h"
 
 
@@ -103,3 +105,44 @@ tipv6(struct in6_addr* addr, const uint64_t lo, const uint64_t hi)
     addr->s6_addr[i + 8] = (uint8_t)(hi >> (8 * i)) & 0xff;
   }
 }
+
+/// Convert the standard IPv4 address structure into two 64-bit unsigned
+/// integers. The address is stored in its IPv4-mapped IPv6 form, so that the
+/// addresses of both protocols can share the same representation.
+///
+/// @param[out] lo   low-bits of the address
+/// @param[out] hi   high-bits of the address
+/// @param[in]  addr IPv4 address structure
+void
+fipv4(uint64_t* lo, uint64_t* hi, const struct in_addr addr)
+{
+  struct in6_addr a6;
+
+  (void)memset(&a6, 0, sizeof(a6));
+  a6.s6_addr[10] = 0xff;
+  a6.s6_addr[11] = 0xff;
+  (void)memcpy(&a6.s6_addr[12], &addr, sizeof(addr));
+
+  fipv6(lo, hi, a6);
+}
+
+/// Convert two 64-bit unsigned integers into the standard IPv4 address
+/// structure, provided that these hold an IPv4-mapped IPv6 address.
+/// @return IPv4 address indication
+///
+/// @param[out] addr IPv4 address structure
+/// @param[in]  lo   low-bits of the address
+/// @param[in]  hi   high-bits of the address
+bool
+tipv4(struct in_addr* addr, const uint64_t lo, const uint64_t hi)
+{
+  struct in6_addr a6;
+
+  tipv6(&a6, lo, hi);
+  if (IN6_IS_ADDR_V4MAPPED(&a6) == 0) {
+    return false;
+  }
+
+  (void)memcpy(addr, &a6.s6_addr[12], sizeof(*addr));
+  return true;
+}
@@ -9,6 +9,7 @@
 
 #include <netinet/in.h>
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
 
@@ -27,4 +28,8 @@ uint64_t ntohll(const uint64_t x);
 void fipv6(uint64_t* lo, uint64_t* hi, const struct in6_addr addr);
 void tipv6(struct in6_addr* addr, const uint64_t lo, const uint64_t hi);
 
+// IPv4 address conversion.
+void fipv4(uint64_t* lo, uint64_t* hi, const struct in_addr addr);
+bool tipv4(struct in_addr* addr, const uint64_t lo, const uint64_t hi);
+
 #endif
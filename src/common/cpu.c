@@ -0,0 +1,182 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+// The CPU affinity interface is not part of POSIX and glibc only exposes it
+// with the GNU extensions enabled.
+#if defined(__linux__)
+  #define _GNU_SOURCE
+#endif
+
+#include <sys/mman.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/cpu.h"
+#include "common/log.h"
+#include "common/parse.h"
+
+
+/// Parse a comma-separated list of CPU identifiers.
+/// @return success/failure indication
+///
+/// @param[out] cpu  array of CPU identifiers
+/// @param[out] ncpu number of CPU identifiers
+/// @param[in]  inp  argument input
+bool
+parse_cpu_list(uint64_t* cpu, uint64_t* ncpu, const char* inp)
+{
+  char cpy[256];
+  char* tok;
+  char* save;
+  bool retb;
+
+  // The tokenizer modifies the string, and therefore we have to operate on a
+  // copy of the argument.
+  if (strlen(inp) >= sizeof(cpy)) {
+    log(LL_WARN, false, "CPU list '%s' is too long", inp);
+    return false;
+  }
+  (void)memset(cpy, '\0', sizeof(cpy));
+  (void)strncpy(cpy, inp, sizeof(cpy) - 1);
+
+  *ncpu = 0;
+  for (tok = strtok_r(cpy, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+    if (*ncpu == CPU_LIST_MAX) {
+      log(LL_WARN, false, "too many CPUs, only %d allowed", CPU_LIST_MAX);
+      return false;
+    }
+
+    retb = parse_uint64(&cpu[*ncpu], tok, 0, CPU_LIST_MAX * 64);
+    if (retb == false) {
+      return false;
+    }
+
+    (*ncpu)++;
+  }
+
+  if (*ncpu == 0) {
+    log(LL_WARN, false, "empty CPU list");
+    return false;
+  }
+
+  return true;
+}
+
+/// Restrict the calling thread to execute only on the selected CPU.
+/// @return success/failure indication
+///
+/// @param[in] cpu CPU identifier (or CPU_NONE)
+bool
+pin_thread(const uint64_t cpu)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  int reti;
+
+  // No affinity was requested.
+  if (cpu == CPU_NONE) {
+    return true;
+  }
+
+  if (cpu >= CPU_SETSIZE) {
+    log(LL_WARN, false, "CPU %" PRIu64 " is out of the supported range", cpu);
+    return false;
+  }
+
+  CPU_ZERO(&set);
+  CPU_SET((size_t)cpu, &set);
+
+  // The function returns the error number directly instead of using errno.
+  reti = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to pin thread to CPU %" PRIu64 ": %s", cpu, strerror(reti));
+    return false;
+  }
+
+  log(LL_DEBUG, false, "thread pinned to CPU %" PRIu64, cpu);
+  return true;
+#else
+  // No affinity was requested.
+  if (cpu == CPU_NONE) {
+    return true;
+  }
+
+  log(LL_WARN, false, "CPU affinity is not supported on this platform");
+  return false;
+#endif
+}
+
+/// Switch the calling thread to the real-time FIFO scheduling policy, so that
+/// it is not preempted by regular threads. This requires the CAP_SYS_NICE
+/// capability or an appropriate RLIMIT_RTPRIO resource limit.
+/// @return success/failure indication
+///
+/// @param[in] prio real-time priority (or CPU_PRIO_NONE)
+bool
+raise_priority(const uint64_t prio)
+{
+  struct sched_param sp;
+  int reti;
+
+  // No priority was requested.
+  if (prio == CPU_PRIO_NONE) {
+    return true;
+  }
+
+  (void)memset(&sp, 0, sizeof(sp));
+  sp.sched_priority = (int)prio;
+
+  // The function returns the error number directly instead of using errno.
+  reti = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to set the FIFO priority %" PRIu64 ": %s", prio, strerror(reti));
+    return false;
+  }
+
+  log(LL_DEBUG, false, "thread scheduled with the FIFO priority %" PRIu64, prio);
+  return true;
+}
+
+/// Touch the stack below the calling function, so that its pages are mapped
+/// before the latency-sensitive work starts.
+__attribute__((noinline))
+static void
+prefault_stack(void)
+{
+  volatile uint8_t stk[CPU_STACK_PREFAULT];
+  size_t i;
+
+  for (i = 0; i < sizeof(stk); i += 4096) {
+    stk[i] = 0;
+  }
+}
+
+/// Lock all current and future pages of the process in memory, and prefault
+/// the stack of the calling thread. Stacks of threads created afterwards are
+/// locked and populated upon their creation. This requires the CAP_IPC_LOCK
+/// capability or a sufficient RLIMIT_MEMLOCK resource limit.
+/// @return success/failure indication
+bool
+lock_memory(void)
+{
+  int reti;
+
+  reti = mlockall(MCL_CURRENT | MCL_FUTURE);
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to lock the process memory");
+    return false;
+  }
+
+  prefault_stack();
+
+  log(LL_DEBUG, false, "process memory locked");
+  return true;
+}
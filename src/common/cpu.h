@@ -0,0 +1,31 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_CPU_H
+#define NEMO_COMMON_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Maximal number of CPUs in an affinity list.
+#define CPU_LIST_MAX 64
+
+// Affinity placeholder denoting no particular CPU.
+#define CPU_NONE UINT64_MAX
+
+// Scheduling priority placeholder denoting the default scheduling policy.
+#define CPU_PRIO_NONE 0
+
+// Size of the stack that is touched in advance to avoid page faults later.
+#define CPU_STACK_PREFAULT (512 * 1024)
+
+bool parse_cpu_list(uint64_t* cpu, uint64_t* ncpu, const char* inp);
+bool pin_thread(const uint64_t cpu);
+bool raise_priority(const uint64_t prio);
+bool lock_memory(void);
+
+#endif
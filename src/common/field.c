@@ -0,0 +1,163 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/field.h"
+
+// The word-wise conversions rely on the first byte being in the lowest byte
+// of the loaded word.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #define FIELD_HAVE_SWAR 1
+#else
+  #define FIELD_HAVE_SWAR 0
+#endif
+
+
+// Longest decimal number that can not overflow 64 bits.
+#define DIGITS_MAX 19
+
+#if FIELD_HAVE_SWAR == 1
+
+/// Convert eight decimal digits into their value, unless any of the bytes is
+/// not a digit. Pairs of digits are combined into bytes, pairs of bytes into
+/// 16-bit halves, and pairs of those into the final value, each step using a
+/// single multiplication.
+/// @return success/failure indication
+///
+/// @param[out] out value
+/// @param[in]  str eight bytes
+static bool
+parse_eight(uint64_t* out, const char* str)
+{
+  uint64_t val;
+
+  // The builtin is used explicitly, as the library calls are not inlined.
+  __builtin_memcpy(&val, str, sizeof(val));
+
+  // Digits are bytes 0x30-0x39: the upper nibble is 3, and adding six does
+  // not carry into the upper nibble.
+  if ((((val & 0xf0f0f0f0f0f0f0f0ULL)
+     | (((val + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)))
+     != 0x3333333333333333ULL) {
+    return false;
+  }
+
+  val = ((val & 0x0f0f0f0f0f0f0f0fULL) * 2561) >> 8;
+  val = ((val & 0x00ff00ff00ff00ffULL) * 6553601) >> 16;
+  *out = ((val & 0x0000ffff0000ffffULL) * 42949672960001ULL) >> 32;
+
+  return true;
+}
+
+#endif
+
+/// Parse a decimal number that spans a whole field. Time-stamps in
+/// nanoseconds have nineteen digits, so that most of them are converted in
+/// blocks of eight digits.
+/// @return success/failure indication
+///
+/// @param[out] out value
+/// @param[in]  beg first byte of the field
+/// @param[in]  end byte after the last one
+bool
+parse_digits(uint64_t* out, const char* beg, const char* end)
+{
+  uint64_t val;
+  const char* cur;
+#if FIELD_HAVE_SWAR == 1
+  uint64_t blk;
+  bool retb;
+#endif
+
+  if (beg == end || end - beg > DIGITS_MAX) {
+    return false;
+  }
+
+  val = 0;
+  cur = beg;
+
+#if FIELD_HAVE_SWAR == 1
+  while (end - cur >= 8) {
+    retb = parse_eight(&blk, cur);
+    if (retb == false) {
+      return false;
+    }
+
+    val = val * 100000000ULL + blk;
+    cur += 8;
+  }
+#endif
+
+  for (; cur < end; cur++) {
+    if (*cur < '0' || *cur > '9') {
+      return false;
+    }
+
+    val = val * 10 + (uint64_t)(*cur - '0');
+  }
+
+  *out = val;
+  return true;
+}
+
+/// Find the separators of the columns of a CSV line. On little-endian
+/// platforms, eight bytes are compared at once: the bytes equal to the
+/// separator are zero after the exclusive or, and only the zero bytes do not
+/// set their highest bit after adding 0x7f to their lower seven bits.
+/// @return number of found separators
+///
+/// @param[out] sep positions of the separators
+/// @param[in]  max maximal number of separators
+/// @param[in]  beg first byte of the line
+/// @param[in]  end byte after the last one
+uint8_t
+find_separators(const char** sep,
+                const uint8_t max,
+                const char* beg,
+                const char* end)
+{
+  const char* cur;
+  uint8_t n;
+#if FIELD_HAVE_SWAR == 1
+  uint64_t word;
+  uint64_t mask;
+#endif
+
+  n   = 0;
+  cur = beg;
+
+#if FIELD_HAVE_SWAR == 1
+  while (end - cur >= 8) {
+    __builtin_memcpy(&word, cur, sizeof(word));
+    word ^= 0x2c2c2c2c2c2c2c2cULL;
+    mask  = ~(((word & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL) | word)
+          & 0x8080808080808080ULL;
+
+    while (mask != 0) {
+      sep[n++] = cur + (__builtin_ctzll(mask) >> 3);
+      if (n == max) {
+        return n;
+      }
+      mask &= mask - 1;
+    }
+
+    cur += 8;
+  }
+#endif
+
+  for (; cur < end; cur++) {
+    if (*cur == ',') {
+      sep[n++] = cur;
+      if (n == max) {
+        return n;
+      }
+    }
+  }
+
+  return n;
+}
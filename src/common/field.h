@@ -0,0 +1,20 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_FIELD_H
+#define NEMO_COMMON_FIELD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+bool parse_digits(uint64_t* out, const char* beg, const char* end);
+uint8_t find_separators(const char** sep,
+                        const uint8_t max,
+                        const char* beg,
+                        const char* end);
+
+#endif
@@ -0,0 +1,107 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdint.h>
+
+#include "common/hist.h"
+
+
+// Bins span from one microsecond to a few seconds in the 1-2.5-5 sequence.
+const uint64_t hist_bound[HIST_BINS - 1] = {
+  1000ULL,       2500ULL,       5000ULL,
+  10000ULL,      25000ULL,      50000ULL,
+  100000ULL,     250000ULL,     500000ULL,
+  1000000ULL,    2500000ULL,    5000000ULL,
+  10000000ULL,   25000000ULL,   50000000ULL,
+  100000000ULL,  250000000ULL,  500000000ULL,
+  1000000000ULL, 2500000000ULL
+};
+
+/// Account for a value in the histogram. This function must be called only
+/// by the thread that owns the histogram.
+///
+/// @param[in] hs  histogram
+/// @param[in] val value in nanoseconds
+void
+update_hist(struct hist* hs, const uint64_t val)
+{
+  uint8_t i;
+
+  for (i = 0; i < HIST_BINS - 1; i++) {
+    if (val <= hist_bound[i]) {
+      break;
+    }
+  }
+
+  // Each value is stored atomically, so that readers never observe a torn
+  // value. The values as a whole can be slightly out of sync.
+  __atomic_store_n(&hs->hs_bin[i], hs->hs_bin[i] + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&hs->hs_sum,    hs->hs_sum    + val, __ATOMIC_RELAXED);
+  __atomic_store_n(&hs->hs_cnt,    hs->hs_cnt    + 1, __ATOMIC_RELAXED);
+}
+
+/// Obtain a snapshot of the histogram. The total count is adjusted to match
+/// the sum of the bins.
+///
+/// @param[out] out snapshot
+/// @param[in]  hs  histogram
+void
+read_hist(struct hist* out, const struct hist* hs)
+{
+  uint8_t i;
+
+  out->hs_cnt = 0;
+  for (i = 0; i < HIST_BINS; i++) {
+    out->hs_bin[i] = __atomic_load_n(&hs->hs_bin[i], __ATOMIC_RELAXED);
+    out->hs_cnt   += out->hs_bin[i];
+  }
+  out->hs_sum = __atomic_load_n(&hs->hs_sum, __ATOMIC_RELAXED);
+}
+
+/// Add the values of a histogram to an aggregate. The source histogram can be
+/// concurrently updated by its owning thread.
+///
+/// @param[out] dst aggregated histogram
+/// @param[in]  src histogram
+void
+merge_hist(struct hist* dst, const struct hist* src)
+{
+  struct hist snap;
+  uint8_t i;
+
+  read_hist(&snap, src);
+  for (i = 0; i < HIST_BINS; i++) {
+    dst->hs_bin[i] += snap.hs_bin[i];
+  }
+  dst->hs_cnt += snap.hs_cnt;
+  dst->hs_sum += snap.hs_sum;
+}
+
+/// Estimate a percentile of the values as the upper bound of the bin that
+/// contains it.
+/// @return upper bound in nanoseconds (UINT64_MAX for the unbounded bin)
+///
+/// @param[in] hs  histogram
+/// @param[in] pct percentile (0-100)
+uint64_t
+quantile_hist(const struct hist* hs, const uint64_t pct)
+{
+  uint64_t need;
+  uint64_t seen;
+  uint8_t i;
+
+  // Ceiling of the rank, so that the percentile is never underestimated.
+  need = (hs->hs_cnt * pct + 99) / 100;
+  seen = 0;
+  for (i = 0; i < HIST_BINS - 1; i++) {
+    seen += hs->hs_bin[i];
+    if (seen >= need) {
+      return hist_bound[i];
+    }
+  }
+
+  return UINT64_MAX;
+}
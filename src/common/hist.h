@@ -0,0 +1,33 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_HIST_H
+#define NEMO_COMMON_HIST_H
+
+#include <stdint.h>
+
+
+// Number of bins, including the final unbounded one.
+#define HIST_BINS 21
+
+// Upper bounds of the bounded bins in nanoseconds.
+extern const uint64_t hist_bound[HIST_BINS - 1];
+
+/// Histogram of durations. The histogram is updated by a single thread, and
+/// can be read by other threads at any time. The individual values are not
+/// cumulative.
+struct hist {
+  uint64_t hs_bin[HIST_BINS]; ///< Number of values in each bin.
+  uint64_t hs_cnt;            ///< Number of all values.
+  uint64_t hs_sum;            ///< Sum of all values.
+};
+
+void update_hist(struct hist* hs, const uint64_t val);
+void read_hist(struct hist* out, const struct hist* hs);
+void merge_hist(struct hist* dst, const struct hist* src);
+uint64_t quantile_hist(const struct hist* hs, const uint64_t pct);
+
+#endif
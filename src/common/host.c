@@ -0,0 +1,178 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/host.h"
+#include "common/log.h"
+
+
+/// Allocate the host cache for a number of peers. The capacity is at least
+/// twice the number of peers, as the cache is never filled beyond its half.
+/// @return success/failure indication
+///
+/// @param[out] hc  host cache
+/// @param[in]  cnt number of peers
+bool
+create_host_cache(struct host_cache* hc, const uint64_t cnt)
+{
+  (void)memset(hc, 0, sizeof(*hc));
+
+  hc->hc_bits = 4;
+  hc->hc_cap  = HOST_CACHE_MIN;
+  while (hc->hc_cap < 2 * cnt && hc->hc_bits < 32) {
+    hc->hc_cap <<= 1;
+    hc->hc_bits++;
+  }
+
+  hc->hc_ent = calloc((size_t)hc->hc_cap, sizeof(*hc->hc_ent));
+  if (hc->hc_ent == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for %" PRIu64 " host names",
+        hc->hc_cap);
+    return false;
+  }
+
+  return true;
+}
+
+/// Release the memory held by the host cache.
+///
+/// @param[in] hc host cache
+void
+delete_host_cache(struct host_cache* hc)
+{
+  free(hc->hc_ent);
+  (void)memset(hc, 0, sizeof(*hc));
+}
+
+/// Derive the identifier of a host from its name. The identifier is the
+/// 64-bit FNV-1a hash of the name, so that every peer derives the same
+/// identifier without any coordination.
+/// @return host identifier (never zero)
+///
+/// @param[in] hn host name
+uint64_t
+host_id(const char hn[static NEMO_HOST_NAME_SIZE])
+{
+  uint64_t id;
+  uint8_t i;
+
+  id = 0xcbf29ce484222325ULL;
+  for (i = 0; i < NEMO_HOST_NAME_SIZE && hn[i] != '\0'; i++) {
+    id ^= (uint8_t)hn[i];
+    id *= 0x100000001b3ULL;
+  }
+
+  // Zero denotes an unused cache entry.
+  if (id == 0) {
+    id = 1;
+  }
+
+  return id;
+}
+
+/// Find the cache entry of a host identifier.
+/// @return entry (NULL if the identifier is not present and cannot be added)
+///
+/// @param[in] hc host cache
+/// @param[in] id host identifier
+static struct host*
+find_host(const struct host_cache* hc, const uint64_t id)
+{
+  const struct host* ho;
+  uint64_t idx;
+  uint64_t i;
+
+  if (hc->hc_ent == NULL) {
+    return NULL;
+  }
+
+  idx = (id * 0x9e3779b97f4a7c15ULL) >> (64 - hc->hc_bits);
+  for (i = 0; i < hc->hc_cap; i++) {
+    ho = &hc->hc_ent[(idx + i) & (hc->hc_cap - 1)];
+    if (ho->ho_id == id || ho->ho_id == 0) {
+      return (struct host*)ho;
+    }
+  }
+
+  return NULL;
+}
+
+/// Remember the name of a host. Hosts are never removed, and no new hosts are
+/// added once the cache is half full, so that the probe sequences remain
+/// short. The cache is sized for the expected number of peers, so that this
+/// limit is reached only by unexpected peers.
+///
+/// @param[in] hc host cache
+/// @param[in] id host identifier
+/// @param[in] hn host name
+void
+learn_host(struct host_cache* hc,
+           const uint64_t id,
+           const char hn[static NEMO_HOST_NAME_SIZE])
+{
+  struct host* ho;
+
+  ho = find_host(hc, id);
+  if (ho == NULL) {
+    return;
+  }
+
+  if (ho->ho_id == 0) {
+    if (2 * hc->hc_nused >= hc->hc_cap) {
+      return;
+    }
+
+    ho->ho_id = id;
+    hc->hc_nused++;
+  }
+
+  (void)memcpy(ho->ho_name, hn, NEMO_HOST_NAME_SIZE);
+}
+
+/// Check whether the name of a host is already known under its identifier.
+/// @return presence indication
+///
+/// @param[in] hc host cache
+/// @param[in] id host identifier
+/// @param[in] hn host name
+bool
+known_host(const struct host_cache* hc,
+           const uint64_t id,
+           const char hn[static NEMO_HOST_NAME_SIZE])
+{
+  const struct host* ho;
+
+  ho = find_host(hc, id);
+  return ho != NULL && ho->ho_id == id
+      && memcmp(ho->ho_name, hn, NEMO_HOST_NAME_SIZE) == 0;
+}
+
+/// Resolve a host identifier to its name. Identifiers that were not learned
+/// yet are rendered in the hexadecimal notation.
+///
+/// @param[out] hn host name
+/// @param[in]  hc host cache
+/// @param[in]  id host identifier
+void
+lookup_host(char hn[static NEMO_HOST_NAME_SIZE],
+            const struct host_cache* hc,
+            const uint64_t id)
+{
+  const struct host* ho;
+
+  ho = find_host(hc, id);
+  if (ho != NULL && ho->ho_id == id) {
+    (void)memcpy(hn, ho->ho_name, NEMO_HOST_NAME_SIZE);
+    return;
+  }
+
+  (void)memset(hn, 0, NEMO_HOST_NAME_SIZE);
+  (void)snprintf(hn, NEMO_HOST_NAME_SIZE, "0x%016" PRIx64, id);
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_HOST_H
+#define NEMO_COMMON_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/payload.h"
+
+
+// Smallest capacity of the host cache.
+#define HOST_CACHE_MIN 16
+
+/// Host name learned from a full-size payload.
+struct host {
+  uint64_t ho_id;                         ///< Host identifier (zero if unused).
+  char     ho_name[NEMO_HOST_NAME_SIZE];  ///< Host name.
+};
+
+/// Cache of host names by their identifiers, used to resolve the identifiers
+/// of compact payloads.
+struct host_cache {
+  struct host* hc_ent;    ///< Open-addressing hash table (NULL if absent).
+  uint64_t     hc_cap;    ///< Number of entries (power of two).
+  uint64_t     hc_nused;  ///< Number of occupied entries.
+  uint8_t      hc_bits;   ///< Base-2 logarithm of the capacity.
+  uint8_t      hc_pad[7]; ///< Padding (unused).
+};
+
+bool create_host_cache(struct host_cache* hc, const uint64_t cnt);
+void delete_host_cache(struct host_cache* hc);
+uint64_t host_id(const char hn[static NEMO_HOST_NAME_SIZE]);
+void learn_host(struct host_cache* hc,
+                const uint64_t id,
+                const char hn[static NEMO_HOST_NAME_SIZE]);
+bool known_host(const struct host_cache* hc,
+                const uint64_t id,
+                const char hn[static NEMO_HOST_NAME_SIZE]);
+void lookup_host(char hn[static NEMO_HOST_NAME_SIZE],
+                 const struct host_cache* hc,
+                 const uint64_t id);
+
+#endif
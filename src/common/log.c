@@ -4,6 +4,10 @@
 // Distributed under the terms of the 2-clause BSD License. The full
 // license is in the file LICENSE, distributed as part of this software.
 
+#include <pthread.h>
+#include <signal.h>
+#include <syslog.h>
+
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -25,6 +29,31 @@ bool    log_col; ///< Coloring policy.
 // Maximal length of a logging line.
 #define NEMO_LOG_MAX_LENGTH 128
 
+// Asynchronous logging.
+#define LOG_RING_SIZE 1024       ///< Number of buffered messages (power of two).
+#define LOG_SLOT_SIZE 256        ///< Maximal length of a buffered message.
+#define LOG_TICK      10000000   ///< Writer wake-up period of 10ms.
+
+/// Buffered message.
+struct slot {
+  uint64_t sl_seq;                ///< Sequence number of the slot.
+  time_t   sl_time;               ///< Time of the message.
+  uint8_t  sl_lvl;                ///< Logging level.
+  char     sl_msg[LOG_SLOT_SIZE]; ///< Formatted message.
+};
+
+// Multiple-producer single-consumer queue of messages, using the per-slot
+// sequence numbers to hand over the slots without any locks.
+static struct slot* log_ring = NULL; ///< Buffered messages.
+static uint64_t log_tail     = 0;    ///< Next slot to reserve by a producer.
+static uint64_t log_head     = 0;    ///< Next slot to output by the writer.
+static uint64_t log_drop     = 0;    ///< Messages dropped due to a full queue.
+static bool log_async        = false; ///< Asynchronous mode is active.
+static bool log_stop         = false; ///< Writer thread termination request.
+static bool log_hook         = false; ///< Process hooks are registered.
+static uint8_t log_bknd      = LB_STDERR; ///< Selected back-end service.
+static pthread_t log_thr;            ///< Writer thread.
+
 /// Append a string (possibly truncating it).
 /// @return new length of the string
 ///
@@ -132,70 +161,342 @@ highlight(char* out, const char* inp, const size_t len)
   (void)append(out, "\x1b[0m", cur, max);
 }
 
-/// Issue a log line to the selected back-end service.
+/// Format the message with all its arguments.
 ///
-/// @param[in] lvl  logging level (one of LL_*)
-/// @param[in] perr append the errno string to end of the log line
-/// @param[in] fmt  message to log
-/// @param[in] ...  arguments for the message
-void
-log(const uint8_t lvl,
-    const bool perr,
-    const char* fmt,
-    ...)
+/// @param[out] out  formatted message
+/// @param[in]  len  maximal length of the message
+/// @param[in]  perr append the errno string to end of the message
+/// @param[in]  save saved errno
+/// @param[in]  fmt  message format
+/// @param[in]  args arguments for the message
+static void
+format_message(char* out,
+               const size_t len,
+               const bool perr,
+               const int save,
+               const char* fmt,
+               va_list args)
 {
-  char tstr[32];
   char hfmt[NEMO_LOG_MAX_LENGTH];
-  char msg[NEMO_LOG_MAX_LENGTH];
-  char errmsg[NEMO_LOG_MAX_LENGTH];
-  struct tm tfmt;
-  time_t tspec;
-  va_list args;
-  int save;
-  static const char* lname[] = {"ERROR", " WARN", " INFO", "DEBUG", "TRACE"};
-  static const int lcol[]    = {31, 33, 32, 34, 35};
-  char lstr[32];
-
-  // Ignore messages that fall below the global threshold.
-  if (lvl > log_lvl) {
-    return;
-  }
-
-  // Save the errno with which the function was called.
-  save = errno;
-
-  // Obtain and format the current time in GMT.
-  tspec = time(NULL);
-  (void)gmtime_r(&tspec, &tfmt);
-  (void)strftime(tstr, sizeof(tstr), "%F %T", &tfmt);
+  size_t cur;
+  int reti;
 
   // Prepare highlights for the message variables.
   (void)memset(hfmt, '\0', sizeof(hfmt));
   if (log_col == true) {
     highlight(hfmt, fmt, sizeof(hfmt));
   } else {
-    (void)memcpy(hfmt, fmt, strlen(fmt));
+    (void)strncpy(hfmt, fmt, sizeof(hfmt) - 1);
   }
 
   // Fill in the passed message.
-  va_start(args, fmt);
-  (void)vsprintf(msg, hfmt, args);
-  va_end(args);
+  reti = vsnprintf(out, len, hfmt, args);
+  if (reti < 0) {
+    cur = 0;
+    out[0] = '\0';
+  } else if ((size_t)reti >= len) {
+    cur = len - 1;
+  } else {
+    cur = (size_t)reti;
+  }
 
-  // Obtain the errno message.
-  (void)memset(errmsg, '\0', sizeof(errmsg));
+  // Append the errno message.
   if (perr == true) {
-    (void)sprintf(errmsg, ": %s", strerror(save));
+    (void)snprintf(out + cur, len - cur, ": %s", strerror(save));
+  }
+}
+
+/// Output a log line to the selected back-end service.
+///
+/// @param[in] lvl   logging level (one of LL_*)
+/// @param[in] tspec time of the message
+/// @param[in] msg   formatted message
+static void
+output_line(const uint8_t lvl, const time_t tspec, const char* msg)
+{
+  char tstr[32];
+  char lstr[32];
+  struct tm tfmt;
+  static const char* lname[] = {"ERROR", " WARN", " INFO", "DEBUG", "TRACE"};
+  static const int lcol[]    = {31, 33, 32, 34, 35};
+  static const int lprio[]   = {LOG_ERR, LOG_WARNING, LOG_INFO, LOG_DEBUG, LOG_DEBUG};
+
+  // The system logging daemon adds its own timestamps.
+  if (log_bknd == LB_SYSLOG) {
+    syslog(lprio[lvl], "%s", msg);
+    return;
   }
 
+  // Format the time in GMT.
+  (void)gmtime_r(&tspec, &tfmt);
+  (void)strftime(tstr, sizeof(tstr), "%F %T", &tfmt);
+
   // Format the level name.
   (void)memset(lstr, '\0', sizeof(lstr));
   if (log_col == true) {
-    (void)sprintf(lstr, "\x1b[%dm%s\x1b[0m", lcol[lvl], lname[lvl]);
+    (void)snprintf(lstr, sizeof(lstr), "\x1b[%dm%s\x1b[0m", lcol[lvl], lname[lvl]);
   } else {
     (void)strncpy(lstr, lname[lvl], sizeof(lstr) - 1);
   }
 
   // Print the final log line.
-  (void)fprintf(stderr, "[%s] %s - %s%s\n", tstr, lstr, msg, errmsg);
+  (void)fprintf(stderr, "[%s] %s - %s\n", tstr, lstr, msg);
+}
+
+/// Issue a log line to the selected back-end service. In the asynchronous
+/// mode, the message is formatted into the queue and the output is left to
+/// the writer thread. Messages are dropped rather than delaying the caller
+/// when the queue is full.
+///
+/// @param[in] lvl  logging level (one of LL_*)
+/// @param[in] perr append the errno string to end of the log line
+/// @param[in] fmt  message to log
+/// @param[in] ...  arguments for the message
+void
+log_write(const uint8_t lvl,
+          const bool perr,
+          const char* fmt,
+          ...)
+{
+  char msg[LOG_SLOT_SIZE];
+  struct slot* sl;
+  uint64_t pos;
+  uint64_t seq;
+  va_list args;
+  int save;
+
+  // Save the errno with which the function was called.
+  save = errno;
+
+  if (__atomic_load_n(&log_async, __ATOMIC_ACQUIRE) == false) {
+    va_start(args, fmt);
+    format_message(msg, sizeof(msg), perr, save, fmt, args);
+    va_end(args);
+
+    output_line(lvl, time(NULL), msg);
+    errno = save;
+    return;
+  }
+
+  // Reserve a slot in the queue.
+  pos = __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+  while (true) {
+    sl  = &log_ring[pos & (LOG_RING_SIZE - 1)];
+    seq = __atomic_load_n(&sl->sl_seq, __ATOMIC_ACQUIRE);
+
+    // The slot is free for this position.
+    if (seq == pos) {
+      if (__atomic_compare_exchange_n(&log_tail, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED) == true) {
+        break;
+      }
+
+      continue;
+    }
+
+    // The slot still holds a message from the previous cycle.
+    if (seq < pos) {
+      __atomic_fetch_add(&log_drop, 1, __ATOMIC_RELAXED);
+      errno = save;
+      return;
+    }
+
+    pos = __atomic_load_n(&log_tail, __ATOMIC_RELAXED);
+  }
+
+  sl->sl_time = time(NULL);
+  sl->sl_lvl  = lvl;
+  va_start(args, fmt);
+  format_message(sl->sl_msg, sizeof(sl->sl_msg), perr, save, fmt, args);
+  va_end(args);
+
+  // Publish the message to the writer thread.
+  __atomic_store_n(&sl->sl_seq, pos + 1, __ATOMIC_RELEASE);
+  errno = save;
+}
+
+/// Output all published messages.
+/// @return number of messages
+static uint64_t
+drain_log(void)
+{
+  struct slot* sl;
+  uint64_t cnt;
+  uint64_t drop;
+  char msg[64];
+
+  cnt = 0;
+  while (true) {
+    sl = &log_ring[log_head & (LOG_RING_SIZE - 1)];
+    if (__atomic_load_n(&sl->sl_seq, __ATOMIC_ACQUIRE) != log_head + 1) {
+      break;
+    }
+
+    output_line(sl->sl_lvl, sl->sl_time, sl->sl_msg);
+
+    // Release the slot for the next cycle of the producers.
+    __atomic_store_n(&sl->sl_seq, log_head + LOG_RING_SIZE, __ATOMIC_RELEASE);
+    log_head++;
+    cnt++;
+  }
+
+  // Report the messages lost since the last drain.
+  drop = __atomic_exchange_n(&log_drop, 0, __ATOMIC_RELAXED);
+  if (drop > 0) {
+    (void)snprintf(msg, sizeof(msg), "dropped %" PRIu64 " log messages", drop);
+    output_line(LL_WARN, time(NULL), msg);
+  }
+
+  return cnt;
+}
+
+/// Entry point of the writer thread.
+/// @return unused
+///
+/// @param[in] arg unused
+static void*
+log_main(void* arg)
+{
+  struct timespec tick;
+  bool stop;
+
+  (void)arg;
+
+  tick.tv_sec  = 0;
+  tick.tv_nsec = LOG_TICK;
+  while (true) {
+    stop = __atomic_load_n(&log_stop, __ATOMIC_ACQUIRE);
+    if (drain_log() > 0) {
+      continue;
+    }
+
+    // Producers that reserved a slot before the stop might not have
+    // published their message yet, so the final drain awaits all of them.
+    if (stop == true
+     && __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE) == log_head) {
+      break;
+    }
+
+    (void)nanosleep(&tick, NULL);
+  }
+
+  (void)fflush(stderr);
+  return NULL;
+}
+
+/// Disable the asynchronous mode in a child process, as the writer thread is
+/// not duplicated by fork(2).
+static void
+log_child(void)
+{
+  __atomic_store_n(&log_async, false, __ATOMIC_RELAXED);
+}
+
+/// Parse the logging back-end service name.
+/// @return success/failure indication
+///
+/// @param[out] bknd back-end service
+/// @param[in]  inp  argument input
+bool
+parse_log_backend(uint8_t* bknd, const char* inp)
+{
+  if (strcmp(inp, "stderr") == 0) {
+    *bknd = LB_STDERR;
+    return true;
+  }
+
+  if (strcmp(inp, "syslog") == 0) {
+    *bknd = LB_SYSLOG;
+    return true;
+  }
+
+  log(LL_WARN, false, "unknown logging back-end '%s'", inp);
+  return false;
+}
+
+/// Obtain the name of a logging back-end service.
+/// @return back-end service name
+///
+/// @param[in] bknd back-end service
+const char*
+log_backend_name(const uint8_t bknd)
+{
+  if (bknd == LB_SYSLOG) {
+    return "syslog";
+  }
+
+  return "stderr";
+}
+
+/// Start the asynchronous logging to the selected back-end service. The
+/// remaining messages are output when the process exits.
+/// @return success/failure indication
+///
+/// @param[in] bknd  back-end service (one of LB_*)
+/// @param[in] ident program identification for the system logging daemon
+bool
+start_log(const uint8_t bknd, const char* ident)
+{
+  sigset_t all;
+  sigset_t old;
+  uint64_t i;
+  int reti;
+
+  // The system logging daemon does not interpret the escape codes.
+  if (bknd == LB_SYSLOG) {
+    openlog(ident, LOG_PID | LOG_NDELAY, LOG_DAEMON);
+    log_col = false;
+  }
+  log_bknd = bknd;
+
+  // The queue is retained for the lifetime of the process, so that a late
+  // producer never accesses released memory.
+  if (log_ring == NULL) {
+    log_ring = calloc(LOG_RING_SIZE, sizeof(*log_ring));
+    if (log_ring == NULL) {
+      log(LL_WARN, true, "unable to allocate memory for the log queue");
+      return false;
+    }
+  }
+
+  for (i = 0; i < LOG_RING_SIZE; i++) {
+    log_ring[i].sl_seq = i;
+  }
+  log_tail = 0;
+  log_head = 0;
+  log_stop = false;
+
+  // The writer thread must never handle signals meant for the main thread.
+  (void)sigfillset(&all);
+  (void)pthread_sigmask(SIG_SETMASK, &all, &old);
+  reti = pthread_create(&log_thr, NULL, log_main, NULL);
+  (void)pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to start the log writer: %s", strerror(reti));
+    return false;
+  }
+
+  if (log_hook == false) {
+    (void)pthread_atfork(NULL, NULL, log_child);
+    (void)atexit(stop_log);
+    log_hook = true;
+  }
+
+  __atomic_store_n(&log_async, true, __ATOMIC_RELEASE);
+  return true;
+}
+
+/// Output all remaining messages and stop the asynchronous logging.
+void
+stop_log(void)
+{
+  if (__atomic_load_n(&log_async, __ATOMIC_ACQUIRE) == false) {
+    return;
+  }
+
+  // Any further messages are output synchronously, while the writer thread
+  // outputs the queued messages before terminating.
+  __atomic_store_n(&log_async, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&log_stop, true, __ATOMIC_RELEASE);
+  (void)pthread_join(log_thr, NULL);
 }
@@ -22,14 +22,44 @@
 #define LB_STDERR 1 // Standard error stream.
 #define LB_SYSLOG 2 // System logging daemon.
 
+// Highest logging level compiled into the program. Messages above this level
+// are eliminated by the compiler, including the evaluation of their arguments.
+#ifndef NEMO_LOG_LEVEL
+  #define NEMO_LOG_LEVEL LL_TRACE
+#endif
+
 // Logging settings.
 extern uint8_t log_lvl; ///< Minimal level threshold.
 extern bool log_col;    ///< Colouring policy.
 
+/// Decide whether a message passes the run-time threshold.
+/// @return decision
+///
+/// @param[in] lvl logging level (one of LL_*)
+static inline bool
+log_enabled(const uint8_t lvl)
+{
+  return lvl <= log_lvl;
+}
+
 // Logging function.
-void log(const uint8_t lvl,
-         const bool perr,
-         const char* msg,
-         ...);
+void log_write(const uint8_t lvl,
+               const bool perr,
+               const char* msg,
+               ...);
+
+// Filter the message before any of its arguments are evaluated.
+#define log(lvl, perr, ...)                                  \
+  do {                                                       \
+    if ((lvl) <= NEMO_LOG_LEVEL && log_enabled(lvl)) {       \
+      log_write((lvl), (perr), __VA_ARGS__);                 \
+    }                                                        \
+  } while (0)
+
+// Asynchronous logging.
+bool parse_log_backend(uint8_t* bknd, const char* inp);
+const char* log_backend_name(const uint8_t bknd);
+bool start_log(const uint8_t bknd, const char* ident);
+void stop_log(void);
 
 #endif
@@ -5,12 +5,25 @@
 // license is in the file LICENSE, distributed as part of this software.
 
 #include <unistd.h>
+#include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
 #include <time.h>
 
 #include "common/convert.h"
+#include "common/log.h"
 #include "common/now.h"
 
+// The time-stamp counter is only supported on the x86 architecture.
+#if defined(__x86_64__) || defined(__i386__)
+  #define NOW_HAVE_TSC 1
+  #include <cpuid.h>
+#else
+  #define NOW_HAVE_TSC 0
+#endif
+
 
 // Make sure that the POSIX timers are available on this system.
 #if _POSIX_TIMERS == 0
@@ -23,10 +36,45 @@
 #endif
 
 
-/// Get the current real-time clock value.
+// Calibration of the time-stamp counter.
+#define TSC_SHIFT     24          ///< Fixed-point precision of the tick length.
+#define TSC_SAMPLES   8           ///< Attempts to obtain a tight clock sample.
+#define TSC_WINDOW    10000000ULL ///< Startup calibration window of 10ms.
+#define TSC_PERIOD    1000000000ULL ///< Recalibration period of one second.
+#define TSC_STEP_MAX  1000000ULL  ///< Largest error corrected by slewing.
+#define TSC_DRIFT_MAX 1000ULL     ///< Largest rate difference in ppm.
+#define TSC_SPAN_MAX  (1ULL << 39) ///< Longest window for the rate computation.
+
+/// Calibration of the time-stamp counter against the monotonic clock. The
+/// conversion parameters are protected by a sequence lock, so that readers
+/// never block, whereas the recalibration is performed by at most one thread
+/// at a time.
+struct calib {
+  uint64_t tc_seq;  ///< Sequence number of the conversion parameters.
+  uint64_t tc_tsc;  ///< Anchor counter value.
+  uint64_t tc_mono; ///< Monotonic time at the anchor.
+  uint64_t tc_mult; ///< Fixed-point tick length in nanoseconds.
+  uint64_t tc_roff; ///< Offset of the real-time clock from the monotonic one.
+  uint64_t tc_per;  ///< Recalibration period in ticks.
+  uint64_t tc_lock; ///< Recalibration in progress.
+  uint64_t tc_base; ///< Tick length established at startup.
+  uint64_t tc_rtsc; ///< Counter value of the last clock sample.
+  uint64_t tc_rmon; ///< Monotonic time of the last clock sample.
+};
+
+static uint8_t now_clk = NOW_CLOCK_SYSTEM;
+static struct calib tc;
+
+// Acceleration of the virtual clock, along with the monotonic and real times
+// at which the acceleration started.
+static uint64_t now_acc = 1;
+static uint64_t now_mbeg = 0;
+static uint64_t now_rbeg = 0;
+
+/// Get the current real-time clock value from the system.
 /// @return time in nanoseconds
-uint64_t
-real_now(void)
+static uint64_t
+system_real(void)
 {
   uint64_t ns;
   struct timespec ts;
@@ -41,10 +89,10 @@ real_now(void)
   return ns;
 }
 
-/// Get the current monotonic clock value.
+/// Get the current monotonic clock value from the system.
 /// @return time in nanoseconds
-uint64_t
-mono_now(void)
+static uint64_t
+system_mono(void)
 {
   uint64_t ns;
   struct timespec ts;
@@ -58,3 +106,518 @@ mono_now(void)
 
   return ns;
 }
+
+/// Read the time-stamp counter.
+/// @return counter value
+static uint64_t
+read_tsc(void)
+{
+#if NOW_HAVE_TSC == 1
+  return (uint64_t)__builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/// Verify that the operating system considers the time-stamp counter to be
+/// synchronized across all CPUs. The Linux kernel removes the counter from the
+/// list of available clock sources once it detects its instability.
+/// @return success/failure indication
+static bool
+verify_kernel_tsc(void)
+{
+#if defined(__linux__)
+  FILE* file;
+  char line[256];
+  char* tok;
+  char* save;
+
+  file = fopen("/sys/devices/system/clocksource/clocksource0/available_clocksource", "r");
+  if (file == NULL) {
+    log(LL_DEBUG, true, "unable to inspect the kernel clock sources");
+    return true;
+  }
+
+  (void)memset(line, '\0', sizeof(line));
+  tok = fgets(line, sizeof(line), file);
+  (void)fclose(file);
+  if (tok == NULL) {
+    return true;
+  }
+
+  for (tok = strtok_r(line, " \n", &save); tok != NULL; tok = strtok_r(NULL, " \n", &save)) {
+    if (strcmp(tok, "tsc") == 0) {
+      return true;
+    }
+  }
+
+  log(LL_WARN, false, "time-stamp counter was marked unstable by the kernel");
+  return false;
+#else
+  return true;
+#endif
+}
+
+/// Verify that the time-stamp counter ticks at a constant rate regardless of
+/// the frequency scaling and sleep states of the CPU.
+/// @return success/failure indication
+static bool
+verify_tsc(void)
+{
+#if NOW_HAVE_TSC == 1
+  unsigned int eax;
+  unsigned int ebx;
+  unsigned int ecx;
+  unsigned int edx;
+  int reti;
+
+  // Invariant counter is advertised in the advanced power management leaf.
+  reti = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  if (reti == 0 || (edx & (1U << 8)) == 0) {
+    log(LL_WARN, false, "time-stamp counter is not invariant");
+    return false;
+  }
+
+  return verify_kernel_tsc();
+#else
+  log(LL_WARN, false, "time-stamp counter is not supported on this platform");
+  return false;
+#endif
+}
+
+/// Obtain a simultaneous reading of the time-stamp counter and the monotonic
+/// clock. The reading with the shortest duration is selected out of multiple
+/// attempts to minimize the effect of preemption.
+///
+/// @param[out] tsc  counter value
+/// @param[out] mono monotonic time
+static void
+sample_clocks(uint64_t* tsc, uint64_t* mono)
+{
+  uint64_t best;
+  uint64_t pre;
+  uint64_t post;
+  uint64_t ns;
+  int i;
+
+  best = UINT64_MAX;
+  for (i = 0; i < TSC_SAMPLES; i++) {
+    pre  = read_tsc();
+    ns   = system_mono();
+    post = read_tsc();
+
+    if (post - pre < best) {
+      best  = post - pre;
+      *tsc  = pre + (post - pre) / 2;
+      *mono = ns;
+    }
+  }
+}
+
+/// Compute the fixed-point tick length based on two clock samples.
+/// @return tick length
+///
+/// @param[in] tsc0  first counter value
+/// @param[in] mono0 first monotonic time
+/// @param[in] tsc1  second counter value
+/// @param[in] mono1 second monotonic time
+static uint64_t
+tick_length(const uint64_t tsc0,
+            const uint64_t mono0,
+            const uint64_t tsc1,
+            const uint64_t mono1)
+{
+  if (tsc1 <= tsc0) {
+    return 0;
+  }
+
+  return ((mono1 - mono0) << TSC_SHIFT) / (tsc1 - tsc0);
+}
+
+/// Compute the difference between two tick lengths.
+/// @return difference in parts per million
+///
+/// @param[in] a tick length
+/// @param[in] b reference tick length
+static uint64_t
+tick_drift(const uint64_t a, const uint64_t b)
+{
+  uint64_t diff;
+
+  if (a > b) {
+    diff = a - b;
+  } else {
+    diff = b - a;
+  }
+
+  return (diff * 1000000ULL) / b;
+}
+
+/// Publish new conversion parameters.
+///
+/// @param[in] tsc  anchor counter value
+/// @param[in] mono monotonic time at the anchor
+/// @param[in] mult fixed-point tick length
+/// @param[in] roff offset of the real-time clock
+static void
+store_calib(const uint64_t tsc,
+            const uint64_t mono,
+            const uint64_t mult,
+            const uint64_t roff)
+{
+  uint64_t seq;
+
+  seq = __atomic_load_n(&tc.tc_seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&tc.tc_seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  __atomic_store_n(&tc.tc_tsc,  tsc,  __ATOMIC_RELAXED);
+  __atomic_store_n(&tc.tc_mono, mono, __ATOMIC_RELAXED);
+  __atomic_store_n(&tc.tc_mult, mult, __ATOMIC_RELAXED);
+  __atomic_store_n(&tc.tc_roff, roff, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&tc.tc_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/// Obtain a consistent snapshot of the conversion parameters.
+///
+/// @param[out] tsc  anchor counter value
+/// @param[out] mono monotonic time at the anchor
+/// @param[out] mult fixed-point tick length
+/// @param[out] roff offset of the real-time clock
+static void
+load_calib(uint64_t* tsc, uint64_t* mono, uint64_t* mult, uint64_t* roff)
+{
+  uint64_t seq1;
+  uint64_t seq2;
+
+  do {
+    seq1  = __atomic_load_n(&tc.tc_seq,  __ATOMIC_ACQUIRE);
+    *tsc  = __atomic_load_n(&tc.tc_tsc,  __ATOMIC_RELAXED);
+    *mono = __atomic_load_n(&tc.tc_mono, __ATOMIC_RELAXED);
+    *mult = __atomic_load_n(&tc.tc_mult, __ATOMIC_RELAXED);
+    *roff = __atomic_load_n(&tc.tc_roff, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seq2  = __atomic_load_n(&tc.tc_seq,  __ATOMIC_RELAXED);
+  } while (seq1 != seq2 || (seq1 & 1) != 0);
+}
+
+/// Correct the conversion parameters against the monotonic clock. Small
+/// errors are slewed over the next period to keep the time monotonic, while
+/// larger errors caused by the counter falling behind are stepped over. The
+/// counter is abandoned if its rate drifts beyond the limits of the NTP
+/// frequency adjustments.
+///
+/// @param[in] tsc  current counter value
+/// @param[in] cur  current converted monotonic time
+static void
+recalibrate(const uint64_t tsc, const uint64_t cur)
+{
+  uint64_t rtsc;
+  uint64_t rmon;
+  uint64_t raw;
+  uint64_t mult;
+  uint64_t corr;
+  uint64_t anchor;
+  uint64_t roff;
+
+  sample_clocks(&rtsc, &rmon);
+  roff = system_real() - system_mono();
+
+  // Measure the current tick length, unless the last sample is too old.
+  raw = tc.tc_base;
+  if (rmon - tc.tc_rmon < TSC_SPAN_MAX) {
+    raw = tick_length(tc.tc_rtsc, tc.tc_rmon, rtsc, rmon);
+  }
+  tc.tc_rtsc = rtsc;
+  tc.tc_rmon = rmon;
+
+  if (raw == 0 || tick_drift(raw, tc.tc_base) > TSC_DRIFT_MAX) {
+    log(LL_WARN, false, "time-stamp counter became unstable, using system clock");
+    __atomic_store_n(&now_clk, NOW_CLOCK_SYSTEM, __ATOMIC_RELAXED);
+    return;
+  }
+
+  // Extrapolate the converted time to the instant of the new sample.
+  anchor = cur;
+  if (rtsc > tsc) {
+    anchor += ((rtsc - tsc) * tc.tc_mult) >> TSC_SHIFT;
+  }
+
+  if (rmon >= anchor) {
+    // The counter is behind the system clock.
+    if (rmon - anchor > TSC_STEP_MAX) {
+      anchor = rmon;
+      mult   = raw;
+    } else {
+      corr = ((rmon - anchor) << TSC_SHIFT) / tc.tc_per;
+      mult = raw + corr;
+    }
+  } else {
+    // The counter is ahead of the system clock.
+    corr = anchor - rmon;
+    if (corr > TSC_STEP_MAX) {
+      corr = TSC_STEP_MAX;
+    }
+
+    corr = (corr << TSC_SHIFT) / tc.tc_per;
+    if (corr > raw / 2) {
+      corr = raw / 2;
+    }
+    mult = raw - corr;
+  }
+
+  store_calib(rtsc, anchor, mult, roff);
+}
+
+/// Get the current monotonic time based on the time-stamp counter.
+/// @return time in nanoseconds
+///
+/// @param[out] roff offset of the real-time clock
+static uint64_t
+tsc_mono(uint64_t* roff)
+{
+  uint64_t tsc;
+  uint64_t mono;
+  uint64_t mult;
+  uint64_t now;
+  uint64_t delta;
+  uint64_t cur;
+  uint64_t exp;
+
+  load_calib(&tsc, &mono, &mult, roff);
+  now = read_tsc();
+
+  // The counters of different CPUs are not perfectly aligned.
+  delta = 0;
+  if (now > tsc) {
+    delta = now - tsc;
+  }
+
+  // Avoid the overflow of the fixed-point arithmetic after a long inactivity
+  // by moving the anchor to the current instant. The rate remains, as the
+  // last sample of the rate is too old to be compared against.
+  if (delta >= 64 * tc.tc_per) {
+    exp = 0;
+    if (__atomic_compare_exchange_n(&tc.tc_lock, &exp, 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) == false) {
+      return system_mono();
+    }
+
+    sample_clocks(&tsc, &mono);
+    *roff = system_real() - system_mono();
+    store_calib(tsc, mono, mult, *roff);
+    __atomic_store_n(&tc.tc_lock, 0, __ATOMIC_RELEASE);
+
+    log(LL_DEBUG, false, "time-stamp counter re-anchored after inactivity");
+    return mono;
+  }
+
+  cur = mono + ((delta * mult) >> TSC_SHIFT);
+
+  // Periodically correct the conversion, by at most one thread at a time.
+  if (delta >= tc.tc_per) {
+    exp = 0;
+    if (__atomic_compare_exchange_n(&tc.tc_lock, &exp, 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) == true) {
+      recalibrate(now, cur);
+      __atomic_store_n(&tc.tc_lock, 0, __ATOMIC_RELEASE);
+    }
+  }
+
+  return cur;
+}
+
+/// Calibrate the time-stamp counter against the monotonic clock. The rate is
+/// measured over two consecutive windows that have to agree.
+/// @return success/failure indication
+static bool
+calibrate_tsc(void)
+{
+  uint64_t tsc[3];
+  uint64_t mono[3];
+  uint64_t mult[3];
+  struct timespec win;
+  int i;
+
+  fnanos(&win, TSC_WINDOW);
+  for (i = 0; i < 3; i++) {
+    if (i > 0) {
+      (void)nanosleep(&win, NULL);
+    }
+
+    sample_clocks(&tsc[i], &mono[i]);
+  }
+
+  mult[0] = tick_length(tsc[0], mono[0], tsc[1], mono[1]);
+  mult[1] = tick_length(tsc[1], mono[1], tsc[2], mono[2]);
+  mult[2] = tick_length(tsc[0], mono[0], tsc[2], mono[2]);
+  if (mult[0] == 0 || mult[1] == 0 || mult[2] == 0) {
+    log(LL_WARN, false, "time-stamp counter does not advance");
+    return false;
+  }
+
+  if (tick_drift(mult[1], mult[0]) > TSC_DRIFT_MAX) {
+    log(LL_WARN, false, "time-stamp counter rate is not stable");
+    return false;
+  }
+
+  tc.tc_base = mult[2];
+  tc.tc_rtsc = tsc[2];
+  tc.tc_rmon = mono[2];
+  tc.tc_per  = (TSC_PERIOD << TSC_SHIFT) / mult[2];
+  tc.tc_lock = 0;
+  store_calib(tsc[2], mono[2], mult[2], system_real() - system_mono());
+
+  log(LL_DEBUG, false, "time-stamp counter frequency: %" PRIu64 "Hz",
+      (1000000000ULL << TSC_SHIFT) / mult[2]);
+
+  return true;
+}
+
+/// Parse the clock source name.
+/// @return success/failure indication
+///
+/// @param[out] clk clock source
+/// @param[in]  inp argument input
+bool
+parse_clock(uint8_t* clk, const char* inp)
+{
+  if (strcmp(inp, "sys") == 0) {
+    *clk = NOW_CLOCK_SYSTEM;
+    return true;
+  }
+
+  if (strcmp(inp, "tsc") == 0) {
+    *clk = NOW_CLOCK_TSC;
+    return true;
+  }
+
+  log(LL_WARN, false, "unknown clock source '%s'", inp);
+  return false;
+}
+
+/// Obtain the name of a clock source.
+/// @return clock source name
+///
+/// @param[in] clk clock source
+const char*
+clock_name(const uint8_t clk)
+{
+  if (clk == NOW_CLOCK_TSC) {
+    return "tsc";
+  }
+
+  return "sys";
+}
+
+/// Select the clock source for all subsequent time readings. This function
+/// must be called before any threads are started.
+/// @return success/failure indication
+///
+/// @param[in] clk clock source
+bool
+select_clock(const uint8_t clk)
+{
+  bool retb;
+
+  if (clk == NOW_CLOCK_TSC) {
+    retb = verify_tsc();
+    if (retb == false) {
+      log(LL_WARN, false, "refusing to use the time-stamp counter");
+      return false;
+    }
+
+    retb = calibrate_tsc();
+    if (retb == false) {
+      log(LL_WARN, false, "unable to calibrate the time-stamp counter");
+      return false;
+    }
+  }
+
+  now_clk = clk;
+  return true;
+}
+
+/// Get the current real-time clock value of the selected clock source.
+/// @return time in nanoseconds
+static uint64_t
+source_real(void)
+{
+  uint64_t roff;
+  uint64_t mono;
+
+  if (__atomic_load_n(&now_clk, __ATOMIC_RELAXED) == NOW_CLOCK_SYSTEM) {
+    return system_real();
+  }
+
+  // The real-time clock is derived from the monotonic clock and an offset
+  // tracked during the recalibration.
+  mono = tsc_mono(&roff);
+  return mono + roff;
+}
+
+/// Get the current monotonic clock value of the selected clock source.
+/// @return time in nanoseconds
+static uint64_t
+source_mono(void)
+{
+  uint64_t roff;
+
+  if (__atomic_load_n(&now_clk, __ATOMIC_RELAXED) == NOW_CLOCK_SYSTEM) {
+    return system_mono();
+  }
+
+  return tsc_mono(&roff);
+}
+
+/// Run the clock faster than the wall clock by a constant factor, starting
+/// from the current time. This is only meaningful if all events observed by
+/// the process are simulated, and must be called before any threads are
+/// started.
+///
+/// @param[in] fac acceleration factor
+void
+accelerate_clock(const uint64_t fac)
+{
+  now_mbeg = source_mono();
+  now_rbeg = source_real();
+  now_acc  = fac;
+}
+
+/// Convert a duration of the clock to the duration of the wall clock, e.g.
+/// to sleep until the clock reaches a point in time.
+/// @return duration in nanoseconds
+///
+/// @param[in] dur duration of the clock
+uint64_t
+wall_span(const uint64_t dur)
+{
+  return (dur + now_acc - 1) / now_acc;
+}
+
+/// Get the current real-time clock value.
+/// @return time in nanoseconds
+uint64_t
+real_now(void)
+{
+  if (now_acc == 1) {
+    return source_real();
+  }
+
+  // The accelerated real-time clock advances in lockstep with the monotonic
+  // one, as the wall clock adjustments are not simulated.
+  return now_rbeg + (mono_now() - now_mbeg);
+}
+
+/// Get the current monotonic clock value.
+/// @return time in nanoseconds
+uint64_t
+mono_now(void)
+{
+  if (now_acc == 1) {
+    return source_mono();
+  }
+
+  return now_mbeg + (source_mono() - now_mbeg) * now_acc;
+}
@@ -7,9 +7,20 @@
 #ifndef NEMO_COMMON_NOW_H
 #define NEMO_COMMON_NOW_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
+// Clock sources.
+#define NOW_CLOCK_SYSTEM 0 ///< POSIX clock_gettime(2).
+#define NOW_CLOCK_TSC    1 ///< Calibrated invariant time-stamp counter.
+
+bool parse_clock(uint8_t* clk, const char* inp);
+const char* clock_name(const uint8_t clk);
+bool select_clock(const uint8_t clk);
+void accelerate_clock(const uint64_t fac);
+uint64_t wall_span(const uint64_t dur);
+
 uint64_t real_now(void);
 uint64_t mono_now(void);
 
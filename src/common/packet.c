@@ -8,22 +8,28 @@
 
 #include <string.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <time.h>
 
 #include "common/channel.h"
 #include "common/convert.h"
+#include "common/host.h"
 #include "common/packet.h"
 #include "common/log.h"
+#include "common/now.h"
+#include "common/sim.h"
 
 
-// This memory block is used to send and receive packets that are larger than
-// diagnostic payload.
-static uint8_t wrapper[65536];
+// This memory block is used to artificially extend outgoing packets beyond
+// the diagnostic payload. As it is never written to, it can be safely shared
+// by all channels and threads.
+static const uint8_t padding[CHANNEL_BUFFER_SIZE];
 
 /// Encode the payload to the on-wire format.
 ///
 /// @param[in] dst encoded payload
 /// @param[in] src original payload
-static void
+void
 encode_payload(struct payload* dst, const struct payload* src)
 {
   // Copy the whole payload. This ensures that all single-byte fields are
@@ -40,13 +46,37 @@ encode_payload(struct payload* dst, const struct payload* src)
   dst->pl_rtm1  = htonll(src->pl_rtm1);
   dst->pl_mtm2  = htonll(src->pl_mtm2);
   dst->pl_rtm2  = htonll(src->pl_rtm2);
+  dst->pl_hid   = htonll(src->pl_hid);
+}
+
+/// Encode the payload to the on-wire compact format.
+///
+/// @param[in] dst encoded payload
+/// @param[in] src original payload
+void
+encode_compact(struct payload_compact* dst, const struct payload* src)
+{
+  (void)memset(dst, 0, sizeof(*dst));
+  dst->pc_mgic = htons(src->pl_mgic);
+  dst->pc_len  = htons(src->pl_len);
+  dst->pc_fver = src->pl_fver;
+  dst->pc_type = src->pl_type;
+  dst->pc_ttl1 = src->pl_ttl1;
+  dst->pc_ttl2 = src->pl_ttl2;
+  dst->pc_hid  = htonll(src->pl_hid);
+  dst->pc_snum = htonll(src->pl_snum);
+  dst->pc_key  = htonll(src->pl_key);
+  dst->pc_mtm1 = htonll(src->pl_mtm1);
+  dst->pc_rtm1 = htonll(src->pl_rtm1);
+  dst->pc_mtm2 = htonll(src->pl_mtm2);
+  dst->pc_rtm2 = htonll(src->pl_rtm2);
 }
 
 /// Decode the on-wire format of the payload.
 ///
 /// @param[in] dst decoded payload
 /// @param[in] src original payload
-static void
+void
 decode_payload(struct payload* dst, const struct payload* src)
 {
   // Copy the whole payload. This ensures that all single-byte fields are
@@ -63,6 +93,31 @@ decode_payload(struct payload* dst, const struct payload* src)
   dst->pl_rtm1  = ntohll(src->pl_rtm1);
   dst->pl_mtm2  = ntohll(src->pl_mtm2);
   dst->pl_rtm2  = ntohll(src->pl_rtm2);
+  dst->pl_hid   = ntohll(src->pl_hid);
+}
+
+/// Decode the on-wire compact format of the payload. The host name is left
+/// empty and the sequence length is zero, as neither is transmitted.
+///
+/// @param[in] dst decoded payload
+/// @param[in] src original payload
+void
+decode_compact(struct payload* dst, const struct payload_compact* src)
+{
+  (void)memset(dst, 0, sizeof(*dst));
+  dst->pl_mgic = ntohs(src->pc_mgic);
+  dst->pl_len  = ntohs(src->pc_len);
+  dst->pl_fver = src->pc_fver;
+  dst->pl_type = src->pc_type;
+  dst->pl_ttl1 = src->pc_ttl1;
+  dst->pl_ttl2 = src->pc_ttl2;
+  dst->pl_hid  = ntohll(src->pc_hid);
+  dst->pl_snum = ntohll(src->pc_snum);
+  dst->pl_key  = ntohll(src->pc_key);
+  dst->pl_mtm1 = ntohll(src->pc_mtm1);
+  dst->pl_rtm1 = ntohll(src->pc_rtm1);
+  dst->pl_mtm2 = ntohll(src->pc_mtm2);
+  dst->pl_rtm2 = ntohll(src->pc_rtm2);
 }
 
 /// Verify the incoming payload for correctness.
@@ -70,7 +125,7 @@ decode_payload(struct payload* dst, const struct payload* src)
 ///
 /// @param[in] ch channel
 /// @param[in] pl payload
-static bool
+bool
 verify_payload(struct channel* ch, const struct payload* pl)
 {
   log(LL_TRACE, false, "verifying payload");
@@ -83,10 +138,13 @@ verify_payload(struct channel* ch, const struct payload* pl)
     return false;
   }
 
-  // Verify the payload version.
-  if (pl->pl_fver != NEMO_PAYLOAD_VERSION) {
+  // Verify the payload version. Both formats are accepted, so that peers
+  // using either of them can interoperate.
+  if (pl->pl_fver != NEMO_PAYLOAD_VERSION_FULL
+   && pl->pl_fver != NEMO_PAYLOAD_VERSION_COMPACT) {
     log(LL_DEBUG, false, "unsupported payload version, expected: %"
-        PRIu8 ", actual: %" PRIu8, NEMO_PAYLOAD_VERSION, pl->pl_fver);
+        PRIu8 " or %" PRIu8 ", actual: %" PRIu8, NEMO_PAYLOAD_VERSION_FULL,
+        NEMO_PAYLOAD_VERSION_COMPACT, pl->pl_fver);
     ch->ch_repv++;
     return false;
   }
@@ -98,7 +156,7 @@ verify_payload(struct channel* ch, const struct payload* pl)
 ///
 /// @param[out] ttl Time-To-Live value
 /// @param[in]  msg received message
-static void
+void
 retrieve_ttl(uint8_t* ttl, struct msghdr* msg)
 {
   struct cmsghdr* cmsg;
@@ -136,45 +194,88 @@ retrieve_ttl(uint8_t* ttl, struct msghdr* msg)
   *ttl = 0;
 }
 
-/// Send a payload to a network address.
+/// Associate the payload with the host name of its sender. Full-size payloads
+/// teach the channel the name belonging to the identifier, which is derived
+/// from the name unless the channel already knows the name under the stated
+/// identifier, as peers that predate the identifier echo it back unchanged.
+/// Compact payloads obtain the name from the channel.
+///
+/// @param[in] ch channel
+/// @param[in] pl payload in host byte order
+static void
+resolve_host(struct channel* ch, struct payload* pl)
+{
+  if (pl->pl_fver == NEMO_PAYLOAD_VERSION_FULL) {
+    if (known_host(&ch->ch_hc, pl->pl_hid, pl->pl_host) == false) {
+      pl->pl_hid = host_id(pl->pl_host);
+      learn_host(&ch->ch_hc, pl->pl_hid, pl->pl_host);
+    }
+  } else {
+    lookup_host(pl->pl_host, &ch->ch_hc, pl->pl_hid);
+  }
+}
+
+/// Send a payload to a network address, unless the send buffer of the socket
+/// is full. In such case the datagram is not sent and the full flag is set,
+/// so that the caller can retry once the socket becomes writable. Without the
+/// full flag, a full send buffer is an error as any other.
 /// @return success/failure indication
 ///
-/// @global wrapper
+/// @global padding
 ///
-/// @param[in] ch   channel
-/// @param[in] pl   payload in host byte order
-/// @param[in] addr IPv4/IPv6 address
-/// @param[in] err  fail on error
+/// @param[in]  ch   channel
+/// @param[in]  pl   payload in host byte order
+/// @param[in]  ad   IPv4/IPv6 address
+/// @param[out] full send buffer is full (can be NULL)
+/// @param[in]  er   fail on error
 bool
-send_packet(struct channel* ch,
-            const struct payload* pl,
-            struct sockaddr_storage ad,
-            const bool er)
+offer_packet(struct channel* ch,
+             const struct payload* pl,
+             const struct sockaddr_storage* ad,
+             bool* full,
+             const bool er)
 {
   struct payload npl;
+  struct payload_compact ncpl;
   struct msghdr msg;
-  struct iovec iov;
+  struct iovec iov[2];
   ssize_t len;
   uint8_t lvl;
 
   log(LL_TRACE, false, "sending a packet");
 
+  if (full != NULL) {
+    *full = false;
+  }
+
+  // Datagrams of a simulated channel never reach the network.
+  if (ch->ch_sim != NULL) {
+    return send_sim(ch, pl, ad);
+  }
+
   // Prepare payload data for transport. First step is to encode the payload
-  // to ensure correct handling of endianness of the multi-byte integers.
-  // Second step consists of placing the encoded payload at start of the
-  // wrapper buffer to allow for artificially extending the payload.
-  encode_payload(&npl, pl);
-  (void)memcpy(wrapper, &npl, sizeof(npl));
-  (void)memset(&iov, 0, sizeof(iov));
-  iov.iov_base = wrapper;
-  iov.iov_len  = pl->pl_len;
+  // in the format selected by its version to ensure correct handling of
+  // endianness of the multi-byte integers. Second step consists of appending
+  // the shared padding to allow for artificially extending the payload.
+  (void)memset(iov, 0, sizeof(iov));
+  if (pl->pl_fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    encode_compact(&ncpl, pl);
+    iov[0].iov_base = &ncpl;
+    iov[0].iov_len  = sizeof(ncpl);
+  } else {
+    encode_payload(&npl, pl);
+    iov[0].iov_base = &npl;
+    iov[0].iov_len  = sizeof(npl);
+  }
+  iov[1].iov_base = (void*)padding;
+  iov[1].iov_len  = (size_t)pl->pl_len - iov[0].iov_len;
 
   // Prepare the message.
   (void)memset(&msg, 0, sizeof(msg));
-  msg.msg_name       = &ad;
-  msg.msg_namelen    = sizeof(ad);
-  msg.msg_iov        = &iov;
-  msg.msg_iovlen     = 1;
+  msg.msg_name       = (void*)ad;
+  msg.msg_namelen    = sizeof(*ad);
+  msg.msg_iov        = iov;
+  msg.msg_iovlen     = 2;
   msg.msg_control    = NULL;
   msg.msg_controllen = 0;
   msg.msg_flags      = 0;
@@ -187,9 +288,19 @@ send_packet(struct channel* ch,
   }
 
   // Send the UDP datagram in a non-blocking mode.
-  ch->ch_sall++;
   len = sendmsg(ch->ch_sock, &msg, MSG_DONTWAIT);
 
+  // Leave the datagram to the caller if the send buffer is full.
+  if (len == -1 && full != NULL
+   && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+    log(LL_TRACE, false, "send buffer is full");
+    ch->ch_sdef++;
+    *full = true;
+    return true;
+  }
+
+  ch->ch_sall++;
+
   // Verify if sending has completed successfully.
   if (len == -1 || len != (ssize_t)pl->pl_len) {
     log(lvl, true, "unable to send a payload");
@@ -200,39 +311,209 @@ send_packet(struct channel* ch,
   return true;
 }
 
-/// Receive datagrams on both IPv4 and IPv6.
+/// Send a payload to a network address.
 /// @return success/failure indication
 ///
-/// @global wrapper
+/// @param[in] ch   channel
+/// @param[in] pl   payload in host byte order
+/// @param[in] addr IPv4/IPv6 address
+/// @param[in] err  fail on error
+bool
+send_packet(struct channel* ch,
+            const struct payload* pl,
+            struct sockaddr_storage ad,
+            const bool er)
+{
+  return offer_packet(ch, pl, &ad, NULL, er);
+}
+
+/// Encode a payload into a datagram, in the same way as it is sent by the
+/// send_packet function. The buffer must hold the whole datagram.
+///
+/// @global padding
+///
+/// @param[out] buf datagram contents
+/// @param[in]  pl  payload in host byte order
+void
+pack_payload(uint8_t* buf, const struct payload* pl)
+{
+  struct payload npl;
+  struct payload_compact ncpl;
+  size_t len;
+
+  if (pl->pl_fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    encode_compact(&ncpl, pl);
+    (void)memcpy(buf, &ncpl, sizeof(ncpl));
+    len = sizeof(ncpl);
+  } else {
+    encode_payload(&npl, pl);
+    (void)memcpy(buf, &npl, sizeof(npl));
+    len = sizeof(npl);
+  }
+
+  (void)memcpy(buf + len, padding, (size_t)pl->pl_len - len);
+}
+
+/// Decode a received datagram into a payload, verify its correctness and
+/// associate it with the host name of its sender. The buffer must contain at
+/// least the full-size payload, or the whole datagram if it is shorter.
+/// @return success/failure indication
+///
+/// @param[in]  ch  channel
+/// @param[out] pl  payload in host byte order
+/// @param[in]  buf datagram contents
+/// @param[in]  len datagram length
+/// @param[in]  lvl logging level of failures
+bool
+unpack_payload(struct channel* ch,
+               struct payload* pl,
+               const uint8_t* buf,
+               const size_t len,
+               const uint8_t lvl)
+{
+  struct payload npl;
+  struct payload_compact ncpl;
+  bool retb;
+
+  // Ensure that at least the base payload has arrived.
+  if (len < sizeof(ncpl)) {
+    log(lvl, false, "insufficient payload length");
+    ch->ch_resz++;
+    return false;
+  }
+
+  // Unpack the payload from the buffer and convert the payload from its
+  // on-wire format. Both formats share the leading fields, including the
+  // format version.
+  (void)memcpy(&ncpl, buf, sizeof(ncpl));
+  if (ncpl.pc_fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    decode_compact(pl, &ncpl);
+  } else {
+    if (len < sizeof(npl)) {
+      log(lvl, false, "insufficient payload length");
+      ch->ch_resz++;
+      return false;
+    }
+
+    (void)memcpy(&npl, buf, sizeof(npl));
+    decode_payload(pl, &npl);
+  }
+
+  // Now that the base part of the payload is decoded, we can examine whether
+  // the actual length of the datagram matches the expected length.
+  if (len != (size_t)pl->pl_len) {
+    log(lvl, false, "wrong payload size, expected %zu, actual %" PRIu16, len, pl->pl_len);
+    return false;
+  }
+
+  // Verify the payload correctness.
+  retb = verify_payload(ch, pl);
+  if (retb == false) {
+    log(LL_WARN, false, "invalid payload");
+    return false;
+  }
+
+  resolve_host(ch, pl);
+
+  return true;
+}
+
+/// Account for the time from the arrival of the datagram, as timestamped by
+/// the kernel, to its receipt by the process. The clock is read only when the
+/// kernel attached the timestamp.
+///
+/// @param[in] ch  channel
+/// @param[in] msg message headers
+static void
+retrieve_wake(struct channel* ch, struct msghdr* msg)
+{
+#if defined(SCM_TIMESTAMPNS)
+  struct cmsghdr* cmsg;
+  struct timespec ts;
+  uint64_t arr;
+  uint64_t rcv;
+
+  for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      rcv = real_now();
+      (void)memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+      arr = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+      // Both clocks are the same, but guard against the clock being stepped.
+      if (rcv >= arr) {
+        update_hist(&ch->ch_wake, rcv - arr);
+      }
+      return;
+    }
+  }
+#else
+  (void)ch;
+  (void)msg;
+#endif
+}
+
+/// Obtain the number of datagrams that the kernel dropped so far due to a
+/// full receive queue. The count is only attached to the datagrams received
+/// after the first drop.
+///
+/// @param[in] ch  channel
+/// @param[in] msg message headers
+static void
+retrieve_drops(struct channel* ch, struct msghdr* msg)
+{
+#if defined(SO_RXQ_OVFL)
+  struct cmsghdr* cmsg;
+  uint32_t val;
+
+  for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+      (void)memcpy(&val, CMSG_DATA(cmsg), sizeof(val));
+
+      // The kernel reports the running total of the socket.
+      __atomic_store_n(&ch->ch_rdrop, (uint64_t)val, __ATOMIC_RELAXED);
+      return;
+    }
+  }
+#else
+  (void)ch;
+  (void)msg;
+#endif
+}
+
+/// Receive a datagram on both IPv4 and IPv6, optionally treating an empty
+/// socket as a regular outcome.
+/// @return success/failure indication
 ///
 /// @param[in]  ch   channel
 /// @param[in]  addr IPv4/IPv6 address of the sender
 /// @param[out] pl   payload in host byte order
 /// @param[out] ttl  time to live
-/// @param[in]  msg  message headers
+/// @param[out] got  datagram was received (or NULL)
 /// @param[in]  err  exit on error
-bool
-receive_packet(struct channel* ch,
-               struct sockaddr_storage* addr,
-               struct payload* pl,
-               uint8_t* ttl,
-               const bool err)
+static bool
+receive_message(struct channel* ch,
+                struct sockaddr_storage* addr,
+                struct payload* pl,
+                uint8_t* ttl,
+                bool* got,
+                const bool err)
 {
-  struct payload npl;
   ssize_t len;
-  bool retb;
   uint8_t lvl;
   uint8_t cmsg[256];
   struct msghdr msg;
   struct iovec iov;
   bool ctl;
 
-  log(LL_TRACE, false, "receiving a packet");
+  // Datagrams of a simulated channel never reach the network.
+  if (ch->ch_sim != NULL) {
+    return receive_sim(ch, addr, pl, ttl, got, err);
+  }
 
   // Prepare payload data.
   (void)memset(&iov, 0, sizeof(iov));
-  iov.iov_base = wrapper;
-  iov.iov_len  = sizeof(wrapper);
+  iov.iov_base = ch->ch_buf;
+  iov.iov_len  = sizeof(ch->ch_buf);
 
   // Prepare the message.
   (void)memset(&msg, 0, sizeof(msg));
@@ -252,23 +533,27 @@ receive_packet(struct channel* ch,
   }
 
   // Receive the message and handle potential errors.
-  ch->ch_rall++;
   len = recvmsg(ch->ch_sock, &msg, MSG_DONTWAIT | MSG_TRUNC);
 
+  // An empty socket is expected when polling.
+  if (got != NULL) {
+    *got = !(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    if (*got == false) {
+      return true;
+    }
+  }
+
+  // The empty polls are not traced, as these are too frequent.
+  log(LL_TRACE, false, "receiving a packet");
+
   // Check for errors during the receipt.
+  ch->ch_rall++;
   if (len < 0) {
     log(lvl, true, "receiving has failed");
     ch->ch_reni++;
     return false;
   }
 
-  // Ensure that at least the base payload has arrived.
-  if (len < (ssize_t)sizeof(npl)) {
-    log(lvl, false, "insufficient payload length");
-    ch->ch_resz++;
-    return false;
-  }
-
   // Check for received packet payload size.
   if (msg.msg_flags & MSG_TRUNC) {
     log(lvl, false, "payload was truncated");
@@ -285,32 +570,59 @@ receive_packet(struct channel* ch,
     ctl = false;
   }
 
-  // Unpack the payload from the wrapper and convert the payload from its
-  // on-wire format.
-  (void)memcpy(&npl, wrapper, sizeof(npl));
-  decode_payload(pl, &npl);
-
-  // Now that the base part of the payload is decoded, we can examine whether
-  // the actual length of the datagram matches the expected length.
-  if (len != (ssize_t)pl->pl_len) {
-    log(lvl, false, "wrong payload size, expected %zd, actual %" PRIu64, len, pl->pl_len);
-    return false;
-  }
-
-  // Obtain the TTL/hops value, if the control data was successfully received.
-  // If not, an invalid TTL/hops value of 0 is used.
+  // Obtain the TTL/hops value and the arrival time, if the control data was
+  // successfully received. If not, an invalid TTL/hops value of 0 is used.
   if (ctl == true) {
+    retrieve_wake(ch, &msg);
     retrieve_ttl(ttl, &msg);
+    retrieve_drops(ch, &msg);
   } else {
     *ttl = 0;
   }
 
-  // Verify the payload correctness.
-  retb = verify_payload(ch, pl);
-  if (retb == false) {
-    log(LL_WARN, false, "invalid payload");
-    return false;
+  // Sample the receive queue while it is likely to be occupied.
+  if (ch->ch_rall % CHANNEL_QUEUE_SAMPLE == 1) {
+    sample_channel(ch);
   }
 
-  return true;
+  return unpack_payload(ch, pl, ch->ch_buf, (size_t)len, lvl);
+}
+
+/// Receive datagrams on both IPv4 and IPv6.
+/// @return success/failure indication
+///
+/// @param[in]  ch   channel
+/// @param[in]  addr IPv4/IPv6 address of the sender
+/// @param[out] pl   payload in host byte order
+/// @param[out] ttl  time to live
+/// @param[in]  err  exit on error
+bool
+receive_packet(struct channel* ch,
+               struct sockaddr_storage* addr,
+               struct payload* pl,
+               uint8_t* ttl,
+               const bool err)
+{
+  return receive_message(ch, addr, pl, ttl, NULL, err);
+}
+
+/// Receive a datagram if one is available, without waiting for it. This is
+/// the building block of the busy-polling loops.
+/// @return success/failure indication
+///
+/// @param[in]  ch   channel
+/// @param[in]  addr IPv4/IPv6 address of the sender
+/// @param[out] pl   payload in host byte order
+/// @param[out] ttl  time to live
+/// @param[out] got  datagram was received
+/// @param[in]  err  exit on error
+bool
+poll_packet(struct channel* ch,
+            struct sockaddr_storage* addr,
+            struct payload* pl,
+            uint8_t* ttl,
+            bool* got,
+            const bool err)
+{
+  return receive_message(ch, addr, pl, ttl, got, err);
 }
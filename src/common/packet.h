@@ -16,14 +16,48 @@
 #include "common/channel.h"
 
 
+// Longest time spent spinning on non-blocking receives before the other
+// events are checked.
+#define POLL_PERIOD 1000000ULL
+
+// Time in microseconds that the kernel busy-polls the device queue for a
+// blocking receive on a busy-polled socket.
+#define POLL_BUSY_TIME 50
+
+// Codec.
+void encode_payload(struct payload* dst, const struct payload* src);
+void decode_payload(struct payload* dst, const struct payload* src);
+void encode_compact(struct payload_compact* dst, const struct payload* src);
+void decode_compact(struct payload* dst, const struct payload_compact* src);
+bool verify_payload(struct channel* ch, const struct payload* pl);
+void retrieve_ttl(uint8_t* ttl, struct msghdr* msg);
+void pack_payload(uint8_t* buf, const struct payload* pl);
+bool unpack_payload(struct channel* ch,
+                    struct payload* pl,
+                    const uint8_t* buf,
+                    const size_t len,
+                    const uint8_t lvl);
+
+// Transmission.
 bool send_packet(struct channel* ch,
                  const struct payload* pl,
                  const struct sockaddr_storage addr,
                  const bool err);
+bool offer_packet(struct channel* ch,
+                  const struct payload* pl,
+                  const struct sockaddr_storage* addr,
+                  bool* full,
+                  const bool err);
 bool receive_packet(struct channel* ch,
                     struct sockaddr_storage* addr,
                     struct payload* pl,
                     uint8_t* ttl,
                     const bool err);
+bool poll_packet(struct channel* ch,
+                 struct sockaddr_storage* addr,
+                 struct payload* pl,
+                 uint8_t* ttl,
+                 bool* got,
+                 const bool err);
 
 #endif
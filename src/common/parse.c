@@ -258,3 +258,50 @@ parse_scalar(uint64_t* out,
   *out = x;
   return true;
 }
+
+/// Parse a socket buffer size, which is either a fixed memory size, or the
+/// word "auto" optionally followed by a colon and the ceiling of the adaptive
+/// sizing. The adaptive sizing starts from the previously selected size.
+/// @return success/failure indication
+///
+/// @param[out] out  initial buffer size
+/// @param[out] cap  ceiling of the adaptive sizing (0 for a fixed size)
+/// @param[in]  inp  input string
+/// @param[in]  min  lower inclusive bound
+/// @param[in]  dcap default ceiling of the adaptive sizing
+bool
+parse_buffer(uint64_t* out,
+             uint64_t* cap,
+             const char* inp,
+             const uint64_t min,
+             const uint64_t dcap)
+{
+  int reti;
+  bool retb;
+
+  // Fixed size.
+  reti = strncmp(inp, "auto", 4);
+  if (reti != 0) {
+    *cap = 0;
+    return parse_scalar(out, inp, "b", min, INT_MAX, parse_memory_unit);
+  }
+
+  // Adaptive sizing with an optional ceiling.
+  if (inp[4] == '\0') {
+    *cap = dcap;
+  } else if (inp[4] == ':') {
+    retb = parse_scalar(cap, inp + 5, "b", min, INT_MAX, parse_memory_unit);
+    if (retb == false) {
+      return false;
+    }
+  } else {
+    log(LL_ERROR, false, "unknown buffer size '%s'", inp);
+    return false;
+  }
+
+  if (*out > *cap) {
+    *out = *cap;
+  }
+
+  return true;
+}
@@ -23,6 +23,12 @@ bool parse_scalar(uint64_t* out,
                   const uint64_t max,
                   bool (*func) (uint64_t*, const char*));
 
+bool parse_buffer(uint64_t* out,
+                  uint64_t* cap,
+                  const char* inp,
+                  const uint64_t min,
+                  const uint64_t dcap);
+
 bool parse_memory_unit(uint64_t* mult, const char* unit);
 bool parse_time_unit(uint64_t* mult, const char* unit);
 
@@ -16,13 +16,20 @@
 
 // Constants.
 #define NEMO_PAYLOAD_MAGIC   0x444c
-#define NEMO_PAYLOAD_VERSION      9
+#define NEMO_PAYLOAD_VERSION_FULL    9
+#define NEMO_PAYLOAD_VERSION_COMPACT 10
 
 // Memory size.
-#define NEMO_PAYLOAD_SIZE  128
-#define NEMO_HOST_NAME_SIZE 48
+#define NEMO_PAYLOAD_SIZE         128
+#define NEMO_PAYLOAD_COMPACT_SIZE  64
+#define NEMO_HOST_NAME_SIZE        48
 
-// Payload.
+// Number of rounds between two full-size payloads of a compact requester,
+// which advertise the host name belonging to the host identifier.
+#define NEMO_PAYLOAD_HELLO 64
+
+// Payload. This is both the on-wire layout of the full format and the host
+// representation of both formats.
 struct payload {
   uint16_t pl_mgic;     ///< Magic identifier.
   uint16_t pl_len;      ///< Artificial payload length in bytes.
@@ -40,7 +47,28 @@ struct payload {
   uint64_t pl_mtm2;     ///< Steady time of response.
   uint64_t pl_rtm2;     ///< System time of response.
   char     pl_host[NEMO_HOST_NAME_SIZE]; ///< Host name.
-  uint8_t  pl_pad3[12]; ///< Padding(unused).
+  uint64_t pl_hid;      ///< Host identifier.
+  uint8_t  pl_pad3[8];  ///< Padding(unused).
+};
+
+// Compact payload. The host name is replaced by its identifier and the
+// sequence length is omitted, as it is known to the requester.
+struct payload_compact {
+  uint16_t pc_mgic;     ///< Magic identifier.
+  uint16_t pc_len;      ///< Artificial payload length in bytes.
+  uint8_t  pc_fver : 5; ///< Format version.
+  uint8_t  pc_type : 1; ///< Message type.
+  uint8_t  pc_pad  : 2; ///< Padding (unused).
+  uint8_t  pc_pad2;     ///< Padding (unused).
+  uint8_t  pc_ttl1;     ///< Time-To-Live when sent.
+  uint8_t  pc_ttl2;     ///< Time-To-Live when received.
+  uint64_t pc_hid;      ///< Host identifier.
+  uint64_t pc_snum;     ///< Sequence iteration number.
+  uint64_t pc_key;      ///< Responder/requester key.
+  uint64_t pc_mtm1;     ///< Steady time of request.
+  uint64_t pc_rtm1;     ///< System time of request.
+  uint64_t pc_mtm2;     ///< Steady time of response.
+  uint64_t pc_rtm2;     ///< System time of response.
 };
 
 #endif
@@ -5,6 +5,7 @@
 // license is in the file LICENSE, distributed as part of this software.
 
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <sys/wait.h>
 
 #include <unistd.h>
@@ -104,6 +105,8 @@ load_plugins(struct plugin* pi, uint64_t* npi, const char* so[])
     }
 
     pi[i].pi_state = PLUGIN_STATE_PREPARED;
+    pi[i].pi_nnot  = 0;
+    pi[i].pi_nerr  = 0;
   }
 
   return true;
@@ -276,7 +279,7 @@ start_plugins(struct plugin* pi, const uint64_t npi)
 /// @param[in] npi number of plugins
 /// @param[in] pl  payload
 void
-notify_plugins(const struct plugin* pi,
+notify_plugins(struct plugin* pi,
                const uint64_t npi,
                const struct payload* pl)
 {
@@ -291,15 +294,19 @@ notify_plugins(const struct plugin* pi,
 
     // Communicate the event.
     retss = write(pi[i].pi_pipe[0], pl, sizeof(*pl));
+    pi[i].pi_nnot++;
 
     // Check for error.
     if (retss == -1) {
       log(LL_WARN, true, "unable to send payload to plugin %s", pi[i].pi_name);
+      pi[i].pi_nerr++;
+      continue;
     }
 
     // Check whether all expected data was written to the pipe.
     if (retss != (ssize_t)sizeof(*pl)) {
       log(LL_WARN, false, "unable to send full payload to plugin %s", pi[i].pi_name);
+      pi[i].pi_nerr++;
     }
   }
 }
@@ -387,6 +394,29 @@ wait_plugins(struct plugin* pi, const uint64_t npi)
   }
 }
 
+/// Obtain the number of events waiting in the notification pipe of a plugin.
+/// @return number of events
+///
+/// @param[in] pi plugin
+uint64_t
+queued_events(const struct plugin* pi)
+{
+  int len;
+  int reti;
+
+  if (pi->pi_state != PLUGIN_STATE_RUNNING && pi->pi_state != PLUGIN_STATE_PAUSED) {
+    return 0;
+  }
+
+  // Both ends of the pipe report the amount of unread data.
+  reti = ioctl(pi->pi_pipe[1], FIONREAD, &len);
+  if (reti == -1 || len < 0) {
+    return 0;
+  }
+
+  return (uint64_t)len / sizeof(struct payload);
+}
+
 void
 log_plugins(const struct plugin* pi, const uint64_t npi)
 {
@@ -33,6 +33,8 @@ struct plugin {
   bool      (*pi_free)(void);               ///< Clean-up procedure.
   pid_t       pi_pid;                       ///< Process ID of the sandbox.
   int         pi_pipe[2];                   ///< Payload notification channel.
+  uint64_t    pi_nnot;                      ///< Number of notifications.
+  uint64_t    pi_nerr;                      ///< Number of failed notifications.
   uint8_t     pi_state;                     ///< Operational state.
 };
 
@@ -40,9 +42,10 @@ bool load_plugins(struct plugin* pi, uint64_t* npi, const char* so[]);
 bool start_plugins(struct plugin* pi, const uint64_t npi);
 void wait_plugins(struct plugin* pi, const uint64_t npi);
 void terminate_plugins(struct plugin* pi, const uint64_t npi);
-void notify_plugins(const struct plugin* pi,
+void notify_plugins(struct plugin* pi,
                     const uint64_t npi,
                     const struct payload* pl);
+uint64_t queued_events(const struct plugin* pi);
 void log_plugins(const struct plugin* pi, const uint64_t npi);
 
 #endif
@@ -0,0 +1,670 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "common/channel.h"
+#include "common/convert.h"
+#include "common/hist.h"
+#include "common/log.h"
+#include "common/now.h"
+#include "common/prom.h"
+
+
+/// Counter or gauge of a channel.
+struct counter {
+  const char* co_name; ///< Name of the metric.
+  const char* co_type; ///< Type of the metric (counter or gauge).
+  const char* co_help; ///< Description of the metric.
+  const char* co_rsn;  ///< Reason label (can be NULL).
+  size_t      co_off;  ///< Offset of the value within the channel.
+};
+
+// Metrics of a channel. Entries of the same metric must be consecutive.
+static const struct counter counters[] = {
+  { "nemo_channel_received_total", "counter", "Received datagrams.", NULL,
+    offsetof(struct channel, ch_rall) },
+  { "nemo_channel_receive_errors_total", "counter", "Rejected received datagrams.", "network",
+    offsetof(struct channel, ch_reni) },
+  { "nemo_channel_receive_errors_total", "counter", NULL, "size",
+    offsetof(struct channel, ch_resz) },
+  { "nemo_channel_receive_errors_total", "counter", NULL, "magic",
+    offsetof(struct channel, ch_remg) },
+  { "nemo_channel_receive_errors_total", "counter", NULL, "version",
+    offsetof(struct channel, ch_repv) },
+  { "nemo_channel_receive_errors_total", "counter", NULL, "type",
+    offsetof(struct channel, ch_rety) },
+  { "nemo_channel_sent_total", "counter", "Sent datagrams.", NULL,
+    offsetof(struct channel, ch_sall) },
+  { "nemo_channel_send_errors_total", "counter", "Failed datagram transmissions.", "network",
+    offsetof(struct channel, ch_seni) },
+  { "nemo_channel_send_deferred_total", "counter",
+    "Datagrams deferred due to a full send buffer.", NULL,
+    offsetof(struct channel, ch_sdef) },
+  { "nemo_channel_dropped_total", "counter",
+    "Datagrams dropped by the kernel due to a full receive queue.", NULL,
+    offsetof(struct channel, ch_rdrop) },
+  { "nemo_channel_receive_queue_peak_bytes", "gauge",
+    "Peak sampled occupancy of the receive queue.", NULL,
+    offsetof(struct channel, ch_rqmx) },
+  { "nemo_channel_receive_queue_limit_bytes", "gauge",
+    "Limit of the receive queue.", NULL,
+    offsetof(struct channel, ch_rqlm) }
+};
+
+/// Switch a socket to the non-blocking mode.
+/// @return success/failure indication
+///
+/// @param[in] sock socket
+static bool
+set_nonblock(const int sock)
+{
+  int fl;
+  int reti;
+
+  fl = fcntl(sock, F_GETFL);
+  if (fl == -1) {
+    return false;
+  }
+
+  reti = fcntl(sock, F_SETFL, fl | O_NONBLOCK);
+  if (reti == -1) {
+    return false;
+  }
+
+  return true;
+}
+
+/// Register the descriptors of the endpoint for the event waiting. No new
+/// connections are accepted while a client is being served.
+/// @return highest descriptor plus one
+///
+/// @param[in]  pr  metrics endpoint
+/// @param[out] rfd read file descriptors
+/// @param[out] wfd write file descriptors
+static int
+watch_prom(const struct prom* pr, fd_set* rfd, fd_set* wfd)
+{
+  if (pr->pr_csock == -1) {
+    FD_SET(pr->pr_lsock, rfd);
+    return pr->pr_lsock + 1;
+  }
+
+  if (pr->pr_end == 0) {
+    FD_SET(pr->pr_csock, rfd);
+  } else {
+    FD_SET(pr->pr_csock, wfd);
+  }
+
+  return pr->pr_csock + 1;
+}
+
+/// Disconnect the current client.
+///
+/// @param[in] pr metrics endpoint
+static void
+drop_client(struct prom* pr)
+{
+  (void)close(pr->pr_csock);
+  pr->pr_csock = -1;
+  pr->pr_rlen  = 0;
+  pr->pr_end   = 0;
+}
+
+/// Append formatted text to the response, growing the buffer if needed.
+///
+/// @param[in] pr  metrics endpoint
+/// @param[in] fmt format string
+static void
+append_text(struct prom* pr, const char* fmt, ...)
+{
+  va_list ap;
+  char* buf;
+  int reti;
+
+  if (pr->pr_full == true) {
+    return;
+  }
+
+  while (true) {
+    va_start(ap, fmt);
+    reti = vsnprintf(pr->pr_buf + pr->pr_end, pr->pr_cap - pr->pr_end, fmt, ap);
+    va_end(ap);
+
+    if (reti < 0) {
+      pr->pr_full = true;
+      return;
+    }
+
+    if ((size_t)reti < pr->pr_cap - pr->pr_end) {
+      pr->pr_end += (size_t)reti;
+      return;
+    }
+
+    buf = realloc(pr->pr_buf, pr->pr_cap * 2);
+    if (buf == NULL) {
+      log(LL_WARN, true, "unable to grow the metrics buffer");
+      pr->pr_full = true;
+      return;
+    }
+
+    pr->pr_buf  = buf;
+    pr->pr_cap *= 2;
+  }
+}
+
+/// Send as much of the response as the socket accepts.
+///
+/// @param[in] pr metrics endpoint
+static void
+flush_response(struct prom* pr)
+{
+  ssize_t retss;
+
+  while (pr->pr_beg < pr->pr_end) {
+    retss = send(pr->pr_csock, pr->pr_buf + pr->pr_beg,
+                 pr->pr_end - pr->pr_beg, MSG_NOSIGNAL);
+    if (retss == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return;
+      }
+
+      log(LL_DEBUG, true, "unable to send metrics");
+      drop_client(pr);
+      return;
+    }
+
+    pr->pr_beg += (size_t)retss;
+  }
+
+  pr->pr_nscr++;
+  drop_client(pr);
+}
+
+/// Render the response to the received request. The metrics are rendered
+/// after the space reserved for the header, which is then prepended once the
+/// length of the metrics is known.
+///
+/// @param[in] pr metrics endpoint
+static void
+prepare_response(struct prom* pr)
+{
+  char head[PROM_HEAD_SIZE];
+  const char* stat;
+  int reti;
+
+  pr->pr_end  = PROM_HEAD_SIZE;
+  pr->pr_full = false;
+
+  if (strncmp(pr->pr_req, "GET ", 4) == 0) {
+    pr->pr_fill(pr, pr->pr_arg);
+    stat = "200 OK";
+  } else {
+    append_text(pr, "only the GET method is supported\n");
+    stat = "405 Method Not Allowed";
+  }
+
+  if (pr->pr_full == true) {
+    log(LL_WARN, false, "metrics response was truncated");
+  }
+
+  reti = snprintf(head, sizeof(head),
+                  "HTTP/1.0 %s\r\n"
+                  "Content-Type: text/plain; version=0.0.4\r\n"
+                  "Content-Length: %zu\r\n"
+                  "Connection: close\r\n\r\n",
+                  stat, pr->pr_end - PROM_HEAD_SIZE);
+
+  pr->pr_beg = PROM_HEAD_SIZE - (size_t)reti;
+  (void)memcpy(pr->pr_buf + pr->pr_beg, head, (size_t)reti);
+}
+
+/// Receive the request of the current client.
+///
+/// @param[in] pr metrics endpoint
+static void
+receive_request(struct prom* pr)
+{
+  ssize_t retss;
+
+  retss = recv(pr->pr_csock, pr->pr_req + pr->pr_rlen,
+               sizeof(pr->pr_req) - 1 - pr->pr_rlen, 0);
+  if (retss == -1) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      log(LL_DEBUG, true, "unable to receive metrics request");
+      drop_client(pr);
+    }
+
+    return;
+  }
+
+  if (retss == 0) {
+    drop_client(pr);
+    return;
+  }
+
+  pr->pr_rlen += (size_t)retss;
+  pr->pr_req[pr->pr_rlen] = '\0';
+
+  // Respond once the request header is complete. Overly long requests are
+  // answered based on their beginning.
+  if (strstr(pr->pr_req, "\r\n\r\n") != NULL
+   || pr->pr_rlen == sizeof(pr->pr_req) - 1) {
+    prepare_response(pr);
+    flush_response(pr);
+  }
+}
+
+/// Handle the events of the endpoint. Failures of the endpoint are never
+/// fatal to the program, the affected client is disconnected instead.
+///
+/// @param[in] pr  metrics endpoint
+/// @param[in] rfd read file descriptors
+/// @param[in] wfd write file descriptors
+static void
+handle_prom(struct prom* pr, const fd_set* rfd, const fd_set* wfd)
+{
+  bool retb;
+
+  // Disconnect clients that do not finish in time.
+  if (pr->pr_csock != -1 && mono_now() > pr->pr_dl) {
+    log(LL_DEBUG, false, "metrics client timed out");
+    drop_client(pr);
+    return;
+  }
+
+  if (pr->pr_csock == -1) {
+    if (FD_ISSET(pr->pr_lsock, rfd) == 0) {
+      return;
+    }
+
+    pr->pr_csock = accept(pr->pr_lsock, NULL, NULL);
+    if (pr->pr_csock == -1) {
+      return;
+    }
+
+    retb = set_nonblock(pr->pr_csock);
+    if (retb == false) {
+      log(LL_DEBUG, true, "unable to make the metrics client non-blocking");
+      drop_client(pr);
+      return;
+    }
+
+    pr->pr_dl = mono_now() + PROM_TIMEOUT;
+    return;
+  }
+
+  if (pr->pr_end == 0 && FD_ISSET(pr->pr_csock, rfd) != 0) {
+    receive_request(pr);
+    return;
+  }
+
+  if (pr->pr_end != 0 && FD_ISSET(pr->pr_csock, wfd) != 0) {
+    flush_response(pr);
+  }
+}
+
+/// Serve the endpoint until it is closed. The rendering reads the values
+/// while the packet handling keeps updating them, so that neither waits on
+/// the other.
+/// @return NULL
+///
+/// @param[in] arg metrics endpoint
+static void*
+prom_main(void* arg)
+{
+  struct prom* pr;
+  struct timespec tick;
+  fd_set rfd;
+  fd_set wfd;
+  int nfds;
+  int reti;
+
+  pr = arg;
+  fnanos(&tick, PROM_TICK);
+  while (__atomic_load_n(&pr->pr_stop, __ATOMIC_ACQUIRE) == false) {
+    FD_ZERO(&rfd);
+    FD_ZERO(&wfd);
+    nfds = watch_prom(pr, &rfd, &wfd);
+
+    reti = pselect(nfds, &rfd, &wfd, NULL, &tick, NULL);
+    if (reti == -1) {
+      if (errno != EINTR) {
+        log(LL_WARN, true, "waiting for metrics clients failed");
+        break;
+      }
+
+      continue;
+    }
+
+    handle_prom(pr, &rfd, &wfd);
+  }
+
+  return NULL;
+}
+
+/// Start the thread that serves the endpoint.
+/// @return success/failure indication
+///
+/// @param[in] pr metrics endpoint
+static bool
+start_prom(struct prom* pr)
+{
+  sigset_t all;
+  sigset_t old;
+  int reti;
+
+  // The serving thread must never handle signals meant for the main thread.
+  (void)sigfillset(&all);
+  (void)pthread_sigmask(SIG_SETMASK, &all, &old);
+  reti = pthread_create(&pr->pr_thr, NULL, prom_main, pr);
+  (void)pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to start the metrics thread: %s", strerror(reti));
+    return false;
+  }
+
+  pr->pr_run = true;
+  return true;
+}
+
+/// Create the listening Unix domain socket of the metrics endpoint and start
+/// serving it. A stale socket left behind by a previous process is replaced.
+/// @return success/failure indication
+///
+/// @param[out] pr   metrics endpoint
+/// @param[in]  path path of the socket
+/// @param[in]  fill rendering of all metrics
+/// @param[in]  arg  argument of the rendering
+bool
+open_prom(struct prom* pr,
+          const char* path,
+          void (*fill)(struct prom* pr, void* arg),
+          void* arg)
+{
+  struct sockaddr_un sun;
+  struct stat sb;
+  int reti;
+  bool retb;
+
+  (void)memset(pr, 0, sizeof(*pr));
+  pr->pr_lsock = -1;
+  pr->pr_csock = -1;
+  pr->pr_fill  = fill;
+  pr->pr_arg   = arg;
+
+  if (strlen(path) >= sizeof(sun.sun_path) || strlen(path) >= sizeof(pr->pr_path)) {
+    log(LL_WARN, false, "metrics socket path is too long: %s", path);
+    return false;
+  }
+  (void)strncpy(pr->pr_path, path, sizeof(pr->pr_path) - 1);
+
+  // Remove a stale socket, but never any other kind of file.
+  reti = lstat(path, &sb);
+  if (reti == 0 && S_ISSOCK(sb.st_mode)) {
+    (void)unlink(path);
+  }
+
+  pr->pr_lsock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (pr->pr_lsock == -1) {
+    log(LL_WARN, true, "unable to create the metrics socket");
+    return false;
+  }
+
+  retb = set_nonblock(pr->pr_lsock);
+  if (retb == false) {
+    log(LL_WARN, true, "unable to make the metrics socket non-blocking");
+    return false;
+  }
+
+  (void)memset(&sun, 0, sizeof(sun));
+  sun.sun_family = AF_UNIX;
+  (void)strncpy(sun.sun_path, path, sizeof(sun.sun_path) - 1);
+
+  reti = bind(pr->pr_lsock, (struct sockaddr*)&sun, sizeof(sun));
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to bind the metrics socket to %s", path);
+    return false;
+  }
+
+  reti = listen(pr->pr_lsock, 8);
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to listen on the metrics socket");
+    return false;
+  }
+
+  pr->pr_buf = malloc(PROM_BUFFER_SIZE);
+  if (pr->pr_buf == NULL) {
+    log(LL_WARN, true, "unable to allocate the metrics buffer");
+    return false;
+  }
+  pr->pr_cap = PROM_BUFFER_SIZE;
+
+  retb = start_prom(pr);
+  if (retb == false) {
+    return false;
+  }
+
+  log(LL_DEBUG, false, "serving metrics on %s", path);
+  return true;
+}
+
+/// Close the endpoint and remove its socket.
+///
+/// @param[in] pr metrics endpoint
+void
+close_prom(struct prom* pr)
+{
+  if (pr->pr_buf == NULL) {
+    return;
+  }
+
+  if (pr->pr_run == true) {
+    __atomic_store_n(&pr->pr_stop, true, __ATOMIC_RELEASE);
+    (void)pthread_join(pr->pr_thr, NULL);
+    pr->pr_run = false;
+  }
+
+  if (pr->pr_csock != -1) {
+    drop_client(pr);
+  }
+
+  (void)close(pr->pr_lsock);
+  (void)unlink(pr->pr_path);
+  free(pr->pr_buf);
+  pr->pr_buf = NULL;
+
+  log(LL_DEBUG, false, "served %" PRIu64 " metrics scrapes", pr->pr_nscr);
+}
+
+/// Format a duration in nanoseconds as a decimal number of seconds.
+///
+/// @param[out] str output string
+/// @param[in]  len length of the output string
+/// @param[in]  ns  duration
+static void
+format_seconds(char* str, const size_t len, const uint64_t ns)
+{
+  int reti;
+
+  reti = snprintf(str, len, "%" PRIu64 ".%09" PRIu64,
+                  ns / (uint64_t)1000000000, ns % (uint64_t)1000000000);
+  if (reti <= 0 || (size_t)reti >= len) {
+    return;
+  }
+
+  // Remove the trailing zeros of the fraction.
+  while (reti > 1 && str[reti - 1] == '0') {
+    reti--;
+  }
+  if (str[reti - 1] == '.') {
+    reti--;
+  }
+  str[reti] = '\0';
+}
+
+/// Start a new metric family.
+///
+/// @param[in] pr   metrics endpoint
+/// @param[in] name name of the metric
+/// @param[in] type type of the metric (counter, gauge or histogram)
+/// @param[in] help description of the metric
+void
+describe_metric(struct prom* pr,
+                const char* name,
+                const char* type,
+                const char* help)
+{
+  append_text(pr, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/// Append a single sample of a counter or a gauge.
+///
+/// @param[in] pr   metrics endpoint
+/// @param[in] name name of the metric
+/// @param[in] lbl  comma-separated labels (can be empty)
+/// @param[in] val  value
+void
+append_metric(struct prom* pr,
+              const char* name,
+              const char* lbl,
+              const uint64_t val)
+{
+  if (lbl[0] == '\0') {
+    append_text(pr, "%s %" PRIu64 "\n", name, val);
+  } else {
+    append_text(pr, "%s{%s} %" PRIu64 "\n", name, lbl, val);
+  }
+}
+
+/// Append all samples of a histogram of durations. The durations are
+/// expressed in seconds, as is the convention of the format.
+///
+/// @param[in] pr   metrics endpoint
+/// @param[in] name name of the metric
+/// @param[in] lbl  comma-separated labels (can be empty)
+/// @param[in] hs   histogram
+void
+append_hist(struct prom* pr,
+            const char* name,
+            const char* lbl,
+            const struct hist* hs)
+{
+  struct hist snap;
+  const char* sep;
+  char bound[32];
+  uint64_t cum;
+  uint8_t i;
+
+  read_hist(&snap, hs);
+  sep = lbl[0] == '\0' ? "" : ",";
+
+  cum = 0;
+  for (i = 0; i < HIST_BINS - 1; i++) {
+    cum += snap.hs_bin[i];
+    format_seconds(bound, sizeof(bound), hist_bound[i]);
+    append_text(pr, "%s_bucket{%s%sle=\"%s\"} %" PRIu64 "\n", name, lbl, sep, bound, cum);
+  }
+  append_text(pr, "%s_bucket{%s%sle=\"+Inf\"} %" PRIu64 "\n", name, lbl, sep, snap.hs_cnt);
+
+  format_seconds(bound, sizeof(bound), snap.hs_sum);
+  if (lbl[0] == '\0') {
+    append_text(pr, "%s_sum %s\n%s_count %" PRIu64 "\n", name, bound, name, snap.hs_cnt);
+  } else {
+    append_text(pr, "%s_sum{%s} %s\n%s_count{%s} %" PRIu64 "\n",
+                name, lbl, bound, name, lbl, snap.hs_cnt);
+  }
+}
+
+/// Escape a label value, so that it can be enclosed in double quotes.
+///
+/// @param[out] out escaped value
+/// @param[in]  len size of the escaped value
+/// @param[in]  inp label value
+void
+escape_label(char* out, const size_t len, const char* inp)
+{
+  size_t i;
+
+  for (i = 0; *inp != '\0' && i + 2 < len; inp++) {
+    if (*inp == '"' || *inp == '\\') {
+      out[i++] = '\\';
+      out[i++] = *inp;
+    } else if (*inp == '\n') {
+      out[i++] = '\\';
+      out[i++] = 'n';
+    } else {
+      out[i++] = *inp;
+    }
+  }
+
+  out[i] = '\0';
+}
+
+/// Append the counters of a set of channels. The channels are expected to be
+/// embedded in an array of larger structures, hence the stride.
+///
+/// @param[in] pr     metrics endpoint
+/// @param[in] ch     first channel
+/// @param[in] stride distance between two consecutive channels in bytes
+/// @param[in] nch    number of channels
+/// @param[in] lkey   label identifying the channel by its index (can be NULL)
+void
+expose_channels(struct prom* pr,
+                const struct channel* ch,
+                const size_t stride,
+                const uint64_t nch,
+                const char* lkey)
+{
+  const struct channel* cur;
+  const struct counter* co;
+  const uint64_t* val;
+  char lbl[128];
+  uint64_t i;
+  size_t k;
+  int reti;
+
+  for (k = 0; k < sizeof(counters) / sizeof(counters[0]); k++) {
+    co = &counters[k];
+    if (co->co_help != NULL) {
+      describe_metric(pr, co->co_name, co->co_type, co->co_help);
+    }
+
+    for (i = 0; i < nch; i++) {
+      cur = (const struct channel*)((const char*)ch + i * stride);
+      val = (const uint64_t*)((const char*)cur + co->co_off);
+
+      reti = 0;
+      lbl[0] = '\0';
+      if (lkey != NULL) {
+        reti = snprintf(lbl, sizeof(lbl), "%s=\"%" PRIu64 "\"", lkey, i);
+      }
+      if (co->co_rsn != NULL && reti >= 0 && (size_t)reti < sizeof(lbl)) {
+        (void)snprintf(lbl + reti, sizeof(lbl) - (size_t)reti, "%sreason=\"%s\"",
+                       reti == 0 ? "" : ",", co->co_rsn);
+      }
+
+      // The counters might be updated by other threads.
+      append_metric(pr, co->co_name, lbl, __atomic_load_n(val, __ATOMIC_RELAXED));
+    }
+  }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_PROM_H
+#define NEMO_COMMON_PROM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "common/channel.h"
+#include "common/hist.h"
+
+
+// Initial size of the response buffer. The buffer grows as needed.
+#define PROM_BUFFER_SIZE 65536
+
+// Space reserved for the response header in front of the metrics.
+#define PROM_HEAD_SIZE 256
+
+// Maximal size of the request, the rest is ignored.
+#define PROM_REQUEST_SIZE 1024
+
+// Maximal size of the socket path.
+#define PROM_PATH_SIZE 108
+
+// Time limit for a single scrape.
+#define PROM_TIMEOUT 1000000000ULL
+
+// Period of the termination checks of the serving thread.
+#define PROM_TICK 100000000ULL
+
+/// Metrics endpoint serving the Prometheus text exposition format over a Unix
+/// domain socket. A single client is served at a time by a dedicated thread,
+/// so that the rendering never delays the packet handling.
+struct prom {
+  char*    pr_buf;   ///< Response buffer (NULL if the endpoint is disabled).
+  size_t   pr_cap;   ///< Capacity of the response buffer.
+  size_t   pr_beg;   ///< Start of the unsent part of the response.
+  size_t   pr_end;   ///< End of the response (zero while reading the request).
+  size_t   pr_rlen;  ///< Received length of the request.
+  uint64_t pr_dl;    ///< Deadline of the current client.
+  uint64_t pr_nscr;  ///< Number of served scrapes.
+  void   (*pr_fill)(struct prom* pr, void* arg); ///< Rendering of metrics.
+  void*    pr_arg;   ///< Argument of the rendering.
+  int      pr_lsock; ///< Listening socket.
+  int      pr_csock; ///< Client socket (-1 if there is none).
+  pthread_t pr_thr;  ///< Serving thread.
+  bool     pr_full;  ///< The response was truncated.
+  bool     pr_run;   ///< The serving thread is running.
+  bool     pr_stop;  ///< Request to stop the serving thread.
+  uint8_t  pr_pad[5]; ///< Padding (unused).
+  char     pr_req[PROM_REQUEST_SIZE]; ///< Request.
+  char     pr_path[PROM_PATH_SIZE];   ///< Path of the socket.
+};
+
+// Endpoint.
+bool open_prom(struct prom* pr,
+               const char* path,
+               void (*fill)(struct prom* pr, void* arg),
+               void* arg);
+void close_prom(struct prom* pr);
+
+// Rendering.
+void describe_metric(struct prom* pr,
+                     const char* name,
+                     const char* type,
+                     const char* help);
+void append_metric(struct prom* pr,
+                   const char* name,
+                   const char* lbl,
+                   const uint64_t val);
+void append_hist(struct prom* pr,
+                 const char* name,
+                 const char* lbl,
+                 const struct hist* hs);
+void escape_label(char* out, const size_t len, const char* inp);
+void expose_channels(struct prom* pr,
+                     const struct channel* ch,
+                     const size_t stride,
+                     const uint64_t nch,
+                     const char* lkey);
+
+#endif
@@ -0,0 +1,106 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/log.h"
+#include "common/ring.h"
+
+
+/// Create an empty ring.
+/// @return success/failure indication
+///
+/// @param[out] rg  ring
+/// @param[in]  esz element size in bytes
+/// @param[in]  cap capacity in elements (power of two)
+bool
+create_ring(struct ring* rg, const uint64_t esz, const uint64_t cap)
+{
+  // The capacity needs to be a power of two, so that the indices can be
+  // mapped to slots by masking.
+  if (cap == 0 || (cap & (cap - 1)) != 0) {
+    log(LL_WARN, false, "ring capacity %" PRIu64 " is not a power of two", cap);
+    return false;
+  }
+
+  (void)memset(rg, 0, sizeof(*rg));
+  rg->rg_esz = esz;
+  rg->rg_cap = cap;
+  rg->rg_buf = calloc((size_t)cap, (size_t)esz);
+  if (rg->rg_buf == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for a ring");
+    return false;
+  }
+
+  return true;
+}
+
+/// Release the memory held by the ring.
+///
+/// @param[in] rg ring
+void
+delete_ring(struct ring* rg)
+{
+  free(rg->rg_buf);
+  rg->rg_buf = NULL;
+}
+
+/// Enqueue an element. This function must only be called by the producer.
+/// @return success/failure indication
+///
+/// @param[in] rg ring
+/// @param[in] el element
+bool
+push_ring(struct ring* rg, const void* el)
+{
+  uint64_t head;
+  uint64_t tail;
+
+  // The producer is the only writer of the tail index, and therefore it can
+  // be read without synchronisation.
+  tail = rg->rg_tail;
+  head = __atomic_load_n(&rg->rg_head, __ATOMIC_ACQUIRE);
+  if (tail - head == rg->rg_cap) {
+    rg->rg_drop++;
+    return false;
+  }
+
+  (void)memcpy(rg->rg_buf + (tail & (rg->rg_cap - 1)) * rg->rg_esz, el, (size_t)rg->rg_esz);
+
+  // Publish the element to the consumer.
+  __atomic_store_n(&rg->rg_tail, tail + 1, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+/// Dequeue an element. This function must only be called by the consumer.
+/// @return success/failure indication
+///
+/// @param[in]  rg ring
+/// @param[out] el element
+bool
+pop_ring(struct ring* rg, void* el)
+{
+  uint64_t head;
+  uint64_t tail;
+
+  // The consumer is the only writer of the head index, and therefore it can
+  // be read without synchronisation.
+  head = rg->rg_head;
+  tail = __atomic_load_n(&rg->rg_tail, __ATOMIC_ACQUIRE);
+  if (head == tail) {
+    return false;
+  }
+
+  (void)memcpy(el, rg->rg_buf + (head & (rg->rg_cap - 1)) * rg->rg_esz, (size_t)rg->rg_esz);
+
+  // Return the slot to the producer.
+  __atomic_store_n(&rg->rg_head, head + 1, __ATOMIC_RELEASE);
+
+  return true;
+}
@@ -0,0 +1,36 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_RING_H
+#define NEMO_COMMON_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Assumed size of the processor cache line.
+#define RING_CACHE_LINE 64
+
+/// Lock-free queue of fixed-size elements with a single producer and a single
+/// consumer. The producer and consumer indices are kept on separate cache
+/// lines to prevent false sharing between the two threads.
+struct ring {
+  uint64_t rg_head;                           ///< Consumer index.
+  uint8_t  rg_pad1[RING_CACHE_LINE - 8];      ///< Padding (unused).
+  uint64_t rg_tail;                           ///< Producer index.
+  uint64_t rg_drop;                           ///< Elements dropped when full.
+  uint8_t  rg_pad2[RING_CACHE_LINE - 16];     ///< Padding (unused).
+  uint8_t* rg_buf;                            ///< Element storage.
+  uint64_t rg_esz;                            ///< Element size in bytes.
+  uint64_t rg_cap;                            ///< Capacity (power of two).
+};
+
+bool create_ring(struct ring* rg, const uint64_t esz, const uint64_t cap);
+void delete_ring(struct ring* rg);
+bool push_ring(struct ring* rg, const void* el);
+bool pop_ring(struct ring* rg, void* el);
+
+#endif
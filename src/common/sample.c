@@ -0,0 +1,134 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <string.h>
+
+#include "common/now.h"
+#include "common/sample.h"
+
+
+// Tokens of a single row. A token bucket holds one second worth of rows.
+#define SAMPLE_TOKEN 1000000000ULL
+
+/// Prepare the sampler.
+///
+/// @param[out] sp    sampler
+/// @param[in]  meth  sampling method
+/// @param[in]  every sampling period
+/// @param[in]  rate  limit of rows per second (0 if unlimited)
+void
+init_sampler(struct sampler* sp,
+             const uint8_t meth,
+             const uint64_t every,
+             const uint64_t rate)
+{
+  (void)memset(sp, 0, sizeof(*sp));
+  sp->sp_meth  = meth;
+  sp->sp_every = every;
+  sp->sp_rate  = rate;
+
+  // The bucket starts full, so that the first second is not throttled.
+  if (rate != 0) {
+    sp->sp_tok  = rate * SAMPLE_TOKEN;
+    sp->sp_last = mono_now();
+  }
+}
+
+/// Hash the key and the sequence number of a request. The requester and the
+/// responder sample the same requests without any coordination.
+/// @return hash value
+///
+/// @param[in] key  key of the request
+/// @param[in] snum sequence number of the request
+static uint64_t
+hash_request(const uint64_t key, const uint64_t snum)
+{
+  uint64_t h;
+
+  h  = key ^ (snum * 0x9e3779b97f4a7c15ULL);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+/// Decide whether a report row of a request is to be printed. Sampled rows
+/// then take a token from the bucket, which refills at the selected rate.
+/// @return print/skip decision
+///
+/// @param[in] sp   sampler
+/// @param[in] key  key of the request
+/// @param[in] snum sequence number of the request
+bool
+sample_row(struct sampler* sp, const uint64_t key, const uint64_t snum)
+{
+  uint64_t cur;
+  uint64_t dur;
+  bool keep;
+
+  switch (sp->sp_meth) {
+    case SAMPLE_COUNT:
+      keep = sp->sp_cnt % sp->sp_every == 0;
+      sp->sp_cnt++;
+      break;
+
+    case SAMPLE_HASH:
+      keep = hash_request(key, snum) % sp->sp_every == 0;
+      break;
+
+    default:
+      keep = true;
+      break;
+  }
+
+  if (keep == false) {
+    __atomic_store_n(&sp->sp_nskip, sp->sp_nskip + 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  if (sp->sp_rate == 0) {
+    return true;
+  }
+
+  // Refill the bucket. The elapsed time is capped at one second, the
+  // capacity of the bucket, so that the product can not overflow.
+  cur = mono_now();
+  dur = cur - sp->sp_last;
+  if (dur > SAMPLE_TOKEN) {
+    dur = SAMPLE_TOKEN;
+  }
+  sp->sp_last = cur;
+  sp->sp_tok += dur * sp->sp_rate;
+  if (sp->sp_tok > sp->sp_rate * SAMPLE_TOKEN) {
+    sp->sp_tok = sp->sp_rate * SAMPLE_TOKEN;
+  }
+
+  if (sp->sp_tok < SAMPLE_TOKEN) {
+    __atomic_store_n(&sp->sp_nsup, sp->sp_nsup + 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  sp->sp_tok -= SAMPLE_TOKEN;
+  return true;
+}
+
+/// Obtain the name of a sampling method.
+/// @return method name
+///
+/// @param[in] meth sampling method
+const char*
+sampling_name(const uint8_t meth)
+{
+  switch (meth) {
+    case SAMPLE_NONE:  return "none";
+    case SAMPLE_COUNT: return "count";
+    case SAMPLE_HASH:  return "hash";
+    default:           return "unknown";
+  }
+}
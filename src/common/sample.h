@@ -0,0 +1,44 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_SAMPLE_H
+#define NEMO_COMMON_SAMPLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Methods of sampling the report rows.
+#define SAMPLE_NONE  0 ///< All rows are reported.
+#define SAMPLE_COUNT 1 ///< Every N-th row is reported.
+#define SAMPLE_HASH  2 ///< Rows whose key and sequence number hash to 1 in N.
+
+// Largest sampling period and rate limit.
+#define SAMPLE_MAX 1000000000ULL
+
+/// Sampling and rate limiting of the report rows. The sampler is used by a
+/// single thread, while its counters can be read by other threads at any
+/// time. A zeroed sampler reports all rows.
+struct sampler {
+  uint64_t sp_every; ///< Sampling period (one row in every).
+  uint64_t sp_cnt;   ///< Number of rows seen by the counting method.
+  uint64_t sp_rate;  ///< Limit of rows per second (0 if unlimited).
+  uint64_t sp_tok;   ///< Available tokens in billionths of a row.
+  uint64_t sp_last;  ///< Monotonic time of the last refill.
+  uint64_t sp_nskip; ///< Number of rows not sampled.
+  uint64_t sp_nsup;  ///< Number of sampled rows suppressed by the limit.
+  uint8_t  sp_meth;  ///< Sampling method.
+  uint8_t  sp_pad[7]; ///< Padding (unused).
+};
+
+void init_sampler(struct sampler* sp,
+                  const uint8_t meth,
+                  const uint64_t every,
+                  const uint64_t rate);
+bool sample_row(struct sampler* sp, const uint64_t key, const uint64_t snum);
+const char* sampling_name(const uint8_t meth);
+
+#endif
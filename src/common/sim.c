@@ -0,0 +1,497 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/socket.h>
+
+#include <netinet/in.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/channel.h"
+#include "common/host.h"
+#include "common/log.h"
+#include "common/now.h"
+#include "common/packet.h"
+#include "common/payload.h"
+#include "common/sim.h"
+
+
+/// Scramble the bits of a value (the finalizer of the SplitMix64 generator).
+/// @return scrambled value
+///
+/// @param[in] x value
+static uint64_t
+mix_bits(uint64_t x)
+{
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/// Draw a pseudo-random number from the generator of the network.
+/// @return number below the bound
+///
+/// @param[in] sm  simulated network
+/// @param[in] lim exclusive upper bound (must not be zero)
+static uint64_t
+draw_number(struct sim* sm, const uint64_t lim)
+{
+  sm->sm_rng += 0x9e3779b97f4a7c15ULL;
+  return mix_bits(sm->sm_rng) % lim;
+}
+
+/// Decide whether an event of a selected probability happens.
+/// @return event indication
+///
+/// @param[in] sm  simulated network
+/// @param[in] ppm probability in parts per million
+static bool
+draw_event(struct sim* sm, const uint64_t ppm)
+{
+  if (ppm == 0) {
+    return false;
+  }
+
+  return draw_number(sm, 1000000) < ppm;
+}
+
+/// Derive the fixed properties of a target from its address, so that these
+/// do not depend on the order of requests or on the worker that issued them.
+/// @return hash of the address
+///
+/// @param[in] ss IPv4/IPv6 socket address
+static uint64_t
+hash_target(const struct sockaddr_storage* ss)
+{
+  const struct sockaddr_in* s4;
+  const struct sockaddr_in6* s6;
+  uint64_t lo;
+  uint64_t hi;
+
+  if (ss->ss_family == AF_INET) {
+    s4 = (const struct sockaddr_in*)ss;
+    return mix_bits((uint64_t)s4->sin_addr.s_addr);
+  }
+
+  s6 = (const struct sockaddr_in6*)ss;
+  (void)memcpy(&lo, &s6->sin6_addr.s6_addr[0], sizeof(lo));
+  (void)memcpy(&hi, &s6->sin6_addr.s6_addr[8], sizeof(hi));
+  return mix_bits(lo ^ mix_bits(hi));
+}
+
+/// Compare two arrivals.
+/// @return earlier indication
+///
+/// @param[in] a first arrival
+/// @param[in] b second arrival
+static bool
+earlier_arrival(const struct arrival* a, const struct arrival* b)
+{
+  if (a->ar_due != b->ar_due) {
+    return a->ar_due < b->ar_due;
+  }
+
+  return a->ar_ord < b->ar_ord;
+}
+
+/// Insert an arrival into the heap.
+///
+/// @param[in] sm simulated network
+/// @param[in] ar arrival
+static void
+push_arrival(struct sim* sm, const struct arrival* ar)
+{
+  uint64_t idx;
+  uint64_t par;
+
+  idx = sm->sm_cnt;
+  sm->sm_cnt++;
+
+  while (idx > 0) {
+    par = (idx - 1) / 2;
+    if (earlier_arrival(&sm->sm_heap[par], ar) == true) {
+      break;
+    }
+
+    sm->sm_heap[idx] = sm->sm_heap[par];
+    idx = par;
+  }
+
+  sm->sm_heap[idx] = *ar;
+}
+
+/// Remove the earliest arrival from the heap.
+///
+/// @param[in] sm simulated network
+static void
+pop_arrival(struct sim* sm)
+{
+  struct arrival last;
+  uint64_t idx;
+  uint64_t kid;
+
+  sm->sm_cnt--;
+  last = sm->sm_heap[sm->sm_cnt];
+
+  idx = 0;
+  while (true) {
+    kid = 2 * idx + 1;
+    if (kid >= sm->sm_cnt) {
+      break;
+    }
+
+    if (kid + 1 < sm->sm_cnt
+     && earlier_arrival(&sm->sm_heap[kid + 1], &sm->sm_heap[kid]) == true) {
+      kid++;
+    }
+
+    if (earlier_arrival(&last, &sm->sm_heap[kid]) == true) {
+      break;
+    }
+
+    sm->sm_heap[idx] = sm->sm_heap[kid];
+    idx = kid;
+  }
+
+  sm->sm_heap[idx] = last;
+}
+
+/// Double the capacity of the network, up to its maximum.
+/// @return success/failure indication
+///
+/// @param[in] sm simulated network
+static bool
+grow_sim(struct sim* sm)
+{
+  struct transit* tr;
+  struct arrival* heap;
+  uint32_t* fr;
+  uint64_t cap;
+  uint64_t i;
+
+  if (sm->sm_cap >= SIM_QUEUE_MAX) {
+    return false;
+  }
+  cap = sm->sm_cap * 2;
+
+  tr = realloc(sm->sm_tr, (size_t)cap * sizeof(*tr));
+  if (tr == NULL) {
+    log(LL_WARN, true, "unable to grow the simulated network");
+    return false;
+  }
+  sm->sm_tr = tr;
+
+  heap = realloc(sm->sm_heap, (size_t)cap * sizeof(*heap));
+  if (heap == NULL) {
+    log(LL_WARN, true, "unable to grow the simulated network");
+    return false;
+  }
+  sm->sm_heap = heap;
+
+  fr = realloc(sm->sm_free, (size_t)cap * sizeof(*fr));
+  if (fr == NULL) {
+    log(LL_WARN, true, "unable to grow the simulated network");
+    return false;
+  }
+  sm->sm_free = fr;
+
+  // The storage is full, and therefore only the new slots are free.
+  for (i = 0; i < cap - sm->sm_cap; i++) {
+    sm->sm_free[i] = (uint32_t)(cap - 1 - i);
+  }
+  sm->sm_cap = cap;
+
+  return true;
+}
+
+/// Create a channel backed by a simulated network instead of a socket. The
+/// network reflects each request the same way as the responder, after the
+/// delay selected by the model. The pseudo-random decisions of the model
+/// are derived from the seed, so that runs with the same sequence of
+/// requests are reproducible.
+/// @return success/failure indication
+///
+/// @param[out] ch   channel
+/// @param[in]  ipv4 IPv4 protocol usage
+/// @param[in]  md   model of the network
+/// @param[in]  seed seed of the pseudo-random generator
+bool
+open_sim(struct channel* ch,
+         const bool ipv4,
+         const struct model* md,
+         const uint64_t seed)
+{
+  struct sim* sm;
+  char hn[NEMO_HOST_NAME_SIZE];
+  uint64_t i;
+  int reti;
+
+  (void)memset(ch, 0, sizeof(*ch));
+  ch->ch_ipv4 = ipv4;
+  ch->ch_sock = -1;
+  ch->ch_port = 0;
+  if (ipv4 == true) {
+    ch->ch_name = "IPv4";
+  } else {
+    ch->ch_name = "IPv6";
+  }
+
+  log(LL_INFO, false, "creating the simulated %s channel", ch->ch_name);
+
+  sm = calloc(1, sizeof(*sm));
+  if (sm == NULL) {
+    log(LL_WARN, true, "unable to allocate the simulated network");
+    return false;
+  }
+
+  reti = pthread_mutex_init(&sm->sm_lock, NULL);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to create the lock of the simulated network");
+    free(sm);
+    return false;
+  }
+  ch->ch_sim = sm;
+
+  sm->sm_md  = *md;
+  sm->sm_rng = mix_bits(seed);
+  sm->sm_cap = SIM_QUEUE_INIT;
+  sm->sm_tr   = calloc(SIM_QUEUE_INIT, sizeof(*sm->sm_tr));
+  sm->sm_heap = calloc(SIM_QUEUE_INIT, sizeof(*sm->sm_heap));
+  sm->sm_free = calloc(SIM_QUEUE_INIT, sizeof(*sm->sm_free));
+  if (sm->sm_tr == NULL || sm->sm_heap == NULL || sm->sm_free == NULL) {
+    log(LL_WARN, true, "unable to allocate the simulated network");
+    return false;
+  }
+
+  for (i = 0; i < SIM_QUEUE_INIT; i++) {
+    sm->sm_free[i] = (uint32_t)(SIM_QUEUE_INIT - 1 - i);
+  }
+
+  (void)memset(hn, '\0', sizeof(hn));
+  (void)strncpy(hn, SIM_HOST_NAME, sizeof(hn) - 1);
+  (void)memcpy(sm->sm_host, hn, sizeof(hn));
+  sm->sm_hid = host_id(hn);
+
+  return true;
+}
+
+/// Pass a request through the simulated network. Unless the request is lost,
+/// its response is stored until its arrival. Each target has its own mean
+/// round-trip time and number of hops, derived from its address, while the
+/// jitter, loss and reordering are drawn for each request. A reordered
+/// response is further delayed by the round-trip time of its target.
+/// @return success/failure indication
+///
+/// @param[in] ch   channel
+/// @param[in] pl   payload in host byte order
+/// @param[in] addr IPv4/IPv6 address of the target
+bool
+send_sim(struct channel* ch,
+         const struct payload* pl,
+         const struct sockaddr_storage* addr)
+{
+  struct sim* sm;
+  struct transit* tr;
+  struct arrival ar;
+  struct payload rpl;
+  struct payload npl;
+  struct payload_compact ncpl;
+  uint64_t mono;
+  uint64_t real;
+  uint64_t hash;
+  uint64_t base;
+  uint64_t fwd;
+  uint64_t bwd;
+  uint8_t hops;
+  bool retb;
+
+  sm = ch->ch_sim;
+  ch->ch_sall++;
+
+  mono = mono_now();
+  real = real_now();
+  hash = hash_target(addr);
+  base = sm->sm_md.md_lat / 2 + hash % (sm->sm_md.md_lat + 1);
+  hops = (uint8_t)(1 + (hash >> 32) % SIM_HOPS_MAX);
+
+  (void)pthread_mutex_lock(&sm->sm_lock);
+
+  // Requests and responses that run out of hops are lost as well.
+  if (draw_event(sm, sm->sm_md.md_loss) == true || pl->pl_ttl1 <= 2 * hops) {
+    sm->sm_lost++;
+    (void)pthread_mutex_unlock(&sm->sm_lock);
+    return true;
+  }
+
+  // Split the round-trip time into both directions.
+  fwd = base / 2 + draw_number(sm, sm->sm_md.md_jit / 2 + 1);
+  bwd = base - base / 2 + draw_number(sm, sm->sm_md.md_jit - sm->sm_md.md_jit / 2 + 1);
+  if (draw_event(sm, sm->sm_md.md_reo) == true) {
+    bwd += base;
+    sm->sm_reo++;
+  }
+
+  // Datagrams beyond the capacity are dropped as by a full receive queue.
+  if (sm->sm_cnt == sm->sm_cap) {
+    retb = grow_sim(sm);
+    if (retb == false) {
+      (void)pthread_mutex_unlock(&sm->sm_lock);
+      ch->ch_rdrop++;
+      return true;
+    }
+  }
+
+  // Reflect the request in the same way as the responder.
+  rpl = *pl;
+  rpl.pl_type = NEMO_PAYLOAD_TYPE_RESPONSE;
+  rpl.pl_mtm2 = mono + fwd;
+  rpl.pl_rtm2 = real + fwd;
+  rpl.pl_ttl2 = (uint8_t)(pl->pl_ttl1 - hops);
+  (void)memcpy(rpl.pl_host, sm->sm_host, NEMO_HOST_NAME_SIZE);
+  rpl.pl_hid  = sm->sm_hid;
+
+  ar.ar_due = mono + fwd + bwd;
+  ar.ar_ord = sm->sm_ord;
+  ar.ar_idx = sm->sm_free[sm->sm_cap - sm->sm_cnt - 1];
+  sm->sm_ord++;
+
+  tr = &sm->sm_tr[ar.ar_idx];
+  (void)memset(tr->tr_buf, 0, sizeof(tr->tr_buf));
+  if (rpl.pl_fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    encode_compact(&ncpl, &rpl);
+    (void)memcpy(tr->tr_buf, &ncpl, sizeof(ncpl));
+  } else {
+    encode_payload(&npl, &rpl);
+    (void)memcpy(tr->tr_buf, &npl, sizeof(npl));
+  }
+  tr->tr_addr = *addr;
+  tr->tr_len  = pl->pl_len;
+  tr->tr_ttl  = (uint8_t)(pl->pl_ttl1 - hops);
+
+  push_arrival(sm, &ar);
+  (void)pthread_mutex_unlock(&sm->sm_lock);
+
+  return true;
+}
+
+/// Receive the earliest response of the simulated network, if it has already
+/// arrived.
+/// @return success/failure indication
+///
+/// @param[in]  ch   channel
+/// @param[out] addr IPv4/IPv6 address of the responder
+/// @param[out] pl   payload in host byte order
+/// @param[out] ttl  time to live
+/// @param[out] got  datagram was received (or NULL)
+/// @param[in]  err  exit on error
+bool
+receive_sim(struct channel* ch,
+            struct sockaddr_storage* addr,
+            struct payload* pl,
+            uint8_t* ttl,
+            bool* got,
+            const bool err)
+{
+  struct sim* sm;
+  struct transit* tr;
+  uint16_t len;
+  uint8_t lvl;
+
+  // Increase the seriousness of the incident in case we are going to fail.
+  if (err == true) {
+    lvl = LL_WARN;
+  } else {
+    lvl = LL_DEBUG;
+  }
+
+  sm = ch->ch_sim;
+  (void)pthread_mutex_lock(&sm->sm_lock);
+
+  if (sm->sm_cnt == 0 || sm->sm_heap[0].ar_due > mono_now()) {
+    (void)pthread_mutex_unlock(&sm->sm_lock);
+
+    // An empty network is expected when polling.
+    if (got != NULL) {
+      *got = false;
+      return true;
+    }
+
+    log(lvl, false, "no datagram has arrived");
+    ch->ch_rall++;
+    ch->ch_reni++;
+    return false;
+  }
+
+  // Copy the datagram out of the network, so that its slot can be reused.
+  tr = &sm->sm_tr[sm->sm_heap[0].ar_idx];
+  (void)memcpy(ch->ch_buf, tr->tr_buf, sizeof(tr->tr_buf));
+  *addr = tr->tr_addr;
+  *ttl  = tr->tr_ttl;
+  len   = tr->tr_len;
+
+  sm->sm_free[sm->sm_cap - sm->sm_cnt] = sm->sm_heap[0].ar_idx;
+  pop_arrival(sm);
+  (void)pthread_mutex_unlock(&sm->sm_lock);
+
+  log(LL_TRACE, false, "receiving a packet");
+
+  if (got != NULL) {
+    *got = true;
+  }
+  ch->ch_rall++;
+
+  return unpack_payload(ch, pl, ch->ch_buf, (size_t)len, lvl);
+}
+
+/// Obtain the time of the earliest arrival of a response.
+/// @return monotonic time (UINT64_MAX if there is no response in transit)
+///
+/// @param[in] ch channel
+uint64_t
+next_sim(struct channel* ch)
+{
+  struct sim* sm;
+  uint64_t due;
+
+  sm = ch->ch_sim;
+  due = UINT64_MAX;
+
+  (void)pthread_mutex_lock(&sm->sm_lock);
+  if (sm->sm_cnt > 0) {
+    due = sm->sm_heap[0].ar_due;
+  }
+  (void)pthread_mutex_unlock(&sm->sm_lock);
+
+  return due;
+}
+
+/// Release the simulated network of a channel.
+///
+/// @param[in] ch channel
+void
+close_sim(struct channel* ch)
+{
+  struct sim* sm;
+
+  sm = ch->ch_sim;
+  if (sm == NULL) {
+    return;
+  }
+
+  log(LL_DEBUG, false, "simulated %s network lost %" PRIu64 " and reordered %"
+      PRIu64 " datagrams, %" PRIu64 " remained in transit",
+      ch->ch_name, sm->sm_lost, sm->sm_reo, sm->sm_cnt);
+
+  (void)pthread_mutex_destroy(&sm->sm_lock);
+  free(sm->sm_tr);
+  free(sm->sm_heap);
+  free(sm->sm_free);
+  free(sm);
+  ch->ch_sim = NULL;
+}
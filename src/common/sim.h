@@ -0,0 +1,95 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_SIM_H
+#define NEMO_COMMON_SIM_H
+
+#include <sys/socket.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/channel.h"
+#include "common/payload.h"
+
+
+// Initial and maximal number of datagrams in transit through a simulated
+// network. Datagrams beyond the maximum are dropped, same as by a full
+// receive queue.
+#define SIM_QUEUE_INIT 256
+#define SIM_QUEUE_MAX  (1U << 17)
+
+// Host name of all simulated responders.
+#define SIM_HOST_NAME "nemo-sim"
+
+// Largest number of hops between the requester and a simulated responder.
+#define SIM_HOPS_MAX 16
+
+/// Model of a simulated network. Each target is assigned its own mean
+/// round-trip time within the range of 50% to 150% of the overall mean,
+/// and each datagram is delayed by a further jitter, uniformly distributed in
+/// each direction.
+struct model {
+  uint64_t md_lat;  ///< Mean round-trip time.
+  uint64_t md_jit;  ///< Largest round-trip jitter.
+  uint64_t md_loss; ///< Probability of a loss in parts per million.
+  uint64_t md_reo;  ///< Probability of a reordering in parts per million.
+};
+
+/// Reflected datagram in transit through the simulated network.
+struct transit {
+  struct sockaddr_storage tr_addr; ///< Address of the responder.
+  uint8_t  tr_buf[NEMO_PAYLOAD_SIZE]; ///< Encoded base payload.
+  uint16_t tr_len;    ///< Length of the datagram.
+  uint8_t  tr_ttl;    ///< Time-to-live upon the arrival.
+  uint8_t  tr_pad[5]; ///< Padding (unused).
+};
+
+/// Arrival of a datagram, ordered by its time and then by its departure.
+struct arrival {
+  uint64_t ar_due; ///< Monotonic time of the arrival.
+  uint64_t ar_ord; ///< Order of the departure.
+  uint32_t ar_idx; ///< Index of the datagram in the storage.
+  uint8_t  ar_pad[4]; ///< Padding (unused).
+};
+
+/// In-memory network behind a simulated channel. The arrivals are kept in a
+/// binary min-heap, and the storage of the datagrams is recycled through a
+/// stack of free slots. The lock allows for a separate receiver thread.
+struct sim {
+  struct model    sm_md;   ///< Model of the network.
+  struct transit* sm_tr;   ///< Storage of datagrams in transit.
+  struct arrival* sm_heap; ///< Heap of arrivals.
+  uint32_t*       sm_free; ///< Stack of free storage slots.
+  uint64_t        sm_cap;  ///< Capacity of the storage.
+  uint64_t        sm_cnt;  ///< Number of datagrams in transit.
+  uint64_t        sm_ord;  ///< Order of the next departure.
+  uint64_t        sm_rng;  ///< State of the pseudo-random generator.
+  uint64_t        sm_lost; ///< Number of lost datagrams.
+  uint64_t        sm_reo;  ///< Number of reordered datagrams.
+  uint64_t        sm_hid;  ///< Host identifier of the responders.
+  char            sm_host[NEMO_HOST_NAME_SIZE]; ///< Host name of the responders.
+  pthread_mutex_t sm_lock; ///< Lock guarding the network.
+};
+
+bool open_sim(struct channel* ch,
+              const bool ipv4,
+              const struct model* md,
+              const uint64_t seed);
+bool send_sim(struct channel* ch,
+              const struct payload* pl,
+              const struct sockaddr_storage* addr);
+bool receive_sim(struct channel* ch,
+                 struct sockaddr_storage* addr,
+                 struct payload* pl,
+                 uint8_t* ttl,
+                 bool* got,
+                 const bool err);
+uint64_t next_sim(struct channel* ch);
+void close_sim(struct channel* ch);
+
+#endif
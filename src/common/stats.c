@@ -0,0 +1,352 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+#include "common/log.h"
+#include "common/now.h"
+#include "common/stats.h"
+
+
+// Names of the values of each section kind.
+static const char* ch_fields[] = {
+  "recv_all", "recv_err_net", "recv_err_size", "recv_err_magic",
+  "recv_err_version", "recv_err_type", "send_all", "send_err_net", "port",
+  "recv_drop", "recv_queue_peak", "recv_queue_limit"
+};
+static const char* sc_fields[] = {
+  "rounds", "requests", "responses", "lag_last_ns", "lag_max_ns", "lag_sum_ns",
+  "lost", "late"
+};
+static const char* pi_fields[] = {
+  "state", "pid", "notifications", "errors"
+};
+
+// Segment to remove at the process exit.
+static char stats_name[STATS_NAME_SIZE];
+static pid_t stats_pid = 0;
+
+/// Remove the shared memory segment of the process, unless called by a
+/// forked child process.
+static void
+remove_stats(void)
+{
+  if (stats_pid == getpid()) {
+    (void)shm_unlink(stats_name);
+  }
+}
+
+/// Create and map a shared memory segment for the statistics of the process.
+/// The segment is named after the program and the process identifier, and is
+/// removed at the process exit.
+/// @return success/failure indication
+///
+/// @param[out] st    statistics
+/// @param[in]  prog  program name
+/// @param[in]  nsect number of sections
+bool
+create_stats(struct stats* st, const char* prog, const uint32_t nsect)
+{
+  int fd;
+  int reti;
+  void* mem;
+
+  if (nsect > STATS_SECT_MAX) {
+    log(LL_WARN, false, "too many statistics sections: %" PRIu32, nsect);
+    return false;
+  }
+
+  (void)memset(st, 0, sizeof(*st));
+  (void)snprintf(st->st_name, sizeof(st->st_name), "/" STATS_PREFIX "%s.%ld",
+                 prog, (long)getpid());
+  st->st_size = sizeof(struct stats_head) + nsect * sizeof(struct stats_sect);
+
+  fd = shm_open(st->st_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd == -1) {
+    log(LL_WARN, true, "unable to create shared memory segment %s", st->st_name);
+    return false;
+  }
+
+  reti = ftruncate(fd, (off_t)st->st_size);
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to resize shared memory segment %s", st->st_name);
+    (void)close(fd);
+    (void)shm_unlink(st->st_name);
+    return false;
+  }
+
+  mem = mmap(NULL, st->st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  (void)close(fd);
+  if (mem == MAP_FAILED) {
+    log(LL_WARN, true, "unable to map shared memory segment %s", st->st_name);
+    (void)shm_unlink(st->st_name);
+    return false;
+  }
+
+  (void)strncpy(stats_name, st->st_name, sizeof(stats_name) - 1);
+  if (stats_pid == 0) {
+    (void)atexit(remove_stats);
+  }
+  stats_pid = getpid();
+
+  // The memory is zero-filled, and the magic number is written last so that
+  // readers never observe an incomplete header.
+  st->st_head = mem;
+  st->st_sect = (struct stats_sect*)(st->st_head + 1);
+  st->st_head->sh_ver   = STATS_VERSION;
+  st->st_head->sh_size  = (uint32_t)st->st_size;
+  st->st_head->sh_ssz   = (uint32_t)sizeof(struct stats_sect);
+  st->st_head->sh_nsect = nsect;
+  st->st_head->sh_pid   = (uint64_t)getpid();
+  st->st_head->sh_start = real_now();
+  (void)strncpy(st->st_head->sh_prog, prog, sizeof(st->st_head->sh_prog) - 1);
+  __atomic_store_n(&st->st_head->sh_magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+  log(LL_DEBUG, false, "publishing statistics to %s", st->st_name);
+  return true;
+}
+
+/// Describe a section of the statistics.
+/// @return section
+///
+/// @param[in] st   statistics
+/// @param[in] sidx index of the section
+/// @param[in] kind kind of the section (one of STATS_*)
+/// @param[in] idx  index of the worker or plugin
+/// @param[in] name human-readable name
+struct stats_sect*
+init_section(struct stats* st,
+             const uint32_t sidx,
+             const uint32_t kind,
+             const uint32_t idx,
+             const char* name)
+{
+  struct stats_sect* ss;
+
+  ss = &st->st_sect[sidx];
+  ss->ss_kind = kind;
+  ss->ss_idx  = idx;
+  (void)strncpy(ss->ss_name, name, sizeof(ss->ss_name) - 1);
+
+  return ss;
+}
+
+/// Publish new values of a section. This function must be called only by
+/// the thread that owns the section.
+///
+/// @param[in] ss   section
+/// @param[in] val  values
+/// @param[in] nval number of values
+void
+publish_section(struct stats_sect* ss, const uint64_t* val, const uint32_t nval)
+{
+  uint64_t seq;
+  uint32_t i;
+
+  seq = __atomic_load_n(&ss->ss_seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&ss->ss_seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  for (i = 0; i < nval && i < STATS_FIELD_MAX; i++) {
+    __atomic_store_n(&ss->ss_val[i], val[i], __ATOMIC_RELAXED);
+  }
+
+  __atomic_store_n(&ss->ss_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/// Publish the counters of a channel.
+///
+/// @param[in] ss section
+/// @param[in] ch channel
+void
+publish_channel(struct stats_sect* ss, const struct channel* ch)
+{
+  uint64_t val[STATS_FIELD_MAX];
+
+  // The counters might be updated by a separate receiver thread.
+  val[SV_CH_RALL] = __atomic_load_n(&ch->ch_rall, __ATOMIC_RELAXED);
+  val[SV_CH_RENI] = __atomic_load_n(&ch->ch_reni, __ATOMIC_RELAXED);
+  val[SV_CH_RESZ] = __atomic_load_n(&ch->ch_resz, __ATOMIC_RELAXED);
+  val[SV_CH_REMG] = __atomic_load_n(&ch->ch_remg, __ATOMIC_RELAXED);
+  val[SV_CH_REPV] = __atomic_load_n(&ch->ch_repv, __ATOMIC_RELAXED);
+  val[SV_CH_RETY] = __atomic_load_n(&ch->ch_rety, __ATOMIC_RELAXED);
+  val[SV_CH_SALL] = __atomic_load_n(&ch->ch_sall, __ATOMIC_RELAXED);
+  val[SV_CH_SENI] = __atomic_load_n(&ch->ch_seni, __ATOMIC_RELAXED);
+  val[SV_CH_PORT] = ch->ch_port;
+  val[SV_CH_RDRP] = __atomic_load_n(&ch->ch_rdrop, __ATOMIC_RELAXED);
+  val[SV_CH_RQMX] = __atomic_load_n(&ch->ch_rqmx, __ATOMIC_RELAXED);
+  val[SV_CH_RQLM] = __atomic_load_n(&ch->ch_rqlm, __ATOMIC_RELAXED);
+
+  publish_section(ss, val, SV_CH_RQLM + 1);
+}
+
+/// Unmap and remove the shared memory segment.
+///
+/// @param[in] st statistics
+void
+delete_stats(struct stats* st)
+{
+  int reti;
+
+  if (st->st_head == NULL) {
+    return;
+  }
+
+  reti = munmap(st->st_head, st->st_size);
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to unmap shared memory segment %s", st->st_name);
+  }
+
+  reti = shm_unlink(st->st_name);
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to remove shared memory segment %s", st->st_name);
+  }
+
+  st->st_head = NULL;
+  stats_pid = 0;
+}
+
+/// Map the shared memory segment of another process for reading.
+/// @return success/failure indication
+///
+/// @param[out] st   statistics
+/// @param[in]  name name of the segment
+bool
+open_stats(struct stats* st, const char* name)
+{
+  struct stat sb;
+  struct stats_head* sh;
+  int fd;
+  int reti;
+  void* mem;
+
+  (void)memset(st, 0, sizeof(*st));
+  if (name[0] == '/') {
+    (void)snprintf(st->st_name, sizeof(st->st_name), "%s", name);
+  } else {
+    (void)snprintf(st->st_name, sizeof(st->st_name), "/%s", name);
+  }
+
+  fd = shm_open(st->st_name, O_RDONLY, 0);
+  if (fd == -1) {
+    log(LL_WARN, true, "unable to open shared memory segment %s", st->st_name);
+    return false;
+  }
+
+  reti = fstat(fd, &sb);
+  if (reti == -1 || (size_t)sb.st_size < sizeof(struct stats_head)) {
+    log(LL_WARN, false, "shared memory segment %s is too small", st->st_name);
+    (void)close(fd);
+    return false;
+  }
+
+  mem = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  (void)close(fd);
+  if (mem == MAP_FAILED) {
+    log(LL_WARN, true, "unable to map shared memory segment %s", st->st_name);
+    return false;
+  }
+
+  // Verify that the layout is understood by this reader.
+  sh = mem;
+  st->st_size = (size_t)sb.st_size;
+  if (__atomic_load_n(&sh->sh_magic, __ATOMIC_ACQUIRE) != STATS_MAGIC
+   || sh->sh_ver != STATS_VERSION
+   || sh->sh_ssz != sizeof(struct stats_sect)
+   || sh->sh_size > st->st_size
+   || sizeof(*sh) + sh->sh_nsect * sizeof(struct stats_sect) > st->st_size) {
+    log(LL_WARN, false, "unsupported layout of shared memory segment %s", st->st_name);
+    (void)munmap(mem, st->st_size);
+    return false;
+  }
+
+  st->st_head = sh;
+  st->st_sect = (struct stats_sect*)(sh + 1);
+
+  return true;
+}
+
+/// Read a consistent snapshot of the section values.
+/// @return success/failure indication
+///
+/// @param[in]  ss  section
+/// @param[out] val values
+bool
+read_section(const struct stats_sect* ss, uint64_t val[STATS_FIELD_MAX])
+{
+  uint64_t seq1;
+  uint64_t seq2;
+  uint32_t i;
+  uint32_t tries;
+
+  // Give up after a number of attempts, so that a stopped writer does not
+  // block the reader.
+  for (tries = 0; tries < 1000; tries++) {
+    seq1 = __atomic_load_n(&ss->ss_seq, __ATOMIC_ACQUIRE);
+    if ((seq1 & 1) != 0) {
+      continue;
+    }
+
+    for (i = 0; i < STATS_FIELD_MAX; i++) {
+      val[i] = __atomic_load_n(&ss->ss_val[i], __ATOMIC_RELAXED);
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    seq2 = __atomic_load_n(&ss->ss_seq, __ATOMIC_RELAXED);
+    if (seq1 == seq2) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Obtain the names of values of a section kind.
+/// @return number of values
+///
+/// @param[in]  kind  kind of the section (one of STATS_*)
+/// @param[out] names names of values
+uint32_t
+section_fields(const uint32_t kind, const char*** names)
+{
+  if (kind == STATS_CHANNEL) {
+    *names = ch_fields;
+    return sizeof(ch_fields) / sizeof(ch_fields[0]);
+  }
+
+  if (kind == STATS_SCHEDULER) {
+    *names = sc_fields;
+    return sizeof(sc_fields) / sizeof(sc_fields[0]);
+  }
+
+  if (kind == STATS_PLUGIN) {
+    *names = pi_fields;
+    return sizeof(pi_fields) / sizeof(pi_fields[0]);
+  }
+
+  *names = NULL;
+  return 0;
+}
+
+/// Unmap the shared memory segment of another process.
+///
+/// @param[in] st statistics
+void
+close_stats(struct stats* st)
+{
+  if (st->st_head != NULL) {
+    (void)munmap(st->st_head, st->st_size);
+    st->st_head = NULL;
+  }
+}
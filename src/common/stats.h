@@ -0,0 +1,117 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_COMMON_STATS_H
+#define NEMO_COMMON_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "common/channel.h"
+
+
+// Identification of the shared memory segment layout.
+#define STATS_MAGIC   0x6e656d6f73746174ULL ///< ASCII "nemostat".
+#define STATS_VERSION 1
+
+// Limits of the layout.
+#define STATS_SECT_MAX  128 ///< Maximal number of sections.
+#define STATS_FIELD_MAX 12  ///< Maximal number of values in a section.
+#define STATS_NAME_SIZE 32  ///< Size of the section and program names.
+
+// Minimal period between two publications of the same section.
+#define STATS_PERIOD 100000000ULL
+
+// Prefix of the shared memory segment names.
+#define STATS_PREFIX "nemo-"
+
+// Section kinds.
+#define STATS_CHANNEL   1 ///< Counters of a network channel.
+#define STATS_SCHEDULER 2 ///< Request schedule of a requester worker.
+#define STATS_PLUGIN    3 ///< Event notifications of a plugin.
+
+// Values of the channel section.
+#define SV_CH_RALL 0
+#define SV_CH_RENI 1
+#define SV_CH_RESZ 2
+#define SV_CH_REMG 3
+#define SV_CH_REPV 4
+#define SV_CH_RETY 5
+#define SV_CH_SALL 6
+#define SV_CH_SENI 7
+#define SV_CH_PORT 8
+#define SV_CH_RDRP 9
+#define SV_CH_RQMX 10
+#define SV_CH_RQLM 11
+
+// Values of the scheduler section.
+#define SV_SC_ROUNDS 0
+#define SV_SC_SENT   1
+#define SV_SC_RECV   2
+#define SV_SC_LAST   3
+#define SV_SC_MAX    4
+#define SV_SC_SUM    5
+#define SV_SC_LOST   6
+#define SV_SC_LATE   7
+
+// Values of the plugin section.
+#define SV_PI_STATE  0
+#define SV_PI_PID    1
+#define SV_PI_NOTIFY 2
+#define SV_PI_ERROR  3
+
+/// Section of the statistics, updated by a single thread. The values are
+/// protected by a sequence lock: the sequence number is odd while an update
+/// is in progress, and readers retry whenever it changed during their read.
+struct stats_sect {
+  uint64_t ss_seq;                   ///< Sequence number.
+  uint32_t ss_kind;                  ///< Kind of the section (one of STATS_*).
+  uint32_t ss_idx;                   ///< Index of the worker or plugin.
+  char     ss_name[STATS_NAME_SIZE]; ///< Human-readable name.
+  uint64_t ss_val[STATS_FIELD_MAX];  ///< Values.
+};
+
+/// Header of the shared memory segment.
+struct stats_head {
+  uint64_t sh_magic;                 ///< Layout identification.
+  uint32_t sh_ver;                   ///< Layout version.
+  uint32_t sh_size;                  ///< Overall size of the segment.
+  uint32_t sh_ssz;                   ///< Size of a section.
+  uint32_t sh_nsect;                 ///< Number of sections.
+  uint64_t sh_pid;                   ///< Process identifier.
+  uint64_t sh_start;                 ///< Real time of the process start.
+  char     sh_prog[STATS_NAME_SIZE]; ///< Program name.
+};
+
+/// Statistics published by a process.
+struct stats {
+  struct stats_head* st_head;                 ///< Mapped segment.
+  struct stats_sect* st_sect;                 ///< Sections of the segment.
+  size_t             st_size;                 ///< Size of the segment.
+  char               st_name[STATS_NAME_SIZE]; ///< Name of the segment.
+};
+
+// Publishing.
+bool create_stats(struct stats* st, const char* prog, const uint32_t nsect);
+struct stats_sect* init_section(struct stats* st,
+                                const uint32_t sidx,
+                                const uint32_t kind,
+                                const uint32_t idx,
+                                const char* name);
+void publish_section(struct stats_sect* ss,
+                     const uint64_t* val,
+                     const uint32_t nval);
+void publish_channel(struct stats_sect* ss, const struct channel* ch);
+void delete_stats(struct stats* st);
+
+// Reading.
+bool open_stats(struct stats* st, const char* name);
+bool read_section(const struct stats_sect* ss, uint64_t val[STATS_FIELD_MAX]);
+uint32_t section_fields(const uint32_t kind, const char*** names);
+void close_stats(struct stats* st);
+
+#endif
@@ -0,0 +1,145 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "join/funcs.h"
+#include "join/types.h"
+#include "common/log.h"
+#include "common/parse.h"
+
+
+// Default values.
+#define DEF_WINDOW 10000000000ULL ///< Ten seconds.
+
+/// Print the usage information to the standard output stream.
+static void
+print_usage(void)
+{
+  (void)printf(
+    "About:\n"
+    "  Join of the ureq and ures reports into one-way delays.\n\n"
+
+    "Usage:\n"
+    "  nemo-join [OPTIONS] req res\n\n"
+
+    "Arguments:\n"
+    "  req     Report produced by ureq in the CSV format (- for stdin).\n"
+    "  res     Report produced by ures in the CSV format (- for stdin).\n\n"
+
+    "Options:\n"
+    "  -a ADDR Address of the responder, other requests are skipped.\n"
+    "          (repeatable, def=learned from the responses)\n"
+    "  -h      Print this help message.\n"
+    "  -v      Report the join statistics.\n"
+    "  -w DUR  Maximal difference of the requester and responder times.\n"
+    "          (def=10s)\n");
+}
+
+/// Convert a responder address into the textual form used by the requester
+/// report, so that the addresses can be compared as strings.
+/// @return success/failure indication
+///
+/// @param[out] cf  configuration
+/// @param[in]  inp input string
+static bool
+parse_address(struct config* cf, const char* inp)
+{
+  struct in_addr a4;
+  struct in6_addr a6;
+  const char* str;
+  char* out;
+  int reti;
+
+  if (cf->cf_naddr == JOIN_ADDR_MAX) {
+    log(LL_WARN, false, "too many addresses, maximum is %d", JOIN_ADDR_MAX);
+    return false;
+  }
+  out = cf->cf_addr[cf->cf_naddr];
+
+  reti = inet_pton(AF_INET, inp, &a4);
+  if (reti == 1) {
+    str = inet_ntop(AF_INET, &a4, out, JOIN_ADDR_SIZE);
+  } else {
+    reti = inet_pton(AF_INET6, inp, &a6);
+    if (reti != 1) {
+      log(LL_WARN, false, "invalid address '%s'", inp);
+      return false;
+    }
+
+    // The requester reports IPv4-mapped addresses in the IPv4 form.
+    if (IN6_IS_ADDR_V4MAPPED(&a6)) {
+      (void)memcpy(&a4, &a6.s6_addr[12], sizeof(a4));
+      str = inet_ntop(AF_INET, &a4, out, JOIN_ADDR_SIZE);
+    } else {
+      str = inet_ntop(AF_INET6, &a6, out, JOIN_ADDR_SIZE);
+    }
+  }
+
+  if (str == NULL) {
+    return false;
+  }
+
+  cf->cf_naddr++;
+  return true;
+}
+
+/// Parse the command-line options.
+/// @return success/failure indication
+///
+/// @param[out] cf   configuration
+/// @param[in]  argc argument count
+/// @param[in]  argv argument vector
+bool
+parse_config(struct config* cf, int argc, char* argv[])
+{
+  int opt;
+  bool retb;
+
+  (void)memset(cf, 0, sizeof(*cf));
+  cf->cf_win  = DEF_WINDOW;
+  cf->cf_verb = false;
+
+  while ((opt = getopt(argc, argv, "a:hvw:")) != -1) {
+    retb = true;
+
+    if (opt == 'a') {
+      retb = parse_address(cf, optarg);
+    } else if (opt == 'v') {
+      cf->cf_verb = true;
+    } else if (opt == 'w') {
+      retb = parse_scalar(&cf->cf_win, optarg, "ns", 1, UINT64_MAX / 4, parse_time_unit);
+    } else {
+      print_usage();
+      exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (retb == false) {
+      log(LL_WARN, false, "invalid value of option '%c'", opt);
+      return false;
+    }
+  }
+
+  if (argc - optind != 2) {
+    log(LL_WARN, false, "expected the requester and the responder report");
+    return false;
+  }
+
+  cf->cf_req = argv[optind];
+  cf->cf_res = argv[optind + 1];
+  if (strcmp(cf->cf_req, "-") == 0 && strcmp(cf->cf_res, "-") == 0) {
+    log(LL_WARN, false, "only one report can be read from the standard input");
+    return false;
+  }
+
+  return true;
+}
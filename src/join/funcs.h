@@ -0,0 +1,35 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_JOIN_FUNCS_H
+#define NEMO_JOIN_FUNCS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "join/types.h"
+
+
+// Configuration.
+bool parse_config(struct config* cf, int argc, char* argv[]);
+
+// Reading.
+bool open_reader(struct reader* rd, const char* path);
+bool read_line(struct reader* rd, const char** beg, const char** end);
+void close_reader(struct reader* rd);
+
+// Parsing.
+bool parse_request(struct request* rq, const char* beg, const char* end);
+bool parse_response(struct entry* en, const char* beg, const char* end);
+
+// Window.
+bool create_window(struct window* wn, const uint64_t width);
+void delete_window(struct window* wn);
+bool insert_entry(struct window* wn, const struct entry* en);
+struct entry* find_entry(struct window* wn, const struct request* rq);
+void flush_window(struct window* wn);
+
+#endif
@@ -0,0 +1,388 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "join/funcs.h"
+#include "join/types.h"
+#include "common/log.h"
+#include "common/now.h"
+
+
+/// Insert the responder rows into the window until the arrival of a request
+/// exceeds the limit. The first such row is retained for the following call.
+/// @return success/failure indication
+///
+/// @param[in]  wn   window
+/// @param[in]  rd   reader of the responder report
+/// @param[in]  en   retained row
+/// @param[in]  pend retained row is valid
+/// @param[out] nbad number of malformed lines
+/// @param[in]  lim  limit of the request arrival
+static bool
+load_responses(struct window* wn,
+               struct reader* rd,
+               struct entry* en,
+               bool* pend,
+               uint64_t* nbad,
+               const uint64_t lim)
+{
+  const char* beg;
+  const char* end;
+  bool retb;
+
+  while (true) {
+    if (*pend == false) {
+      retb = read_line(rd, &beg, &end);
+      if (retb == false) {
+        return false;
+      }
+
+      // End of the report.
+      if (beg == NULL) {
+        return true;
+      }
+
+      // Skip the header and the empty lines.
+      if (beg == end || *beg < '0' || *beg > '9') {
+        continue;
+      }
+
+      retb = parse_response(en, beg, end);
+      if (retb == false) {
+        (*nbad)++;
+        continue;
+      }
+
+      *pend = true;
+    }
+
+    if (en->en_areq > lim) {
+      return true;
+    }
+
+    retb = insert_entry(wn, en);
+    if (retb == false) {
+      return false;
+    }
+
+    *pend = false;
+  }
+}
+
+/// Write a time-stamp in the CSV format.
+///
+/// @param[in] fp output stream
+/// @param[in] ts time-stamp (0 if not available)
+static void
+write_time(FILE* fp, const uint64_t ts)
+{
+  if (ts == 0) {
+    (void)fprintf(fp, "N/A,");
+  } else {
+    (void)fprintf(fp, "%" PRIu64 ",", ts);
+  }
+}
+
+/// Write the difference of two time-stamps in the CSV format. Time-stamps of
+/// different hosts are subject to the offset of their clocks, and therefore
+/// the difference can be negative.
+///
+/// @param[in] fp  output stream
+/// @param[in] beg earlier time-stamp (0 if not available)
+/// @param[in] end later time-stamp (0 if not available)
+static void
+write_delay(FILE* fp, const uint64_t beg, const uint64_t end)
+{
+  if (beg == 0 || end == 0) {
+    (void)fprintf(fp, "N/A,");
+  } else {
+    (void)fprintf(fp, "%" PRId64 ",", (int64_t)(end - beg));
+  }
+}
+
+/// Determine the path on which a request was lost.
+/// @return path name
+///
+/// @param[in] rq requester row
+/// @param[in] en responder row (or NULL)
+static const char*
+loss_name(const struct request* rq, const struct entry* en)
+{
+  if (rq->rq_slen != 4 || memcmp(rq->rq_stat, "lost", 4) != 0) {
+    return "none";
+  }
+
+  if (en == NULL) {
+    return "fwd";
+  }
+
+  // The responder received the request, but did not send the response.
+  if (en->en_dres == 0) {
+    return "res";
+  }
+
+  return "bwd";
+}
+
+/// Write a joined row in the CSV format.
+///
+/// @param[in] fp output stream
+/// @param[in] rq requester row
+/// @param[in] en responder row (or NULL)
+static void
+write_row(FILE* fp, const struct request* rq, const struct entry* en)
+{
+  uint64_t areq;
+  uint64_t dres;
+
+  (void)fprintf(fp, "%" PRIu64 ",%" PRIu64 ",%.*s,",
+                rq->rq_key, rq->rq_seq, (int)rq->rq_hrql, rq->rq_hreq);
+
+  if (rq->rq_hres != NULL) {
+    (void)fprintf(fp, "%.*s,", (int)rq->rq_hrsl, rq->rq_hres);
+  } else if (en != NULL) {
+    (void)fprintf(fp, "%.*s,", NEMO_HOST_NAME_SIZE, en->en_hres);
+  } else {
+    (void)fprintf(fp, "N/A,");
+  }
+
+  (void)fprintf(fp, "%.*s,%.*s,",
+                (int)rq->rq_alen, rq->rq_addr, (int)rq->rq_slen, rq->rq_stat);
+
+  // The responder report provides the arrival of lost requests as well.
+  areq = en != NULL ? en->en_areq : rq->rq_areq;
+  dres = en != NULL ? en->en_dres : 0;
+
+  write_time(fp, rq->rq_dreq);
+  write_time(fp, areq);
+  write_time(fp, dres);
+  write_time(fp, rq->rq_ares);
+  write_delay(fp, rq->rq_dreq, areq);
+  write_delay(fp, areq, dres);
+  write_delay(fp, dres, rq->rq_ares);
+
+  (void)fprintf(fp, "%s\n", loss_name(rq, en));
+}
+
+/// Determine whether an address belongs to the responder.
+/// @return membership indication
+///
+/// @param[in] addr  addresses of the responder
+/// @param[in] naddr number of addresses
+/// @param[in] rq    requester row
+static bool
+find_address(char addr[static JOIN_ADDR_MAX][JOIN_ADDR_SIZE],
+             const uint64_t naddr,
+             const struct request* rq)
+{
+  uint64_t i;
+
+  for (i = 0; i < naddr; i++) {
+    if (strncmp(addr[i], rq->rq_addr, rq->rq_alen) == 0 && addr[i][rq->rq_alen] == '\0') {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Join the requester report with the responder report. Both reports are
+/// expected to be ordered by time up to the width of the window: responder
+/// rows are loaded until their request arrival exceeds the latest request
+/// departure by the width of the window, and are dropped once they fall
+/// behind it by more than twice the width.
+///
+/// The requester does not know the responder of a lost request, and the
+/// sequence numbers are shared by all targets of a round. Lost requests are
+/// therefore joined only if they were sent to an address of the responder,
+/// either selected by the configuration or learned from the preceding
+/// responses.
+/// @return success/failure indication
+///
+/// @param[in] req reader of the requester report
+/// @param[in] res reader of the responder report
+/// @param[in] wn  window
+/// @param[in] cf  configuration
+static bool
+join_reports(struct reader* req,
+             struct reader* res,
+             struct window* wn,
+             const struct config* cf)
+{
+  char addr[JOIN_ADDR_MAX][JOIN_ADDR_SIZE];
+  struct request rq;
+  struct entry en;
+  struct entry* mat;
+  const char* beg;
+  const char* end;
+  uint64_t last;
+  uint64_t nrow;
+  uint64_t nmat;
+  uint64_t nbad;
+  uint64_t nskip;
+  uint64_t tbeg;
+  uint64_t naddr;
+  bool known;
+  bool pend;
+  bool retb;
+
+  (void)printf("key,seq_num,host_req,host_res,addr_res,status,"
+               "real_dep_req,real_arr_res,real_dep_res,real_arr_req,"
+               "delay_fwd,dwell,delay_bwd,loss\n");
+
+  last  = 0;
+  nrow  = 0;
+  nmat  = 0;
+  nbad  = 0;
+  nskip = 0;
+  pend  = false;
+  naddr = cf->cf_naddr;
+  (void)memcpy(addr, cf->cf_addr, sizeof(addr));
+  tbeg  = mono_now();
+
+  while (true) {
+    retb = read_line(req, &beg, &end);
+    if (retb == false) {
+      return false;
+    }
+
+    // End of the report.
+    if (beg == NULL) {
+      break;
+    }
+
+    // Skip the header and the empty lines.
+    if (beg == end || *beg < '0' || *beg > '9') {
+      continue;
+    }
+
+    retb = parse_request(&rq, beg, end);
+    if (retb == false) {
+      nbad++;
+      continue;
+    }
+
+    // Requests sent to other responders can not be matched.
+    known = find_address(addr, naddr, &rq);
+    if (cf->cf_naddr > 0 && known == false) {
+      nskip++;
+      continue;
+    }
+
+    // Lost requests are reported after their deadline, and therefore the
+    // window follows the latest departure.
+    if (rq.rq_dreq > last) {
+      last = rq.rq_dreq;
+    }
+
+    retb = load_responses(wn, res, &en, &pend, &nbad, last + cf->cf_win);
+    if (retb == false) {
+      return false;
+    }
+
+    mat = NULL;
+    if (rq.rq_hres != NULL || known == true) {
+      mat = find_entry(wn, &rq);
+    }
+
+    if (mat != NULL) {
+      nmat++;
+
+      // Learn the address under which the responder was reached.
+      if (known == false && naddr < JOIN_ADDR_MAX) {
+        (void)memcpy(addr[naddr], rq.rq_addr, rq.rq_alen);
+        addr[naddr][rq.rq_alen] = '\0';
+        naddr++;
+      }
+    }
+
+    write_row(stdout, &rq, mat);
+    nrow++;
+  }
+
+  // Account for the responder rows that were never loaded.
+  retb = load_responses(wn, res, &en, &pend, &nbad, UINT64_MAX);
+  if (retb == false) {
+    return false;
+  }
+  flush_window(wn);
+
+  if (nbad > 0) {
+    log(LL_WARN, false, "skipped %" PRIu64 " malformed lines", nbad);
+  }
+  if (wn->wn_nold > 0) {
+    log(LL_WARN, false, "skipped %" PRIu64 " responder rows that arrived after "
+        "their window", wn->wn_nold);
+  }
+
+  log(LL_INFO, false, "joined %" PRIu64 " of %" PRIu64 " requester rows in %.3fs, "
+      "skipped %" PRIu64 " rows of other responders, %" PRIu64 " of %" PRIu64
+      " responder rows were not matched", nmat, nrow,
+      (double)(mono_now() - tbeg) / 1e9, nskip, wn->wn_nunm, wn->wn_nins);
+
+  return true;
+}
+
+/// Join of the requester and responder reports. The joined rows are printed
+/// to the standard output in the order of the requester report.
+int
+main(int argc, char* argv[])
+{
+  struct config cf;
+  struct reader req;
+  struct reader res;
+  struct window wn;
+  bool retb;
+
+  log_lvl = LL_WARN;
+  log_col = isatty(STDERR_FILENO) == 1;
+
+  retb = parse_config(&cf, argc, argv);
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to parse the configuration");
+    return EXIT_FAILURE;
+  }
+
+  if (cf.cf_verb == true) {
+    log_lvl = LL_INFO;
+  }
+
+  retb = open_reader(&req, cf.cf_req);
+  if (retb == false) {
+    return EXIT_FAILURE;
+  }
+
+  retb = open_reader(&res, cf.cf_res);
+  if (retb == false) {
+    close_reader(&req);
+    return EXIT_FAILURE;
+  }
+
+  retb = create_window(&wn, cf.cf_win);
+  if (retb == true) {
+    retb = join_reports(&req, &res, &wn, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to join the reports");
+    }
+
+    delete_window(&wn);
+  }
+
+  close_reader(&res);
+  close_reader(&req);
+
+  if (fflush(stdout) == EOF) {
+    log(LL_ERROR, true, "unable to write the joined rows");
+    retb = false;
+  }
+
+  return retb == true ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "join/funcs.h"
+#include "join/types.h"
+#include "common/field.h"
+
+
+// Columns of the requester report that are joined.
+#define REQ_KEY          0
+#define REQ_SEQ_NUM      2
+#define REQ_HOST_REQ     4
+#define REQ_HOST_RES     5
+#define REQ_ADDR_RES     6
+#define REQ_REAL_DEP_REQ 12
+#define REQ_REAL_ARR_RES 13
+#define REQ_REAL_ARR_REQ 14
+#define REQ_STATUS       19
+
+// Columns of the responder report that are joined.
+#define RES_KEY          0
+#define RES_SEQ_NUM      2
+#define RES_HOST_REQ     4
+#define RES_HOST_RES     7
+#define RES_REAL_ARR_RES 11
+#define RES_REAL_DEP_RES 14
+#define RES_MONO_DEP_RES 15
+
+/// Determine whether a field is not available.
+/// @return availability of the field
+///
+/// @param[in] beg first byte of the field
+/// @param[in] end byte after the last one
+static bool
+is_missing(const char* beg, const char* end)
+{
+  return end - beg == 3 && memcmp(beg, "N/A", 3) == 0;
+}
+
+/// Parse a time-stamp that can be reported as not available.
+/// @return success/failure indication
+///
+/// @param[out] out time-stamp (0 if not available)
+/// @param[in]  beg first byte of the field
+/// @param[in]  end byte after the last one
+static bool
+parse_time(uint64_t* out, const char* beg, const char* end)
+{
+  if (is_missing(beg, end) == true) {
+    *out = 0;
+    return true;
+  }
+
+  return parse_digits(out, beg, end);
+}
+
+/// Parse the relevant fields of a requester report line.
+/// @return success/failure indication
+///
+/// @param[out] rq  relevant fields of the line
+/// @param[in]  beg first byte of the line
+/// @param[in]  end byte after the last one, excluding the line feed
+bool
+parse_request(struct request* rq, const char* beg, const char* end)
+{
+  const char* sep[REQ_STATUS];
+  uint8_t nsep;
+  bool retb;
+
+  nsep = find_separators(sep, REQ_STATUS, beg, end);
+  if (nsep != REQ_STATUS) {
+    return false;
+  }
+
+  retb = parse_digits(&rq->rq_key, beg, sep[REQ_KEY]);
+  if (retb == false) {
+    return false;
+  }
+
+  retb = parse_digits(&rq->rq_seq, sep[REQ_SEQ_NUM - 1] + 1, sep[REQ_SEQ_NUM]);
+  if (retb == false) {
+    return false;
+  }
+
+  rq->rq_hreq = sep[REQ_HOST_REQ - 1] + 1;
+  rq->rq_hrql = (size_t)(sep[REQ_HOST_REQ] - rq->rq_hreq);
+  if (rq->rq_hrql > NEMO_HOST_NAME_SIZE) {
+    return false;
+  }
+
+  // Lost requests do not know the name of the responder.
+  rq->rq_hres = sep[REQ_HOST_RES - 1] + 1;
+  rq->rq_hrsl = (size_t)(sep[REQ_HOST_RES] - rq->rq_hres);
+  if (rq->rq_hrsl > NEMO_HOST_NAME_SIZE) {
+    return false;
+  }
+  if (is_missing(rq->rq_hres, sep[REQ_HOST_RES]) == true) {
+    rq->rq_hres = NULL;
+    rq->rq_hrsl = 0;
+  }
+
+  rq->rq_addr = sep[REQ_ADDR_RES - 1] + 1;
+  rq->rq_alen = (size_t)(sep[REQ_ADDR_RES] - rq->rq_addr);
+  if (rq->rq_alen >= JOIN_ADDR_SIZE) {
+    return false;
+  }
+
+  retb = parse_digits(&rq->rq_dreq, sep[REQ_REAL_DEP_REQ - 1] + 1, sep[REQ_REAL_DEP_REQ]);
+  if (retb == false) {
+    return false;
+  }
+
+  retb = parse_time(&rq->rq_areq, sep[REQ_REAL_ARR_RES - 1] + 1, sep[REQ_REAL_ARR_RES]);
+  if (retb == false) {
+    return false;
+  }
+
+  retb = parse_time(&rq->rq_ares, sep[REQ_REAL_ARR_REQ - 1] + 1, sep[REQ_REAL_ARR_REQ]);
+  if (retb == false) {
+    return false;
+  }
+
+  rq->rq_stat = sep[REQ_STATUS - 1] + 1;
+  rq->rq_slen = (size_t)(end - rq->rq_stat);
+
+  return true;
+}
+
+/// Parse the relevant fields of a responder report line.
+/// @return success/failure indication
+///
+/// @param[out] en  entry of the window
+/// @param[in]  beg first byte of the line
+/// @param[in]  end byte after the last one, excluding the line feed
+bool
+parse_response(struct entry* en, const char* beg, const char* end)
+{
+  const char* sep[RES_MONO_DEP_RES];
+  const char* str;
+  size_t len;
+  uint8_t nsep;
+  bool retb;
+
+  nsep = find_separators(sep, RES_MONO_DEP_RES, beg, end);
+  if (nsep != RES_MONO_DEP_RES) {
+    return false;
+  }
+
+  (void)memset(en, 0, sizeof(*en));
+
+  retb = parse_digits(&en->en_key, beg, sep[RES_KEY]);
+  if (retb == false) {
+    return false;
+  }
+
+  retb = parse_digits(&en->en_seq, sep[RES_SEQ_NUM - 1] + 1, sep[RES_SEQ_NUM]);
+  if (retb == false) {
+    return false;
+  }
+
+  str = sep[RES_HOST_REQ - 1] + 1;
+  len = (size_t)(sep[RES_HOST_REQ] - str);
+  if (len > NEMO_HOST_NAME_SIZE) {
+    return false;
+  }
+  (void)memcpy(en->en_hreq, str, len);
+
+  str = sep[RES_HOST_RES - 1] + 1;
+  len = (size_t)(sep[RES_HOST_RES] - str);
+  if (len > NEMO_HOST_NAME_SIZE) {
+    return false;
+  }
+  (void)memcpy(en->en_hres, str, len);
+
+  retb = parse_digits(&en->en_areq, sep[RES_REAL_ARR_RES - 1] + 1, sep[RES_REAL_ARR_RES]);
+  if (retb == false) {
+    return false;
+  }
+
+  // Responses that were not sent have no departure.
+  return parse_time(&en->en_dres, sep[RES_REAL_DEP_RES - 1] + 1, sep[RES_REAL_DEP_RES]);
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "join/funcs.h"
+#include "join/types.h"
+#include "common/log.h"
+
+
+/// Open a report for sequential reading. The report is read through a buffer
+/// of constant size, so that reports larger than the memory can be joined,
+/// including those arriving through a pipe.
+/// @return success/failure indication
+///
+/// @param[out] rd   reader
+/// @param[in]  path path to the report (- for the standard input)
+bool
+open_reader(struct reader* rd, const char* path)
+{
+  (void)memset(rd, 0, sizeof(*rd));
+  rd->rd_path = path;
+
+  if (strcmp(path, "-") == 0) {
+    rd->rd_fd = STDIN_FILENO;
+  } else {
+    rd->rd_fd = open(path, O_RDONLY);
+    if (rd->rd_fd == -1) {
+      log(LL_WARN, true, "unable to open the report %s", path);
+      return false;
+    }
+
+    // The report is read from the start to the end exactly once.
+    (void)posix_fadvise(rd->rd_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  rd->rd_buf = malloc(JOIN_BUFFER_SIZE);
+  if (rd->rd_buf == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the report buffer");
+    close_reader(rd);
+    return false;
+  }
+
+  return true;
+}
+
+/// Fill the free space of the buffer, moving the unread data to its start.
+/// @return success/failure indication
+///
+/// @param[in] rd reader
+static bool
+fill_buffer(struct reader* rd)
+{
+  ssize_t n;
+
+  if (rd->rd_beg > 0) {
+    (void)memmove(rd->rd_buf, rd->rd_buf + rd->rd_beg, rd->rd_end - rd->rd_beg);
+    rd->rd_end -= rd->rd_beg;
+    rd->rd_beg  = 0;
+  }
+
+  do {
+    n = read(rd->rd_fd, rd->rd_buf + rd->rd_end, JOIN_BUFFER_SIZE - rd->rd_end);
+  } while (n == -1 && errno == EINTR);
+
+  if (n == -1) {
+    log(LL_WARN, true, "unable to read the report %s", rd->rd_path);
+    return false;
+  }
+
+  if (n == 0) {
+    rd->rd_eof = true;
+  }
+  rd->rd_end += (size_t)n;
+
+  return true;
+}
+
+/// Obtain the next line of a report. The line is valid until the following
+/// call. A line that does not fit into the buffer is split into multiple
+/// ones, which are then rejected by the parsers.
+/// @return success/failure indication
+///
+/// @param[in]  rd  reader
+/// @param[out] beg first byte of the line (NULL at the end of the report)
+/// @param[out] end byte after the last one, excluding the line feed
+bool
+read_line(struct reader* rd, const char** beg, const char** end)
+{
+  const char* eol;
+  bool retb;
+
+  while (true) {
+    eol = memchr(rd->rd_buf + rd->rd_beg, '\n', rd->rd_end - rd->rd_beg);
+    if (eol != NULL) {
+      break;
+    }
+
+    // The last line of the report does not have to be terminated.
+    if (rd->rd_eof == true || (rd->rd_beg == 0 && rd->rd_end == JOIN_BUFFER_SIZE)) {
+      if (rd->rd_beg == rd->rd_end) {
+        *beg = NULL;
+        *end = NULL;
+        return true;
+      }
+
+      *beg = rd->rd_buf + rd->rd_beg;
+      *end = rd->rd_buf + rd->rd_end;
+      rd->rd_beg = rd->rd_end;
+      return true;
+    }
+
+    retb = fill_buffer(rd);
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  *beg = rd->rd_buf + rd->rd_beg;
+  *end = eol;
+  rd->rd_beg = (size_t)(eol - rd->rd_buf) + 1;
+
+  return true;
+}
+
+/// Release the resources of a reader.
+///
+/// @param[in] rd reader
+void
+close_reader(struct reader* rd)
+{
+  if (rd->rd_fd != STDIN_FILENO && rd->rd_fd != -1) {
+    (void)close(rd->rd_fd);
+  }
+
+  free(rd->rd_buf);
+  rd->rd_buf = NULL;
+  rd->rd_fd  = -1;
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_JOIN_TYPES_H
+#define NEMO_JOIN_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "common/payload.h"
+
+
+// Number of generations of responder rows retained in the window. The rows
+// are loaded up to one generation ahead of the latest requester row, and the
+// requester rows can lag one generation behind the latest one.
+#define JOIN_GEN_CNT 4
+
+// Initial number of entries of a generation.
+#define JOIN_TABLE_INIT 1024
+
+// Size of the input buffer of a report.
+#define JOIN_BUFFER_SIZE (1ULL << 20)
+
+// Size of the textual address, including the terminating byte.
+#define JOIN_ADDR_SIZE 48
+
+// Maximal number of addresses of the responder.
+#define JOIN_ADDR_MAX 16
+
+/// Join configuration.
+struct config {
+  uint64_t    cf_win;   ///< Width of the time window.
+  const char* cf_req;   ///< Requester report.
+  const char* cf_res;   ///< Responder report.
+  char        cf_addr[JOIN_ADDR_MAX][JOIN_ADDR_SIZE]; ///< Responder addresses.
+  uint64_t    cf_naddr; ///< Number of responder addresses.
+  bool        cf_verb;  ///< Report the join statistics.
+  uint8_t     cf_pad[7]; ///< Padding (unused).
+};
+
+/// Buffered sequential reader of a report.
+struct reader {
+  char*       rd_buf;  ///< Buffer.
+  const char* rd_path; ///< Path to the report.
+  size_t      rd_beg;  ///< Start of the unread data.
+  size_t      rd_end;  ///< End of the buffered data.
+  int         rd_fd;   ///< File descriptor.
+  bool        rd_eof;  ///< End of the report was reached.
+  uint8_t     rd_pad[3]; ///< Padding (unused).
+};
+
+/// Relevant fields of a requester report line. The strings point into the
+/// report and are not terminated.
+struct request {
+  const char* rq_hreq; ///< Host name of the requester.
+  const char* rq_hres; ///< Host name of the responder (NULL if unknown).
+  const char* rq_addr; ///< Address of the responder.
+  const char* rq_stat; ///< Status of the request.
+  size_t      rq_hrql; ///< Length of the requester host name.
+  size_t      rq_hrsl; ///< Length of the responder host name.
+  size_t      rq_alen; ///< Length of the address.
+  size_t      rq_slen; ///< Length of the status.
+  uint64_t    rq_key;  ///< Key.
+  uint64_t    rq_seq;  ///< Sequence number.
+  uint64_t    rq_dreq; ///< Real-time departure of the request.
+  uint64_t    rq_areq; ///< Real-time arrival of the request (0 if unknown).
+  uint64_t    rq_ares; ///< Real-time arrival of the response (0 if unknown).
+};
+
+/// Responder report line retained in the window. The host names are padded
+/// with zero bytes, so that they can be compared as a whole.
+struct entry {
+  char     en_hreq[NEMO_HOST_NAME_SIZE]; ///< Host name of the requester.
+  char     en_hres[NEMO_HOST_NAME_SIZE]; ///< Host name of the responder.
+  uint64_t en_hash; ///< Hash of the requester host name and sequence number.
+  uint64_t en_key;  ///< Key of the requester.
+  uint64_t en_seq;  ///< Sequence number.
+  uint64_t en_areq; ///< Real-time arrival of the request.
+  uint64_t en_dres; ///< Real-time departure of the response (0 if not sent).
+  bool     en_used; ///< Slot occupancy.
+  bool     en_mat;  ///< Entry was matched by a requester row.
+  uint8_t  en_pad[6]; ///< Padding (unused).
+};
+
+/// Open-addressing hash table of the responder rows that arrived within a
+/// single generation of the window.
+struct table {
+  struct entry* tb_ent; ///< Entries.
+  uint64_t      tb_cap; ///< Number of slots (power of two).
+  uint64_t      tb_cnt; ///< Number of used slots.
+  uint64_t      tb_gen; ///< Generation.
+};
+
+/// Time-bounded window of the responder rows. Each generation covers the
+/// width of the window and is dropped as a whole once the requester rows
+/// advance past it, so that the memory usage is bounded by the request rate
+/// rather than by the length of the reports.
+struct window {
+  struct table wn_tb[JOIN_GEN_CNT]; ///< Generations.
+  uint64_t     wn_width; ///< Width of a generation.
+  uint64_t     wn_nins;  ///< Number of inserted rows.
+  uint64_t     wn_nunm;  ///< Number of dropped rows that were not matched.
+  uint64_t     wn_nold;  ///< Number of rows that arrived after their generation.
+};
+
+#endif
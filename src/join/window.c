@@ -0,0 +1,298 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "join/funcs.h"
+#include "join/types.h"
+#include "common/log.h"
+
+
+/// Allocate an empty window.
+/// @return success/failure indication
+///
+/// @param[out] wn    window
+/// @param[in]  width width of a generation
+bool
+create_window(struct window* wn, const uint64_t width)
+{
+  struct table* tb;
+  uint64_t i;
+
+  (void)memset(wn, 0, sizeof(*wn));
+  wn->wn_width = width;
+
+  for (i = 0; i < JOIN_GEN_CNT; i++) {
+    tb = &wn->wn_tb[i];
+    tb->tb_cap = JOIN_TABLE_INIT;
+    tb->tb_ent = calloc((size_t)tb->tb_cap, sizeof(*tb->tb_ent));
+    if (tb->tb_ent == NULL) {
+      log(LL_WARN, true, "unable to allocate memory for the window");
+      delete_window(wn);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Release the resources of a window.
+///
+/// @param[in] wn window
+void
+delete_window(struct window* wn)
+{
+  uint64_t i;
+
+  for (i = 0; i < JOIN_GEN_CNT; i++) {
+    free(wn->wn_tb[i].tb_ent);
+    wn->wn_tb[i].tb_ent = NULL;
+    wn->wn_tb[i].tb_cap = 0;
+    wn->wn_tb[i].tb_cnt = 0;
+  }
+}
+
+/// Hash the requester host name and the sequence number of a request.
+/// @return hash value
+///
+/// @param[in] host host name padded with zero bytes
+/// @param[in] seq  sequence number
+static uint64_t
+hash_request(const char host[static NEMO_HOST_NAME_SIZE], const uint64_t seq)
+{
+  uint64_t word;
+  uint64_t h;
+  size_t i;
+
+  // The host name is a multiple of eight bytes, so that it is mixed word by
+  // word.
+  h = seq * 0x9e3779b97f4a7c15ULL;
+  for (i = 0; i < NEMO_HOST_NAME_SIZE; i += sizeof(word)) {
+    __builtin_memcpy(&word, host + i, sizeof(word));
+    h = (h ^ word) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+
+  return h;
+}
+
+/// Find the first empty slot for an entry.
+/// @return empty slot
+///
+/// @param[in] tb   table
+/// @param[in] hash hash of the entry
+static struct entry*
+find_empty(const struct table* tb, const uint64_t hash)
+{
+  struct entry* en;
+  uint64_t i;
+
+  // The table is never full, so that the probing always terminates.
+  for (i = hash;; i++) {
+    en = &tb->tb_ent[i & (tb->tb_cap - 1)];
+    if (en->en_used == false) {
+      return en;
+    }
+  }
+}
+
+/// Double the capacity of a table.
+/// @return success/failure indication
+///
+/// @param[in] tb table
+static bool
+grow_table(struct table* tb)
+{
+  struct table old;
+  struct entry* en;
+  uint64_t i;
+
+  old = *tb;
+  tb->tb_cap = old.tb_cap * 2;
+  tb->tb_ent = calloc((size_t)tb->tb_cap, sizeof(*tb->tb_ent));
+  if (tb->tb_ent == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the window");
+    *tb = old;
+    return false;
+  }
+
+  for (i = 0; i < old.tb_cap; i++) {
+    if (old.tb_ent[i].en_used == false) {
+      continue;
+    }
+
+    en  = find_empty(tb, old.tb_ent[i].en_hash);
+    *en = old.tb_ent[i];
+  }
+
+  free(old.tb_ent);
+  return true;
+}
+
+/// Drop all entries of a table, accounting for those that were not matched.
+/// The capacity of the table is retained for the following generation.
+///
+/// @param[in] wn window
+/// @param[in] tb table
+static void
+expire_table(struct window* wn, struct table* tb)
+{
+  uint64_t i;
+
+  if (tb->tb_cnt == 0) {
+    return;
+  }
+
+  for (i = 0; i < tb->tb_cap; i++) {
+    if (tb->tb_ent[i].en_used == true && tb->tb_ent[i].en_mat == false) {
+      wn->wn_nunm++;
+    }
+  }
+
+  (void)memset(tb->tb_ent, 0, (size_t)tb->tb_cap * sizeof(*tb->tb_ent));
+  tb->tb_cnt = 0;
+}
+
+/// Insert a responder row into the generation of its request arrival. The
+/// generation that previously occupied the table is dropped, and rows of
+/// generations that were already dropped are only counted.
+/// @return success/failure indication
+///
+/// @param[in] wn window
+/// @param[in] en entry
+bool
+insert_entry(struct window* wn, const struct entry* en)
+{
+  struct table* tb;
+  struct entry* slot;
+  uint64_t gen;
+  uint64_t hash;
+  bool retb;
+
+  gen = en->en_areq / wn->wn_width;
+  tb  = &wn->wn_tb[gen % JOIN_GEN_CNT];
+  if (tb->tb_gen > gen) {
+    wn->wn_nold++;
+    return true;
+  }
+
+  if (tb->tb_gen < gen) {
+    expire_table(wn, tb);
+    tb->tb_gen = gen;
+  }
+
+  // Keep the load factor at most one half, so that the probes remain short.
+  if (2 * (tb->tb_cnt + 1) > tb->tb_cap) {
+    retb = grow_table(tb);
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  hash  = hash_request(en->en_hreq, en->en_seq);
+  slot  = find_empty(tb, hash);
+  *slot = *en;
+  slot->en_hash = hash;
+  slot->en_used = true;
+  slot->en_mat  = false;
+  tb->tb_cnt++;
+  wn->wn_nins++;
+
+  return true;
+}
+
+/// Determine whether a responder row belongs to a requester row. The
+/// responder includes its key in the response only if it filters the requests
+/// by the key, and the requester does not know the responder of a lost
+/// request.
+/// @return match indication
+///
+/// @param[in] en    entry
+/// @param[in] rq    requester row
+/// @param[in] host  requester host name padded with zero bytes
+/// @param[in] width width of the window
+static bool
+match_entry(const struct entry* en,
+            const struct request* rq,
+            const char host[static NEMO_HOST_NAME_SIZE],
+            const uint64_t width)
+{
+  if (en->en_seq != rq->rq_seq
+   || memcmp(en->en_hreq, host, NEMO_HOST_NAME_SIZE) != 0) {
+    return false;
+  }
+
+  if (rq->rq_key != 0 && rq->rq_key != en->en_key) {
+    return false;
+  }
+
+  if (rq->rq_hres != NULL
+   && (memcmp(en->en_hres, rq->rq_hres, rq->rq_hrsl) != 0
+    || (rq->rq_hrsl < NEMO_HOST_NAME_SIZE && en->en_hres[rq->rq_hrsl] != '\0'))) {
+    return false;
+  }
+
+  // Sequence numbers start from zero with each run of the requester.
+  return en->en_areq + width >= rq->rq_dreq && en->en_areq <= rq->rq_dreq + width;
+}
+
+/// Find the responder row of a requester row in all generations of the
+/// window. Matched entries are retained, so that the late and duplicate
+/// responses to the same request are joined as well.
+/// @return entry (or NULL)
+///
+/// @param[in] wn window
+/// @param[in] rq requester row
+struct entry*
+find_entry(struct window* wn, const struct request* rq)
+{
+  char host[NEMO_HOST_NAME_SIZE];
+  struct table* tb;
+  struct entry* en;
+  uint64_t hash;
+  uint64_t i;
+  uint64_t k;
+
+  (void)memset(host, 0, sizeof(host));
+  (void)memcpy(host, rq->rq_hreq, rq->rq_hrql);
+  hash = hash_request(host, rq->rq_seq);
+
+  for (k = 0; k < JOIN_GEN_CNT; k++) {
+    tb = &wn->wn_tb[k];
+    if (tb->tb_cnt == 0) {
+      continue;
+    }
+
+    for (i = hash;; i++) {
+      en = &tb->tb_ent[i & (tb->tb_cap - 1)];
+      if (en->en_used == false) {
+        break;
+      }
+
+      if (en->en_hash == hash && match_entry(en, rq, host, wn->wn_width) == true) {
+        en->en_mat = true;
+        return en;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/// Drop all generations of the window, accounting for the entries that were
+/// not matched.
+///
+/// @param[in] wn window
+void
+flush_window(struct window* wn)
+{
+  uint64_t i;
+
+  for (i = 0; i < JOIN_GEN_CNT; i++) {
+    expire_table(wn, &wn->wn_tb[i]);
+  }
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "agg/funcs.h"
+#include "agg/types.h"
+#include "common/log.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+// Number of distinct responders in the aggregated lines.
+#define BENCH_RESPONDERS 16
+
+// Length of a report line buffer.
+#define BENCH_LINE_SIZE 256
+
+// Destination of the measured values, so that the calls are not elided.
+static volatile uint64_t sink;
+
+/// State of the aggregation operations.
+struct aggregator {
+  char          ag_buf[BENCH_BATCH][BENCH_LINE_SIZE]; ///< Report lines.
+  size_t        ag_len[BENCH_BATCH]; ///< Lengths of the report lines.
+  struct line   ag_ln[BENCH_BATCH];  ///< Parsed report lines.
+  struct table  ag_tb;               ///< Aggregates.
+  struct config ag_cf;               ///< Configuration.
+};
+
+/// Parse a batch of report lines.
+///
+/// @param[in] arg state of the aggregation operations
+/// @param[in] n   number of lines
+static void
+batch_parse(void* arg, const uint64_t n)
+{
+  struct aggregator* ag;
+  uint64_t i;
+  bool retb;
+
+  ag = arg;
+  for (i = 0; i < n; i++) {
+    retb = parse_line(&ag->ag_ln[i], ag->ag_buf[i], ag->ag_buf[i] + ag->ag_len[i]);
+    sink = retb;
+  }
+}
+
+/// Account for a batch of parsed report lines in their aggregates.
+///
+/// @param[in] arg state of the aggregation operations
+/// @param[in] n   number of lines
+static void
+batch_aggregate(void* arg, const uint64_t n)
+{
+  struct aggregator* ag;
+  uint64_t i;
+  bool retb;
+
+  ag = arg;
+  for (i = 0; i < n; i++) {
+    retb = aggregate_line(&ag->ag_tb, &ag->ag_ln[i], &ag->ag_cf);
+    sink = retb;
+  }
+}
+
+/// Measure the cost of the report aggregation: parsing of a report line and
+/// its accounting in the table of aggregates.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_agg(const char* flt)
+{
+  static struct aggregator ag;
+  struct bench bn[2];
+  uint64_t dep;
+  uint64_t i;
+  int reti;
+  bool retb;
+
+  (void)memset(&ag, 0, sizeof(ag));
+  ag.ag_cf.cf_bkt = 60000000000ULL;
+
+  // Timely responses of a single requester, spread over the responders.
+  for (i = 0; i < BENCH_BATCH; i++) {
+    dep  = 1500000000000000000ULL + i * 1000000;
+    reti = snprintf(ag.ag_buf[i], sizeof(ag.ag_buf[i]),
+                    "1,128,%" PRIu64 ",0,requester.example.com,responder,"
+                    "10.0.0.%" PRIu64 ",23000,64,62,64,61,%" PRIu64 ",%" PRIu64
+                    ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",ok",
+                    i, i % BENCH_RESPONDERS, dep, dep + 250000, dep + 500000,
+                    dep, dep + 250000, dep + 500000, 500000 + i);
+    if (reti < 0 || (size_t)reti >= sizeof(ag.ag_buf[i])) {
+      log(LL_WARN, false, "unable to format the report line");
+      return false;
+    }
+    ag.ag_len[i] = (size_t)reti;
+
+    retb = parse_line(&ag.ag_ln[i], ag.ag_buf[i], ag.ag_buf[i] + ag.ag_len[i]);
+    if (retb == false) {
+      log(LL_WARN, false, "unable to parse the report line");
+      return false;
+    }
+  }
+
+  retb = create_table(&ag.ag_tb);
+  if (retb == false) {
+    return false;
+  }
+
+  bn[0].bn_name = "agg.parse_line";
+  bn[0].bn_fn   = batch_parse;
+  bn[0].bn_arg  = &ag;
+  bn[0].bn_out  = false;
+  bn[1].bn_name = "agg.aggregate_line";
+  bn[1].bn_fn   = batch_aggregate;
+  bn[1].bn_arg  = &ag;
+  bn[1].bn_out  = false;
+
+  retb = run_suite(bn, 2, flt);
+  delete_table(&ag.ag_tb);
+
+  return retb;
+}
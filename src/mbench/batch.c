@@ -0,0 +1,216 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <string.h>
+
+#include "common/batch.h"
+#include "common/log.h"
+#include "common/packet.h"
+#include "common/payload.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+// Destination of the measured values, so that the calls are not elided.
+static volatile uint64_t sink;
+
+/// State of the batch operations.
+struct batch {
+  struct payload bt_src[BENCH_BATCH]; ///< Payloads in the host byte order.
+  struct payload bt_dst[BENCH_BATCH]; ///< Payloads in the network byte order.
+  struct payload bt_ref[BENCH_BATCH]; ///< Reference and decoded payloads.
+  uint8_t        bt_st[BENCH_BATCH];  ///< Verification outcomes.
+};
+
+/// Benchmarked codec.
+struct codec {
+  struct batch* cd_bt;  ///< Shared state of the batch operations.
+  uint8_t       cd_cdc; ///< Codec.
+};
+
+/// Encode a batch of payloads.
+///
+/// @param[in] arg benchmarked codec
+/// @param[in] n   number of payloads
+static void
+batch_encode(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+
+  cd = arg;
+  (void)select_codec(cd->cd_cdc);
+  encode_batch(cd->cd_bt->bt_dst, cd->cd_bt->bt_src, n);
+  sink = cd->cd_bt->bt_dst[0].pl_snum;
+}
+
+/// Decode and verify a batch of payloads.
+///
+/// @param[in] arg benchmarked codec
+/// @param[in] n   number of payloads
+static void
+batch_decode(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+
+  cd = arg;
+  (void)select_codec(cd->cd_cdc);
+  sink = decode_batch(cd->cd_bt->bt_ref, cd->cd_bt->bt_st, cd->cd_bt->bt_dst, n);
+}
+
+/// Generate payloads with varied contents. Every seventh payload has its magic
+/// identifier damaged and every eleventh one claims the compact format, so
+/// that the verification outcomes are exercised as well.
+///
+/// @param[out] pl payloads in the host byte order
+/// @param[in]  n  number of payloads
+static void
+generate_payloads(struct payload* pl, const uint64_t n)
+{
+  uint64_t x;
+  uint64_t i;
+  uint8_t* b;
+  size_t k;
+
+  x = 0x9e3779b97f4a7c15ULL;
+  for (i = 0; i < n; i++) {
+    // Fill the whole payload with the xorshift sequence, including the host
+    // name and the padding that are expected to be passed through unchanged.
+    b = (uint8_t*)&pl[i];
+    for (k = 0; k < sizeof(pl[i]); k++) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      b[k] = (uint8_t)x;
+    }
+
+    pl[i].pl_mgic = NEMO_PAYLOAD_MAGIC;
+    pl[i].pl_fver = NEMO_PAYLOAD_VERSION_FULL;
+    if (i % 7 == 3) {
+      pl[i].pl_mgic = 0x1234;
+    }
+    if (i % 11 == 5) {
+      pl[i].pl_fver = NEMO_PAYLOAD_VERSION_COMPACT;
+    }
+  }
+}
+
+/// Ensure that a codec produces the same results as the per-payload scalar
+/// conversions.
+/// @return success/failure indication
+///
+/// @param[in] bt  state of the batch operations
+/// @param[in] cdc codec
+static bool
+cross_check(struct batch* bt, const uint8_t cdc)
+{
+  uint64_t nval;
+  uint64_t exp;
+  uint64_t i;
+  uint8_t st;
+  int reti;
+
+  (void)select_codec(cdc);
+
+  // Compare the encoded payloads.
+  encode_batch(bt->bt_dst, bt->bt_src, BENCH_BATCH);
+  for (i = 0; i < BENCH_BATCH; i++) {
+    encode_payload(&bt->bt_ref[i], &bt->bt_src[i]);
+  }
+
+  reti = memcmp(bt->bt_dst, bt->bt_ref, sizeof(bt->bt_dst));
+  if (reti != 0) {
+    log(LL_WARN, false, "codec %s encodes payloads incorrectly", codec_name(cdc));
+    return false;
+  }
+
+  // Compare the decoded payloads and their verification outcomes.
+  nval = decode_batch(bt->bt_ref, bt->bt_st, bt->bt_dst, BENCH_BATCH);
+  reti = memcmp(bt->bt_ref, bt->bt_src, sizeof(bt->bt_ref));
+  if (reti != 0) {
+    log(LL_WARN, false, "codec %s decodes payloads incorrectly", codec_name(cdc));
+    return false;
+  }
+
+  exp = 0;
+  for (i = 0; i < BENCH_BATCH; i++) {
+    st = BATCH_VALID;
+    if (bt->bt_src[i].pl_mgic != NEMO_PAYLOAD_MAGIC) {
+      st = BATCH_MAGIC;
+    } else if (bt->bt_src[i].pl_fver != NEMO_PAYLOAD_VERSION_FULL) {
+      st = BATCH_VERSION;
+    } else {
+      exp++;
+    }
+
+    if (bt->bt_st[i] != st) {
+      log(LL_WARN, false, "codec %s verifies payloads incorrectly", codec_name(cdc));
+      return false;
+    }
+  }
+
+  if (nval != exp) {
+    log(LL_WARN, false, "codec %s counts valid payloads incorrectly", codec_name(cdc));
+    return false;
+  }
+
+  return true;
+}
+
+/// Measure the cost of the batch payload conversions with each codec that is
+/// supported by the CPU, after verifying their correctness.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_batch(const char* flt)
+{
+  static const char* encn[] = {
+    "batch.encode.scalar", "batch.encode.ssse3", "batch.encode.avx2"};
+  static const char* decn[] = {
+    "batch.decode.scalar", "batch.decode.ssse3", "batch.decode.avx2"};
+  static struct batch bt;
+  struct codec cd[3];
+  struct bench bn[6];
+  uint8_t best;
+  uint8_t cdc;
+  uint64_t nbn;
+  bool retb;
+
+  generate_payloads(bt.bt_src, BENCH_BATCH);
+
+  nbn  = 0;
+  best = best_codec();
+  for (cdc = BATCH_CODEC_SCALAR; cdc <= best; cdc++) {
+    retb = cross_check(&bt, cdc);
+    if (retb == false) {
+      return false;
+    }
+
+    cd[cdc].cd_bt  = &bt;
+    cd[cdc].cd_cdc = cdc;
+
+    bn[nbn].bn_name = encn[cdc];
+    bn[nbn].bn_fn   = batch_encode;
+    bn[nbn].bn_arg  = &cd[cdc];
+    bn[nbn].bn_out  = false;
+    nbn++;
+
+    bn[nbn].bn_name = decn[cdc];
+    bn[nbn].bn_fn   = batch_decode;
+    bn[nbn].bn_arg  = &cd[cdc];
+    bn[nbn].bn_out  = false;
+    nbn++;
+  }
+
+  // Prepare the encoded payloads for the decoding benchmarks.
+  (void)select_codec(BATCH_CODEC_SCALAR);
+  encode_batch(bt.bt_dst, bt.bt_src, BENCH_BATCH);
+
+  retb = run_suite(bn, nbn, flt);
+  (void)select_codec(BATCH_CODEC_SCALAR);
+
+  return retb;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdio.h>
+
+#include "common/log.h"
+#include "common/now.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+// Destination of the measured values, so that the calls are not elided.
+static volatile uint64_t sink;
+
+/// Obtain a batch of monotonic timestamps.
+///
+/// @param[in] arg unused
+/// @param[in] n   number of timestamps
+static void
+batch_mono(void* arg, const uint64_t n)
+{
+  uint64_t i;
+
+  (void)arg;
+  for (i = 0; i < n; i++) {
+    sink = mono_now();
+  }
+}
+
+/// Obtain a batch of real-time timestamps.
+///
+/// @param[in] arg unused
+/// @param[in] n   number of timestamps
+static void
+batch_real(void* arg, const uint64_t n)
+{
+  uint64_t i;
+
+  (void)arg;
+  for (i = 0; i < n; i++) {
+    sink = real_now();
+  }
+}
+
+/// Measure the cost of a timestamp for all clock sources.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_clock(const char* flt)
+{
+  struct bench bn[2];
+  char name[2][64];
+  uint8_t clk;
+  bool retb;
+
+  for (clk = NOW_CLOCK_SYSTEM; clk <= NOW_CLOCK_TSC; clk++) {
+    // An unsupported clock source is not an error of the measurement.
+    retb = select_clock(clk);
+    if (retb == false) {
+      log(LL_WARN, false, "skipping the %s clock source", clock_name(clk));
+      continue;
+    }
+
+    (void)snprintf(name[0], sizeof(name[0]), "clock.%s.mono_now", clock_name(clk));
+    (void)snprintf(name[1], sizeof(name[1]), "clock.%s.real_now", clock_name(clk));
+    bn[0].bn_name = name[0];
+    bn[0].bn_fn   = batch_mono;
+    bn[0].bn_arg  = NULL;
+    bn[0].bn_out  = false;
+    bn[1].bn_name = name[1];
+    bn[1].bn_fn   = batch_real;
+    bn[1].bn_arg  = NULL;
+    bn[1].bn_out  = false;
+
+    retb = run_suite(bn, 2, flt);
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  return select_clock(NOW_CLOCK_SYSTEM);
+}
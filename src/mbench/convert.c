@@ -0,0 +1,96 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <netinet/in.h>
+
+#include "common/convert.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+// Destination of the measured values, so that the calls are not elided.
+static volatile uint64_t sink;
+
+/// Convert a batch of 64-bit integers to the network byte order.
+///
+/// @param[in] arg unused
+/// @param[in] n   number of conversions
+static void
+batch_htonll(void* arg, const uint64_t n)
+{
+  uint64_t i;
+
+  (void)arg;
+  for (i = 0; i < n; i++) {
+    sink = htonll(i);
+  }
+}
+
+/// Split a batch of IPv6 addresses into their address bits.
+///
+/// @param[in] arg IPv6 address
+/// @param[in] n   number of conversions
+static void
+batch_fipv6(void* arg, const uint64_t n)
+{
+  const struct in6_addr* a6;
+  uint64_t lo;
+  uint64_t hi;
+  uint64_t i;
+
+  a6 = arg;
+  for (i = 0; i < n; i++) {
+    fipv6(&lo, &hi, *a6);
+    sink = lo ^ hi;
+  }
+}
+
+/// Assemble a batch of IPv6 addresses from their address bits.
+///
+/// @param[in] arg IPv6 address
+/// @param[in] n   number of conversions
+static void
+batch_tipv6(void* arg, const uint64_t n)
+{
+  struct in6_addr* a6;
+  uint64_t i;
+
+  a6 = arg;
+  for (i = 0; i < n; i++) {
+    tipv6(a6, i, ~i);
+    sink = a6->s6_addr[15];
+  }
+}
+
+/// Measure the cost of the byte order and address conversions.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_convert(const char* flt)
+{
+  static struct in6_addr a6;
+  struct bench bn[3];
+  uint8_t i;
+
+  for (i = 0; i < 16; i++) {
+    a6.s6_addr[i] = (uint8_t)(0x20 + i);
+  }
+
+  bn[0].bn_name = "convert.htonll";
+  bn[0].bn_fn   = batch_htonll;
+  bn[1].bn_name = "convert.fipv6";
+  bn[1].bn_fn   = batch_fipv6;
+  bn[2].bn_name = "convert.tipv6";
+  bn[2].bn_fn   = batch_tipv6;
+
+  for (i = 0; i < 3; i++) {
+    bn[i].bn_arg = &a6;
+    bn[i].bn_out = false;
+  }
+
+  return run_suite(bn, 3, flt);
+}
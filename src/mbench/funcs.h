@@ -0,0 +1,32 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_MBENCH_FUNCS_H
+#define NEMO_MBENCH_FUNCS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mbench/types.h"
+
+
+// Harness.
+bool run_bench(struct result* rs, const struct bench* bn);
+bool run_suite(const struct bench* bn, const uint64_t nbn, const char* flt);
+void print_header(void);
+void print_result(const struct bench* bn, const struct result* rs);
+
+// Suites.
+bool bench_agg(const char* flt);
+bool bench_batch(const char* flt);
+bool bench_clock(const char* flt);
+bool bench_convert(const char* flt);
+bool bench_log(const char* flt);
+bool bench_packet(const char* flt);
+bool bench_ureq(const char* flt);
+bool bench_ures(const char* flt);
+
+#endif
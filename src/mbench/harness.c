@@ -0,0 +1,224 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "common/convert.h"
+#include "common/log.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+// The time-stamp counter is only supported on the x86 architecture.
+#if defined(__x86_64__) || defined(__i386__)
+  #define BENCH_HAVE_TSC 1
+#else
+  #define BENCH_HAVE_TSC 0
+#endif
+
+/// Get the current monotonic time directly from the system, so that the
+/// measurement does not depend on any of the measured clock sources.
+/// @return time in nanoseconds
+static uint64_t
+bench_now(void)
+{
+  uint64_t ns;
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  tnanos(&ns, ts);
+
+  return ns;
+}
+
+/// Read the time-stamp counter, so that the measurement can be expressed in
+/// cycles as well.
+/// @return counter value (zero if not supported)
+static uint64_t
+bench_ticks(void)
+{
+#if BENCH_HAVE_TSC == 1
+  return (uint64_t)__builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/// Compare two durations.
+/// @return comparison result
+///
+/// @param[in] a first duration
+/// @param[in] b second duration
+static int
+compare_durations(const void* a, const void* b)
+{
+  uint64_t x;
+  uint64_t y;
+
+  x = *(const uint64_t*)a;
+  y = *(const uint64_t*)b;
+
+  if (x < y) {
+    return -1;
+  }
+
+  if (x > y) {
+    return 1;
+  }
+
+  return 0;
+}
+
+/// Measure the duration of an operation. The operation is executed in
+/// batches, so that the overhead of the time measurement is amortized, and
+/// the first batches are discarded to warm up the caches.
+/// @return success/failure indication
+///
+/// @param[out] rs result
+/// @param[in]  bn measured operation
+bool
+run_bench(struct result* rs, const struct bench* bn)
+{
+  uint64_t* dur;
+  uint64_t* cyc;
+  uint64_t start;
+  uint64_t tick;
+  uint64_t i;
+
+  dur = calloc(BENCH_RUNS, sizeof(*dur));
+  cyc = calloc(BENCH_RUNS, sizeof(*cyc));
+  if (dur == NULL || cyc == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for measurements");
+    free(dur);
+    free(cyc);
+    return false;
+  }
+
+  for (i = 0; i < BENCH_WARMUP; i++) {
+    bn->bn_fn(bn->bn_arg, BENCH_BATCH);
+  }
+
+  for (i = 0; i < BENCH_RUNS; i++) {
+    start = bench_now();
+    tick  = bench_ticks();
+    bn->bn_fn(bn->bn_arg, BENCH_BATCH);
+    cyc[i] = bench_ticks() - tick;
+    dur[i] = bench_now() - start;
+  }
+
+  qsort(dur, BENCH_RUNS, sizeof(*dur), compare_durations);
+  qsort(cyc, BENCH_RUNS, sizeof(*cyc), compare_durations);
+
+  rs->rs_runs = BENCH_RUNS;
+  rs->rs_bat  = BENCH_BATCH;
+  rs->rs_med  = (double)dur[BENCH_RUNS / 2]         / (double)BENCH_BATCH;
+  rs->rs_p99  = (double)dur[(BENCH_RUNS * 99) / 100] / (double)BENCH_BATCH;
+  rs->rs_cyc  = (double)cyc[BENCH_RUNS / 2]         / (double)BENCH_BATCH;
+
+  free(dur);
+  free(cyc);
+  return true;
+}
+
+/// Measure an operation whose output is discarded. The standard output is
+/// redirected only for the duration of the measurement, so that the results
+/// can still be reported.
+/// @return success/failure indication
+///
+/// @param[out] rs result
+/// @param[in]  bn measured operation
+static bool
+run_silenced(struct result* rs, const struct bench* bn)
+{
+  int null;
+  int save;
+  bool retb;
+
+  (void)fflush(stdout);
+
+  null = open("/dev/null", O_WRONLY);
+  if (null == -1) {
+    log(LL_WARN, true, "unable to open the null device");
+    return false;
+  }
+
+  save = dup(STDOUT_FILENO);
+  if (save == -1) {
+    log(LL_WARN, true, "unable to duplicate the standard output");
+    (void)close(null);
+    return false;
+  }
+
+  (void)dup2(null, STDOUT_FILENO);
+  (void)close(null);
+
+  retb = run_bench(rs, bn);
+
+  (void)fflush(stdout);
+  (void)dup2(save, STDOUT_FILENO);
+  (void)close(save);
+
+  return retb;
+}
+
+/// Measure and report all operations of a suite.
+/// @return success/failure indication
+///
+/// @param[in] bn  measured operations
+/// @param[in] nbn number of operations
+/// @param[in] flt name filter (or NULL)
+bool
+run_suite(const struct bench* bn, const uint64_t nbn, const char* flt)
+{
+  struct result rs;
+  uint64_t i;
+  bool retb;
+
+  for (i = 0; i < nbn; i++) {
+    if (flt != NULL && strstr(bn[i].bn_name, flt) == NULL) {
+      continue;
+    }
+
+    if (bn[i].bn_out == true) {
+      retb = run_silenced(&rs, &bn[i]);
+    } else {
+      retb = run_bench(&rs, &bn[i]);
+    }
+
+    if (retb == false) {
+      log(LL_WARN, false, "unable to measure %s", bn[i].bn_name);
+      return false;
+    }
+
+    print_result(&bn[i], &rs);
+  }
+
+  return true;
+}
+
+/// Print the CSV header of the results.
+void
+print_header(void)
+{
+  (void)printf("name,runs,batch,median_ns,p99_ns,median_cyc\n");
+}
+
+/// Print the result of a measurement in the CSV format.
+///
+/// @param[in] bn measured operation
+/// @param[in] rs result
+void
+print_result(const struct bench* bn, const struct result* rs)
+{
+  (void)printf("%s,%" PRIu64 ",%" PRIu64 ",%.2f,%.2f,%.2f\n",
+               bn->bn_name, rs->rs_runs, rs->rs_bat, rs->rs_med, rs->rs_p99, rs->rs_cyc);
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "common/log.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+/// Issue a batch of debug messages that are below the logging threshold.
+///
+/// @param[in] arg unused
+/// @param[in] n   number of messages
+static void
+batch_debug(void* arg, const uint64_t n)
+{
+  uint64_t i;
+
+  (void)arg;
+  for (i = 0; i < n; i++) {
+    log(LL_DEBUG, false, "filtered message %" PRIu64, i);
+  }
+}
+
+/// Issue a batch of tracing messages that are below the logging threshold.
+///
+/// @param[in] arg unused
+/// @param[in] n   number of messages
+static void
+batch_trace(void* arg, const uint64_t n)
+{
+  uint64_t i;
+
+  (void)arg;
+  for (i = 0; i < n; i++) {
+    log(LL_TRACE, false, "filtered message %" PRIu64, i);
+  }
+}
+
+/// Measure the cost of logging messages that are filtered out. The messages
+/// are removed at compile time if NEMO_LOG_LEVEL is set below their level,
+/// and are filtered at run time otherwise.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_log(const char* flt)
+{
+  struct bench bn[2];
+  uint8_t lvl;
+  bool retb;
+
+  bn[0].bn_name = "log.filtered.debug";
+  bn[0].bn_fn   = batch_debug;
+  bn[0].bn_arg  = NULL;
+  bn[0].bn_out  = false;
+  bn[1].bn_name = "log.filtered.trace";
+  bn[1].bn_fn   = batch_trace;
+  bn[1].bn_arg  = NULL;
+  bn[1].bn_out  = false;
+
+  lvl = log_lvl;
+  log_lvl = LL_WARN;
+  retb = run_suite(bn, 2, flt);
+  log_lvl = lvl;
+
+  return retb;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "common/log.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+/// Microbenchmarks of the hot-path primitives. The optional argument selects
+/// only the benchmarks whose name contains it.
+int
+main(int argc, char* argv[])
+{
+  const char* flt;
+  bool retb;
+
+  if (argc > 2) {
+    (void)fprintf(stderr, "Usage: mbench [filter]\n");
+    return EXIT_FAILURE;
+  }
+
+  flt = NULL;
+  if (argc == 2) {
+    flt = argv[1];
+  }
+
+  print_header();
+
+  retb = bench_clock(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "clock benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  retb = bench_convert(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "convert benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  retb = bench_packet(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "packet benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  retb = bench_batch(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "batch benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  retb = bench_log(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "log benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  retb = bench_ureq(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "ureq benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  retb = bench_ures(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "ures benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  retb = bench_agg(flt);
+  if (retb == false) {
+    log(LL_ERROR, false, "agg benchmark has failed");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/socket.h>
+
+#include <netinet/in.h>
+
+#include <string.h>
+
+#include "common/channel.h"
+#include "common/packet.h"
+#include "common/payload.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+
+
+// Destination of the measured values, so that the calls are not elided.
+static volatile uint64_t sink;
+
+/// State of the payload operations.
+struct codec {
+  struct payload cd_src;  ///< Payload in the host byte order.
+  struct payload cd_dst;  ///< Payload in the network byte order.
+  struct payload_compact cd_cdst; ///< Compact payload in the network byte order.
+  struct channel cd_ch;   ///< Channel accounting the verification failures.
+  struct msghdr  cd_msg;  ///< Received message.
+  uint8_t        cd_cmsg[CMSG_SPACE(sizeof(int))]; ///< Control messages.
+};
+
+/// Encode a batch of payloads.
+///
+/// @param[in] arg state of the payload operations
+/// @param[in] n   number of payloads
+static void
+batch_encode(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+  uint64_t i;
+
+  cd = arg;
+  for (i = 0; i < n; i++) {
+    cd->cd_src.pl_snum = i;
+    encode_payload(&cd->cd_dst, &cd->cd_src);
+  }
+  sink = cd->cd_dst.pl_snum;
+}
+
+/// Decode a batch of payloads.
+///
+/// @param[in] arg state of the payload operations
+/// @param[in] n   number of payloads
+static void
+batch_decode(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+  uint64_t i;
+
+  cd = arg;
+  for (i = 0; i < n; i++) {
+    cd->cd_dst.pl_snum = i;
+    decode_payload(&cd->cd_src, &cd->cd_dst);
+  }
+  sink = cd->cd_src.pl_snum;
+}
+
+/// Encode a batch of compact payloads.
+///
+/// @param[in] arg state of the payload operations
+/// @param[in] n   number of payloads
+static void
+batch_encode_compact(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+  uint64_t i;
+
+  cd = arg;
+  for (i = 0; i < n; i++) {
+    cd->cd_src.pl_snum = i;
+    encode_compact(&cd->cd_cdst, &cd->cd_src);
+  }
+  sink = cd->cd_cdst.pc_snum;
+}
+
+/// Decode a batch of compact payloads.
+///
+/// @param[in] arg state of the payload operations
+/// @param[in] n   number of payloads
+static void
+batch_decode_compact(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+  uint64_t i;
+
+  cd = arg;
+  for (i = 0; i < n; i++) {
+    cd->cd_cdst.pc_snum = i;
+    decode_compact(&cd->cd_src, &cd->cd_cdst);
+  }
+  sink = cd->cd_src.pl_snum;
+}
+
+/// Verify a batch of payloads.
+///
+/// @param[in] arg state of the payload operations
+/// @param[in] n   number of payloads
+static void
+batch_verify(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+  uint64_t i;
+
+  cd = arg;
+  for (i = 0; i < n; i++) {
+    sink = verify_payload(&cd->cd_ch, &cd->cd_src);
+  }
+}
+
+/// Retrieve a batch of Time-To-Live values.
+///
+/// @param[in] arg state of the payload operations
+/// @param[in] n   number of messages
+static void
+batch_ttl(void* arg, const uint64_t n)
+{
+  struct codec* cd;
+  uint8_t ttl;
+  uint64_t i;
+
+  cd = arg;
+  for (i = 0; i < n; i++) {
+    retrieve_ttl(&ttl, &cd->cd_msg);
+    sink = ttl;
+  }
+}
+
+/// Measure the cost of the payload operations performed for each datagram.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_packet(const char* flt)
+{
+  static struct codec cd;
+  struct cmsghdr* cmsg;
+  struct bench bn[6];
+  uint64_t i;
+  int ttl;
+
+  (void)memset(&cd, 0, sizeof(cd));
+  cd.cd_src.pl_mgic = NEMO_PAYLOAD_MAGIC;
+  cd.cd_src.pl_fver = NEMO_PAYLOAD_VERSION_FULL;
+  cd.cd_src.pl_len  = NEMO_PAYLOAD_SIZE;
+  cd.cd_src.pl_key  = 1;
+  cd.cd_src.pl_slen = 1000;
+  (void)strncpy(cd.cd_src.pl_host, "localhost", sizeof(cd.cd_src.pl_host));
+
+  // The message carries a single IPv4 Time-To-Live label, as it would be
+  // received from the kernel.
+  ttl = 64;
+  cd.cd_msg.msg_control    = cd.cd_cmsg;
+  cd.cd_msg.msg_controllen = sizeof(cd.cd_cmsg);
+  cmsg = CMSG_FIRSTHDR(&cd.cd_msg);
+  cmsg->cmsg_level = IPPROTO_IP;
+#if defined(__FreeBSD__)
+  cmsg->cmsg_type  = IP_RECVTTL;
+#else
+  cmsg->cmsg_type  = IP_TTL;
+#endif
+  cmsg->cmsg_len   = CMSG_LEN(sizeof(ttl));
+  (void)memcpy(CMSG_DATA(cmsg), &ttl, sizeof(ttl));
+
+  bn[0].bn_name = "packet.encode_payload";
+  bn[0].bn_fn   = batch_encode;
+  bn[1].bn_name = "packet.decode_payload";
+  bn[1].bn_fn   = batch_decode;
+  bn[2].bn_name = "packet.verify_payload";
+  bn[2].bn_fn   = batch_verify;
+  bn[3].bn_name = "packet.retrieve_ttl";
+  bn[3].bn_fn   = batch_ttl;
+  bn[4].bn_name = "packet.encode_compact";
+  bn[4].bn_fn   = batch_encode_compact;
+  bn[5].bn_name = "packet.decode_compact";
+  bn[5].bn_fn   = batch_decode_compact;
+
+  for (i = 0; i < 6; i++) {
+    bn[i].bn_arg = &cd;
+    bn[i].bn_out = false;
+  }
+
+  return run_suite(bn, 6, flt);
+}
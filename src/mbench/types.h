@@ -0,0 +1,37 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#ifndef NEMO_MBENCH_TYPES_H
+#define NEMO_MBENCH_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+// Measurement settings.
+#define BENCH_WARMUP 16   ///< Number of discarded batches.
+#define BENCH_RUNS   1000 ///< Number of measured batches.
+#define BENCH_BATCH  1000 ///< Number of operations in a batch.
+
+/// Measured operation.
+struct bench {
+  const char* bn_name;              ///< Name.
+  void (*bn_fn)(void* arg,          ///< Execute a batch of operations.
+                const uint64_t n);
+  void* bn_arg;                     ///< Argument of the operation.
+  bool  bn_out;                     ///< Operation writes to the standard output.
+};
+
+/// Result of a measurement.
+struct result {
+  uint64_t rs_runs; ///< Number of measured batches.
+  uint64_t rs_bat;  ///< Number of operations in a batch.
+  double   rs_med;  ///< Median duration of an operation in nanoseconds.
+  double   rs_p99;  ///< 99th percentile duration of an operation.
+  double   rs_cyc;  ///< Median time-stamp counter ticks of an operation.
+};
+
+#endif
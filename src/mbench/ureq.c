@@ -0,0 +1,235 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/log.h"
+#include "common/payload.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+#include "ureq/funcs.h"
+#include "ureq/types.h"
+
+
+// Number of targets in the normalized array, half of them duplicates.
+#define BENCH_TARGETS 64
+
+// Destination of the measured values, so that the calls are not elided.
+static volatile uint64_t sink;
+
+/// State of the requester operations.
+struct requester {
+  struct worker* rq_wk;  ///< Worker with the report buffer.
+  struct config  rq_cf;  ///< Configuration.
+  struct payload rq_pl;  ///< Received payload in the host byte order.
+  char rq_hn[NEMO_HOST_NAME_SIZE]; ///< Local host name.
+  struct target  rq_orig[BENCH_TARGETS]; ///< Targets before normalization.
+  struct target  rq_tg[BENCH_TARGETS];   ///< Normalized targets.
+  uint64_t       rq_snum; ///< Sequence number of the next request.
+};
+
+/// Report a batch of responses.
+///
+/// @param[in] arg state of the requester operations
+/// @param[in] n   number of responses
+static void
+batch_report(void* arg, const uint64_t n)
+{
+  struct requester* rq;
+  uint64_t i;
+
+  rq = arg;
+  for (i = 0; i < n; i++) {
+    rq->rq_pl.pl_snum = i;
+    report_event(rq->rq_wk, &rq->rq_pl, rq->rq_hn, 1500000000000000000ULL + i,
+                 1000000 + i, 61, 0, 0x0100007fffff0000ULL, 500, OUTCOME_OK, &rq->rq_cf);
+  }
+}
+
+/// Insert a batch of requests into the in-flight table and match their
+/// responses, spread over all targets.
+///
+/// @param[in] arg state of the requester operations
+/// @param[in] n   number of requests
+static void
+batch_flight(void* arg, const uint64_t n)
+{
+  struct requester* rq;
+  struct departure dp;
+  uint64_t rtt;
+  uint64_t i;
+
+  rq = arg;
+  for (i = 0; i < n; i++) {
+    dp.dp_snum  = rq->rq_snum / BENCH_TARGETS;
+    dp.dp_mono  = 1000000 + rq->rq_snum;
+    dp.dp_real  = 1500000000000000000ULL + rq->rq_snum;
+    dp.dp_laddr = 0;
+    dp.dp_haddr = 0x0100000affff0000ULL + ((rq->rq_snum % BENCH_TARGETS) << 56);
+    depart_flight(rq->rq_wk, &dp, rq->rq_hn, &rq->rq_cf);
+
+    // Responders echo the departure time of the request.
+    rq->rq_pl.pl_snum = dp.dp_snum;
+    rq->rq_pl.pl_mtm1 = dp.dp_mono;
+    sink = land_flight(rq->rq_wk, &rtt, &rq->rq_pl, 0, dp.dp_haddr,
+                       dp.dp_mono + 500, rq->rq_hn, &rq->rq_cf);
+    rq->rq_snum++;
+  }
+}
+
+/// Verify that responses are matched against their requests regardless of
+/// the key, unless the responder includes a different key than the one of
+/// the request.
+/// @return success/failure indication
+///
+/// @param[in] rq state of the requester operations
+static bool
+check_keys(struct requester* rq)
+{
+  static const uint64_t key[3] = { 0, 1, 2 };
+  static const uint8_t exp[3] = { OUTCOME_OK, OUTCOME_OK, OUTCOME_UNKNOWN };
+  struct departure dp;
+  struct payload pl;
+  uint64_t rtt;
+  uint64_t i;
+  uint8_t out;
+
+  (void)memcpy(&pl, &rq->rq_pl, sizeof(pl));
+  for (i = 0; i < 3; i++) {
+    dp.dp_snum  = i;
+    dp.dp_mono  = 1000000 + i;
+    dp.dp_real  = 1500000000000000000ULL + i;
+    dp.dp_laddr = 0;
+    dp.dp_haddr = 0x0100007fffff0000ULL;
+    depart_flight(rq->rq_wk, &dp, rq->rq_hn, &rq->rq_cf);
+
+    pl.pl_snum = dp.dp_snum;
+    pl.pl_mtm1 = dp.dp_mono;
+    pl.pl_key  = key[i];
+    out = land_flight(rq->rq_wk, &rtt, &pl, 0, dp.dp_haddr, dp.dp_mono + 500,
+                      rq->rq_hn, &rq->rq_cf);
+    if (out != exp[i]) {
+      log(LL_WARN, false, "response with key %" PRIu64 " matched incorrectly",
+          key[i]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Normalize a batch of target arrays. Each operation includes the copy of
+/// the original array.
+///
+/// @param[in] arg state of the requester operations
+/// @param[in] n   number of normalizations
+static void
+batch_normalize(void* arg, const uint64_t n)
+{
+  struct requester* rq;
+  uint64_t len;
+  uint64_t i;
+
+  rq = arg;
+  for (i = 0; i < n; i++) {
+    (void)memcpy(rq->rq_tg, rq->rq_orig, sizeof(rq->rq_tg));
+    normalize_targets(rq->rq_tg, &len, BENCH_TARGETS);
+    sink = len;
+  }
+}
+
+/// Measure the cost of the requester operations: formatting of a report line,
+/// normalization of the target array and matching of responses against the
+/// in-flight requests.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_ureq(const char* flt)
+{
+  static struct requester rq;
+  struct bench bn[3];
+  uint64_t i;
+  bool retb;
+
+  (void)memset(&rq, 0, sizeof(rq));
+  rq.rq_wk = calloc(1, sizeof(*rq.rq_wk));
+  if (rq.rq_wk == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the worker");
+    return false;
+  }
+
+  rq.rq_cf.cf_sil  = false;
+  rq.rq_cf.cf_ipv4 = true;
+  rq.rq_cf.cf_port = 23000;
+  rq.rq_cf.cf_ttl  = 64;
+  rq.rq_cf.cf_key  = 1;
+  rq.rq_cf.cf_ntg  = BENCH_TARGETS;
+  rq.rq_cf.cf_int  = 1000000000;
+  rq.rq_cf.cf_dead = 1000000000;
+
+  rq.rq_pl.pl_mgic = NEMO_PAYLOAD_MAGIC;
+  rq.rq_pl.pl_fver = NEMO_PAYLOAD_VERSION_FULL;
+  rq.rq_pl.pl_len  = NEMO_PAYLOAD_SIZE;
+  rq.rq_pl.pl_key  = 1;
+  rq.rq_pl.pl_slen = 1000;
+  rq.rq_pl.pl_ttl1 = 64;
+  rq.rq_pl.pl_ttl2 = 62;
+  rq.rq_pl.pl_mtm1 = 1000000;
+  rq.rq_pl.pl_mtm2 = 1000500;
+  rq.rq_pl.pl_rtm1 = 1500000000000000000ULL;
+  rq.rq_pl.pl_rtm2 = 1500000000000000500ULL;
+  (void)strncpy(rq.rq_pl.pl_host, "responder.example.com", sizeof(rq.rq_pl.pl_host));
+  (void)strncpy(rq.rq_hn, "requester.example.com", sizeof(rq.rq_hn));
+
+  // Every address appears twice, in a descending order, so that both the
+  // sorting and the removal of duplicates perform work.
+  for (i = 0; i < BENCH_TARGETS; i++) {
+    rq.rq_orig[i].tg_name  = NULL;
+    rq.rq_orig[i].tg_laddr = 0;
+    rq.rq_orig[i].tg_haddr = 0x0100000affff0000ULL + ((BENCH_TARGETS - i) / 2 << 56);
+  }
+
+  retb = create_flights(rq.rq_wk, &rq.rq_cf);
+  if (retb == false) {
+    free(rq.rq_wk->wk_lane);
+    free(rq.rq_wk);
+    return false;
+  }
+
+  retb = check_keys(&rq);
+  if (retb == false) {
+    free(rq.rq_wk->wk_lane);
+    free(rq.rq_wk->wk_flt);
+    free(rq.rq_wk);
+    return false;
+  }
+
+  bn[0].bn_name = "ureq.report_event";
+  bn[0].bn_fn   = batch_report;
+  bn[0].bn_arg  = &rq;
+  bn[0].bn_out  = true;
+  bn[1].bn_name = "ureq.normalize_targets";
+  bn[1].bn_fn   = batch_normalize;
+  bn[1].bn_arg  = &rq;
+  bn[1].bn_out  = false;
+  bn[2].bn_name = "ureq.match_flight";
+  bn[2].bn_fn   = batch_flight;
+  bn[2].bn_arg  = &rq;
+  bn[2].bn_out  = false;
+
+  retb = run_suite(bn, 3, flt);
+
+  // Discard the remaining report lines.
+  rq.rq_wk->wk_rlen = 0;
+  free(rq.rq_wk->wk_lane);
+  free(rq.rq_wk->wk_flt);
+  free(rq.rq_wk);
+
+  return retb;
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <string.h>
+
+#include "common/payload.h"
+#include "mbench/funcs.h"
+#include "mbench/types.h"
+#include "ures/funcs.h"
+#include "ures/types.h"
+
+
+// Number of distinct requesters of the aggregated reports.
+#define BENCH_REQUESTERS 1024
+
+/// State of the responder operations.
+struct responder {
+  struct config  rs_cf; ///< Configuration.
+  struct config  rs_acf; ///< Configuration of the aggregation.
+  struct payload rs_pl; ///< Received payload.
+  char rs_hn[NEMO_HOST_NAME_SIZE]; ///< Local host name.
+};
+
+/// Report a batch of requests.
+///
+/// @param[in] arg state of the responder operations
+/// @param[in] n   number of requests
+static void
+batch_report(void* arg, const uint64_t n)
+{
+  struct responder* rs;
+  uint64_t i;
+
+  rs = arg;
+  for (i = 0; i < n; i++) {
+    rs->rs_pl.pl_snum = i;
+    report_event(&rs->rs_pl, rs->rs_hn, 0x0100007f, 0, 40000, true,
+                 1500000000000001000ULL + i, 1001000 + i, &rs->rs_cf);
+  }
+}
+
+/// Aggregate a batch of requests from a fixed set of requesters.
+///
+/// @param[in] arg state of the responder operations
+/// @param[in] n   number of requests
+static void
+batch_aggregate(void* arg, const uint64_t n)
+{
+  struct responder* rs;
+  uint64_t i;
+
+  rs = arg;
+  for (i = 0; i < n; i++) {
+    rs->rs_pl.pl_snum = i / BENCH_REQUESTERS;
+    report_event(&rs->rs_pl, rs->rs_hn, 0x0100000a + (i % BENCH_REQUESTERS), 0, 40000,
+                 true, 1500000000000001000ULL + i, 1001000 + i, &rs->rs_acf);
+  }
+}
+
+/// Measure the cost of the responder operations: formatting of a report line
+/// and the update of a per-requester summary.
+/// The report functions of the responder are renamed at compile time, so that
+/// they can coexist with the ones of the requester.
+/// @return success/failure indication
+///
+/// @param[in] flt name filter (or NULL)
+bool
+bench_ures(const char* flt)
+{
+  static struct responder rs;
+  struct bench bn[2];
+  bool retb;
+
+  (void)memset(&rs, 0, sizeof(rs));
+  rs.rs_cf.cf_sil  = false;
+  rs.rs_cf.cf_ipv4 = true;
+
+  // The period is never reached, so that no summaries are emitted.
+  rs.rs_acf = rs.rs_cf;
+  rs.rs_acf.cf_agp = UINT64_MAX / 2;
+  rs.rs_acf.cf_agn = AGGR_DEF_SIZE;
+
+  rs.rs_pl.pl_mgic = NEMO_PAYLOAD_MAGIC;
+  rs.rs_pl.pl_fver = NEMO_PAYLOAD_VERSION_FULL;
+  rs.rs_pl.pl_len  = NEMO_PAYLOAD_SIZE;
+  rs.rs_pl.pl_key  = 1;
+  rs.rs_pl.pl_slen = 1000;
+  rs.rs_pl.pl_ttl1 = 64;
+  rs.rs_pl.pl_ttl2 = 62;
+  rs.rs_pl.pl_mtm1 = 1000000;
+  rs.rs_pl.pl_mtm2 = 1000250;
+  rs.rs_pl.pl_rtm1 = 1500000000000000000ULL;
+  rs.rs_pl.pl_rtm2 = 1500000000000000250ULL;
+  (void)strncpy(rs.rs_pl.pl_host, "requester.example.com", sizeof(rs.rs_pl.pl_host));
+  (void)strncpy(rs.rs_hn, "responder.example.com", sizeof(rs.rs_hn));
+
+  bn[0].bn_name = "ures.report_event";
+  bn[0].bn_fn   = batch_report;
+  bn[0].bn_arg  = &rs;
+  bn[0].bn_out  = true;
+
+  bn[1].bn_name = "ures.aggregate_event";
+  bn[1].bn_fn   = batch_aggregate;
+  bn[1].bn_arg  = &rs;
+  bn[1].bn_out  = false;
+
+  retb = open_aggregation(&rs.rs_acf);
+  if (retb == true) {
+    retb = run_suite(bn, 2, flt);
+  }
+
+  // Drop the summaries instead of printing them.
+  rs.rs_acf.cf_sil = true;
+  close_aggregation(&rs.rs_acf);
+
+  return retb;
+}
@@ -0,0 +1,211 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/types.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "common/convert.h"
+#include "common/log.h"
+#include "common/now.h"
+#include "common/parse.h"
+#include "common/stats.h"
+
+
+// Maximal number of sampled processes.
+#define SEG_MAX 1024
+
+// Location of the POSIX shared memory segments on Linux.
+#define SHM_DIR "/dev/shm"
+
+/// Print the usage information to the standard output stream.
+static void
+print_usage(void)
+{
+  (void)printf(
+    "About:\n"
+    "  Reader of the live statistics published by ureq and ures.\n\n"
+
+    "Usage:\n"
+    "  nemo-stat [OPTIONS] [segment]...\n\n"
+
+    "Arguments:\n"
+    "  segment Name of the shared memory segment, e.g. nemo-ureq.1234.\n"
+    "          All segments in " SHM_DIR " are sampled if none is given.\n\n"
+
+    "Options:\n"
+    "  -c CNT  Number of samples. (def=1)\n"
+    "  -h      Print this help message.\n"
+    "  -i DUR  Interval between samples. (def=1s)\n");
+}
+
+/// Find all published segments.
+/// @return success/failure indication
+///
+/// @param[out] st  array of statistics
+/// @param[out] nst number of statistics
+static bool
+find_segments(struct stats* st, uint64_t* nst)
+{
+  DIR* dir;
+  struct dirent* ent;
+  bool retb;
+
+  dir = opendir(SHM_DIR);
+  if (dir == NULL) {
+    log(LL_WARN, true, "unable to list the shared memory segments");
+    return false;
+  }
+
+  while ((ent = readdir(dir)) != NULL && *nst < SEG_MAX) {
+    if (strncmp(ent->d_name, STATS_PREFIX, strlen(STATS_PREFIX)) != 0) {
+      continue;
+    }
+
+    retb = open_stats(&st[*nst], ent->d_name);
+    if (retb == true) {
+      (*nst)++;
+    }
+  }
+
+  (void)closedir(dir);
+  return true;
+}
+
+/// Print all values of a segment in the CSV format.
+///
+/// @param[in] st   statistics
+/// @param[in] real current real time
+static void
+print_segment(const struct stats* st, const uint64_t real)
+{
+  const struct stats_sect* ss;
+  const char** names;
+  uint64_t val[STATS_FIELD_MAX];
+  uint32_t nval;
+  uint32_t i;
+  uint32_t j;
+  bool retb;
+
+  for (i = 0; i < st->st_head->sh_nsect; i++) {
+    ss = &st->st_sect[i];
+
+    retb = read_section(ss, val);
+    if (retb == false) {
+      log(LL_WARN, false, "unable to read section %" PRIu32 " of %s", i, st->st_name);
+      continue;
+    }
+
+    nval = section_fields(ss->ss_kind, &names);
+    for (j = 0; j < nval; j++) {
+      (void)printf("%" PRIu64 ",%s,%s,%" PRIu64 ",%.*s,%" PRIu32 ",%s,%" PRIu64 "\n",
+                   real, st->st_name + 1, st->st_head->sh_prog, st->st_head->sh_pid,
+                   STATS_NAME_SIZE, ss->ss_name, ss->ss_idx, names[j], val[j]);
+    }
+  }
+}
+
+/// Reader of the live statistics.
+int
+main(int argc, char* argv[])
+{
+  struct stats* st;
+  struct timespec ts;
+  uint64_t nst;
+  uint64_t cnt;
+  uint64_t itv;
+  uint64_t i;
+  uint64_t k;
+  int opt;
+  int reti;
+  bool retb;
+
+  log_lvl = LL_WARN;
+  log_col = isatty(STDERR_FILENO) == 1;
+
+  cnt = 1;
+  itv = 1000000000ULL;
+  while ((opt = getopt(argc, argv, "c:hi:")) != -1) {
+    if (opt == 'c') {
+      retb = parse_uint64(&cnt, optarg, 1, UINT64_MAX);
+    } else if (opt == 'i') {
+      retb = parse_scalar(&itv, optarg, "ns", 1, UINT64_MAX, parse_time_unit);
+    } else {
+      print_usage();
+      return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (retb == false) {
+      log(LL_ERROR, false, "invalid value of option '%c'", opt);
+      return EXIT_FAILURE;
+    }
+  }
+
+  st = calloc(SEG_MAX, sizeof(*st));
+  if (st == NULL) {
+    log(LL_ERROR, true, "unable to allocate memory for segments");
+    return EXIT_FAILURE;
+  }
+
+  // Map the selected segments, or all available ones.
+  nst = 0;
+  if (optind == argc) {
+    retb = find_segments(st, &nst);
+    if (retb == false) {
+      return EXIT_FAILURE;
+    }
+  } else {
+    for (reti = optind; reti < argc && nst < SEG_MAX; reti++) {
+      retb = open_stats(&st[nst], argv[reti]);
+      if (retb == false) {
+        return EXIT_FAILURE;
+      }
+      nst++;
+    }
+  }
+
+  (void)printf("real,segment,program,pid,section,index,field,value\n");
+
+  fnanos(&ts, itv);
+  for (k = 0; k < cnt; k++) {
+    if (k > 0) {
+      (void)nanosleep(&ts, NULL);
+    }
+
+    for (i = 0; i < nst; i++) {
+      if (st[i].st_head == NULL) {
+        continue;
+      }
+
+      // Segments of terminated processes might be left behind.
+      reti = kill((pid_t)st[i].st_head->sh_pid, 0);
+      if (reti == -1 && errno == ESRCH) {
+        log(LL_WARN, false, "process of segment %s has terminated", st[i].st_name);
+        close_stats(&st[i]);
+        continue;
+      }
+
+      print_segment(&st[i], real_now());
+    }
+
+    (void)fflush(stdout);
+  }
+
+  for (i = 0; i < nst; i++) {
+    close_stats(&st[i]);
+  }
+  free(st);
+
+  return EXIT_SUCCESS;
+}
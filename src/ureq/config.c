@@ -14,9 +14,12 @@
 #include <inttypes.h>
 #include <time.h>
 
+#include "common/cpu.h"
 #include "common/log.h"
+#include "common/now.h"
 #include "common/parse.h"
 #include "common/payload.h"
+#include "common/sim.h"
 #include "ureq/funcs.h"
 #include "ureq/types.h"
 #include "ureq/version.h"
@@ -27,6 +30,7 @@
 #define DEF_COUNT          UINT64_MAX ///< Number of published datagrams.
 #define DEF_INTERVAL       1000000000 ///< One second pause between payloads.
 #define DEF_FINAL_WAIT     2000000000 ///< Two second wait time for responses.
+#define DEF_DEADLINE       1000000000 ///< One second deadline of a response.
 #define DEF_UPDATE         60000000000 ///< One minute period of name resolution update.
 #define DEF_TIME_TO_LIVE   64          ///< IP Time-To-Live value.
 #define DEF_EXIT_ON_ERROR  false      ///< Process exit on publishing error.
@@ -39,8 +43,16 @@
 #define DEF_SILENT         false      ///< Do not suppress reporting.
 #define DEF_GROUP          false      ///< Do not group requests.
 #define DEF_KEY            0          ///< Issue promiscuous requests.
-#define DEF_LENGTH         NEMO_PAYLOAD_SIZE
+#define DEF_LENGTH         0          ///< Size of the payload format.
+#define DEF_FORMAT         NEMO_PAYLOAD_VERSION_FULL ///< Full-size payloads.
 #define DEF_PROTO_VERSION_4 true
+#define DEF_WORKERS        1          ///< Single worker thread.
+#define DEF_SPLIT          false      ///< Send and receive on the same thread.
+#define DEF_CLOCK          NOW_CLOCK_SYSTEM ///< Clock source of the system.
+#define DEF_LOG_BACKEND    LB_STDERR  ///< Log to the standard error stream.
+#define DEF_STATS          false      ///< Do not publish live statistics.
+#define DEF_BUSY           false      ///< Sleep until responses arrive.
+#define DEF_ACCEL          1          ///< Virtual clock runs at the real pace.
 
 /// Print the usage information to the standard output stream.
 static void
@@ -50,7 +62,7 @@ print_usage(void)
     "About:\n"
     "  Unicast network requester.\n"
     "  Program version: %d.%d.%d\n"
-    "  Payload version: %d\n\n"
+    "  Payload versions: %d (full), %d (compact)\n\n"
 
     "Usage:\n"
     "  ureq [OPTIONS] target [target]...\n\n"
@@ -59,36 +71,147 @@ print_usage(void)
     "  target  IPv4/IPv6 address or hostname\n\n"
 
     "Options:\n"
-    "  -6      Use the IPv6 protocol.\n"
+    "  -4      Use the IPv4 protocol. (def)\n"
+    "  -6      Use the IPv6 protocol, along with IPv4 if -4 is selected.\n"
+    "  -A FACT Run the clock FACT times faster in the simulated network.\n"
+    "  -b      Spin on non-blocking receives instead of sleeping (busy mode).\n"
+    "  -C CPUS Comma-separated list of CPUs for worker threads.\n"
     "  -c CNT  Limit the number of issued requests.\n"
+    "  -d DUR  Deadline of a response, after which its request is lost. (def=1s)\n"
     "  -e      Stop the process on first network error.\n"
+    "  -f FMT  Payload format: full or compact. (def=full)\n"
     "  -g      Group requests at the start of each round.\n"
     "  -h      Print this help message.\n"
     "  -i DUR  Minimal duration of a request round. (def=1s)\n"
     "  -j CNT  Upper limit on network target count. (def=%d)\n"
     "  -k KEY  Key for the current run. (def=%d)\n"
-    "  -l LEN  Extended length of the payload. (def=%d)\n"
+    "  -l LEN  Extended length of the payload. (def=size of the format)\n"
+    "  -L BKND Logging back-end service: stderr or syslog. (def=stderr)\n"
     "  -m      Do not react to responses (monologue mode).\n"
+    "  -M      Publish live statistics in a shared memory segment.\n"
     "  -n      Turn off colors in logging messages.\n"
-    "  -r RBS  Receive memory buffer size.\n"
-    "  -s SBS  Send memory buffer size.\n"
+    "  -N NET  Simulated network instead of sockets: LAT[:JIT[:LOSS[:REO]]].\n"
+    "  -r RBS  Receive memory buffer size, or auto[:MAX].\n"
+    "  -R PRIO Real-time FIFO scheduling priority of worker threads (1-99).\n"
+    "  -s SBS  Send memory buffer size, or auto[:MAX].\n"
+    "  -S CLK  Clock source for timestamps: sys or tsc. (def=sys)\n"
     "  -p NUM  UDP port to use for all endpoints. (def=%d)\n"
+    "  -P PATH Serve metrics on a Unix domain socket.\n"
     "  -t TTL  Set the Time-To-Live for all published datagrams. (def=%d)\n"
+    "  -T CNT  Number of worker threads, each with its own socket. (def=%d)\n"
     "  -u DUR  Duration of the name resolution update period.\n"
     "  -v      Increase the verbosity of the logging output.\n"
-    "  -w DUR  Wait time for responses after last request. (def=2s)\n",
+    "  -w DUR  Wait time for responses after last request. (def=2s)\n"
+    "  -x      Send and receive on separate threads.\n"
+    "  -y N    Report every N-th row.\n"
+    "  -Y N    Report the rows of 1 in N requests, sampled by their hash.\n"
+    "  -z RATE Report at most RATE rows per second.\n",
     NEMO_REQ_VERSION_MAJOR,
     NEMO_REQ_VERSION_MINOR,
     NEMO_REQ_VERSION_PATCH,
-    NEMO_PAYLOAD_VERSION,
+    NEMO_PAYLOAD_VERSION_FULL,
+    NEMO_PAYLOAD_VERSION_COMPACT,
     DEF_TARGET_COUNT,
     DEF_KEY,
-    DEF_LENGTH,
     DEF_UDP_PORT,
-    DEF_TIME_TO_LIVE);
+    DEF_TIME_TO_LIVE,
+    DEF_WORKERS);
 }
 
-/// Select IPv6 protocol only.
+/// Parse a probability expressed in percents, e.g. 0.5%.
+/// @return success/failure indication
+///
+/// @param[out] ppm probability in parts per million
+/// @param[in]  inp input string
+static bool
+parse_ratio(uint64_t* ppm, const char* inp)
+{
+  double val;
+  char* end;
+
+  val = strtod(inp, &end);
+  if (end == inp || strcmp(end, "%") != 0 || !(val >= 0.0 && val <= 100.0)) {
+    log(LL_WARN, false, "invalid percentage '%s'", inp);
+    return false;
+  }
+
+  *ppm = (uint64_t)(val * 10000.0 + 0.5);
+  return true;
+}
+
+/// Parse the model of a simulated network in the LAT[:JIT[:LOSS[:REO]]]
+/// form, e.g. 20ms:5ms:1%:0.1%.
+/// @return success/failure indication
+///
+/// @param[out] md  model
+/// @param[in]  inp input string
+static bool
+parse_model(struct model* md, const char* inp)
+{
+  char buf[128];
+  char* part[4];
+  char* save;
+  char* tok;
+  uint64_t cnt;
+  bool retb;
+
+  if (strlen(inp) >= sizeof(buf)) {
+    log(LL_WARN, false, "network model '%s' is too long", inp);
+    return false;
+  }
+
+  (void)memset(buf, '\0', sizeof(buf));
+  (void)strncpy(buf, inp, sizeof(buf) - 1);
+  (void)memset(part, 0, sizeof(part));
+
+  cnt = 0;
+  for (tok = strtok_r(buf, ":", &save); tok != NULL; tok = strtok_r(NULL, ":", &save)) {
+    if (cnt == 4) {
+      log(LL_WARN, false, "network model '%s' has too many parts", inp);
+      return false;
+    }
+
+    part[cnt] = tok;
+    cnt++;
+  }
+
+  if (cnt == 0) {
+    log(LL_WARN, false, "network model is empty");
+    return false;
+  }
+
+  (void)memset(md, 0, sizeof(*md));
+  retb = parse_scalar(&md->md_lat, part[0], "ns", 0, UINT64_MAX / 8, parse_time_unit);
+  if (retb == true && part[1] != NULL) {
+    retb = parse_scalar(&md->md_jit, part[1], "ns", 0, UINT64_MAX / 8, parse_time_unit);
+  }
+  if (retb == true && part[2] != NULL) {
+    retb = parse_ratio(&md->md_loss, part[2]);
+  }
+  if (retb == true && part[3] != NULL) {
+    retb = parse_ratio(&md->md_reo, part[3]);
+  }
+
+  return retb;
+}
+
+/// Select the IPv4 protocol. In case the IPv6 protocol is selected too, both
+/// are used at once.
+/// @return success/failure indication
+///
+/// @param[out] cf  configuration
+/// @param[in]  in argument input (unused)
+static bool
+option_4(struct config* cf, const char* in)
+{
+  (void)in;
+  cf->cf_ipv4 = true;
+
+  return true;
+}
+
+/// Select the IPv6 protocol. In case the IPv4 protocol is selected too, both
+/// are used at once.
 /// @return success/failure indication
 ///
 /// @param[out] cf  configuration
@@ -97,11 +220,48 @@ static bool
 option_6(struct config* cf, const char* in)
 {
   (void)in;
-  cf->cf_ipv4 = false;
+  cf->cf_ipv6 = true;
 
   return true;
 }
 
+/// Accelerate the clock of the simulated network.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_A(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_acc, in, 1, 1000000);
+}
+
+/// Spin on non-blocking receives with locked memory and socket busy-polling,
+/// instead of sleeping until a response arrives.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input (unused)
+static bool
+option_b(struct config* cf, const char* in)
+{
+  (void)in;
+  cf->cf_busy = true;
+
+  return true;
+}
+
+/// Set the CPU affinity of the worker threads.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_C(struct config* cf, const char* in)
+{
+  return parse_cpu_list(cf->cf_cpu, &cf->cf_ncpu, in);
+}
+
 /// Attach a plugin from a shared object library. This function does not load
 /// the plugins directly, it merely copies the arguments holding the paths to
 /// the shared objects.
@@ -136,6 +296,17 @@ option_c(struct config* cf, const char* in)
   return parse_uint64(&cf->cf_cnt, in, 0, UINT64_MAX);
 }
 
+/// Deadline of a response after the departure of its request.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_d(struct config* cf, const char* in)
+{
+  return parse_scalar(&cf->cf_dead, in, "ns", 1, UINT64_MAX / 2, parse_time_unit);
+}
+
 /// Terminate the process on first network-related error.
 /// @return success/failure indication
 ///
@@ -150,6 +321,28 @@ option_e(struct config* cf, const char* in)
   return true;
 }
 
+/// Select the payload format.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_f(struct config* cf, const char* in)
+{
+  if (strcmp(in, "full") == 0) {
+    cf->cf_fver = NEMO_PAYLOAD_VERSION_FULL;
+    return true;
+  }
+
+  if (strcmp(in, "compact") == 0) {
+    cf->cf_fver = NEMO_PAYLOAD_VERSION_COMPACT;
+    return true;
+  }
+
+  log(LL_WARN, false, "unknown payload format '%s'", in);
+  return false;
+}
+
 /// Group issued requests each round.
 /// @return success/failure indication
 ///
@@ -228,7 +421,18 @@ option_k(struct config* cf, const char* in)
 static bool
 option_l(struct config* cf, const char* in)
 {
-  return parse_scalar(&cf->cf_len, in, "b", NEMO_PAYLOAD_SIZE, 64436, parse_memory_unit);
+  return parse_scalar(&cf->cf_len, in, "b", NEMO_PAYLOAD_COMPACT_SIZE, 64436, parse_memory_unit);
+}
+
+/// Select the back-end service for the logging output.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_L(struct config* cf, const char* in)
+{
+  return parse_log_backend(&cf->cf_lbe, in);
 }
 
 /// Enable monologue mode where no responses are being issued.
@@ -245,6 +449,20 @@ option_m(struct config* cf, const char* in)
   return true;
 }
 
+/// Publish live statistics in a shared memory segment.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input (unused)
+static bool
+option_M(struct config* cf, const char* in)
+{
+  (void)in;
+  cf->cf_stat = true;
+
+  return true;
+}
+
 /// Turn off coloring and highlights in the logging output.
 /// @return success/failure indication
 ///
@@ -259,6 +477,18 @@ option_n(struct config* cf, const char* in)
   return true;
 }
 
+/// Replace the sockets with an in-memory network of the selected model.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_N(struct config* cf, const char* in)
+{
+  cf->cf_sim = true;
+  return parse_model(&cf->cf_mdl, in);
+}
+
 /// Set the UDP port number used for all communication.
 /// @return success/failure indication
 ///
@@ -270,6 +500,19 @@ option_p(struct config* cf, const char* in)
   return parse_uint64(&cf->cf_port, in, 1, 65535);
 }
 
+/// Serve metrics in the Prometheus text format on a Unix domain socket.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_P(struct config* cf, const char* in)
+{
+  cf->cf_prom = in;
+
+  return true;
+}
+
 /// Suppress reporting to the standard output stream.
 /// @return success/failure indication
 ///
@@ -284,7 +527,7 @@ option_q(struct config* cf, const char* in)
   return true;
 }
 
-/// Set the socket receive buffer size.
+/// Set the socket receive buffer size, or its adaptive sizing.
 /// @return success/failure indication
 ///
 /// @param[out] cf configuration
@@ -292,10 +535,21 @@ option_q(struct config* cf, const char* in)
 static bool
 option_r(struct config* cf, const char* in)
 {
-  return parse_scalar(&cf->cf_rbuf, in, "b", NEMO_PAYLOAD_SIZE, SIZE_MAX, parse_memory_unit);
+  return parse_buffer(&cf->cf_rbuf, &cf->cf_rcap, in, NEMO_PAYLOAD_SIZE, CHANNEL_AUTO_CEILING);
+}
+
+/// Schedule the worker threads with the real-time FIFO policy.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_R(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_prio, in, 1, 99);
 }
 
-/// Set the socket send buffer size.
+/// Set the socket send buffer size, or its adaptive sizing.
 /// @return success/failure indication
 ///
 /// @param[out] cf configuration
@@ -303,7 +557,18 @@ option_r(struct config* cf, const char* in)
 static bool
 option_s(struct config* cf, const char* in)
 {
-  return parse_scalar(&cf->cf_sbuf, in, "b", NEMO_PAYLOAD_SIZE, SIZE_MAX, parse_memory_unit);
+  return parse_buffer(&cf->cf_sbuf, &cf->cf_scap, in, NEMO_PAYLOAD_SIZE, CHANNEL_AUTO_CEILING);
+}
+
+/// Select the clock source for all timestamps.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_S(struct config* cf, const char* in)
+{
+  return parse_clock(&cf->cf_clk, in);
 }
 
 /// Set the IP Time-To-Live value.
@@ -317,6 +582,17 @@ option_t(struct config* cf, const char* in)
   return parse_uint64(&cf->cf_ttl, in, 1, 255);
 }
 
+/// Set the number of worker threads.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_T(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_nwk, in, 1, WORK_MAX);
+}
+
 /// Set the update period for name resolution.
 /// @return success/failure indication
 ///
@@ -368,6 +644,70 @@ option_w(struct config* cf, const char* in)
   return parse_scalar(&cf->cf_wait, in, "ns", 1, UINT64_MAX, parse_time_unit);
 }
 
+/// Separate the sending and receiving of datagrams into two threads.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input (unused)
+static bool
+option_x(struct config* cf, const char* in)
+{
+  (void)in;
+  cf->cf_spl = true;
+
+  return true;
+}
+
+/// Report every N-th row of the requests.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_y(struct config* cf, const char* in)
+{
+  cf->cf_smp = SAMPLE_COUNT;
+  return parse_uint64(&cf->cf_sev, in, 1, SAMPLE_MAX);
+}
+
+/// Report the rows of the requests whose key and sequence number hash to one
+/// in N, so that both programs sample the same requests.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_Y(struct config* cf, const char* in)
+{
+  cf->cf_smp = SAMPLE_HASH;
+  return parse_uint64(&cf->cf_sev, in, 1, SAMPLE_MAX);
+}
+
+/// Limit the number of report rows per second.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_z(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_srt, in, 1, SAMPLE_MAX);
+}
+
+/// Obtain the size of the base payload of a format.
+/// @return size in bytes
+///
+/// @param[in] fver format version
+static uint64_t
+payload_size(const uint8_t fver)
+{
+  if (fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    return NEMO_PAYLOAD_COMPACT_SIZE;
+  }
+
+  return NEMO_PAYLOAD_SIZE;
+}
+
 /// Assign default values to all options.
 /// @return success/failure indication
 ///
@@ -385,8 +725,11 @@ set_defaults(struct config* cf)
   cf->cf_cnt  = DEF_COUNT;
   cf->cf_int  = DEF_INTERVAL;
   cf->cf_wait = DEF_FINAL_WAIT;
+  cf->cf_dead = DEF_DEADLINE;
   cf->cf_rbuf = DEF_RECEIVE_BUFFER;
   cf->cf_sbuf = DEF_SEND_BUFFER;
+  cf->cf_rcap = 0;
+  cf->cf_scap = 0;
   cf->cf_err  = DEF_EXIT_ON_ERROR;
   cf->cf_port = DEF_UDP_PORT;
   cf->cf_ttl  = DEF_TIME_TO_LIVE;
@@ -396,9 +739,26 @@ set_defaults(struct config* cf)
   cf->cf_grp  = DEF_GROUP;
   cf->cf_key  = DEF_KEY;
   cf->cf_len  = DEF_LENGTH;
+  cf->cf_fver = DEF_FORMAT;
   cf->cf_llvl = (log_lvl = DEF_LOG_LEVEL);
   cf->cf_lcol = (log_col = DEF_LOG_COLOR);
-  cf->cf_ipv4 = DEF_PROTO_VERSION_4;
+  cf->cf_ipv4 = false;
+  cf->cf_ipv6 = false;
+  cf->cf_clk  = DEF_CLOCK;
+  cf->cf_lbe  = DEF_LOG_BACKEND;
+  cf->cf_stat = DEF_STATS;
+  cf->cf_prom = NULL;
+  cf->cf_nwk  = DEF_WORKERS;
+  cf->cf_ncpu = 0;
+  cf->cf_spl  = DEF_SPLIT;
+  cf->cf_busy = DEF_BUSY;
+  cf->cf_prio = CPU_PRIO_NONE;
+  cf->cf_acc  = DEF_ACCEL;
+  cf->cf_sim  = false;
+  (void)memset(&cf->cf_mdl, 0, sizeof(cf->cf_mdl));
+  cf->cf_smp  = SAMPLE_NONE;
+  cf->cf_sev  = 1;
+  cf->cf_srt  = 0;
 
   return true;
 }
@@ -443,33 +803,50 @@ parse_config(struct config* cf, int argc, char* argv[])
   bool retb;
   uint64_t i;
   char optdsl[128];
-  struct option opts[20] = {
+  struct option opts[37] = {
+    { '4',  false, option_4 },
     { '6',  false, option_6 },
+    { 'A',  true,  option_A },
+    { 'b',  false, option_b },
+    { 'C',  true,  option_C },
     { 'a',  true , option_a },
     { 'c',  true,  option_c },
+    { 'd',  true,  option_d },
     { 'e',  false, option_e },
+    { 'f',  true,  option_f },
     { 'g',  false, option_g },
     { 'h',  false, option_h },
     { 'i',  true , option_i },
     { 'j',  true , option_j },
     { 'k',  true , option_k },
     { 'l',  true , option_l },
+    { 'L',  true,  option_L },
     { 'm',  false, option_m },
+    { 'M',  false, option_M },
     { 'n',  false, option_n },
+    { 'N',  true,  option_N },
     { 'p',  true , option_p },
+    { 'P',  true , option_P },
     { 'q',  false, option_q },
     { 'r',  true , option_r },
+    { 'R',  true,  option_R },
     { 's',  true , option_s },
+    { 'S',  true,  option_S },
     { 't',  true , option_t },
+    { 'T',  true,  option_T },
     { 'u',  true,  option_u },
     { 'v',  false, option_v },
-    { 'w',  true,  option_w }
+    { 'w',  true,  option_w },
+    { 'x',  false, option_x },
+    { 'y',  true,  option_y },
+    { 'Y',  true,  option_Y },
+    { 'z',  true,  option_z }
   };
 
   log(LL_INFO, false, "parsing command-line options");
 
   (void)memset(optdsl, '\0', sizeof(optdsl));
-  generate_getopt_string(optdsl, opts, 20);
+  generate_getopt_string(optdsl, opts, 37);
 
   // Set optional arguments to sensible defaults.
   set_defaults(cf);
@@ -491,7 +868,7 @@ parse_config(struct config* cf, int argc, char* argv[])
     }
 
     // Find the relevant option.
-    for (i = 0; i < 20; i++) {
+    for (i = 0; i < 37; i++) {
       if (opts[i].op_name == (char)opt) {
         retb = opts[i].op_act(cf, optarg);
         if (retb == false) {
@@ -504,6 +881,29 @@ parse_config(struct config* cf, int argc, char* argv[])
     }
   }
 
+  // Use the default protocol unless any was selected.
+  if (cf->cf_ipv4 == false && cf->cf_ipv6 == false) {
+    cf->cf_ipv4 = DEF_PROTO_VERSION_4;
+    cf->cf_ipv6 = !DEF_PROTO_VERSION_4;
+  }
+
+  // Derive the payload length from the format, or verify that the selected
+  // length can hold it.
+  if (cf->cf_len == 0) {
+    cf->cf_len = payload_size(cf->cf_fver);
+  } else if (cf->cf_len < payload_size(cf->cf_fver)) {
+    log(LL_WARN, false, "payload length must be at least %" PRIu64 " bytes",
+        payload_size(cf->cf_fver));
+    return false;
+  }
+
+  // The accelerated clock would distort the round-trip times of a real
+  // network.
+  if (cf->cf_acc != 1 && cf->cf_sim == false) {
+    log(LL_WARN, false, "clock acceleration requires the simulated network");
+    return false;
+  }
+
   // Verify that there are no positional arguments.
   if (optind == argc) {
     log(LL_WARN, false, "at least one target expected");
@@ -546,10 +946,16 @@ log_config(const struct config* cf)
   const char* err;
   const char* grp;
   const char* ipv;
+  const char* spl;
+  const char* stat;
+  const char* busy;
   char key[32];
   char len[32];
   char wait[32];
   char rld[32];
+  char cpu[256];
+  uint64_t i;
+  int reti;
 
   // Monologue mode.
   if (cf->cf_mono == true) {
@@ -565,6 +971,27 @@ log_config(const struct config* cf)
     err = "no";
   }
 
+  // Separate receiver threads.
+  if (cf->cf_spl == true) {
+    spl = "yes";
+  } else {
+    spl = "no";
+  }
+
+  // Live statistics.
+  if (cf->cf_stat == true) {
+    stat = "yes";
+  } else {
+    stat = "no";
+  }
+
+  // Busy mode.
+  if (cf->cf_busy == true) {
+    busy = "yes";
+  } else {
+    busy = "no";
+  }
+
   // Round type.
   if (cf->cf_grp == true) {
     grp = "grouped";
@@ -573,7 +1000,9 @@ log_config(const struct config* cf)
   }
 
   // Internet protocol version.
-  if (cf->cf_ipv4 == true) {
+  if (cf->cf_ipv4 == true && cf->cf_ipv6 == true) {
+    ipv = "IPv4 and IPv6";
+  } else if (cf->cf_ipv4 == true) {
     ipv = "IPv4";
   } else {
     ipv = "IPv6";
@@ -607,17 +1036,63 @@ log_config(const struct config* cf)
     (void)snprintf(rld, sizeof(rld), "%" PRIu64 "ns", cf->cf_rld);
   }
 
+  // CPU affinity.
+  (void)memset(cpu, '\0', sizeof(cpu));
+  if (cf->cf_ncpu == 0) {
+    (void)strncpy(cpu, "any", sizeof(cpu) - 1);
+  } else {
+    reti = 0;
+    for (i = 0; i < cf->cf_ncpu && reti >= 0 && (size_t)reti < sizeof(cpu); i++) {
+      reti += snprintf(cpu + reti, sizeof(cpu) - (size_t)reti, "%s%" PRIu64,
+                       i == 0 ? "" : ",", cf->cf_cpu[i]);
+    }
+  }
+
   log(LL_DEBUG, false, "responder UDP port: %" PRIu64, cf->cf_port);
   log(LL_DEBUG, false, "unique key: %s", key);
   log(LL_DEBUG, false, "number of rounds: %" PRIu64, cf->cf_cnt);
   log(LL_DEBUG, false, "request pattern: %s", grp);
   log(LL_DEBUG, false, "time-to-live: %" PRIu64, cf->cf_ttl);
   log(LL_DEBUG, false, "final wait: %s", wait);
+  log(LL_DEBUG, false, "response deadline: %" PRIu64 "ns", cf->cf_dead);
   log(LL_DEBUG, false, "name resolution window: %s", rld);
   log(LL_DEBUG, false, "payload length: %s", len);
+  log(LL_DEBUG, false, "payload format: %s",
+      cf->cf_fver == NEMO_PAYLOAD_VERSION_COMPACT ? "compact" : "full");
   log(LL_DEBUG, false, "receive buffer size: %" PRIu64 "%c", cf->cf_rbuf, 'B');
+  if (cf->cf_rcap != 0) {
+    log(LL_DEBUG, false, "receive buffer ceiling: %" PRIu64 "%c", cf->cf_rcap, 'B');
+  }
   log(LL_DEBUG, false, "send buffer size: %" PRIu64 "%c", cf->cf_sbuf, 'B');
+  if (cf->cf_scap != 0) {
+    log(LL_DEBUG, false, "send buffer ceiling: %" PRIu64 "%c", cf->cf_scap, 'B');
+  }
   log(LL_DEBUG, false, "internet protocol version: %s", ipv);
   log(LL_DEBUG, false, "exit on error: %s", err);
   log(LL_DEBUG, false, "monologue mode: %s", mono);
+  log(LL_DEBUG, false, "clock source: %s", clock_name(cf->cf_clk));
+  log(LL_DEBUG, false, "logging back-end: %s", log_backend_name(cf->cf_lbe));
+  log(LL_DEBUG, false, "live statistics: %s", stat);
+  log(LL_DEBUG, false, "metrics socket: %s", cf->cf_prom == NULL ? "none" : cf->cf_prom);
+  log(LL_DEBUG, false, "worker threads: %" PRIu64, cf->cf_nwk);
+  log(LL_DEBUG, false, "worker CPU affinity: %s", cpu);
+  log(LL_DEBUG, false, "separate receiver threads: %s", spl);
+  log(LL_DEBUG, false, "busy mode: %s", busy);
+  if (cf->cf_prio != CPU_PRIO_NONE) {
+    log(LL_DEBUG, false, "real-time priority: %" PRIu64, cf->cf_prio);
+  }
+  if (cf->cf_smp != SAMPLE_NONE) {
+    log(LL_DEBUG, false, "report sampling: %s, 1 in %" PRIu64,
+        sampling_name(cf->cf_smp), cf->cf_sev);
+  }
+  if (cf->cf_srt != 0) {
+    log(LL_DEBUG, false, "report rate limit: %" PRIu64 " rows/s", cf->cf_srt);
+  }
+  if (cf->cf_sim == true) {
+    log(LL_DEBUG, false, "simulated round-trip time: %" PRIu64 "ns", cf->cf_mdl.md_lat);
+    log(LL_DEBUG, false, "simulated jitter: %" PRIu64 "ns", cf->cf_mdl.md_jit);
+    log(LL_DEBUG, false, "simulated loss: %" PRIu64 "ppm", cf->cf_mdl.md_loss);
+    log(LL_DEBUG, false, "simulated reordering: %" PRIu64 "ppm", cf->cf_mdl.md_reo);
+    log(LL_DEBUG, false, "clock acceleration: %" PRIu64 "x", cf->cf_acc);
+  }
 }
@@ -0,0 +1,241 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "common/channel.h"
+#include "common/hist.h"
+#include "common/log.h"
+#include "common/now.h"
+#include "common/packet.h"
+#include "ureq/funcs.h"
+#include "ureq/types.h"
+
+
+/// Allocate the queues of requests deferred due to a full send buffer, one
+/// for each channel, so that a blocked channel never holds back the requests
+/// of another one.
+/// @return success/failure indication
+///
+/// @param[in] wk worker
+bool
+create_deferrals(struct worker* wk)
+{
+  uint64_t i;
+
+  for (i = 0; i < CHAN_MAX; i++) {
+    wk->wk_def[i].df_q = calloc(DEFER_MAX, sizeof(*wk->wk_def[i].df_q));
+    if (wk->wk_def[i].df_q == NULL) {
+      log(LL_WARN, true, "unable to allocate memory for deferred requests");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Release the queues of deferred requests.
+///
+/// @param[in] wk worker
+void
+delete_deferrals(struct worker* wk)
+{
+  uint64_t i;
+
+  for (i = 0; i < CHAN_MAX; i++) {
+    free(wk->wk_def[i].df_q);
+    wk->wk_def[i].df_q = NULL;
+  }
+}
+
+/// Count the requests that remain deferred on all channels of a worker. The
+/// function can be called from any thread.
+/// @return number of deferred requests
+///
+/// @param[in] wk worker
+uint64_t
+count_deferrals(const struct worker* wk)
+{
+  uint64_t cnt;
+  uint64_t i;
+
+  cnt = 0;
+  for (i = 0; i < wk->wk_nch; i++) {
+    cnt += __atomic_load_n(&wk->wk_def[i].df_cnt, __ATOMIC_RELAXED);
+  }
+
+  return cnt;
+}
+
+/// Register the sockets of the channels with deferred requests for the write
+/// events.
+/// @return highest descriptor incremented by one
+///
+/// @param[in] wk  worker
+/// @param[in] wfd write file descriptors
+int
+watch_deferrals(const struct worker* wk, fd_set* wfd)
+{
+  uint64_t i;
+  int nfds;
+
+  nfds = 0;
+  for (i = 0; i < wk->wk_nch; i++) {
+    // Simulated channels never defer their requests.
+    if (wk->wk_def[i].df_cnt == 0 || wk->wk_ch[i].ch_sim != NULL) {
+      continue;
+    }
+
+    FD_SET(wk->wk_ch[i].ch_sock, wfd);
+    if (wk->wk_ch[i].ch_sock + 1 > nfds) {
+      nfds = wk->wk_ch[i].ch_sock + 1;
+    }
+  }
+
+  return nfds;
+}
+
+/// Send the deferred requests of a channel in their original order, until
+/// its send buffer is full again. The delay of each request behind its first
+/// attempt is recorded.
+/// @return success/failure indication
+///
+/// @param[in] wk  worker
+/// @param[in] idx index of the channel
+/// @param[in] cf  configuration
+static bool
+flush_channel(struct worker* wk, const uint64_t idx, const struct config* cf)
+{
+  struct deferral* df;
+  struct parcel* pc;
+  uint64_t cur;
+  bool full;
+  bool retb;
+
+  df = &wk->wk_def[idx];
+  while (df->df_cnt > 0) {
+    pc = &df->df_q[df->df_old];
+    retb = offer_packet(&wk->wk_ch[idx], &pc->pc_pl, &pc->pc_addr, &full, cf->cf_err);
+    if (retb == false) {
+      log(LL_WARN, false, "unable to send a deferred request");
+      return false;
+    }
+
+    if (full == true) {
+      break;
+    }
+
+    cur = mono_now();
+    update_hist(&wk->wk_hdef, cur > pc->pc_pl.pl_mtm1 ? cur - pc->pc_pl.pl_mtm1 : 0);
+    df->df_old = (df->df_old + 1) & (DEFER_MAX - 1);
+    __atomic_store_n(&df->df_cnt, df->df_cnt - 1, __ATOMIC_RELAXED);
+  }
+
+  return true;
+}
+
+/// Send the deferred requests of all channels. A channel whose send buffer is
+/// still full does not hold back the other channels.
+/// @return success/failure indication
+///
+/// @param[in] wk worker
+/// @param[in] cf configuration
+bool
+flush_deferrals(struct worker* wk, const struct config* cf)
+{
+  uint64_t i;
+  bool retb;
+
+  for (i = 0; i < wk->wk_nch; i++) {
+    retb = flush_channel(wk, i, cf);
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Decide whether a request can be posted to a channel, after an attempt to
+/// send its older deferred requests. A request is rejected only if it would
+/// be deferred behind a full queue, so that the decision is known before the
+/// departure of the request is announced.
+/// @return success/failure indication
+///
+/// @param[in]  wk   worker
+/// @param[in]  ch   channel
+/// @param[out] room request can be sent or deferred
+/// @param[in]  cf   configuration
+bool
+admit_request(struct worker* wk,
+              const struct channel* ch,
+              bool* room,
+              const struct config* cf)
+{
+  uint64_t idx;
+  bool retb;
+
+  // Attempt to send the older requests first, as the send buffer might have
+  // drained since the last attempt.
+  idx  = (uint64_t)(ch - wk->wk_ch);
+  retb = flush_channel(wk, idx, cf);
+  if (retb == false) {
+    return false;
+  }
+
+  *room = wk->wk_def[idx].df_cnt < DEFER_MAX;
+  if (*room == false) {
+    log(LL_DEBUG, false, "deferral queue of the %s channel is full", ch->ch_name);
+    __atomic_store_n(&wk->wk_ndrop, wk->wk_ndrop + 1, __ATOMIC_RELAXED);
+  }
+
+  return true;
+}
+
+/// Send an admitted request, or defer it in case the send buffer of its
+/// channel is full. A request is deferred also while older requests of its
+/// channel remain deferred, so that the order of the requests is preserved.
+/// @return success/failure indication
+///
+/// @param[in] wk   worker
+/// @param[in] ch   channel
+/// @param[in] pl   payload in host byte order
+/// @param[in] addr IPv4/IPv6 address
+/// @param[in] cf   configuration
+bool
+post_request(struct worker* wk,
+             struct channel* ch,
+             const struct payload* pl,
+             const struct sockaddr_storage* addr,
+             const struct config* cf)
+{
+  struct deferral* df;
+  struct parcel* pc;
+  bool full;
+  bool retb;
+
+  df = &wk->wk_def[ch - wk->wk_ch];
+  if (df->df_cnt == 0) {
+    retb = offer_packet(ch, pl, addr, &full, cf->cf_err);
+    if (retb == false || full == false) {
+      return retb;
+    }
+  }
+
+  pc = &df->df_q[(df->df_old + df->df_cnt) & (DEFER_MAX - 1)];
+  (void)memcpy(&pc->pc_pl, pl, sizeof(*pl));
+  (void)memcpy(&pc->pc_addr, addr, sizeof(*addr));
+  __atomic_store_n(&df->df_cnt, df->df_cnt + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&wk->wk_ndef, wk->wk_ndef + 1, __ATOMIC_RELAXED);
+
+  return true;
+}
@@ -21,31 +21,16 @@
 #include "common/convert.h"
 #include "common/now.h"
 #include "common/signal.h"
+#include "common/stats.h"
 #include "common/packet.h"
+#include "common/ring.h"
+#include "common/sim.h"
 #include "ureq/funcs.h"
 #include "ureq/types.h"
 
 
-/// Create a part of a IPv6 address by converting array of bytes into a
-/// single integer.
-/// @return portion of IPv6 address
-///
-/// @param[in] ab address bytes
-static uint64_t
-ipv6_part(const uint8_t* ab)
-{
-  uint64_t res;
-  uint8_t i;
-
-  res = 0;
-  for (i = 0; i < 8; i++) {
-    res |= ((uint64_t)ab[i] << (i * 8));
-  }
-
-  return res;
-}
-
-/// Retrieve the IP address from a socket address.
+/// Retrieve the IP address from a socket address. IPv4 addresses are
+/// retrieved in their IPv4-mapped IPv6 form, same as the targets.
 ///
 /// @param[out] la low address bits
 /// @param[out] ha high address bits
@@ -60,25 +45,101 @@ retrieve_address(uint64_t* la,
 
   // Cast the address to the appropriate format based on the address family.
   if (ss->ss_family == AF_INET) {
-    s4  = (struct sockaddr_in*)ss;
-    *la = (uint64_t)s4->sin_addr.s_addr;
-    *ha = (uint64_t)0;
+    s4 = (struct sockaddr_in*)ss;
+    fipv4(la, ha, s4->sin_addr);
   } else {
-    s6  = (struct sockaddr_in6*)ss;
-    *la = ipv6_part(&s6->sin6_addr.s6_addr[0]);
-    *ha = ipv6_part(&s6->sin6_addr.s6_addr[7]);
+    s6 = (struct sockaddr_in6*)ss;
+    fipv6(la, ha, s6->sin6_addr);
+  }
+}
+
+/// Account for all departures announced by the sender and insert them into
+/// the in-flight table.
+///
+/// @param[in] wk worker
+/// @param[in] hn local host name
+/// @param[in] cf configuration
+static void
+drain_departures(struct worker* wk,
+                 const char hn[static NEMO_HOST_NAME_SIZE],
+                 const struct config* cf)
+{
+  struct departure dp;
+
+  while (pop_ring(&wk->wk_dep, &dp) == true) {
+    __atomic_store_n(&wk->wk_nsent, wk->wk_nsent + 1, __ATOMIC_RELAXED);
+    depart_flight(wk, &dp, hn, cf);
+  }
+}
+
+/// Account for and report a received response.
+///
+/// @param[in] wk  worker
+/// @param[in] pl  payload in host byte order
+/// @param[in] ss  IPv4/IPv6 address of the responder
+/// @param[in] ttl time-to-live value
+/// @param[in] hn  local host name
+/// @param[in] cf  configuration
+static void
+process_response(struct worker* wk,
+                 struct payload* pl,
+                 const struct sockaddr_storage* ss,
+                 const uint8_t ttl,
+                 const char hn[static NEMO_HOST_NAME_SIZE],
+                 const struct config* cf)
+{
+  uint64_t real;
+  uint64_t mono;
+  uint64_t la;
+  uint64_t ha;
+  uint64_t rtt;
+  uint8_t out;
+
+  // Retrieve the address of the responder.
+  retrieve_address(&la, &ha, ss);
+
+  // The sequence length is not transmitted in the compact format.
+  if (pl->pl_fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    pl->pl_slen = cf->cf_cnt;
+  }
+
+  // Capture the time of arrival of the response.
+  real = real_now();
+  mono = mono_now();
+
+  // Match the response against its request. The separate receiver might
+  // not have learned about the departure of the request yet.
+  out = land_flight(wk, &rtt, pl, la, ha, mono, hn, cf);
+  if (out == OUTCOME_UNKNOWN && cf->cf_spl == true) {
+    drain_departures(wk, hn, cf);
+    out = land_flight(wk, &rtt, pl, la, ha, mono, hn, cf);
+  }
+
+  // Account for the response.
+  __atomic_store_n(&wk->wk_nrecv, wk->wk_nrecv + 1, __ATOMIC_RELAXED);
+  if (out == OUTCOME_UNKNOWN) {
+    __atomic_store_n(&wk->wk_nunk, wk->wk_nunk + 1, __ATOMIC_RELAXED);
+  }
+  if (wk->wk_peer != NULL && (out == OUTCOME_OK || out == OUTCOME_LATE)) {
+    record_rtt(wk, la, ha, rtt);
   }
+
+  // Create a report entry based on the received payload.
+  report_event(wk, pl, hn, real, mono, ttl, la, ha, rtt, out, cf);
+
+  // TODO notify plugins
 }
 
-/// Handle a network event by attempting to receive responses on all available sockets.
+/// Handle a network event by attempting to receive responses on all available
+/// sockets and simulated channels.
 /// @return success/failure indication
 ///
-/// @param[in] ch  channel
+/// @param[in] wk  worker
 /// @param[in] rfd read file descriptors
 /// @param[in] hn  local host name
 /// @param[in] cf  configuration
 static bool
-handle_event(struct channel* ch,
+handle_event(struct worker* wk,
              const fd_set* rfd,
              const char hn[static NEMO_HOST_NAME_SIZE],
              const struct config* cf)
@@ -88,39 +149,152 @@ handle_event(struct channel* ch,
   struct payload pl;
   struct sockaddr_storage ss;
   uint8_t ttl;
-  uint64_t real;
-  uint64_t mono;
-  uint64_t la;
-  uint64_t ha;
+  uint64_t i;
+  bool got;
 
   // Ignore the event in case we are in the monologue mode.
   if (cf->cf_mono == true) {
     return true;
   }
 
-  // Ensure that there is data available on the channel.
-  reti = FD_ISSET(ch->ch_sock, rfd);
-  if (reti == 0) {
-    return true;
+  for (i = 0; i < wk->wk_nch; i++) {
+    // Receive all responses that have arrived through the simulated network.
+    if (wk->wk_ch[i].ch_sim != NULL) {
+      while (true) {
+        retb = poll_packet(&wk->wk_ch[i], &ss, &pl, &ttl, &got, cf->cf_err);
+        if (retb == false) {
+          return false;
+        }
+
+        if (got == false) {
+          break;
+        }
+
+        process_response(wk, &pl, &ss, ttl, hn, cf);
+      }
+
+      continue;
+    }
+
+    // Ensure that there is data available on the channel.
+    reti = FD_ISSET(wk->wk_ch[i].ch_sock, rfd);
+    if (reti == 0) {
+      continue;
+    }
+
+    // Receive the incoming packet.
+    retb = receive_packet(&wk->wk_ch[i], &ss, &pl, &ttl, cf->cf_err);
+    if (retb == false) {
+      return false;
+    }
+
+    process_response(wk, &pl, &ss, ttl, hn, cf);
   }
 
-  // Receive the incoming packet.
-  retb = receive_packet(ch, &ss, &pl, &ttl, cf->cf_err);
-  if (retb == false) {
-    return false;
+  return true;
+}
+
+/// Register the sockets of all channels of a worker for the read events.
+/// @return highest descriptor incremented by one
+///
+/// @param[in] wk  worker
+/// @param[in] rfd read file descriptors
+static int
+watch_channels(const struct worker* wk, fd_set* rfd)
+{
+  uint64_t i;
+  int nfds;
+
+  nfds = 0;
+  for (i = 0; i < wk->wk_nch; i++) {
+    // Simulated channels have no socket.
+    if (wk->wk_ch[i].ch_sim != NULL) {
+      continue;
+    }
+
+    FD_SET(wk->wk_ch[i].ch_sock, rfd);
+    if (wk->wk_ch[i].ch_sock + 1 > nfds) {
+      nfds = wk->wk_ch[i].ch_sock + 1;
+    }
   }
 
-  // Retrieve the address of the responder.
-  retrieve_address(&la, &ha, &ss);
+  return nfds;
+}
 
-  // Capture the time of arrival of the response.
-  real = real_now();
-  mono = mono_now();
+/// Limit the waiting for events by the arrival of the earliest response in
+/// the simulated network, as no socket event signals it.
+/// @return time to wait
+///
+/// @param[in] wk   worker
+/// @param[in] cur  current monotonic time
+/// @param[in] left time to wait otherwise
+static uint64_t
+await_arrival(struct worker* wk, const uint64_t cur, const uint64_t left)
+{
+  uint64_t due;
+  uint64_t res;
+  uint64_t i;
 
-  // Create a report entry based on the received payload.
-  report_event(&pl, hn, real, mono, ttl, la, ha, cf);
+  res = left;
+  for (i = 0; i < wk->wk_nch; i++) {
+    if (wk->wk_ch[i].ch_sim == NULL) {
+      continue;
+    }
 
-  // TODO notify plugins
+    due = next_sim(&wk->wk_ch[i]);
+    if (due <= cur) {
+      return 0;
+    }
+
+    if (due - cur < res) {
+      res = due - cur;
+    }
+  }
+
+  return res;
+}
+
+/// Spin on non-blocking receives of responses for a selected duration of
+/// time. This function is used instead of waiting for the socket events in
+/// the busy mode.
+/// @return success/failure indication
+///
+/// @param[in] wk  worker
+/// @param[in] dur duration of spinning
+/// @param[in] hn  local host name
+/// @param[in] cf  configuration
+static bool
+spin_events(struct worker* wk,
+            const uint64_t dur,
+            const char hn[static NEMO_HOST_NAME_SIZE],
+            const struct config* cf)
+{
+  bool retb;
+  bool got;
+  struct payload pl;
+  struct sockaddr_storage ss;
+  uint8_t ttl;
+  uint64_t start;
+  uint64_t i;
+
+  // There is nothing to receive in the monologue mode.
+  if (cf->cf_mono == true) {
+    return true;
+  }
+
+  start = mono_now();
+  do {
+    for (i = 0; i < wk->wk_nch; i++) {
+      retb = poll_packet(&wk->wk_ch[i], &ss, &pl, &ttl, &got, cf->cf_err);
+      if (retb == false) {
+        return false;
+      }
+
+      if (got == true) {
+        process_response(wk, &pl, &ss, ttl, hn, cf);
+      }
+    }
+  } while (mono_now() - start < dur);
 
   return true;
 }
@@ -131,11 +305,12 @@ handle_event(struct channel* ch,
 /// @global sint
 /// @global sterm
 /// @global susr1
+/// @global shup
 ///
-/// @param[in] ch channel
+/// @param[in] wk worker
 /// @param[in] cf configuration
 static bool
-handle_interrupt(const struct channel* ch, const struct config* cf)
+handle_interrupt(const struct worker* wk, const struct config* cf)
 {
   log(LL_TRACE, false, "handling interrupt");
 
@@ -154,7 +329,7 @@ handle_interrupt(const struct channel* ch, const struct config* cf)
   // Print logging information and continue the process upon receiving SIGUSR1.
   if (susr1 == true) {
     log_config(cf);
-    log_channel(ch);
+    log_workers(wk, cf);
 
     // Reset the signal indicator, so that following signal handling will avoid
     // the false positive.
@@ -162,6 +337,12 @@ handle_interrupt(const struct channel* ch, const struct config* cf)
     return true;
   }
 
+  // Continue the process upon receiving SIGHUP, as the targets get re-loaded
+  // at the start of the next round.
+  if (shup == true) {
+    return true;
+  }
+
   log(LL_WARN, false, "unknown interrupt occurred");
   return false;
 }
@@ -174,12 +355,12 @@ handle_interrupt(const struct channel* ch, const struct config* cf)
 /// @global sterm
 /// @global susr1
 ///
-/// @param[in] ch  channel
+/// @param[in] wk  worker
 /// @param[in] dur duration to wait for responses
 /// @param[in] hn  local host name
 /// @param[in] cf  configuration
 bool
-wait_for_events(struct channel* ch,
+wait_for_events(struct worker* wk,
                 const uint64_t dur,
                 const char hn[static NEMO_HOST_NAME_SIZE],
                 const struct config* cf)
@@ -187,13 +368,25 @@ wait_for_events(struct channel* ch,
   int reti;
   uint64_t cur;
   uint64_t goal;
+  uint64_t left;
   struct timespec todo;
   fd_set rfd;
+  fd_set wfd;
+  int nfds;
+  int pfds;
   sigset_t mask;
+  sigset_t* pmask;
   bool retb;
 
-  // Create the signal mask used for enabling signals during the pselect(2) waiting.
-  create_signal_mask(&mask);
+  // Create the signal mask used for enabling signals during the pselect(2)
+  // waiting. Workers running in their own threads keep all signals blocked,
+  // as these are handled by the main thread.
+  if (wk->wk_sig == true) {
+    create_signal_mask(&mask);
+    pmask = &mask;
+  } else {
+    pmask = NULL;
+  }
 
   // Set the goal time to be in the future.
   cur  = mono_now();
@@ -201,22 +394,62 @@ wait_for_events(struct channel* ch,
 
   // Repeat the waiting process until the sufficient time has passed.
   while (cur < goal) {
-    log(LL_TRACE, false, "waiting for responses");
+    if (cf->cf_busy == false) {
+      log(LL_TRACE, false, "waiting for responses");
+    }
+
+    // Compute the time left to wait for the responses. Workers without
+    // signal delivery wake up periodically to observe termination requests,
+    // and the live statistics are published periodically too.
+    left = goal - cur;
+    if (wk->wk_sig == false && left > WORKER_TICK) {
+      left = WORKER_TICK;
+    }
+    if (wk->wk_stc != NULL && left > STATS_PERIOD) {
+      left = STATS_PERIOD;
+    }
+
+    // In the busy mode, spin on the receives for a while, and then only
+    // check the remaining events without waiting.
+    if (cf->cf_busy == true) {
+      if (cf->cf_spl == false) {
+        retb = spin_events(wk, left < POLL_PERIOD ? left : POLL_PERIOD, hn, cf);
+        if (retb == false) {
+          return false;
+        }
+      }
+      left = 0;
+    }
 
-    // Compute the time left to wait for the responses.
-    fnanos(&todo, goal - cur);
+    // The responses of the simulated network arrive without any event, and
+    // the accelerated clock shortens the actual waiting.
+    if (cf->cf_sim == true && cf->cf_spl == false && cf->cf_mono == false) {
+      left = await_arrival(wk, cur, left);
+    }
+    fnanos(&todo, wall_span(left));
 
-    // Ensure that all relevant events are registered.
+    // Ensure that all relevant events are registered. The sender does not
+    // wait for responses if these are handled by a separate receiver.
     FD_ZERO(&rfd);
-    FD_SET(ch->ch_sock, &rfd);
+    FD_ZERO(&wfd);
+    if (cf->cf_spl == true) {
+      nfds = 0;
+    } else {
+      nfds = watch_channels(wk, &rfd);
+    }
+
+    // Await the room in the send buffers for the deferred requests.
+    pfds = watch_deferrals(wk, &wfd);
+    if (pfds > nfds) {
+      nfds = pfds;
+    }
 
-    // Start waiting on events. The number of file descriptors is based on the fact
-    // that the process is expected to have three standard streams open, plus socket, plus one.
-    reti = pselect(4, &rfd, NULL, NULL, &todo, &mask);
+    // Start waiting on events.
+    reti = pselect(nfds, &rfd, &wfd, NULL, &todo, pmask);
     if (reti == -1) {
       // Check for interrupt (possibly due to a signal).
       if (errno == EINTR) {
-        retb = handle_interrupt(ch, cf);
+        retb = handle_interrupt(wk, cf);
         if (retb == true) {
           continue;
         }
@@ -229,16 +462,131 @@ wait_for_events(struct channel* ch,
     }
 
     // Handle the network events by receiving and reporting responses.
-    if (reti > 0) {
-      retb = handle_event(ch, &rfd, hn, cf);
+    if (reti > 0 || (cf->cf_sim == true && cf->cf_spl == false)) {
+      retb = handle_event(wk, &rfd, hn, cf);
       if (retb == false) {
         return false;
       }
     }
 
+    // Send the deferred requests once their channels become writable.
+    if (reti > 0 && count_deferrals(wk) > 0) {
+      retb = flush_deferrals(wk, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+
+    // Observe the termination requests delivered to the main thread.
+    if (wk->wk_sig == false && (sint == true || sterm == true)) {
+      return false;
+    }
+
     // Update the current time.
     cur = mono_now();
+    publish_worker(wk, cur, false);
+
+    // Expire the requests past their deadline, unless these are owned by a
+    // separate receiver thread.
+    if (cf->cf_spl == false) {
+      sweep_flights(wk, cur, false, hn, cf);
+    }
   }
 
   return true;
 }
+
+/// Receive and report responses until the sender finishes. This function is
+/// executed by the receiver thread in case the sending and receiving are
+/// separated, so that neither delays the other.
+/// @return success/failure indication
+///
+/// @global sint
+/// @global sterm
+///
+/// @param[in] wk worker
+/// @param[in] hn local host name
+/// @param[in] cf configuration
+bool
+receive_loop(struct worker* wk,
+             const char hn[static NEMO_HOST_NAME_SIZE],
+             const struct config* cf)
+{
+  int reti;
+  bool retb;
+  fd_set rfd;
+  struct timespec tick;
+  uint64_t nrcv;
+  int nfds;
+
+  log(LL_INFO, false, "starting the receiver of worker %" PRIu64, wk->wk_idx);
+
+  fnanos(&tick, wall_span(WORKER_TICK));
+  while (__atomic_load_n(&wk->wk_stop, __ATOMIC_ACQUIRE) == false) {
+    // Observe the termination requests delivered to the main thread.
+    if (sint == true || sterm == true) {
+      return false;
+    }
+
+    // In the busy mode, spin on the receives instead of waiting for them.
+    if (cf->cf_busy == true) {
+      nrcv = wk->wk_nrecv;
+      retb = spin_events(wk, POLL_PERIOD, hn, cf);
+      if (retb == false) {
+        return false;
+      }
+
+      drain_departures(wk, hn, cf);
+      sweep_flights(wk, mono_now(), false, hn, cf);
+
+      // Publish the collected reports when there were no responses.
+      if (wk->wk_nrecv == nrcv) {
+        retb = flush_report_buffer(wk, cf);
+        if (retb == false) {
+          return false;
+        }
+      }
+
+      continue;
+    }
+
+    FD_ZERO(&rfd);
+    nfds = watch_channels(wk, &rfd);
+
+    // Wake up upon the arrival of the earliest simulated response.
+    if (cf->cf_sim == true) {
+      fnanos(&tick, wall_span(await_arrival(wk, mono_now(), WORKER_TICK)));
+    }
+
+    // Wait for responses. All signals remain blocked in this thread.
+    reti = pselect(nfds, &rfd, NULL, NULL, &tick, NULL);
+    if (reti == -1) {
+      log(LL_WARN, true, "waiting for responses failed");
+      return false;
+    }
+
+    drain_departures(wk, hn, cf);
+    sweep_flights(wk, mono_now(), false, hn, cf);
+
+    // Publish the collected reports when there are no responses to handle.
+    nrcv = wk->wk_nrecv;
+    if (reti > 0 || cf->cf_sim == true) {
+      retb = handle_event(wk, &rfd, hn, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+
+    if (wk->wk_nrecv == nrcv) {
+      retb = flush_report_buffer(wk, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+  }
+
+  // Requests still in flight are not going to be answered anymore.
+  drain_departures(wk, hn, cf);
+  sweep_flights(wk, mono_now(), true, hn, cf);
+  return flush_report_buffer(wk, cf);
+}
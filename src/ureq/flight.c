@@ -0,0 +1,478 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common/log.h"
+#include "common/payload.h"
+#include "ureq/funcs.h"
+#include "ureq/types.h"
+
+
+/// Allocate the table of in-flight requests. Each target obtains a ring deep
+/// enough to recognize responses up to twice their deadline, and the table of
+/// targets is twice the size of the target limit, so that the probe sequences
+/// remain short.
+/// @return success/failure indication
+///
+/// @param[in] wk worker
+/// @param[in] cf configuration
+bool
+create_flights(struct worker* wk, const struct config* cf)
+{
+  uint64_t i;
+
+  wk->wk_fdep = FLIGHT_DEPTH_MIN;
+  while (wk->wk_fdep < FLIGHT_DEPTH_MAX
+      && wk->wk_fdep < 2 * (cf->cf_dead / cf->cf_int + 1)) {
+    wk->wk_fdep *= 2;
+  }
+
+  wk->wk_nlan = 1;
+  while (wk->wk_nlan < 2 * cf->cf_ntg) {
+    wk->wk_nlan *= 2;
+  }
+
+  wk->wk_lane = calloc((size_t)wk->wk_nlan, sizeof(*wk->wk_lane));
+  if (wk->wk_lane == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for in-flight targets");
+    return false;
+  }
+
+  wk->wk_flt = calloc((size_t)cf->cf_ntg,
+                      (size_t)wk->wk_fdep * sizeof(*wk->wk_flt));
+  if (wk->wk_flt == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for in-flight requests");
+    return false;
+  }
+
+  wk->wk_fre = calloc((size_t)cf->cf_ntg, sizeof(*wk->wk_fre));
+  if (wk->wk_fre == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for in-flight rings");
+    return false;
+  }
+
+  for (i = 0; i < cf->cf_ntg; i++) {
+    wk->wk_fre[i] = i;
+  }
+  wk->wk_fscn = FLIGHT_SCAN;
+
+  return true;
+}
+
+/// Find the in-flight requests of a target. Targets are added to the table
+/// upon their first request, and removed once they leave the table of
+/// targets (see reclaim_lanes).
+/// @return in-flight requests of the target (or NULL)
+///
+/// @param[in] wk  worker
+/// @param[in] la  low address bits of the target
+/// @param[in] ha  high address bits of the target
+/// @param[in] add add the target if not present
+/// @param[in] cf  configuration
+static struct lane*
+find_lane(struct worker* wk,
+          const uint64_t la,
+          const uint64_t ha,
+          const bool add,
+          const struct config* cf)
+{
+  struct lane* ln;
+  uint64_t idx;
+  uint64_t i;
+
+  idx = hash_address(la, ha);
+  for (i = 0; i < wk->wk_nlan; i++) {
+    ln = &wk->wk_lane[(idx + i) & (wk->wk_nlan - 1)];
+
+    if (ln->ln_used == false) {
+      // Each target occupies one of the preallocated rings.
+      if (add == false || wk->wk_ulan >= cf->cf_ntg) {
+        return NULL;
+      }
+
+      ln->ln_laddr = la;
+      ln->ln_haddr = ha;
+      ln->ln_fl    = &wk->wk_flt[wk->wk_fre[wk->wk_ulan] * wk->wk_fdep];
+      ln->ln_old   = 0;
+      ln->ln_new   = 0;
+      ln->ln_gen   = 0;
+      ln->ln_used  = true;
+      wk->wk_ulan++;
+    }
+
+    if (ln->ln_laddr == la && ln->ln_haddr == ha) {
+      return ln;
+    }
+  }
+
+  return NULL;
+}
+
+/// Remove a target from the table of in-flight requests and release its ring.
+/// The following targets of the probe sequence are shifted backwards to fill
+/// the gap, so that no target becomes unreachable.
+///
+/// @param[in] wk  worker
+/// @param[in] idx index of the target in the table
+static void
+remove_lane(struct worker* wk, uint64_t idx)
+{
+  struct lane* ln;
+  uint64_t mask;
+  uint64_t home;
+  uint64_t i;
+
+  mask = wk->wk_nlan - 1;
+  ln   = &wk->wk_lane[idx];
+
+  wk->wk_ulan--;
+  wk->wk_fre[wk->wk_ulan] = (uint64_t)(ln->ln_fl - wk->wk_flt) / wk->wk_fdep;
+  ln->ln_used = false;
+
+  i = idx;
+  while (true) {
+    i  = (i + 1) & mask;
+    ln = &wk->wk_lane[i];
+    if (ln->ln_used == false) {
+      break;
+    }
+
+    // The target can fill the gap unless its home slot lies between the gap
+    // and its current slot.
+    home = hash_address(ln->ln_laddr, ln->ln_haddr) & mask;
+    if (((i - home) & mask) >= ((i - idx) & mask)) {
+      wk->wk_lane[idx] = *ln;
+      ln->ln_used      = false;
+      idx              = i;
+    }
+  }
+}
+
+/// Find the slot of the request answered by a response, unless the slot was
+/// already reused. The responder includes its key in the response only if it
+/// filters the requests by the key, and otherwise overwrites it with zero.
+/// @return request (or NULL)
+///
+/// @param[in] wk worker
+/// @param[in] ln in-flight requests of the target
+/// @param[in] pl payload in host byte order
+static struct flight*
+find_slot(const struct worker* wk,
+          const struct lane* ln,
+          const struct payload* pl)
+{
+  struct flight* fl;
+
+  if (pl->pl_snum >= ln->ln_new || ln->ln_new - pl->pl_snum > wk->wk_fdep) {
+    return NULL;
+  }
+
+  fl = &ln->ln_fl[pl->pl_snum & (wk->wk_fdep - 1)];
+  if (fl->fl_stat == FLIGHT_EMPTY || fl->fl_snum != pl->pl_snum) {
+    return NULL;
+  }
+
+  if (pl->pl_key != 0 && fl->fl_key != pl->pl_key) {
+    return NULL;
+  }
+
+  return fl;
+}
+
+/// Find the request answered by a response. The responder is expected to be
+/// the target of the request, but responders with multiple addresses might
+/// answer from any of them. Such responses are matched by the departure time
+/// echoed in the payload against the requests of other targets, searching at
+/// most FLIGHT_SCAN targets in each sweep period.
+/// @return request (or NULL)
+///
+/// @param[in]  wk worker
+/// @param[out] ln in-flight requests of the target
+/// @param[in]  pl payload in host byte order
+/// @param[in]  la low address bits of the responder
+/// @param[in]  ha high address bits of the responder
+/// @param[in]  cf configuration
+static struct flight*
+find_flight(struct worker* wk,
+            struct lane** ln,
+            const struct payload* pl,
+            const uint64_t la,
+            const uint64_t ha,
+            const struct config* cf)
+{
+  struct flight* fl;
+  struct flight* alt;
+  struct lane* own;
+  uint64_t i;
+
+  fl  = NULL;
+  own = find_lane(wk, la, ha, false, cf);
+  if (own != NULL) {
+    fl = find_slot(wk, own, pl);
+    if (fl != NULL && fl->fl_mono == pl->pl_mtm1) {
+      *ln = own;
+      return fl;
+    }
+  }
+
+  for (i = 0; i < wk->wk_nlan && wk->wk_fscn > 0; i++) {
+    if (wk->wk_lane[i].ln_used == false || &wk->wk_lane[i] == own) {
+      continue;
+    }
+
+    wk->wk_fscn--;
+    alt = find_slot(wk, &wk->wk_lane[i], pl);
+    if (alt != NULL && alt->fl_mono == pl->pl_mtm1) {
+      *ln = &wk->wk_lane[i];
+      return alt;
+    }
+  }
+
+  // The responder might not echo the departure time faithfully.
+  *ln = own;
+  return fl;
+}
+
+/// Account for and report a request that did not receive its response in
+/// time.
+///
+/// @param[in] wk worker
+/// @param[in] ln in-flight requests of the target
+/// @param[in] fl request
+/// @param[in] hn local host name
+/// @param[in] cf configuration
+static void
+expire_flight(struct worker* wk,
+              const struct lane* ln,
+              struct flight* fl,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              const struct config* cf)
+{
+  fl->fl_stat = FLIGHT_EXPIRED;
+  __atomic_store_n(&wk->wk_nlost, wk->wk_nlost + 1, __ATOMIC_RELAXED);
+  report_loss(wk, fl, ln->ln_laddr, ln->ln_haddr, OUTCOME_LOST, hn, cf);
+}
+
+/// Settle the oldest request of a target, so that its slot can be reused.
+/// Requests still awaiting their response are expired.
+///
+/// @param[in] wk worker
+/// @param[in] ln in-flight requests of the target
+/// @param[in] hn local host name
+/// @param[in] cf configuration
+static void
+settle_oldest(struct worker* wk,
+              struct lane* ln,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              const struct config* cf)
+{
+  struct flight* fl;
+
+  // Rounds that skipped the target leave stale slots behind.
+  fl = &ln->ln_fl[ln->ln_old & (wk->wk_fdep - 1)];
+  if (fl->fl_snum == ln->ln_old && fl->fl_stat == FLIGHT_PENDING) {
+    expire_flight(wk, ln, fl, hn, cf);
+  }
+
+  ln->ln_old++;
+}
+
+/// Insert a departed request into the in-flight table. In case the ring of
+/// the target is full, its oldest requests are expired before their deadline.
+/// Requests dropped by the requester are reported right away, and never
+/// expire. This function must be called only by the thread receiving the
+/// responses.
+///
+/// @param[in] wk worker
+/// @param[in] dp departure of the request
+/// @param[in] hn local host name
+/// @param[in] cf configuration
+void
+depart_flight(struct worker* wk,
+              const struct departure* dp,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              const struct config* cf)
+{
+  struct lane* ln;
+  struct flight* fl;
+
+  if (wk->wk_lane == NULL) {
+    return;
+  }
+
+  // Track the generations of the table of targets, so that the targets
+  // which left the table can be recognized.
+  if (dp->dp_gen > wk->wk_lgen) {
+    wk->wk_lgen = dp->dp_gen;
+    wk->wk_lrnd = dp->dp_snum;
+  }
+  if (dp->dp_snum >= wk->wk_lnew) {
+    wk->wk_lnew = dp->dp_snum + 1;
+  }
+
+  ln = find_lane(wk, dp->dp_laddr, dp->dp_haddr, true, cf);
+  if (ln == NULL) {
+    return;
+  }
+
+  // Each target is issued at most one request in a round.
+  if (dp->dp_snum < ln->ln_new) {
+    return;
+  }
+
+  while (ln->ln_old < ln->ln_new && dp->dp_snum - ln->ln_old >= wk->wk_fdep) {
+    settle_oldest(wk, ln, hn, cf);
+  }
+  if (ln->ln_old == ln->ln_new) {
+    ln->ln_old = dp->dp_snum;
+  }
+
+  fl = &ln->ln_fl[dp->dp_snum & (wk->wk_fdep - 1)];
+  fl->fl_snum = dp->dp_snum;
+  fl->fl_key  = cf->cf_key;
+  fl->fl_mono = dp->dp_mono;
+  fl->fl_real = dp->dp_real;
+  fl->fl_dead = dp->dp_mono + cf->cf_dead;
+  fl->fl_stat = FLIGHT_PENDING;
+  ln->ln_new  = dp->dp_snum + 1;
+  ln->ln_gen  = dp->dp_gen;
+
+  if (dp->dp_drop == true) {
+    fl->fl_stat = FLIGHT_DROPPED;
+    report_loss(wk, fl, ln->ln_laddr, ln->ln_haddr, OUTCOME_DROPPED, hn, cf);
+  }
+}
+
+/// Match a response against its request in the in-flight table and compute
+/// the round-trip time. This function must be called only by the thread
+/// receiving the responses.
+/// @return outcome of the request (one of OUTCOME_*)
+///
+/// @param[in]  wk   worker
+/// @param[out] rtt  round-trip time
+/// @param[in]  pl   payload in host byte order
+/// @param[in]  la   low address bits of the responder
+/// @param[in]  ha   high address bits of the responder
+/// @param[in]  mono monotonic time of the receipt
+/// @param[in]  hn   local host name
+/// @param[in]  cf   configuration
+uint8_t
+land_flight(struct worker* wk,
+            uint64_t* rtt,
+            const struct payload* pl,
+            const uint64_t la,
+            const uint64_t ha,
+            const uint64_t mono,
+            const char hn[static NEMO_HOST_NAME_SIZE],
+            const struct config* cf)
+{
+  struct lane* ln;
+  struct flight* fl;
+
+  *rtt = 0;
+  if (wk->wk_lane == NULL) {
+    return OUTCOME_UNKNOWN;
+  }
+
+  fl = find_flight(wk, &ln, pl, la, ha, cf);
+  if (fl == NULL) {
+    return OUTCOME_UNKNOWN;
+  }
+
+  if (mono > fl->fl_mono) {
+    *rtt = mono - fl->fl_mono;
+  }
+
+  if (fl->fl_stat == FLIGHT_ANSWERED) {
+    __atomic_store_n(&wk->wk_ndup, wk->wk_ndup + 1, __ATOMIC_RELAXED);
+    return OUTCOME_DUP;
+  }
+
+  // The request is lost even if its deadline passed only since the last
+  // expiry, so that the outcome does not depend on the timing of expiries.
+  if (fl->fl_stat == FLIGHT_PENDING && mono > fl->fl_dead) {
+    expire_flight(wk, ln, fl, hn, cf);
+  }
+
+  if (fl->fl_stat == FLIGHT_EXPIRED) {
+    fl->fl_stat = FLIGHT_ANSWERED;
+    __atomic_store_n(&wk->wk_nlate, wk->wk_nlate + 1, __ATOMIC_RELAXED);
+    return OUTCOME_LATE;
+  }
+
+  fl->fl_stat = FLIGHT_ANSWERED;
+  return OUTCOME_OK;
+}
+
+/// Expire all requests that are past their deadline, unless these were
+/// expired recently, and release the targets that left the table of targets.
+/// This function must be called only by the thread receiving the responses.
+///
+/// @param[in] wk    worker
+/// @param[in] cur   current monotonic time
+/// @param[in] force expire all requests regardless of their deadline
+/// @param[in] hn    local host name
+/// @param[in] cf    configuration
+void
+sweep_flights(struct worker* wk,
+              const uint64_t cur,
+              const bool force,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              const struct config* cf)
+{
+  struct lane* ln;
+  struct flight* fl;
+  uint64_t i;
+
+  if (wk->wk_lane == NULL) {
+    return;
+  }
+
+  if (force == false && cur < wk->wk_fswp) {
+    return;
+  }
+  wk->wk_fswp = cur + FLIGHT_SWEEP;
+  wk->wk_fscn = FLIGHT_SCAN;
+
+  i = 0;
+  while (i < wk->wk_nlan) {
+    ln = &wk->wk_lane[i];
+    if (ln->ln_used == false) {
+      i++;
+      continue;
+    }
+
+    // Requests to a target depart in the order of their sequence numbers,
+    // and so do their deadlines expire.
+    while (ln->ln_old < ln->ln_new) {
+      fl = &ln->ln_fl[ln->ln_old & (wk->wk_fdep - 1)];
+      if (force == false
+       && fl->fl_snum == ln->ln_old
+       && fl->fl_stat == FLIGHT_PENDING
+       && fl->fl_dead >= cur) {
+        break;
+      }
+
+      settle_oldest(wk, ln, hn, cf);
+    }
+
+    // Targets without a request since the first full round of a newer table
+    // generation have left the table. Their rings are released once all of
+    // their requests are settled. The slot is examined again, as another
+    // target might have been shifted into it.
+    if (ln->ln_old == ln->ln_new
+     && ln->ln_gen < wk->wk_lgen
+     && wk->wk_lnew > wk->wk_lrnd + 1) {
+      remove_lane(wk, i);
+      continue;
+    }
+
+    i++;
+  }
+}
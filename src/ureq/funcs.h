@@ -4,11 +4,15 @@
 // Distributed under the terms of the 2-clause BSD License. The full
 // license is in the file LICENSE, distributed as part of this software.
 
+#include <arpa/inet.h>
+#include <sys/select.h>
+
 #include <stdlib.h>
 #include <stdint.h>
 
 #include "common/channel.h"
 #include "common/payload.h"
+#include "common/prom.h"
 #include "ureq/types.h"
 
 
@@ -16,41 +20,117 @@
 bool parse_config(struct config* cf, int argc, char* argv[]);
 void log_config(const struct config* cf);
 
+// Deferral.
+bool create_deferrals(struct worker* wk);
+void delete_deferrals(struct worker* wk);
+uint64_t count_deferrals(const struct worker* wk);
+int watch_deferrals(const struct worker* wk, fd_set* wfd);
+bool flush_deferrals(struct worker* wk, const struct config* cf);
+bool admit_request(struct worker* wk,
+                   const struct channel* ch,
+                   bool* room,
+                   const struct config* cf);
+bool post_request(struct worker* wk,
+                  struct channel* ch,
+                  const struct payload* pl,
+                  const struct sockaddr_storage* addr,
+                  const struct config* cf);
+
 // Event.
-bool wait_for_events(struct channel* ch,
+bool wait_for_events(struct worker* wk,
                      const uint64_t dur,
                      const char hn[static NEMO_HOST_NAME_SIZE],
                      const struct config* cf);
+bool receive_loop(struct worker* wk,
+                  const char hn[static NEMO_HOST_NAME_SIZE],
+                  const struct config* cf);
+
+// Flight.
+bool create_flights(struct worker* wk, const struct config* cf);
+void depart_flight(struct worker* wk,
+                   const struct departure* dp,
+                   const char hn[static NEMO_HOST_NAME_SIZE],
+                   const struct config* cf);
+uint8_t land_flight(struct worker* wk,
+                    uint64_t* rtt,
+                    const struct payload* pl,
+                    const uint64_t la,
+                    const uint64_t ha,
+                    const uint64_t mono,
+                    const char hn[static NEMO_HOST_NAME_SIZE],
+                    const struct config* cf);
+void sweep_flights(struct worker* wk,
+                   const uint64_t cur,
+                   const bool force,
+                   const char hn[static NEMO_HOST_NAME_SIZE],
+                   const struct config* cf);
 
 // Loop.
-bool request_loop(struct channel* ch, struct target* tg, const struct config* cf);
+bool request_loop(struct worker* wk,
+                  struct table* tb,
+                  const char hn[static NEMO_HOST_NAME_SIZE],
+                  const struct config* cf);
+
+// Metrics.
+bool create_peers(struct worker* wk, const struct config* cf);
+void record_rtt(struct worker* wk,
+                const uint64_t la,
+                const uint64_t ha,
+                const uint64_t rtt);
+void expose_workers(struct prom* pr, void* arg);
 
 // Report.
 void report_header(const struct config* cf);
-void report_event(const struct payload* hpl,
+void report_event(struct worker* wk,
+                  const struct payload* hpl,
                   const char hn[static NEMO_HOST_NAME_SIZE],
                   const uint64_t real,
                   const uint64_t mono,
                   const uint8_t ttl,
                   const uint64_t la,
                   const uint64_t ha,
+                  const uint64_t rtt,
+                  const uint8_t out,
                   const struct config* cf);
+void report_loss(struct worker* wk,
+                 const struct flight* fl,
+                 const uint64_t la,
+                 const uint64_t ha,
+                 const uint8_t out,
+                 const char hn[static NEMO_HOST_NAME_SIZE],
+                 const struct config* cf);
+bool flush_report_buffer(struct worker* wk, const struct config* cf);
 bool flush_report_stream(const struct config* cf);
 
 // Round.
-bool dispersed_round(struct channel* ch,
-                     const struct target* tg,
-                     const uint64_t ntg,
+bool dispersed_round(struct worker* wk,
                      const uint64_t snum,
                      const char hn[static NEMO_HOST_NAME_SIZE],
                      const struct config* cf);
-bool grouped_round(struct channel* ch,
-                   const struct target* tg,
-                   const uint64_t ntg,
+bool grouped_round(struct worker* wk,
                    const uint64_t snum,
                    const char hn[static NEMO_HOST_NAME_SIZE],
                    const struct config* cf);
 
 // Target.
-void log_targets(const struct target tg[], const uint64_t cnt, const struct config* cf);
+uint64_t hash_address(const uint64_t la, const uint64_t ha);
+void format_address(char str[static INET6_ADDRSTRLEN],
+                    const uint64_t la,
+                    const uint64_t ha);
+void log_targets(const struct target tg[], const uint64_t cnt);
+void normalize_targets(struct target* tg, uint64_t* nlen, const uint64_t olen);
 bool load_targets(struct target* tg, uint64_t* cnt, const struct config* cf);
+bool init_table(struct table* tb, const struct config* cf);
+bool refresh_targets(struct worker* wk, struct table* tb, const struct config* cf);
+void free_table(struct table* tb);
+
+// Worker.
+bool create_workers(struct worker** wk, const struct config* cf);
+bool run_workers(struct worker* wk,
+                 struct table* tb,
+                 const char hn[static NEMO_HOST_NAME_SIZE],
+                 const struct config* cf);
+void log_workers(const struct worker* wk, const struct config* cf);
+bool attach_stats(struct worker* wk, struct stats* st, const struct config* cf);
+void publish_worker(struct worker* wk, const uint64_t cur, const bool force);
+void delete_workers(struct worker* wk, const struct config* cf);
@@ -13,11 +13,8 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include <unistd.h>
-#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <errno.h>
 #include <inttypes.h>
 
 #include "common/channel.h"
@@ -30,91 +27,63 @@
 #include "ureq/types.h"
 
 
-/// Main request loop.
+/// Main request loop of a worker.
 /// @return success/failure indication
 ///
-/// @global shup
-///
-/// @param[in] ch channel
-/// @param[in] tg array of targets
+/// @param[in] wk worker
+/// @param[in] tb shared table of targets
+/// @param[in] hn local host name
 /// @param[in] cf configuration
 bool
-request_loop(struct channel* ch, struct target* tg, const struct config* cf)
+request_loop(struct worker* wk,
+             struct table* tb,
+             const char hn[static NEMO_HOST_NAME_SIZE],
+             const struct config* cf)
 {
   uint64_t i;
-  uint64_t ntg;
-  uint64_t rld;
-  uint64_t now;
+  uint64_t k;
   bool retb;
-  int reti;
-  char hn[NEMO_HOST_NAME_SIZE];
-  int err;
-
-  // Log the current configuration.
-  log_config(cf);
 
-  // Obtain the host name.
-  (void)memset(hn, 0, sizeof(hn));
-  reti = gethostname(hn, sizeof(hn) - 1);
-  if (reti == -1) {
-    // Save the errno value so that it can be examined later.
-    err = errno;
-
-    log(LL_WARN, true, "unable to obtain host name");
+  for (i = 0; i < cf->cf_cnt; i++) {
+    log(LL_TRACE, false, "round %" PRIu64 " out of %" PRIu64, i + 1, cf->cf_cnt);
 
-    // Truncation of the host name is acceptable.
-    if (err != ENAMETOOLONG) {
+    // Obtain the current partition of targets, possibly re-loading them.
+    retb = refresh_targets(wk, tb, cf);
+    if (retb == false) {
+      log(LL_WARN, false, "unable to re-load targets");
       return false;
     }
-  }
-
-  // Print the CSV header of the standard output.
-  report_header(cf);
-
-  // Load all targets at start.
-  retb = load_targets(tg, &ntg, cf);
-  if (retb == false) {
-    log(LL_WARN, false, "unable to load targets");
-    return false;
-  }
-
-  // Set the next reload time to be in the future.
-  now = mono_now();
-  rld = now + cf->cf_rld;
-
-  for (i = 0; i < cf->cf_cnt; i++) {
-    log(LL_TRACE, false, "round %" PRIu64 " out of %" PRIu64, i + 1, cf->cf_cnt);
 
-    // Check if name resolution needs to happen. This code contains a possible
-    // race condition, in case a repeated SIGHUP signal appears between the
-    // comparison and the clearing the `shup` flag. This is a conscious
-    // decision, since the target re-loading is already in progress and will
-    // therefore happen imminently, but only once (in case of two or more
-    // SIGHUPs in immediate consequence).
-    now = mono_now();
-    if (now > rld || shup == true) {
-      // Clear the SIGHUP flag.
-      shup = false;
-
-      // Re-load targets.
-      retb = load_targets(tg, &ntg, cf);
-      if (retb == false) {
-        log(LL_WARN, false, "unable to re-load targets");
-        return false;
+    // Grow the socket buffers that are sized adaptively. Grouped rounds
+    // issue all requests at once, and the responses arrive likewise.
+    for (k = 0; k < wk->wk_nch; k++) {
+      if (cf->cf_grp == true) {
+        adapt_channel(&wk->wk_ch[k], wk->wk_ntg * cf->cf_len);
+      } else {
+        adapt_channel(&wk->wk_ch[k], cf->cf_len);
       }
-
-      // Update the next refresh time.
-      rld = now + cf->cf_rld;
     }
 
     // Select the appropriate type of issuing requests in the round.
     if (cf->cf_grp == true) {
-      retb = grouped_round(ch, tg, ntg, i, hn, cf);
+      retb = grouped_round(wk, i, hn, cf);
       if (retb == false) {
         return false;
       }
     } else {
-      retb = dispersed_round(ch, tg, ntg, i, hn, cf);
+      retb = dispersed_round(wk, i, hn, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+
+    wk->wk_nrnd++;
+    publish_worker(wk, mono_now(), false);
+
+    // Publish the reports collected during the round, unless the reports
+    // are owned by a separate receiver thread.
+    if (cf->cf_spl == false) {
+      retb = flush_report_buffer(wk, cf);
       if (retb == false) {
         return false;
       }
@@ -124,11 +93,23 @@ request_loop(struct channel* ch, struct target* tg, const struct config* cf)
   // Await events after issuing all requests. The intention is to wait for
   // potential responses to the last few requests.
   log(LL_TRACE, false, "waiting for final events");
-  retb = wait_for_events(ch, cf->cf_wait, hn, cf);
+  retb = wait_for_events(wk, cf->cf_wait, hn, cf);
   if (retb == false) {
     log(LL_WARN, false, "unable to wait for final events");
     return false;
   }
 
-  return true;
+  // Requests still in flight are not going to be answered anymore, unless
+  // these are owned by a separate receiver thread.
+  if (cf->cf_spl == false) {
+    sweep_flights(wk, mono_now(), true, hn, cf);
+  }
+
+  publish_worker(wk, mono_now(), true);
+
+  if (cf->cf_spl == true) {
+    return true;
+  }
+
+  return flush_report_buffer(wk, cf);
 }
@@ -5,22 +5,60 @@
 // license is in the file LICENSE, distributed as part of this software.
 
 #include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
 
 #include "common/channel.h"
+#include "common/cpu.h"
 #include "common/log.h"
+#include "common/now.h"
 #include "common/payload.h"
+#include "common/prom.h"
 #include "common/signal.h"
+#include "common/stats.h"
 #include "ureq/funcs.h"
 #include "ureq/types.h"
 
 
+/// Obtain the local host name.
+/// @return success/failure indication
+///
+/// @param[out] hn local host name
+static bool
+get_host_name(char hn[static NEMO_HOST_NAME_SIZE])
+{
+  int reti;
+  int err;
+
+  (void)memset(hn, 0, NEMO_HOST_NAME_SIZE);
+  reti = gethostname(hn, NEMO_HOST_NAME_SIZE - 1);
+  if (reti == -1) {
+    // Save the errno value so that it can be examined later.
+    err = errno;
+
+    log(LL_WARN, true, "unable to obtain host name");
+
+    // Truncation of the host name is acceptable.
+    if (err != ENAMETOOLONG) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 /// Unicast network requester.
 int
 main(int argc, char* argv[])
 {
-  struct target* tg;
+  struct worker* wk;
+  struct table tb;
+  struct stats st;
+  struct prom pr;
+  struct prom* ppr;
   struct config cf;
-  struct channel ch;
+  char hn[NEMO_HOST_NAME_SIZE];
   bool retb;
 
   // Parse command-line options.
@@ -30,6 +68,13 @@ main(int argc, char* argv[])
     return EXIT_FAILURE;
   }
 
+  // Move the logging output off the packet-handling threads.
+  retb = start_log(cf.cf_lbe, "ureq");
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to start the asynchronous logging");
+    return EXIT_FAILURE;
+  }
+
   // Verify that the compiled payload is exactly the expected size in bytes.
   if (sizeof(struct payload) != NEMO_PAYLOAD_SIZE) {
     log(LL_ERROR, false, "wrong payload size: expected %d, actual %zu",
@@ -37,43 +82,105 @@ main(int argc, char* argv[])
     return EXIT_FAILURE;
   }
 
-  // Install signal handlers.
+  if (sizeof(struct payload_compact) != NEMO_PAYLOAD_COMPACT_SIZE) {
+    log(LL_ERROR, false, "wrong compact payload size: expected %d, actual %zu",
+      NEMO_PAYLOAD_COMPACT_SIZE, sizeof(struct payload_compact));
+    return EXIT_FAILURE;
+  }
+
+  // Select the clock source for all timestamps.
+  retb = select_clock(cf.cf_clk);
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to select the %s clock source", clock_name(cf.cf_clk));
+    return EXIT_FAILURE;
+  }
+
+  // Run the clock faster in the simulated network. The acceleration has to
+  // start before any timestamps are taken.
+  if (cf.cf_acc != 1) {
+    accelerate_clock(cf.cf_acc);
+  }
+
+  // Install signal handlers. This has to happen before any worker threads
+  // are started, so that they inherit the blocked signal mask.
   retb = install_signal_handlers();
   if (retb == false) {
     log(LL_ERROR, false, "unable to install signal handlers");
     return EXIT_FAILURE;
   }
 
-  // Initialize the channel used to send and receive payloads.
-  retb = open_channel(&ch, cf.cf_ipv4, 0, cf.cf_rbuf, cf.cf_sbuf, (uint8_t)cf.cf_ttl);
+  // Log the current configuration.
+  log_config(&cf);
+
+  // Obtain the host name.
+  retb = get_host_name(hn);
   if (retb == false) {
-    log(LL_ERROR, false, "unable to create the %s channel", ch.ch_name);
+    log(LL_ERROR, false, "unable to obtain the host name");
     return EXIT_FAILURE;
   }
 
-  // Allocate the targets.
-  tg = calloc((size_t)cf.cf_ntg, sizeof(*tg));
-  if (tg == NULL) {
-    log(LL_ERROR, true, "unable to allocate memory for targets");
-    return false;
+  // Initialize the workers along with their channels used to send and receive
+  // payloads.
+  retb = create_workers(&wk, &cf);
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to create workers");
+    return EXIT_FAILURE;
   }
 
-  // Start issuing requests and waiting for responses.
-  retb = request_loop(&ch, tg, &cf);
+  // Avoid page faults while sending and receiving in the busy mode.
+  if (cf.cf_busy == true) {
+    (void)lock_memory();
+  }
+
+  // Publish the live statistics of all workers.
+  (void)memset(&st, 0, sizeof(st));
+  if (cf.cf_stat == true) {
+    retb = attach_stats(wk, &st, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to publish live statistics");
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Load the targets.
+  retb = init_table(&tb, &cf);
   if (retb == false) {
-    log(LL_ERROR, false, "the request loop has terminated");
+    log(LL_ERROR, false, "unable to load targets");
     return EXIT_FAILURE;
   }
 
-  // Deallocate target arrays.
-  free(tg);
-  free(cf.cf_tg);
+  // Print the CSV header of the standard output.
+  report_header(&cf);
 
-  // Close the channel.
-  close_channel(&ch);
+  // Serve the metrics endpoint.
+  ppr = NULL;
+  if (cf.cf_prom != NULL) {
+    retb = open_prom(&pr, cf.cf_prom, expose_workers, wk);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to serve metrics");
+      return EXIT_FAILURE;
+    }
+    ppr = &pr;
+  }
+
+  // Start issuing requests and waiting for responses.
+  retb = run_workers(wk, &tb, hn, &cf);
+  if (ppr != NULL) {
+    close_prom(ppr);
+  }
+  if (retb == false) {
+    log(LL_ERROR, false, "the request loop has terminated");
+    return EXIT_FAILURE;
+  }
 
   // Print final values of counters.
-  log_channel(&ch);
+  log_workers(wk, &cf);
+
+  // Close the channels and deallocate the targets.
+  delete_stats(&st);
+  delete_workers(wk, &cf);
+  free_table(&tb);
+  free(cf.cf_tg);
 
   // Flush the standard output and error streams.
   retb = flush_report_stream(&cf);
@@ -0,0 +1,250 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/socket.h>
+
+#include <arpa/inet.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/convert.h"
+#include "common/hist.h"
+#include "common/log.h"
+#include "common/prom.h"
+#include "ureq/funcs.h"
+#include "ureq/types.h"
+
+
+/// Allocate the table of round-trip times by responder. The table is twice
+/// the size of the target limit, so that the probe sequences remain short.
+/// @return success/failure indication
+///
+/// @param[in] wk worker
+/// @param[in] cf configuration
+bool
+create_peers(struct worker* wk, const struct config* cf)
+{
+  wk->wk_npeer = 1;
+  while (wk->wk_npeer < 2 * cf->cf_ntg) {
+    wk->wk_npeer *= 2;
+  }
+
+  wk->wk_peer = calloc((size_t)wk->wk_npeer, sizeof(*wk->wk_peer));
+  if (wk->wk_peer == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for round-trip times");
+    return false;
+  }
+
+  return true;
+}
+
+/// Account for the round-trip time of a response. Responders are added to
+/// the table upon their first response, and never removed. This function
+/// must be called only by the thread receiving the responses.
+///
+/// @param[in] wk  worker
+/// @param[in] la  low address bits of the responder
+/// @param[in] ha  high address bits of the responder
+/// @param[in] rtt round-trip time
+void
+record_rtt(struct worker* wk,
+           const uint64_t la,
+           const uint64_t ha,
+           const uint64_t rtt)
+{
+  struct peer* pe;
+  uint64_t idx;
+  uint64_t i;
+
+  idx = hash_address(la, ha);
+  for (i = 0; i < wk->wk_npeer; i++) {
+    pe = &wk->wk_peer[(idx + i) & (wk->wk_npeer - 1)];
+
+    if (pe->pe_used == false) {
+      // Stop tracking new responders once the table is half full.
+      if (2 * wk->wk_nused >= wk->wk_npeer) {
+        break;
+      }
+
+      // The slot is published after its address is set.
+      pe->pe_laddr = la;
+      pe->pe_haddr = ha;
+      __atomic_store_n(&pe->pe_used, true, __ATOMIC_RELEASE);
+      wk->wk_nused++;
+    }
+
+    if (pe->pe_laddr == la && pe->pe_haddr == ha) {
+      update_hist(&pe->pe_rtt, rtt);
+      return;
+    }
+  }
+
+  __atomic_store_n(&wk->wk_nmiss, wk->wk_nmiss + 1, __ATOMIC_RELAXED);
+}
+
+/// Render the per-worker counter.
+///
+/// @param[in] pr   metrics endpoint
+/// @param[in] wk   array of workers
+/// @param[in] nwk  number of workers
+/// @param[in] name name of the metric
+/// @param[in] help description of the metric
+/// @param[in] off  offset of the counter within the worker
+static void
+expose_counter(struct prom* pr,
+               const struct worker* wk,
+               const uint64_t nwk,
+               const char* name,
+               const char* help,
+               const size_t off)
+{
+  const uint64_t* val;
+  char lbl[64];
+  uint64_t i;
+
+  describe_metric(pr, name, "counter", help);
+  for (i = 0; i < nwk; i++) {
+    val = (const uint64_t*)((const char*)&wk[i] + off);
+    (void)snprintf(lbl, sizeof(lbl), "worker=\"%" PRIu64 "\"", i);
+    append_metric(pr, name, lbl, __atomic_load_n(val, __ATOMIC_RELAXED));
+  }
+}
+
+/// Render the channel counters of all workers. The channels of both protocol
+/// versions are aggregated, so that the counters are labelled by the worker
+/// only.
+///
+/// @param[in] pr metrics endpoint
+/// @param[in] wk array of workers
+/// @param[in] cf configuration
+static void
+expose_worker_channels(struct prom* pr,
+                       const struct worker* wk,
+                       const struct config* cf)
+{
+  struct channel* sum;
+  uint64_t i;
+  uint64_t k;
+
+  if (wk[0].wk_nch == 1) {
+    expose_channels(pr, &wk[0].wk_ch[0], sizeof(wk[0]), cf->cf_nwk, "worker");
+    return;
+  }
+
+  sum = calloc((size_t)cf->cf_nwk, sizeof(*sum));
+  if (sum == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for channel metrics");
+    return;
+  }
+
+  for (i = 0; i < cf->cf_nwk; i++) {
+    for (k = 0; k < wk[i].wk_nch; k++) {
+      merge_channel(&sum[i], &wk[i].wk_ch[k]);
+    }
+  }
+
+  expose_channels(pr, sum, sizeof(*sum), cf->cf_nwk, "worker");
+  free(sum);
+}
+
+/// Render the metrics of all workers. The values are read while the workers
+/// keep updating them, and no worker is ever blocked by the rendering.
+///
+/// @param[in] pr  metrics endpoint
+/// @param[in] arg array of workers
+void
+expose_workers(struct prom* pr, void* arg)
+{
+  const struct worker* wk;
+  const struct config* cf;
+  const struct peer* pe;
+  char addr[INET6_ADDRSTRLEN];
+  char lbl[128];
+  uint64_t i;
+  uint64_t k;
+
+  wk = arg;
+  cf = wk[0].wk_cf;
+
+  expose_worker_channels(pr, wk, cf);
+
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_rounds_total",
+                 "Finished request rounds.", offsetof(struct worker, wk_nrnd));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_requests_total",
+                 "Issued requests.", offsetof(struct worker, wk_nsent));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_responses_total",
+                 "Received responses.", offsetof(struct worker, wk_nrecv));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_rtt_untracked_total",
+                 "Responses from responders beyond the tracking limit.",
+                 offsetof(struct worker, wk_nmiss));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_requests_lost_total",
+                 "Requests without a response before the deadline.",
+                 offsetof(struct worker, wk_nlost));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_responses_late_total",
+                 "Responses that arrived after the deadline.",
+                 offsetof(struct worker, wk_nlate));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_responses_duplicate_total",
+                 "Repeated responses to an answered request.",
+                 offsetof(struct worker, wk_ndup));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_responses_unknown_total",
+                 "Responses to requests not in the in-flight table.",
+                 offsetof(struct worker, wk_nunk));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_requests_deferred_total",
+                 "Requests deferred due to a full send buffer.",
+                 offsetof(struct worker, wk_ndef));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_requests_deferral_dropped_total",
+                 "Requests dropped due to a full deferral queue.",
+                 offsetof(struct worker, wk_ndrop));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_report_rows_unsampled_total",
+                 "Report rows skipped by the sampling.",
+                 offsetof(struct worker, wk_smp.sp_nskip));
+  expose_counter(pr, wk, cf->cf_nwk, "nemo_report_rows_suppressed_total",
+                 "Sampled report rows suppressed by the rate limit.",
+                 offsetof(struct worker, wk_smp.sp_nsup));
+
+  if (cf->cf_spl == true) {
+    describe_metric(pr, "nemo_departures_dropped_total", "counter",
+                    "Departures lost between the sender and the receiver.");
+    for (i = 0; i < cf->cf_nwk; i++) {
+      (void)snprintf(lbl, sizeof(lbl), "worker=\"%" PRIu64 "\"", i);
+      append_metric(pr, "nemo_departures_dropped_total", lbl,
+                    __atomic_load_n(&wk[i].wk_dep.rg_drop, __ATOMIC_RELAXED));
+    }
+  }
+
+  describe_metric(pr, "nemo_schedule_lag_seconds", "histogram",
+                  "Lag of requests behind their scheduled departure.");
+  for (i = 0; i < cf->cf_nwk; i++) {
+    (void)snprintf(lbl, sizeof(lbl), "worker=\"%" PRIu64 "\"", i);
+    append_hist(pr, "nemo_schedule_lag_seconds", lbl, &wk[i].wk_hlag);
+  }
+
+  describe_metric(pr, "nemo_deferral_delay_seconds", "histogram",
+                  "Delay of deferred requests behind their first attempt.");
+  for (i = 0; i < cf->cf_nwk; i++) {
+    (void)snprintf(lbl, sizeof(lbl), "worker=\"%" PRIu64 "\"", i);
+    append_hist(pr, "nemo_deferral_delay_seconds", lbl, &wk[i].wk_hdef);
+  }
+
+  describe_metric(pr, "nemo_rtt_seconds", "histogram",
+                  "Round-trip time of requests by responder.");
+  for (i = 0; i < cf->cf_nwk; i++) {
+    for (k = 0; k < wk[i].wk_npeer; k++) {
+      pe = &wk[i].wk_peer[k];
+      if (__atomic_load_n(&pe->pe_used, __ATOMIC_ACQUIRE) == false) {
+        continue;
+      }
+
+      format_address(addr, pe->pe_laddr, pe->pe_haddr);
+      (void)snprintf(lbl, sizeof(lbl), "worker=\"%" PRIu64 "\",target=\"%s\"", i, addr);
+      append_hist(pr, "nemo_rtt_seconds", lbl, &pe->pe_rtt);
+    }
+  }
+}
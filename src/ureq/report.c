@@ -13,10 +13,14 @@
 
 #include "common/log.h"
 #include "common/convert.h"
+#include "common/sample.h"
 #include "ureq/funcs.h"
 #include "ureq/types.h"
 
 
+// Upper bound on the length of a single report line.
+#define REPORT_LINE_MAX 512
+
 /// Print the CSV header of the reporting output.
 ///
 /// @param[in] cf configuration
@@ -32,12 +36,46 @@ report_header(const struct config* cf)
   (void)printf("key,len,seq_num,seq_len,host_req,host_res,addr_res,port_res,"
                "ttl_dep_req,ttl_arr_res,ttl_dep_res,ttl_arr_req,"
                "real_dep_req,real_arr_res,real_arr_req,"
-               "mono_dep_req,mono_arr_res,mono_arr_req\n");
+               "mono_dep_req,mono_arr_res,mono_arr_req,rtt,status\n");
+}
+
+/// Obtain the name of a request outcome.
+/// @return outcome name
+///
+/// @param[in] out outcome
+static const char*
+outcome_name(const uint8_t out)
+{
+  switch (out) {
+    case OUTCOME_OK:      return "ok";
+    case OUTCOME_LATE:    return "late";
+    case OUTCOME_DUP:     return "dup";
+    case OUTCOME_LOST:    return "lost";
+    case OUTCOME_DROPPED: return "dropped";
+    default:              return "unknown";
+  }
 }
 
-/// Report the event of the incoming datagram by printing a CSV-formatted line
-/// to the standard output stream.
+/// Advance the report buffer of a worker past a formatted line.
 ///
+/// @param[in] wk   worker
+/// @param[in] reti return value of the formatting
+static void
+append_line(struct worker* wk, const int reti)
+{
+  // Drop the line in case it did not fit into the buffer.
+  if (reti < 0 || (uint64_t)reti >= REPORT_BUFFER_SIZE - wk->wk_rlen) {
+    log(LL_WARN, false, "unable to format the report line");
+    return;
+  }
+
+  wk->wk_rlen += (uint64_t)reti;
+}
+
+/// Report the event of the incoming datagram by appending a CSV-formatted line
+/// to the report buffer of the worker.
+///
+/// @param[in] wk   worker
 /// @param[in] pl   payload in host byte order
 /// @param[in] hn   local host name
 /// @param[in] real real-time of the receipt
@@ -45,40 +83,52 @@ report_header(const struct config* cf)
 /// @param[in] ttl  time-to-live upon receipt
 /// @param[in] la   low address of the responder
 /// @param[in] ha   high address of the responder
+/// @param[in] rtt  round-trip time
+/// @param[in] out  outcome of the request
 /// @param[in] cf   configuration
 void
-report_event(const struct payload* hpl,
+report_event(struct worker* wk,
+             const struct payload* hpl,
              const char hn[static NEMO_HOST_NAME_SIZE],
              const uint64_t real,
              const uint64_t mono,
              const uint8_t ttl,
              const uint64_t la,
              const uint64_t ha,
+             const uint64_t rtt,
+             const uint8_t out,
              const struct config* cf)
 {
   char addrstr[INET6_ADDRSTRLEN];
   char ttl2str[4];
   char ttl4str[4];
-  struct in_addr a4;
-  struct in6_addr a6;
+  char rttstr[21];
+  int reti;
 
   // No output to be performed if the silent mode was requested.
   if (cf->cf_sil == true) {
     return;
   }
 
-  (void)memset(addrstr, '\0', sizeof(addrstr));
+  // Skip the rows that were not sampled or exceed the rate limit. The
+  // responder replaces the key with its own, and therefore the key of the
+  // request is used, as seen by the responder.
+  if (sample_row(&wk->wk_smp, cf->cf_key, hpl->pl_snum) == false) {
+    return;
+  }
+
+  // Ensure that the line fits into the report buffer. The failure to flush
+  // the buffer is only reported, as the line can still be stored.
+  if (REPORT_BUFFER_SIZE - wk->wk_rlen < REPORT_LINE_MAX) {
+    (void)flush_report_buffer(wk, cf);
+  }
+
   (void)memset(ttl2str, '\0', sizeof(ttl2str));
   (void)memset(ttl4str, '\0', sizeof(ttl4str));
+  (void)memset(rttstr,  '\0', sizeof(rttstr));
 
   // Convert the IP address into a string.
-  if (cf->cf_ipv4 == true) {
-    a4.s_addr = (uint32_t)la;
-    (void)inet_ntop(AF_INET, &a4, addrstr, sizeof(addrstr));
-  } else {
-    tipv6(&a6, la, ha);
-    (void)inet_ntop(AF_INET6, &a6, addrstr, sizeof(addrstr));
-  }
+  format_address(addrstr, la, ha);
 
   // If no TTL was received, report it as not available.
   if (hpl->pl_ttl2 == 0) {
@@ -92,32 +142,141 @@ report_event(const struct payload* hpl,
   } else {
     (void)snprintf(ttl4str, sizeof(ttl4str), "%" PRIu8, ttl);
   }
+  // Responses to unknown requests have no round-trip time.
+  if (out == OUTCOME_UNKNOWN) {
+    (void)strncpy(rttstr, "N/A", sizeof(rttstr));
+  } else {
+    (void)snprintf(rttstr, sizeof(rttstr), "%" PRIu64, rtt);
+  }
 
-  (void)printf("%" PRIu64 ","   // key
-               "%" PRIu16 ","   // len
-               "%" PRIu64 ","   // seq_num
-               "%" PRIu64 ","   // seq_len
-               "%.*s,"          // host_req
-               "%.*s,"          // host_res
-               "%s,"            // addr_res
-               "%" PRIu64 ","   // port_res
-               "%" PRIu64 ","   // ttl_dep_req
-               "%s,"            // ttl_arr_res
-               "%" PRIu8  ","   // ttl_dep_res
-               "%s,"            // ttl_arr_req
-               "%" PRIu64 ","   // real_dep_req
-               "%" PRIu64 ","   // real_arr_res
-               "%" PRIu64 ","   // real_arr_req
-               "%" PRIu64 ","   // mono_dep_req
-               "%" PRIu64 ","   // mono_arr_res
-               "%" PRIu64 "\n", // mono_arr_req
-               hpl->pl_key, hpl->pl_len, hpl->pl_snum, hpl->pl_slen,
-               NEMO_HOST_NAME_SIZE, hn,
-               NEMO_HOST_NAME_SIZE, hpl->pl_host,
-               addrstr, cf->cf_port,
-               cf->cf_ttl, ttl2str, hpl->pl_ttl1, ttl4str,
-               hpl->pl_rtm1, hpl->pl_rtm2, real,
-               hpl->pl_mtm1, hpl->pl_mtm2, mono);
+  reti = snprintf(wk->wk_rep + wk->wk_rlen,
+                  (size_t)(REPORT_BUFFER_SIZE - wk->wk_rlen),
+                  "%" PRIu64 ","   // key
+                  "%" PRIu16 ","   // len
+                  "%" PRIu64 ","   // seq_num
+                  "%" PRIu64 ","   // seq_len
+                  "%.*s,"          // host_req
+                  "%.*s,"          // host_res
+                  "%s,"            // addr_res
+                  "%" PRIu64 ","   // port_res
+                  "%" PRIu64 ","   // ttl_dep_req
+                  "%s,"            // ttl_arr_res
+                  "%" PRIu8  ","   // ttl_dep_res
+                  "%s,"            // ttl_arr_req
+                  "%" PRIu64 ","   // real_dep_req
+                  "%" PRIu64 ","   // real_arr_res
+                  "%" PRIu64 ","   // real_arr_req
+                  "%" PRIu64 ","   // mono_dep_req
+                  "%" PRIu64 ","   // mono_arr_res
+                  "%" PRIu64 ","   // mono_arr_req
+                  "%s,"            // rtt
+                  "%s\n",          // status
+                  hpl->pl_key, hpl->pl_len, hpl->pl_snum, hpl->pl_slen,
+                  NEMO_HOST_NAME_SIZE, hn,
+                  NEMO_HOST_NAME_SIZE, hpl->pl_host,
+                  addrstr, cf->cf_port,
+                  cf->cf_ttl, ttl2str, hpl->pl_ttl1, ttl4str,
+                  hpl->pl_rtm1, hpl->pl_rtm2, real,
+                  hpl->pl_mtm1, hpl->pl_mtm2, mono,
+                  rttstr, outcome_name(out));
+  append_line(wk, reti);
+}
+
+/// Report a request that did not receive its response before the deadline,
+/// or that was dropped before being sent, by appending a CSV-formatted line
+/// to the report buffer of the worker. Only the fields known to the
+/// requester are filled in.
+///
+/// @param[in] wk  worker
+/// @param[in] fl  expired or dropped request
+/// @param[in] la  low address of the target
+/// @param[in] ha  high address of the target
+/// @param[in] out outcome of the request (OUTCOME_LOST or OUTCOME_DROPPED)
+/// @param[in] hn  local host name
+/// @param[in] cf  configuration
+void
+report_loss(struct worker* wk,
+            const struct flight* fl,
+            const uint64_t la,
+            const uint64_t ha,
+            const uint8_t out,
+            const char hn[static NEMO_HOST_NAME_SIZE],
+            const struct config* cf)
+{
+  char addrstr[INET6_ADDRSTRLEN];
+  int reti;
+
+  // No output to be performed if the silent mode was requested.
+  if (cf->cf_sil == true) {
+    return;
+  }
+
+  // Skip the rows that were not sampled or exceed the rate limit.
+  if (sample_row(&wk->wk_smp, fl->fl_key, fl->fl_snum) == false) {
+    return;
+  }
+
+  // Ensure that the line fits into the report buffer.
+  if (REPORT_BUFFER_SIZE - wk->wk_rlen < REPORT_LINE_MAX) {
+    (void)flush_report_buffer(wk, cf);
+  }
+
+  format_address(addrstr, la, ha);
+
+  reti = snprintf(wk->wk_rep + wk->wk_rlen,
+                  (size_t)(REPORT_BUFFER_SIZE - wk->wk_rlen),
+                  "%" PRIu64 ","    // key
+                  "%" PRIu64 ","    // len
+                  "%" PRIu64 ","    // seq_num
+                  "%" PRIu64 ","    // seq_len
+                  "%.*s,"           // host_req
+                  "N/A,"            // host_res
+                  "%s,"             // addr_res
+                  "%" PRIu64 ","    // port_res
+                  "%" PRIu64 ","    // ttl_dep_req
+                  "N/A,N/A,N/A,"    // ttl_arr_res, ttl_dep_res, ttl_arr_req
+                  "%" PRIu64 ","    // real_dep_req
+                  "N/A,N/A,"        // real_arr_res, real_arr_req
+                  "%" PRIu64 ","    // mono_dep_req
+                  "N/A,N/A,"        // mono_arr_res, mono_arr_req
+                  "N/A,"            // rtt
+                  "%s\n",           // status
+                  fl->fl_key, cf->cf_len, fl->fl_snum, cf->cf_cnt,
+                  NEMO_HOST_NAME_SIZE, hn,
+                  addrstr, cf->cf_port, cf->cf_ttl,
+                  fl->fl_real, fl->fl_mono,
+                  outcome_name(out));
+  append_line(wk, reti);
+}
+
+/// Write the contents of the report buffer of a worker to the standard
+/// output stream. The whole buffer is written by a single call, so that
+/// lines of different workers are never interleaved.
+/// @return success/failure indication
+///
+/// @param[in] wk worker
+/// @param[in] cf configuration
+bool
+flush_report_buffer(struct worker* wk, const struct config* cf)
+{
+  size_t len;
+  size_t act;
+
+  // No output to be performed if the silent mode was requested.
+  if (cf->cf_sil == true || wk->wk_rlen == 0) {
+    return true;
+  }
+
+  len = (size_t)wk->wk_rlen;
+  act = fwrite(wk->wk_rep, 1, len, stdout);
+  wk->wk_rlen = 0;
+
+  if (act != len) {
+    log(LL_WARN, true, "unable to write the report buffer");
+    return false;
+  }
+
+  return true;
 }
 
 /// Flush all data written to the standard output to their respective device.
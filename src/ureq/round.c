@@ -13,6 +13,8 @@
 #include "common/log.h"
 #include "common/now.h"
 #include "common/convert.h"
+#include "common/hist.h"
+#include "common/ring.h"
 #include "ureq/funcs.h"
 #include "ureq/types.h"
 
@@ -22,16 +24,18 @@
 /// @param[in] hpl  payload in host byte order
 /// @param[in] snum sequence number
 /// @param[in] hn   local host name
+/// @param[in] hid  identifier of the local host name
 /// @param[in] cf   configuration
 static void
 fill_payload(struct payload *hpl,
              const uint64_t snum,
              const char hn[static NEMO_HOST_NAME_SIZE],
+             const uint64_t hid,
              const struct config* cf)
 {
   (void)memset(hpl, 0, sizeof(*hpl));
   hpl->pl_mgic  = NEMO_PAYLOAD_MAGIC;
-  hpl->pl_fver  = NEMO_PAYLOAD_VERSION;
+  hpl->pl_fver  = NEMO_PAYLOAD_VERSION_FULL;
   hpl->pl_type  = NEMO_PAYLOAD_TYPE_REQUEST;
   hpl->pl_ttl1  = (uint8_t)cf->cf_ttl;
   hpl->pl_len   = (uint16_t)cf->cf_len;
@@ -41,26 +45,39 @@ fill_payload(struct payload *hpl,
   hpl->pl_rtm1  = real_now();
   hpl->pl_mtm1  = mono_now();
   (void)memcpy(hpl->pl_host, hn, NEMO_HOST_NAME_SIZE);
+  hpl->pl_hid   = hid;
+
+  // Compact requests are periodically replaced by full-size ones, so that
+  // the responders learn the host name behind the identifier.
+  if (cf->cf_fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    if (snum % NEMO_PAYLOAD_HELLO != 0) {
+      hpl->pl_fver = NEMO_PAYLOAD_VERSION_COMPACT;
+    } else if (hpl->pl_len < NEMO_PAYLOAD_SIZE) {
+      hpl->pl_len = NEMO_PAYLOAD_SIZE;
+    }
+  }
 }
 
 /// Convert the target address to a universal standard address type.
+/// @return IPv4 address indication
 ///
 /// @param[out] ss universal address type
 /// @param[in]  tg network target
 /// @param[in]  cf configuration
-static void
+static bool
 set_address(struct sockaddr_storage* ss,
             const struct target* tg,
             const struct config* cf)
 {
   struct sockaddr_in sin;
   struct sockaddr_in6 sin6;
+  bool ipv4;
 
-  if (cf->cf_ipv4 == true) {
-    (void)memset(&sin, 0, sizeof(sin));
-    sin.sin_family      = AF_INET;
-    sin.sin_port        = htons((uint16_t)cf->cf_port);
-    sin.sin_addr.s_addr = (uint32_t)tg->tg_laddr;
+  (void)memset(&sin, 0, sizeof(sin));
+  ipv4 = tipv4(&sin.sin_addr, tg->tg_laddr, tg->tg_haddr);
+  if (ipv4 == true) {
+    sin.sin_family = AF_INET;
+    sin.sin_port   = htons((uint16_t)cf->cf_port);
 
     (void)memcpy(ss, &sin, sizeof(sin));
   } else {
@@ -71,131 +88,257 @@ set_address(struct sockaddr_storage* ss,
 
     (void)memcpy(ss, &sin6, sizeof(sin6));
   }
+
+  return ipv4;
+}
+
+/// Select the channel of the protocol version of a target. The targets of
+/// protocol versions without a channel are rejected upon their parsing.
+/// @return channel
+///
+/// @param[in] wk   worker
+/// @param[in] ipv4 IPv4 target indication
+static struct channel*
+select_channel(struct worker* wk, const bool ipv4)
+{
+  uint64_t i;
+
+  for (i = 0; i < wk->wk_nch; i++) {
+    if (wk->wk_ch[i].ch_ipv4 == ipv4) {
+      return &wk->wk_ch[i];
+    }
+  }
+
+  return &wk->wk_ch[0];
+}
+
+/// Announce the departure of a request. In case the receiving is handled by a
+/// separate thread, the departure is passed through a lock-free queue.
+///
+/// @param[in] wk   worker
+/// @param[in] hpl  payload in host byte order
+/// @param[in] tg   network target
+/// @param[in] drop request was dropped instead of sent
+/// @param[in] hn   local host name
+/// @param[in] cf   configuration
+static void
+announce_departure(struct worker* wk,
+                   const struct payload* hpl,
+                   const struct target* tg,
+                   const bool drop,
+                   const char hn[static NEMO_HOST_NAME_SIZE],
+                   const struct config* cf)
+{
+  struct departure dp;
+  bool retb;
+
+  (void)memset(&dp, 0, sizeof(dp));
+  dp.dp_snum  = hpl->pl_snum;
+  dp.dp_mono  = hpl->pl_mtm1;
+  dp.dp_real  = hpl->pl_rtm1;
+  dp.dp_laddr = tg->tg_laddr;
+  dp.dp_haddr = tg->tg_haddr;
+  dp.dp_gen   = wk->wk_gen;
+  dp.dp_drop  = drop;
+
+  if (cf->cf_spl == false) {
+    __atomic_store_n(&wk->wk_nsent, wk->wk_nsent + 1, __ATOMIC_RELAXED);
+    depart_flight(wk, &dp, hn, cf);
+    return;
+  }
+
+  retb = push_ring(&wk->wk_dep, &dp);
+  if (retb == false) {
+    log(LL_DEBUG, false, "departure queue is full");
+  }
 }
 
 /// Issue a request against a target.
 /// @return success/failure indication
 ///
-/// @param[in] ch   channel
+/// @param[in] wk   worker
 /// @param[in] snum sequence number
 /// @param[in] tg   network target
 /// @param[in] hn   local host name
 /// @param[in] cf   configuration
 static bool
-issue_request(struct channel* ch,
+issue_request(struct worker* wk,
               const uint64_t snum,
               const struct target* tg,
               const char hn[static NEMO_HOST_NAME_SIZE],
               const struct config* cf)
 {
   bool retb;
+  bool ipv4;
+  bool room;
+  struct channel* ch;
   struct payload hpl;
   struct sockaddr_storage addr;
 
   // Prepare data for transmission.
-  fill_payload(&hpl, snum, hn, cf);
-  set_address(&addr, tg, cf);
+  fill_payload(&hpl, snum, hn, wk->wk_hid, cf);
+  ipv4 = set_address(&addr, tg, cf);
+  ch   = select_channel(wk, ipv4);
 
-  // Issue the request.
-  retb = send_packet(ch, &hpl, addr, cf->cf_err);
+  // Drop the request if it does not fit into the deferral queue, so that it
+  // is reported as dropped rather than lost in the network.
+  retb = admit_request(wk, ch, &room, cf);
   if (retb == false) {
     log(LL_WARN, false, "unable to send a request");
     return false;
   }
 
+  // Announce the departure ahead of the request, so that a separate receiver
+  // does not obtain the response before learning about its request.
+  announce_departure(wk, &hpl, tg, room == false, hn, cf);
+  if (room == false) {
+    return true;
+  }
+
+  // Issue the request, possibly deferred until its channel becomes writable.
+  retb = post_request(wk, ch, &hpl, &addr, cf);
+  if (retb == false) {
+    log(LL_WARN, false, "unable to send a request");
+    return false;
+  }
+
+  return true;
+}
+
+/// Account for the lag of a request behind its scheduled departure.
+///
+/// @param[in] wk   worker
+/// @param[in] goal scheduled monotonic time of the departure
+static void
+record_lag(struct worker* wk, const uint64_t goal)
+{
+  uint64_t cur;
+
+  cur = mono_now();
+  if (cur > goal) {
+    wk->wk_lag = cur - goal;
+  } else {
+    wk->wk_lag = 0;
+  }
+
+  if (wk->wk_lag > wk->wk_lmax) {
+    wk->wk_lmax = wk->wk_lag;
+  }
+  wk->wk_lsum += wk->wk_lag;
+  update_hist(&wk->wk_hlag, wk->wk_lag);
+}
+
+/// Await events until the selected point in time.
+/// @return success/failure indication
+///
+/// @param[in] wk   worker
+/// @param[in] goal monotonic time to wait for
+/// @param[in] hn   local host name
+/// @param[in] cf   configuration
+static bool
+wait_until(struct worker* wk,
+           const uint64_t goal,
+           const char hn[static NEMO_HOST_NAME_SIZE],
+           const struct config* cf)
+{
+  uint64_t cur;
+  bool retb;
+
+  // The goal time might have already passed in case of a slow progress.
+  cur = mono_now();
+  if (cur >= goal) {
+    return true;
+  }
+
+  retb = wait_for_events(wk, goal - cur, hn, cf);
+  if (retb == false) {
+    log(LL_WARN, false, "unable to wait for events");
+    return false;
+  }
+
   return true;
 }
 
-/// Single round of issued requests with small pauses after each request.
+/// Single round of issued requests with small pauses after each request. The
+/// requests are scheduled relative to the start of the round, so that the
+/// processing time does not accumulate into a drift.
 /// @return success/failure indication
 ///
-/// @param[in] ch  channel
-/// @param[in] tg  array of network targets
-/// @param[in] ntg number of network targets
+/// @param[in] wk  worker
 /// @param[in] sn  sequence number
 /// @param[in] hn  local host name
 /// @param[in] cf  configuration
 bool
-dispersed_round(struct channel* ch,
-                const struct target* tg,
-                const uint64_t ntg,
+dispersed_round(struct worker* wk,
                 const uint64_t snum,
                 const char hn[static NEMO_HOST_NAME_SIZE],
                 const struct config* cf)
 {
   uint64_t i;
   uint64_t part;
+  uint64_t start;
   bool retb;
 
-  // In case there are no targets, just sleep throughout the whole round.
-  if (ntg == 0) {
-    retb = wait_for_events(ch, cf->cf_int, hn, cf);
-    if (retb == false) {
-      log(LL_WARN, false, "unable to wait for events");
-      return false;
-    }
+  start = mono_now();
 
-    return true;
+  // In case there are no targets, just sleep throughout the whole round.
+  if (wk->wk_ntg == 0) {
+    return wait_until(wk, start + cf->cf_int, hn, cf);
   }
 
   // Compute the time to sleep between each request in the round. We can safely
   // divide by the number of targets, as we have previously handled the case of
   // no targets.
-  part = (cf->cf_int / ntg) + 1;
+  part = (cf->cf_int / wk->wk_ntg) + 1;
 
   // Issue all requests.
-  for (i = 0; i < ntg; i++) {
-    retb = issue_request(ch, snum, &tg[i], hn, cf);
+  for (i = 0; i < wk->wk_ntg; i++) {
+    // Await events until the scheduled time of the request.
+    retb = wait_until(wk, start + i * part, hn, cf);
     if (retb == false) {
       return false;
     }
+    record_lag(wk, start + i * part);
 
-    // Await events for the appropriate fraction of the round.
-    retb = wait_for_events(ch, part, hn, cf);
+    retb = issue_request(wk, snum, &wk->wk_tg[i], hn, cf);
     if (retb == false) {
-      log(LL_WARN, false, "unable to wait for events");
       return false;
     }
   }
 
-  return true;
+  // Await events for the remainder of the round.
+  return wait_until(wk, start + wk->wk_ntg * part, hn, cf);
 }
 
 /// Single round of issued requests with no pauses after each request, followed
 /// by a single full pause.
 /// @return success/failure indication
 ///
-/// @param[in] ch  channel
-/// @param[in] tg  array of network targets
-/// @param[in] ntg number of network targets
+/// @param[in] wk  worker
 /// @param[in] sn  sequence number
 /// @param[in] hn  local host name
 /// @param[in] cf  configuration
 bool
-grouped_round(struct channel* ch,
-              const struct target* tg,
-              const uint64_t ntg,
+grouped_round(struct worker* wk,
               const uint64_t snum,
               const char hn[static NEMO_HOST_NAME_SIZE],
               const struct config* cf)
 {
   uint64_t i;
+  uint64_t start;
   bool retb;
 
-  // Issue all requests.
-  for (i = 0; i < ntg; i++) {
-    retb = issue_request(ch, snum, &tg[i], hn, cf);
+  start = mono_now();
+
+  // Issue all requests. All of them are scheduled at the start of the round.
+  for (i = 0; i < wk->wk_ntg; i++) {
+    record_lag(wk, start);
+    retb = issue_request(wk, snum, &wk->wk_tg[i], hn, cf);
     if (retb == false) {
       return false;
     }
   }
 
   // Await events for the remainder of the interval.
-  retb = wait_for_events(ch, cf->cf_int, hn, cf);
-  if (retb == false) {
-    log(LL_WARN, false, "unable to wait for events");
-    return false;
-  }
-
-  return true;
+  return wait_until(wk, start + cf->cf_int, hn, cf);
 }
@@ -10,6 +10,7 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -17,29 +18,12 @@
 
 #include "common/convert.h"
 #include "common/log.h"
+#include "common/now.h"
+#include "common/signal.h"
 #include "ureq/funcs.h"
 #include "ureq/types.h"
 
 
-/// Create a part of a IPv6 address by converting array of bytes into a
-/// single integer.
-/// @return portion of IPv6 address
-///
-/// @param[in] ab address bytes
-static uint64_t
-ipv6_part(const uint8_t* ab)
-{
-  uint64_t res;
-  uint8_t i;
-
-  res = 0;
-  for (i = 0; i < 8; i++) {
-    res |= ((uint64_t)ab[i] << (i * 8));
-  }
-
-  return res;
-}
-
 /// Convert a IPv4 address into a network target.
 ///
 /// @param[out] tg network target
@@ -47,8 +31,7 @@ ipv6_part(const uint8_t* ab)
 static void
 read_target4(struct target* tg, const struct in_addr* a4)
 {
-  tg->tg_laddr = (uint64_t)a4->s_addr;
-  tg->tg_haddr = (uint64_t)0;
+  fipv4(&tg->tg_laddr, &tg->tg_haddr, *a4);
 }
 
 /// Convert a IPv6 address into a network target.
@@ -58,11 +41,56 @@ read_target4(struct target* tg, const struct in_addr* a4)
 static void
 read_target6(struct target* tg, const struct in6_addr* a6)
 {
-  tg->tg_laddr = ipv6_part(&a6->s6_addr[0]);
-  tg->tg_haddr = ipv6_part(&a6->s6_addr[7]);
+  fipv6(&tg->tg_laddr, &tg->tg_haddr, *a6);
+}
+
+/// Hash an address of the requester. The bits of IPv4 addresses occupy only
+/// the upper half of the high address bits, and therefore all bits are mixed
+/// into the lower ones, which select the slots of the hash tables.
+/// @return hash value
+///
+/// @param[in] la low address bits
+/// @param[in] ha high address bits
+uint64_t
+hash_address(const uint64_t la, const uint64_t ha)
+{
+  uint64_t h;
+
+  h  = la ^ (ha * 0xff51afd7ed558ccdULL);
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+/// Convert an address of the requester into a string.
+///
+/// @param[out] str address string
+/// @param[in]  la  low address bits
+/// @param[in]  ha  high address bits
+void
+format_address(char str[static INET6_ADDRSTRLEN],
+               const uint64_t la,
+               const uint64_t ha)
+{
+  struct in_addr a4;
+  struct in6_addr a6;
+  bool retb;
+
+  (void)memset(str, '\0', INET6_ADDRSTRLEN);
+
+  retb = tipv4(&a4, la, ha);
+  if (retb == true) {
+    (void)inet_ntop(AF_INET, &a4, str, INET6_ADDRSTRLEN);
+  } else {
+    tipv6(&a6, la, ha);
+    (void)inet_ntop(AF_INET6, &a6, str, INET6_ADDRSTRLEN);
+  }
 }
 
-/// Resolve a domain name into multiple network targets.
+/// Resolve a domain name into multiple network targets. In case both protocol
+/// versions are used, the name yields the targets of both record types.
 /// @return success/failure indication
 ///
 /// @param[out] tg   array of targets
@@ -81,6 +109,7 @@ resolve_name(struct target* tg,
   struct addrinfo hint;
   struct addrinfo* ais;
   struct addrinfo* ai;
+  struct in_addr a4;
   char estr[128];
   uint8_t lvl;
 
@@ -98,7 +127,9 @@ resolve_name(struct target* tg,
   hint.ai_protocol = 0;
 
   // Select address family type.
-  if (cf->cf_ipv4 == true) {
+  if (cf->cf_ipv4 == true && cf->cf_ipv6 == true) {
+    hint.ai_family = AF_UNSPEC;
+  } else if (cf->cf_ipv4 == true) {
     hint.ai_family = AF_INET;
   } else {
     hint.ai_family = AF_INET6;
@@ -112,6 +143,8 @@ resolve_name(struct target* tg,
     (void)snprintf(estr, sizeof(estr), "unable to resolve name '%%s': %s", gai_strerror(reti));
     log(lvl, false, estr, name);
 
+    // A name that does not resolve yields no targets.
+    *tcnt = 0;
     return !cf->cf_err;
   }
 
@@ -131,10 +164,18 @@ resolve_name(struct target* tg,
     }
 
     // Convert the IP address into a target.
-    if (cf->cf_ipv4 == true) {
+    if (ai->ai_family == AF_INET) {
       read_target4(&tg[*tcnt], &((struct sockaddr_in*)ai->ai_addr)->sin_addr);
-    } else {
+    } else if (ai->ai_family == AF_INET6) {
       read_target6(&tg[*tcnt], &((struct sockaddr_in6*)ai->ai_addr)->sin6_addr);
+    } else {
+      continue;
+    }
+
+    // Some resolvers return the IPv4-mapped addresses of A records, which can
+    // only be reached through an IPv4 channel.
+    if (cf->cf_ipv4 == false && tipv4(&a4, tg[*tcnt].tg_laddr, tg[*tcnt].tg_haddr)) {
+      continue;
     }
 
     tg[*tcnt].tg_name = name;
@@ -190,12 +231,19 @@ parse_target_string(struct target* tg,
   reti = inet_pton(AF_INET6, tstr, &a6);
   if (reti == 1) {
     // Verify that we accept IPv6 protocol addresses.
-    if (cf->cf_ipv4 == true) {
+    if (cf->cf_ipv6 == false) {
       log(LL_WARN, false, "target %s is a %s address, which is not selected", tstr, "IPv6");
       return false;
     }
 
     read_target6(&tg[0], &a6);
+
+    // IPv4-mapped addresses are treated as IPv4 targets.
+    if (cf->cf_ipv4 == false && tipv4(&a4, tg[0].tg_laddr, tg[0].tg_haddr)) {
+      log(LL_WARN, false, "target %s is a %s address, which is not selected", tstr, "IPv4");
+      return false;
+    }
+
     tg[0].tg_name = NULL;
     *tcnt = 1;
 
@@ -234,7 +282,7 @@ compare_targets(const void* tg1, const void* tg2)
 /// @param[out] tg   array of targets
 /// @param[out] nlen new length of the array
 /// @param[in]  olen old length of the array
-static void
+void
 normalize_targets(struct target* tg, uint64_t* nlen, const uint64_t olen)
 {
   uint64_t idx;
@@ -302,7 +350,7 @@ load_targets(struct target* tg,
     normalize_targets(tg2, &tcnt2, tcnt1);
 
     // Verify that we are not reaching the overall limit on targets.
-    if (tcnt2 + tall - 1 > cf->cf_ntg) {
+    if (tall + tcnt2 > cf->cf_ntg) {
       log(lvl, false, "unable to append more targets");
 
       if (cf->cf_err == true) {
@@ -318,33 +366,135 @@ load_targets(struct target* tg,
   }
 
   // Final normalization sweep.
-  normalize_targets(tg, tcnt, tcnt2);
+  normalize_targets(tg, tcnt, tall);
 
   return true;
 }
 
+/// Initialise the shared table of targets and perform the initial load.
+/// @return success/failure indication
+///
+/// @param[out] tb table of targets
+/// @param[in]  cf configuration
+bool
+init_table(struct table* tb, const struct config* cf)
+{
+  int reti;
+  bool retb;
+
+  // Allocate the targets.
+  tb->tb_tg = calloc((size_t)cf->cf_ntg, sizeof(*tb->tb_tg));
+  if (tb->tb_tg == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for targets");
+    return false;
+  }
+
+  // The function returns the error number directly instead of using errno.
+  reti = pthread_mutex_init(&tb->tb_lock, NULL);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to create the target lock: %s", strerror(reti));
+    return false;
+  }
+
+  // Load all targets at start.
+  retb = load_targets(tb->tb_tg, &tb->tb_ntg, cf);
+  if (retb == false) {
+    log(LL_WARN, false, "unable to load targets");
+    return false;
+  }
+  log_targets(tb->tb_tg, tb->tb_ntg);
+
+  // Set the next reload time to be in the future.
+  tb->tb_gen = 1;
+  tb->tb_rld = mono_now() + cf->cf_rld;
+
+  return true;
+}
+
+/// Re-load the targets if the reload period has passed or if it was
+/// explicitly requested, and update the partition of targets that belong to
+/// the worker. The table is partitioned in a round-robin fashion.
+/// @return success/failure indication
+///
+/// @global shup
+///
+/// @param[in] wk worker
+/// @param[in] tb table of targets
+/// @param[in] cf configuration
+bool
+refresh_targets(struct worker* wk, struct table* tb, const struct config* cf)
+{
+  uint64_t now;
+  uint64_t i;
+  bool retb;
+
+  (void)pthread_mutex_lock(&tb->tb_lock);
+
+  // Check if name resolution needs to happen. This code contains a possible
+  // race condition, in case a repeated SIGHUP signal appears between the
+  // comparison and the clearing the `shup` flag. This is a conscious
+  // decision, since the target re-loading is already in progress and will
+  // therefore happen imminently, but only once (in case of two or more
+  // SIGHUPs in immediate consequence). The first worker to observe the
+  // condition performs the re-load on behalf of all workers.
+  now = mono_now();
+  if ((cf->cf_rld != 0 && now > tb->tb_rld) || shup == true) {
+    // Clear the SIGHUP flag.
+    shup = false;
+
+    // Re-load targets.
+    retb = load_targets(tb->tb_tg, &tb->tb_ntg, cf);
+    if (retb == false) {
+      (void)pthread_mutex_unlock(&tb->tb_lock);
+      return false;
+    }
+
+    // Update the next refresh time.
+    tb->tb_rld = now + cf->cf_rld;
+    tb->tb_gen++;
+  }
+
+  // Copy the partition of targets in case the table has changed.
+  if (wk->wk_gen != tb->tb_gen) {
+    wk->wk_ntg = 0;
+    for (i = wk->wk_idx; i < tb->tb_ntg; i += cf->cf_nwk) {
+      wk->wk_tg[wk->wk_ntg] = tb->tb_tg[i];
+      wk->wk_ntg++;
+    }
+
+    wk->wk_gen = tb->tb_gen;
+    log(LL_DEBUG, false, "worker %" PRIu64 " has %" PRIu64 " targets",
+        wk->wk_idx, wk->wk_ntg);
+  }
+
+  (void)pthread_mutex_unlock(&tb->tb_lock);
+
+  return true;
+}
+
+/// Release all resources held by the table of targets.
+///
+/// @param[in] tb table of targets
+void
+free_table(struct table* tb)
+{
+  (void)pthread_mutex_destroy(&tb->tb_lock);
+  free(tb->tb_tg);
+}
+
 /// Print all targets and their sources as debugging log entries.
 ///
 /// @param[in] tg  array of targets
 /// @param[in] cnt number of targets
-/// @param[in] cf  configuration
 void
-log_targets(const struct target tg[], const uint64_t cnt, const struct config* cf)
+log_targets(const struct target tg[], const uint64_t cnt)
 {
   uint64_t i;
-  struct in_addr a4;
-  struct in6_addr a6;
   char str[INET6_ADDRSTRLEN];
 
   for (i = 0; i < cnt; i++) {
     // Convert the address into a string.
-    if (cf->cf_ipv4 == true) {
-      a4.s_addr = (uint32_t)tg[i].tg_laddr;
-      (void)inet_ntop(AF_INET, &a4, str, sizeof(str));
-    } else {
-      tipv6(&a6, tg[i].tg_laddr, tg[i].tg_haddr);
-      (void)inet_ntop(AF_INET6, &a6, str, sizeof(str));
-    }
+    format_address(str, tg[i].tg_laddr, tg[i].tg_haddr);
 
     // Print the target address. In case the target was resolved from a domain
     // name, append the information.
@@ -7,36 +7,110 @@
 #ifndef NEMO_UREQ_TYPES_H
 #define NEMO_UREQ_TYPES_H
 
+#include <sys/socket.h>
+
+#include <pthread.h>
+
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "common/channel.h"
+#include "common/cpu.h"
+#include "common/hist.h"
+#include "common/payload.h"
+#include "common/ring.h"
+#include "common/sample.h"
+#include "common/sim.h"
+#include "common/stats.h"
+
 
 #define PLUG_MAX 32
 #define TARG_MAX 2048
+#define WORK_MAX 64
+#define CHAN_MAX 2
+
+// Size of the per-worker report buffer.
+#define REPORT_BUFFER_SIZE 65536
+
+// Period in which threads check for termination requests.
+#define WORKER_TICK 100000000ULL
+
+// Capacity of the departure queue between the sender and the receiver.
+#define DEPART_MAX 4096
+
+// Capacity of the queue of each channel holding the requests deferred due to
+// a full send buffer.
+#define DEFER_MAX 4096
+
+// Bounds on the depth of the in-flight ring of a single target.
+#define FLIGHT_DEPTH_MIN 16
+#define FLIGHT_DEPTH_MAX 1024
+
+// Period in which the in-flight requests past their deadline are expired.
+#define FLIGHT_SWEEP 10000000ULL
+
+// Number of targets searched in each sweep period for the requests answered
+// from an address other than their target.
+#define FLIGHT_SCAN 65536
+
+// States of an in-flight request.
+#define FLIGHT_EMPTY    0 ///< Slot was never used.
+#define FLIGHT_PENDING  1 ///< Response is awaited.
+#define FLIGHT_ANSWERED 2 ///< Response was received.
+#define FLIGHT_EXPIRED  3 ///< Deadline passed without a response.
+#define FLIGHT_DROPPED  4 ///< Request was never sent.
+
+// Outcomes of a request, as reported in the status column.
+#define OUTCOME_OK      0 ///< Response arrived before the deadline.
+#define OUTCOME_LATE    1 ///< Response arrived after the deadline.
+#define OUTCOME_DUP     2 ///< Request was already answered.
+#define OUTCOME_UNKNOWN 3 ///< Request is not in the in-flight table.
+#define OUTCOME_LOST    4 ///< No response arrived before the deadline.
+#define OUTCOME_DROPPED 5 ///< Request was dropped by the requester.
 
 /// Configuration.
 struct config {
   const char* cf_pi[PLUG_MAX]; ///< Attached plugins.
   const char** cf_tg;          ///< Network targets.
+  const char* cf_prom;         ///< Path of the metrics socket.
   uint64_t    cf_ntg;          ///< Number of network targets.
   uint64_t    cf_cnt;          ///< Number of emitted payload rounds.
   uint64_t    cf_int;          ///< Inter-payload sleep interval.
   uint64_t    cf_wait;         ///< Wait time after last request.
+  uint64_t    cf_dead;         ///< Deadline of a response after its request.
   uint64_t    cf_rbuf;         ///< Socket receive buffer memory size.
   uint64_t    cf_sbuf;         ///< Socket send buffer memory size.
+  uint64_t    cf_rcap;         ///< Ceiling of the receive buffer (0 if fixed).
+  uint64_t    cf_scap;         ///< Ceiling of the send buffer (0 if fixed).
   uint64_t    cf_ttl;          ///< Time-To-Live for published datagrams.
   uint64_t    cf_key;          ///< Key of the current process.
   uint64_t    cf_port;         ///< UDP port for all endpoints.
   uint64_t    cf_rld;          ///< Name resolution refresh period.
   uint64_t    cf_len;          ///< Overall payload length.
+  uint64_t    cf_nwk;          ///< Number of worker threads.
+  uint64_t    cf_cpu[CPU_LIST_MAX]; ///< CPU affinity of worker threads.
+  uint64_t    cf_ncpu;         ///< Number of CPUs in the affinity list.
+  uint64_t    cf_prio;         ///< Real-time scheduling priority.
+  uint64_t    cf_acc;          ///< Acceleration of the virtual clock.
+  struct model cf_mdl;         ///< Model of the simulated network.
+  uint64_t    cf_sev;          ///< Sampling period of the report rows.
+  uint64_t    cf_srt;          ///< Limit of report rows per second (0 if none).
   uint8_t     cf_llvl;         ///< Notification verbosity level.
+  uint8_t     cf_clk;          ///< Clock source.
+  uint8_t     cf_lbe;          ///< Notification back-end service.
+  uint8_t     cf_fver;         ///< Payload format version.
   bool        cf_lcol;         ///< Notification coloring policy.
   bool        cf_err;          ///< Process exit policy on publishing error.
   bool        cf_mono;         ///< Do not capture responses (monologue mode).
   bool        cf_sil;          ///< Suppress reporting output.
   bool        cf_grp;          ///< Group requests at the beginning of a round.
   bool        cf_ipv4;         ///< Usage of Internet Protocol version 4.
-  uint8_t     cf_pad;          ///< Padding (unused).
+  bool        cf_ipv6;         ///< Usage of Internet Protocol version 6.
+  bool        cf_spl;          ///< Separate sender and receiver threads.
+  bool        cf_stat;         ///< Publish live statistics.
+  bool        cf_busy;         ///< Spin on non-blocking receives.
+  bool        cf_sim;          ///< Use the simulated network.
+  uint8_t     cf_smp;          ///< Sampling method of the report rows.
 };
 
 /// Command-line option.
@@ -47,11 +121,141 @@ struct option {
                  const char* inp);
 };
 
-/// Network endpoint.
+/// Network endpoint. IPv4 addresses are stored in their IPv4-mapped IPv6
+/// form, as are all other addresses of the requester.
 struct target {
   const char* tg_name;   ///< Domain name.
   uint64_t    tg_laddr;  ///< Low address bits.
   uint64_t    tg_haddr;  ///< High address bits.
 };
 
+/// Departure of a request, as announced by the sender to the receiver.
+struct departure {
+  uint64_t dp_snum;   ///< Sequence number.
+  uint64_t dp_mono;   ///< Monotonic time of departure.
+  uint64_t dp_real;   ///< Real time of departure.
+  uint64_t dp_laddr;  ///< Low address bits of the target.
+  uint64_t dp_haddr;  ///< High address bits of the target.
+  uint64_t dp_gen;    ///< Generation of the table of targets.
+  bool     dp_drop;   ///< Request was dropped instead of sent.
+  uint8_t  dp_pad[7]; ///< Padding (unused).
+};
+
+/// Request deferred due to a full send buffer of its channel. The payload
+/// retains the times of its first attempt, so that the round-trip time of the
+/// request includes its deferral.
+struct parcel {
+  struct payload          pc_pl;   ///< Payload in host byte order.
+  struct sockaddr_storage pc_addr; ///< Address of the target.
+};
+
+/// Requests of a single channel deferred due to its full send buffer.
+struct deferral {
+  struct parcel* df_q;   ///< Ring of deferred requests.
+  uint64_t       df_old; ///< Index of the oldest deferred request.
+  uint64_t       df_cnt; ///< Number of deferred requests.
+};
+
+/// Request awaiting its response.
+struct flight {
+  uint64_t fl_snum;   ///< Sequence number.
+  uint64_t fl_key;    ///< Key of the request.
+  uint64_t fl_mono;   ///< Monotonic time of departure.
+  uint64_t fl_real;   ///< Real time of departure.
+  uint64_t fl_dead;   ///< Monotonic deadline of the response.
+  uint8_t  fl_stat;   ///< State (one of FLIGHT_*).
+  uint8_t  fl_pad[7]; ///< Padding (unused).
+};
+
+/// In-flight requests of a single target, indexed by the sequence number.
+struct lane {
+  uint64_t       ln_laddr;  ///< Low address bits.
+  uint64_t       ln_haddr;  ///< High address bits.
+  struct flight* ln_fl;     ///< Ring of requests.
+  uint64_t       ln_old;    ///< Oldest sequence number not yet settled.
+  uint64_t       ln_new;    ///< Sequence number following the newest request.
+  uint64_t       ln_gen;    ///< Table generation of the newest request.
+  bool           ln_used;   ///< Slot is occupied.
+  uint8_t        ln_pad[7]; ///< Padding (unused).
+};
+
+/// Round-trip times of a single responder.
+struct peer {
+  uint64_t    pe_laddr;  ///< Low address bits.
+  uint64_t    pe_haddr;  ///< High address bits.
+  struct hist pe_rtt;    ///< Histogram of round-trip times.
+  bool        pe_used;   ///< Slot is occupied.
+  uint8_t     pe_pad[7]; ///< Padding (unused).
+};
+
+/// Shared table of all resolved network targets.
+struct table {
+  struct target*  tb_tg;   ///< Array of targets.
+  uint64_t        tb_ntg;  ///< Number of targets.
+  uint64_t        tb_gen;  ///< Generation, incremented upon each reload.
+  uint64_t        tb_rld;  ///< Time of the next scheduled reload.
+  pthread_mutex_t tb_lock; ///< Lock guarding the table.
+};
+
+/// Request worker.
+struct worker {
+  struct channel wk_ch[CHAN_MAX]; ///< Channels of each protocol version.
+  uint64_t       wk_nch;   ///< Number of channels.
+  struct target* wk_tg;    ///< Partition of the network targets.
+  uint64_t       wk_ntg;   ///< Number of targets in the partition.
+  uint64_t       wk_idx;   ///< Index of the worker.
+  uint64_t       wk_gen;   ///< Generation of the partitioned table.
+  uint64_t       wk_cpu;   ///< CPU affinity.
+  uint64_t       wk_rcpu;  ///< CPU affinity of the receiver thread.
+  uint64_t       wk_rlen;  ///< Occupied length of the report buffer.
+  uint64_t       wk_nsent; ///< Number of requests known to the receiver.
+  uint64_t       wk_nrecv; ///< Number of received responses.
+  uint64_t       wk_nrnd;  ///< Number of finished rounds.
+  uint64_t       wk_lag;   ///< Lag of the last request behind its schedule.
+  uint64_t       wk_lmax;  ///< Maximal lag of a request.
+  uint64_t       wk_lsum;  ///< Sum of lags of all requests.
+  uint64_t       wk_spub;  ///< Time of the last statistics publication.
+  struct stats_sect* wk_stc; ///< Statistics of the channel.
+  struct stats_sect* wk_sts; ///< Statistics of the request schedule.
+  struct hist    wk_hlag;  ///< Histogram of lags behind the schedule.
+  struct peer*   wk_peer;  ///< Round-trip times by responder (hash table).
+  uint64_t       wk_npeer; ///< Capacity of the responder table.
+  uint64_t       wk_nused; ///< Occupied slots of the responder table.
+  uint64_t       wk_nmiss; ///< Responses not tracked by the responder table.
+  struct lane*   wk_lane;  ///< In-flight requests by target (hash table).
+  struct flight* wk_flt;   ///< Storage of all in-flight rings.
+  uint64_t*      wk_fre;   ///< Indices of the in-flight rings, free ones last.
+  uint64_t       wk_nlan;  ///< Capacity of the target table.
+  uint64_t       wk_ulan;  ///< Occupied slots of the target table.
+  uint64_t       wk_fdep;  ///< Depth of each in-flight ring.
+  uint64_t       wk_fswp;  ///< Time of the next expiry of in-flight requests.
+  uint64_t       wk_fscn;  ///< Targets left to search until the next expiry.
+  uint64_t       wk_lgen;  ///< Newest table generation of a departure.
+  uint64_t       wk_lrnd;  ///< First sequence number of that generation.
+  uint64_t       wk_lnew;  ///< Sequence number following the newest departure.
+  uint64_t       wk_nlost; ///< Requests without a response before the deadline.
+  uint64_t       wk_nlate; ///< Responses after the deadline.
+  uint64_t       wk_ndup;  ///< Repeated responses to a request.
+  uint64_t       wk_nunk;  ///< Responses to requests not in the table.
+  struct deferral wk_def[CHAN_MAX]; ///< Deferred requests of each channel.
+  uint64_t       wk_ndef;  ///< Requests deferred at least once.
+  uint64_t       wk_ndrop; ///< Requests dropped due to a full deferral queue.
+  struct hist    wk_hdef;  ///< Histogram of delays of the deferred requests.
+  struct sampler wk_smp;   ///< Sampling of the report rows.
+  struct ring    wk_dep;   ///< Departures from the sender to the receiver.
+  pthread_t      wk_thr;   ///< Thread handle.
+  pthread_t      wk_rthr;  ///< Receiver thread handle.
+  struct table*  wk_tb;    ///< Shared table of targets.
+  const char*    wk_hn;    ///< Local host name.
+  uint64_t       wk_hid;   ///< Identifier of the local host name.
+  const struct config* wk_cf; ///< Configuration.
+  bool           wk_sig;   ///< Signals are handled by the worker itself.
+  bool           wk_done;  ///< Worker has finished.
+  bool           wk_ret;   ///< Success/failure of the worker.
+  bool           wk_stop;  ///< Sender has finished, receiver should stop.
+  bool           wk_rret;  ///< Success/failure of the receiver.
+  uint8_t        wk_pad[3]; ///< Padding (unused).
+  char           wk_rep[REPORT_BUFFER_SIZE]; ///< Report buffer.
+};
+
 #endif
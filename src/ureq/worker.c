@@ -0,0 +1,605 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/select.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "common/channel.h"
+#include "common/convert.h"
+#include "common/cpu.h"
+#include "common/hist.h"
+#include "common/host.h"
+#include "common/log.h"
+#include "common/packet.h"
+#include "common/ring.h"
+#include "common/signal.h"
+#include "common/sim.h"
+#include "common/stats.h"
+#include "ureq/funcs.h"
+#include "ureq/types.h"
+
+
+/// Entry point of a receiver thread.
+/// @return unused
+///
+/// @param[in] arg worker
+static void*
+receiver_main(void* arg)
+{
+  struct worker* wk;
+
+  wk = arg;
+
+  // Failing to apply the affinity or the priority is not fatal to the
+  // measurement.
+  (void)pin_thread(wk->wk_rcpu);
+  (void)raise_priority(wk->wk_cf->cf_prio);
+
+  wk->wk_rret = receive_loop(wk, wk->wk_hn, wk->wk_cf);
+  if (wk->wk_rret == false) {
+    log(LL_WARN, false, "receiver of worker %" PRIu64 " has terminated", wk->wk_idx);
+  }
+
+  return NULL;
+}
+
+/// Execute the request loop of a worker. In case the sending and receiving
+/// are separated, the calling thread becomes the sender and a new receiver
+/// thread is started.
+/// @return success/failure indication
+///
+/// @param[in] wk worker
+/// @param[in] tb shared table of targets
+/// @param[in] hn local host name
+/// @param[in] cf configuration
+static bool
+run_worker(struct worker* wk,
+           struct table* tb,
+           const char hn[static NEMO_HOST_NAME_SIZE],
+           const struct config* cf)
+{
+  int reti;
+  bool retb;
+
+  // Failing to apply the affinity or the priority is not fatal to the
+  // measurement.
+  (void)pin_thread(wk->wk_cpu);
+  (void)raise_priority(cf->cf_prio);
+
+  // The identifier is derived only once, rather than for each request.
+  wk->wk_hid = host_id(hn);
+
+  if (cf->cf_spl == false) {
+    return request_loop(wk, tb, hn, cf);
+  }
+
+  // Start the receiver. The receiver inherits the blocked signal mask.
+  wk->wk_hn   = hn;
+  wk->wk_cf   = cf;
+  wk->wk_stop = false;
+  reti = pthread_create(&wk->wk_rthr, NULL, receiver_main, wk);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to start receiver %" PRIu64 ": %s", wk->wk_idx, strerror(reti));
+    return false;
+  }
+
+  retb = request_loop(wk, tb, hn, cf);
+
+  // Instruct the receiver to stop, regardless of the sender outcome.
+  __atomic_store_n(&wk->wk_stop, true, __ATOMIC_RELEASE);
+  reti = pthread_join(wk->wk_rthr, NULL);
+  if (reti != 0) {
+    log(LL_WARN, false, "unable to join receiver %" PRIu64 ": %s", wk->wk_idx, strerror(reti));
+    return false;
+  }
+
+  return retb && wk->wk_rret;
+}
+
+/// Entry point of a worker thread.
+/// @return unused
+///
+/// @param[in] arg worker
+static void*
+worker_main(void* arg)
+{
+  struct worker* wk;
+  bool retb;
+
+  wk = arg;
+
+  retb = run_worker(wk, wk->wk_tb, wk->wk_hn, wk->wk_cf);
+  if (retb == false) {
+    log(LL_WARN, false, "worker %" PRIu64 " has terminated", wk->wk_idx);
+  }
+
+  wk->wk_ret = retb;
+  __atomic_store_n(&wk->wk_done, true, __ATOMIC_RELEASE);
+
+  return NULL;
+}
+
+/// Create a channel of the worker on an ephemeral port.
+/// @return success/failure indication
+///
+/// @param[in] wk   worker
+/// @param[in] ipv4 IPv4 protocol usage
+/// @param[in] cf   configuration
+static bool
+create_channel(struct worker* wk, const bool ipv4, const struct config* cf)
+{
+  struct channel* ch;
+  bool retb;
+
+  ch = &wk->wk_ch[wk->wk_nch];
+
+  // The simulated network is seeded by the worker and the protocol version,
+  // so that repeated runs draw the same delays.
+  if (cf->cf_sim == true) {
+    retb = open_sim(ch, ipv4, &cf->cf_mdl, cf->cf_key + 2 * wk->wk_idx + (ipv4 ? 0 : 1));
+    if (retb == false) {
+      log(LL_WARN, false, "unable to create the simulated %s channel", ch->ch_name);
+      close_sim(ch);
+      return false;
+    }
+    wk->wk_nch++;
+
+    return create_host_cache(&ch->ch_hc, cf->cf_ntg);
+  }
+
+  retb = open_channel(ch, ipv4, NULL, 0, cf->cf_rbuf, cf->cf_sbuf, (uint8_t)cf->cf_ttl);
+  if (retb == false) {
+    log(LL_WARN, false, "unable to create the %s channel", ch->ch_name);
+    return false;
+  }
+  wk->wk_nch++;
+  auto_size_channel(ch, cf->cf_rcap, cf->cf_scap);
+
+  // Each target is a single responder, whose host name the channel learns.
+  retb = create_host_cache(&ch->ch_hc, cf->cf_ntg);
+  if (retb == false) {
+    return false;
+  }
+
+  // Let the kernel busy-poll the device queue in the busy mode.
+  if (cf->cf_busy == true) {
+    (void)busy_poll_channel(ch, POLL_BUSY_TIME);
+  }
+
+  return true;
+}
+
+/// Allocate all workers and create their channels. Each worker uses a
+/// distinct local UDP port, so that responses are routed back directly to
+/// the worker that issued the request.
+/// @return success/failure indication
+///
+/// @param[out] wk array of workers
+/// @param[in]  cf configuration
+bool
+create_workers(struct worker** wk, const struct config* cf)
+{
+  uint64_t i;
+  bool retb;
+  struct worker* w;
+
+  log(LL_INFO, false, "creating %" PRIu64 " workers", cf->cf_nwk);
+
+  *wk = calloc((size_t)cf->cf_nwk, sizeof(**wk));
+  if (*wk == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for workers");
+    return false;
+  }
+
+  for (i = 0; i < cf->cf_nwk; i++) {
+    w = &(*wk)[i];
+    w->wk_idx = i;
+    w->wk_cf  = cf;
+
+    // The limit of report rows is divided among the workers.
+    init_sampler(&w->wk_smp, cf->cf_smp, cf->cf_sev,
+                 (cf->cf_srt + cf->cf_nwk - 1) / cf->cf_nwk);
+
+    // Assign the CPUs in a round-robin fashion. Separate sender and receiver
+    // threads of a worker occupy two consecutive CPUs from the list.
+    if (cf->cf_ncpu == 0) {
+      w->wk_cpu  = CPU_NONE;
+      w->wk_rcpu = CPU_NONE;
+    } else if (cf->cf_spl == true) {
+      w->wk_cpu  = cf->cf_cpu[(2 * i)     % cf->cf_ncpu];
+      w->wk_rcpu = cf->cf_cpu[(2 * i + 1) % cf->cf_ncpu];
+    } else {
+      w->wk_cpu  = cf->cf_cpu[i % cf->cf_ncpu];
+      w->wk_rcpu = CPU_NONE;
+    }
+
+    // Create the queue of departures between the sender and the receiver.
+    if (cf->cf_spl == true) {
+      retb = create_ring(&w->wk_dep, sizeof(struct departure), DEPART_MAX);
+      if (retb == false) {
+        log(LL_WARN, false, "unable to create the departure queue");
+        return false;
+      }
+    }
+
+    // Allocate the table of requests awaiting their responses.
+    if (cf->cf_mono == false) {
+      retb = create_flights(w, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+
+    // Allocate the queue of requests deferred due to a full send buffer.
+    retb = create_deferrals(w);
+    if (retb == false) {
+      return false;
+    }
+
+    // Allocate the table of round-trip times exposed as metrics.
+    if (cf->cf_prom != NULL) {
+      retb = create_peers(w, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+
+    // Allocate the partition of targets. As the partition can not be larger
+    // than the overall table, its upper limit applies.
+    w->wk_tg = calloc((size_t)cf->cf_ntg, sizeof(*w->wk_tg));
+    if (w->wk_tg == NULL) {
+      log(LL_WARN, true, "unable to allocate memory for targets");
+      return false;
+    }
+
+    // Create a channel for each protocol version.
+    if (cf->cf_ipv4 == true) {
+      retb = create_channel(w, true, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+
+    if (cf->cf_ipv6 == true) {
+      retb = create_channel(w, false, cf);
+      if (retb == false) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/// Wait for all workers to finish, while handling signals on their behalf.
+/// @return success/failure indication
+///
+/// @global sint
+/// @global sterm
+/// @global susr1
+/// @global schld
+///
+/// @param[in] wk array of workers
+/// @param[in] cf configuration
+static bool
+supervise_workers(const struct worker* wk, const struct config* cf)
+{
+  sigset_t mask;
+  struct timespec tick;
+  uint64_t i;
+  uint64_t done;
+  int reti;
+
+  // Create the signal mask used for enabling signals during the pselect(2)
+  // waiting. The worker threads keep all signals blocked, and therefore the
+  // main thread is the only recipient.
+  create_signal_mask(&mask);
+  fnanos(&tick, WORKER_TICK);
+
+  while (true) {
+    // Check whether all workers have finished.
+    done = 0;
+    for (i = 0; i < cf->cf_nwk; i++) {
+      if (__atomic_load_n(&wk[i].wk_done, __ATOMIC_ACQUIRE) == true) {
+        done++;
+      }
+    }
+
+    if (done == cf->cf_nwk) {
+      return true;
+    }
+
+    reti = pselect(0, NULL, NULL, NULL, &tick, &mask);
+    if (reti == 0) {
+      continue;
+    }
+
+    if (errno != EINTR) {
+      log(LL_WARN, true, "waiting for workers failed");
+      return false;
+    }
+
+    // The SIGINT and SIGTERM signals are observed by the workers themselves,
+    // which then terminate at their earliest convenience. Similarly, the
+    // SIGHUP signal is handled upon the next target table refresh.
+    if (sint == true) {
+      log(LL_WARN, false, "received the %s signal", "SIGINT");
+    }
+
+    if (sterm == true) {
+      log(LL_WARN, false, "received the %s signal", "SIGTERM");
+    }
+
+    // Plugin processes are not used by the requester.
+    schld = false;
+
+    // Print logging information upon receiving SIGUSR1.
+    if (susr1 == true) {
+      log_config(cf);
+      log_workers(wk, cf);
+      susr1 = false;
+    }
+  }
+}
+
+/// Start the requesting on all workers and wait for them to finish. A single
+/// worker is executed directly by the calling thread.
+/// @return success/failure indication
+///
+/// @param[in] wk array of workers
+/// @param[in] tb shared table of targets
+/// @param[in] hn local host name
+/// @param[in] cf configuration
+bool
+run_workers(struct worker* wk,
+            struct table* tb,
+            const char hn[static NEMO_HOST_NAME_SIZE],
+            const struct config* cf)
+{
+  uint64_t i;
+  uint64_t nthr;
+  int reti;
+  bool retb;
+
+  // Avoid the overhead of worker threads in the basic case.
+  if (cf->cf_nwk == 1) {
+    wk[0].wk_sig = true;
+    return run_worker(&wk[0], tb, hn, cf);
+  }
+
+  // Start all worker threads.
+  for (nthr = 0; nthr < cf->cf_nwk; nthr++) {
+    wk[nthr].wk_tb = tb;
+    wk[nthr].wk_hn = hn;
+    wk[nthr].wk_cf = cf;
+
+    // The function returns the error number directly instead of using errno.
+    reti = pthread_create(&wk[nthr].wk_thr, NULL, worker_main, &wk[nthr]);
+    if (reti != 0) {
+      log(LL_WARN, false, "unable to start worker %" PRIu64 ": %s", nthr, strerror(reti));
+      break;
+    }
+  }
+
+  // Handle signals until all workers finish. In case not all workers were
+  // started, emulate the termination request to stop the running ones.
+  if (nthr == cf->cf_nwk) {
+    retb = supervise_workers(wk, cf);
+  } else {
+    sterm = true;
+    retb = false;
+  }
+
+  // Wait for the termination of all started threads.
+  for (i = 0; i < nthr; i++) {
+    reti = pthread_join(wk[i].wk_thr, NULL);
+    if (reti != 0) {
+      log(LL_WARN, false, "unable to join worker %" PRIu64 ": %s", i, strerror(reti));
+      retb = false;
+      continue;
+    }
+
+    if (wk[i].wk_ret == false) {
+      retb = false;
+    }
+  }
+
+  return retb;
+}
+
+/// Create the live statistics segment with a channel and a scheduler section
+/// for each worker.
+/// @return success/failure indication
+///
+/// @param[in]  wk workers
+/// @param[out] st statistics
+/// @param[in]  cf configuration
+bool
+attach_stats(struct worker* wk, struct stats* st, const struct config* cf)
+{
+  uint64_t i;
+  bool retb;
+
+  retb = create_stats(st, "ureq", (uint32_t)(2 * cf->cf_nwk));
+  if (retb == false) {
+    return false;
+  }
+
+  for (i = 0; i < cf->cf_nwk; i++) {
+    wk[i].wk_stc = init_section(st, (uint32_t)(2 * i),     STATS_CHANNEL,   (uint32_t)i, "channel");
+    wk[i].wk_sts = init_section(st, (uint32_t)(2 * i + 1), STATS_SCHEDULER, (uint32_t)i, "scheduler");
+    publish_worker(&wk[i], 0, true);
+  }
+
+  return true;
+}
+
+/// Publish the live statistics of a worker, unless these were published
+/// recently. This function must be called only by the sending thread of the
+/// worker.
+///
+/// @param[in] wk    worker
+/// @param[in] cur   current monotonic time
+/// @param[in] force ignore the time of the last publication
+void
+publish_worker(struct worker* wk, const uint64_t cur, const bool force)
+{
+  uint64_t val[STATS_FIELD_MAX];
+  struct channel sum;
+  uint64_t i;
+
+  if (wk->wk_stc == NULL) {
+    return;
+  }
+
+  if (force == false && cur - wk->wk_spub < STATS_PERIOD) {
+    return;
+  }
+  wk->wk_spub = cur;
+
+  // The channels of both protocol versions share the section, and their
+  // aggregate has no port.
+  if (wk->wk_nch == 1) {
+    publish_channel(wk->wk_stc, &wk->wk_ch[0]);
+  } else {
+    (void)memset(&sum, 0, sizeof(sum));
+    for (i = 0; i < wk->wk_nch; i++) {
+      merge_channel(&sum, &wk->wk_ch[i]);
+    }
+    publish_channel(wk->wk_stc, &sum);
+  }
+
+  val[SV_SC_ROUNDS] = wk->wk_nrnd;
+  val[SV_SC_SENT]   = __atomic_load_n(&wk->wk_nsent, __ATOMIC_RELAXED);
+  val[SV_SC_RECV]   = __atomic_load_n(&wk->wk_nrecv, __ATOMIC_RELAXED);
+  val[SV_SC_LAST]   = wk->wk_lag;
+  val[SV_SC_MAX]    = wk->wk_lmax;
+  val[SV_SC_SUM]    = wk->wk_lsum;
+  val[SV_SC_LOST]   = __atomic_load_n(&wk->wk_nlost, __ATOMIC_RELAXED);
+  val[SV_SC_LATE]   = __atomic_load_n(&wk->wk_nlate, __ATOMIC_RELAXED);
+  publish_section(wk->wk_sts, val, SV_SC_LATE + 1);
+}
+
+/// Log the aggregated channel statistics of all workers.
+///
+/// @param[in] wk array of workers
+/// @param[in] cf configuration
+void
+log_workers(const struct worker* wk, const struct config* cf)
+{
+  struct channel sum;
+  struct hist hdef;
+  uint64_t i;
+  uint64_t k;
+  uint64_t sent;
+  uint64_t recv;
+
+  log(LL_DEBUG, false, "number of workers: %" PRIu64, cf->cf_nwk);
+
+  (void)memset(&sum, 0, sizeof(sum));
+  for (i = 0; i < cf->cf_nwk; i++) {
+    for (k = 0; k < wk[i].wk_nch; k++) {
+      log(LL_DEBUG, false, "worker %" PRIu64 " local %s UDP port: %" PRIu16,
+          i, wk[i].wk_ch[k].ch_name, wk[i].wk_ch[k].ch_port);
+    }
+
+    // Requests that were not answered yet, or were lost.
+    sent = __atomic_load_n(&wk[i].wk_nsent, __ATOMIC_RELAXED);
+    recv = __atomic_load_n(&wk[i].wk_nrecv, __ATOMIC_RELAXED);
+    log(LL_DEBUG, false, "worker %" PRIu64 " unanswered requests: %" PRIu64,
+        i, sent > recv ? sent - recv : 0);
+
+    // Outcomes of the requests matched against their responses.
+    if (cf->cf_mono == false) {
+      log(LL_DEBUG, false, "worker %" PRIu64 " lost requests: %" PRIu64,
+          i, __atomic_load_n(&wk[i].wk_nlost, __ATOMIC_RELAXED));
+      log(LL_DEBUG, false, "worker %" PRIu64 " late responses: %" PRIu64,
+          i, __atomic_load_n(&wk[i].wk_nlate, __ATOMIC_RELAXED));
+      log(LL_DEBUG, false, "worker %" PRIu64 " duplicate responses: %" PRIu64,
+          i, __atomic_load_n(&wk[i].wk_ndup, __ATOMIC_RELAXED));
+      log(LL_DEBUG, false, "worker %" PRIu64 " unknown responses: %" PRIu64,
+          i, __atomic_load_n(&wk[i].wk_nunk, __ATOMIC_RELAXED));
+    }
+
+    // Report rows that were not printed.
+    if (cf->cf_smp != SAMPLE_NONE || cf->cf_srt != 0) {
+      log(LL_DEBUG, false, "worker %" PRIu64 " unsampled report rows: %" PRIu64,
+          i, __atomic_load_n(&wk[i].wk_smp.sp_nskip, __ATOMIC_RELAXED));
+      log(LL_DEBUG, false, "worker %" PRIu64 " suppressed report rows: %" PRIu64,
+          i, __atomic_load_n(&wk[i].wk_smp.sp_nsup, __ATOMIC_RELAXED));
+    }
+
+    // Requests delayed or dropped due to a full send buffer.
+    log(LL_DEBUG, false, "worker %" PRIu64 " deferred requests: %" PRIu64,
+        i, __atomic_load_n(&wk[i].wk_ndef, __ATOMIC_RELAXED));
+    log(LL_DEBUG, false, "worker %" PRIu64 " dropped deferred requests: %" PRIu64,
+        i, __atomic_load_n(&wk[i].wk_ndrop, __ATOMIC_RELAXED) + count_deferrals(&wk[i]));
+    read_hist(&hdef, &wk[i].wk_hdef);
+    if (hdef.hs_cnt != 0) {
+      log(LL_DEBUG, false, "worker %" PRIu64 " deferral delay: mean %" PRIu64
+          "ns, p50 <= %" PRIu64 "ns, p99 <= %" PRIu64 "ns", i,
+          hdef.hs_sum / hdef.hs_cnt,
+          quantile_hist(&hdef, 50),
+          quantile_hist(&hdef, 99));
+    }
+
+    if (cf->cf_spl == true) {
+      log(LL_DEBUG, false, "worker %" PRIu64 " dropped departures: %" PRIu64,
+          i, __atomic_load_n(&wk[i].wk_dep.rg_drop, __ATOMIC_RELAXED));
+    }
+
+    for (k = 0; k < wk[i].wk_nch; k++) {
+      merge_channel(&sum, &wk[i].wk_ch[k]);
+    }
+  }
+
+  // The aggregate has no port, all of them were listed above.
+  sum.ch_name = "aggregate";
+  if (cf->cf_nwk == 1 && wk[0].wk_nch == 1) {
+    sum.ch_name = wk[0].wk_ch[0].ch_name;
+    sum.ch_port = wk[0].wk_ch[0].ch_port;
+  }
+  log_channel(&sum);
+}
+
+/// Close all channels and release all memory held by workers.
+///
+/// @param[in] wk array of workers
+/// @param[in] cf configuration
+void
+delete_workers(struct worker* wk, const struct config* cf)
+{
+  uint64_t i;
+  uint64_t k;
+
+  for (i = 0; i < cf->cf_nwk; i++) {
+    for (k = 0; k < wk[i].wk_nch; k++) {
+      if (wk[i].wk_ch[k].ch_sim != NULL) {
+        close_sim(&wk[i].wk_ch[k]);
+      } else {
+        close_channel(&wk[i].wk_ch[k]);
+      }
+      delete_host_cache(&wk[i].wk_ch[k].ch_hc);
+    }
+    free(wk[i].wk_tg);
+    free(wk[i].wk_peer);
+    free(wk[i].wk_lane);
+    free(wk[i].wk_flt);
+    free(wk[i].wk_fre);
+    delete_deferrals(&wk[i]);
+
+    if (cf->cf_spl == true) {
+      delete_ring(&wk[i].wk_dep);
+    }
+  }
+
+  free(wk);
+}
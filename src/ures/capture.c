@@ -0,0 +1,519 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/channel.h"
+#include "common/log.h"
+#include "common/now.h"
+#include "ures/funcs.h"
+#include "ures/types.h"
+
+
+/// Extract the requester address, the Time-To-Live value and the UDP payload
+/// from an IP packet. The packet is expected to be a UDP datagram, as selected
+/// by the socket filter or by the replay.
+/// @return success/failure indication
+///
+/// @param[out] ss  IPv4/IPv6 address of the requester
+/// @param[out] pl  start of the UDP payload
+/// @param[out] len length of the UDP payload
+/// @param[out] ttl time-to-live value
+/// @param[in]  pkt IP packet
+/// @param[in]  cap captured length of the packet
+bool
+parse_packet(struct sockaddr_storage* ss,
+             const uint8_t** pl,
+             size_t* len,
+             uint8_t* ttl,
+             const uint8_t* pkt,
+             const size_t cap)
+{
+  struct sockaddr_in* s4;
+  struct sockaddr_in6* s6;
+  const uint8_t* udp;
+  size_t hlen;
+  size_t ulen;
+
+  (void)memset(ss, 0, sizeof(*ss));
+
+  if ((pkt[0] >> 4) == 4) {
+    hlen = (size_t)(pkt[0] & 0x0f) * 4;
+    if (cap < hlen + CAPTURE_UDP_LEN) {
+      return false;
+    }
+
+    s4 = (struct sockaddr_in*)ss;
+    s4->sin_family = AF_INET;
+    (void)memcpy(&s4->sin_addr, pkt + 12, sizeof(s4->sin_addr));
+    (void)memcpy(&s4->sin_port, pkt + hlen, sizeof(s4->sin_port));
+    *ttl = pkt[8];
+  } else {
+    hlen = CAPTURE_IPV6_LEN;
+    if (cap < hlen + CAPTURE_UDP_LEN) {
+      return false;
+    }
+
+    s6 = (struct sockaddr_in6*)ss;
+    s6->sin6_family = AF_INET6;
+    (void)memcpy(&s6->sin6_addr, pkt + 8, sizeof(s6->sin6_addr));
+    (void)memcpy(&s6->sin6_port, pkt + hlen, sizeof(s6->sin6_port));
+    *ttl = pkt[7];
+  }
+
+  // The UDP length covers the header and the payload.
+  udp  = pkt + hlen;
+  ulen = ((size_t)udp[4] << 8) | (size_t)udp[5];
+  if (ulen < CAPTURE_UDP_LEN || hlen + ulen > cap) {
+    return false;
+  }
+
+  *pl  = udp + CAPTURE_UDP_LEN;
+  *len = ulen - CAPTURE_UDP_LEN;
+
+  return true;
+}
+
+// The TPACKET_V3 packet rings are only available on Linux.
+#if defined(__linux__)
+
+#include <sys/mman.h>
+
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+
+#include <unistd.h>
+#include <errno.h>
+
+
+// Length of the captured part of each frame.
+#define CAPTURE_SNAP_LEN 65535
+
+// Offset of the link-layer address that follows the frame header. The
+// TPACKET_ALIGN macro of the kernel headers does not pass the conversion
+// warnings.
+#define CAPTURE_SLL_OFF \
+  ((sizeof(struct tpacket3_hdr) + TPACKET_ALIGNMENT - 1) & ~(size_t)(TPACKET_ALIGNMENT - 1))
+
+/// Attach a classic BPF filter to a socket.
+/// @return success/failure indication
+///
+/// @param[in] sock socket
+/// @param[in] ins  instructions
+/// @param[in] nins number of instructions
+static bool
+attach_filter(const int sock, struct sock_filter* ins, const uint16_t nins)
+{
+  struct sock_fprog fp;
+  int reti;
+
+  fp.len    = nins;
+  fp.filter = ins;
+
+  reti = setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &fp, sizeof(fp));
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to attach the socket filter");
+    return false;
+  }
+
+  return true;
+}
+
+/// Only let through the UDP datagrams that are destined to the port of the
+/// channel, so that the ring is not filled with unrelated traffic. The packet
+/// socket strips the link-layer header, and therefore all offsets are relative
+/// to the IP header.
+/// @return success/failure indication
+///
+/// @param[in] cp packet capture
+/// @param[in] cf configuration
+static bool
+filter_port(const struct capture* cp, const struct config* cf)
+{
+  // Fragments other than the first one do not carry the UDP header.
+  struct sock_filter ins4[] = {
+    BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 0),
+    BPF_STMT(BPF_ALU | BPF_AND | BPF_K,   0xf0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   0x40, 0, 8),
+    BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 9),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 6),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 6),
+    BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K,  0x1fff, 4, 0),
+    BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, 0),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, 2),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   (uint32_t)cf->cf_port[0], 0, 1),
+    BPF_STMT(BPF_RET | BPF_K,             CAPTURE_SNAP_LEN),
+    BPF_STMT(BPF_RET | BPF_K,             0)
+  };
+
+  // Datagrams behind IPv6 extension headers are not recognized.
+  struct sock_filter ins6[] = {
+    BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 0),
+    BPF_STMT(BPF_ALU | BPF_AND | BPF_K,   0xf0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   0x60, 0, 5),
+    BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 6),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 3),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, CAPTURE_IPV6_LEN + 2),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   (uint32_t)cf->cf_port[0], 0, 1),
+    BPF_STMT(BPF_RET | BPF_K,             CAPTURE_SNAP_LEN),
+    BPF_STMT(BPF_RET | BPF_K,             0)
+  };
+
+  if (cf->cf_ipv4 == true) {
+    return attach_filter(cp->cp_sock, ins4, sizeof(ins4) / sizeof(ins4[0]));
+  } else {
+    return attach_filter(cp->cp_sock, ins6, sizeof(ins6) / sizeof(ins6[0]));
+  }
+}
+
+/// Configure the packet socket to use the TPACKET_V3 ring with timestamps.
+/// @return success/failure indication
+///
+/// @param[in] cp packet capture
+/// @param[in] cf configuration
+static bool
+configure_ring(struct capture* cp, const struct config* cf)
+{
+  struct tpacket_req3 req;
+  int ver;
+  int tsf;
+  int reti;
+
+  ver  = TPACKET_V3;
+  reti = setsockopt(cp->cp_sock, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver));
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to select the packet ring version");
+    return false;
+  }
+
+  // Prefer the hardware timestamps, if the network interface was configured
+  // to generate them, and fall back to the software ones otherwise.
+  tsf  = SOF_TIMESTAMPING_RAW_HARDWARE;
+  reti = setsockopt(cp->cp_sock, SOL_PACKET, PACKET_TIMESTAMP, &tsf, sizeof(tsf));
+  if (reti == -1) {
+    log(LL_DEBUG, true, "unable to request hardware timestamps");
+  }
+
+  // The receive buffer size determines the number of blocks in the ring.
+  cp->cp_bsz  = CAPTURE_BLOCK_SIZE;
+  cp->cp_nblk = cf->cf_rbuf / CAPTURE_BLOCK_SIZE;
+  if (cp->cp_nblk < CAPTURE_BLOCK_MIN) {
+    cp->cp_nblk = CAPTURE_BLOCK_MIN;
+  }
+
+  (void)memset(&req, 0, sizeof(req));
+  req.tp_block_size       = (unsigned int)cp->cp_bsz;
+  req.tp_block_nr         = (unsigned int)cp->cp_nblk;
+  req.tp_frame_size       = CAPTURE_FRAME_SIZE;
+  req.tp_frame_nr         = (unsigned int)(cp->cp_bsz / CAPTURE_FRAME_SIZE * cp->cp_nblk);
+  req.tp_retire_blk_tov   = CAPTURE_RETIRE;
+  req.tp_sizeof_priv      = 0;
+  req.tp_feature_req_word = 0;
+
+  reti = setsockopt(cp->cp_sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to create the packet ring");
+    return false;
+  }
+
+  cp->cp_ring = mmap(NULL, cp->cp_bsz * cp->cp_nblk, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, cp->cp_sock, 0);
+  if (cp->cp_ring == MAP_FAILED) {
+    cp->cp_ring = NULL;
+    log(LL_WARN, true, "unable to map the packet ring");
+    return false;
+  }
+
+  log(LL_DEBUG, false, "packet ring: %" PRIu64 " blocks of %" PRIu64 "B",
+    cp->cp_nblk, cp->cp_bsz);
+
+  // The kernel hands over a block that is not full only after the retirement
+  // timeout, by which the responses to sparse requests are late.
+  if (cf->cf_mono == false) {
+    log(LL_WARN, false, "packet ring delays the responses by up to %d ms",
+      CAPTURE_RETIRE);
+  }
+
+  return true;
+}
+
+/// Bind the packet socket to the network interface.
+/// @return success/failure indication
+///
+/// @param[in] cp packet capture
+/// @param[in] cf configuration
+static bool
+bind_interface(const struct capture* cp, const struct config* cf)
+{
+  struct sockaddr_ll sll;
+  unsigned int ifx;
+  int reti;
+
+  ifx = if_nametoindex(cf->cf_cap);
+  if (ifx == 0) {
+    log(LL_WARN, true, "unable to find the interface %s", cf->cf_cap);
+    return false;
+  }
+
+  (void)memset(&sll, 0, sizeof(sll));
+  sll.sll_family   = AF_PACKET;
+  sll.sll_protocol = htons(ETH_P_ALL);
+  sll.sll_ifindex  = (int)ifx;
+
+  reti = bind(cp->cp_sock, (struct sockaddr*)&sll, sizeof(sll));
+  if (reti == -1) {
+    log(LL_WARN, true, "unable to bind to the interface %s", cf->cf_cap);
+    return false;
+  }
+
+  return true;
+}
+
+/// Open the packet socket with a memory-mapped ring that receives the requests
+/// on the selected network interface. The channel socket is still used to
+/// send the responses, and keeps the port bound so that the requesters do not
+/// receive port unreachable errors, but it discards all the datagrams it
+/// receives.
+/// @return success/failure indication
+///
+/// @param[out] cp packet capture
+/// @param[in]  ch channel
+/// @param[in]  cf configuration
+bool
+open_capture(struct capture* cp,
+             const struct channel* ch,
+             const struct config* cf)
+{
+  struct sock_filter none[] = {
+    BPF_STMT(BPF_RET | BPF_K, 0)
+  };
+  bool retb;
+
+  log(LL_INFO, false, "opening the packet ring on interface %s", cf->cf_cap);
+
+  (void)memset(cp, 0, sizeof(*cp));
+
+  // The socket does not receive any frames until it is bound, so that the
+  // filter is in place before the first one arrives.
+  cp->cp_sock = socket(AF_PACKET, SOCK_DGRAM, 0);
+  if (cp->cp_sock == -1) {
+    log(LL_WARN, true, "unable to create the packet socket");
+    return false;
+  }
+
+  retb = filter_port(cp, cf);
+  if (retb == false) {
+    return false;
+  }
+
+  retb = configure_ring(cp, cf);
+  if (retb == false) {
+    return false;
+  }
+
+  retb = bind_interface(cp, cf);
+  if (retb == false) {
+    return false;
+  }
+
+  return attach_filter(ch->ch_sock, none, 1);
+}
+
+/// Close the packet socket and unmap its ring.
+///
+/// @param[in] cp packet capture
+void
+close_capture(struct capture* cp)
+{
+  struct tpacket_stats_v3 ts;
+  socklen_t tsl;
+  int reti;
+
+  if (cp->cp_sock != -1) {
+    tsl  = sizeof(ts);
+    reti = getsockopt(cp->cp_sock, SOL_PACKET, PACKET_STATISTICS, &ts, &tsl);
+    if (reti == 0) {
+      log(LL_DEBUG, false, "frames dropped by the packet ring: %u", ts.tp_drops);
+    }
+  }
+
+  if (cp->cp_ring != NULL) {
+    (void)munmap(cp->cp_ring, cp->cp_bsz * cp->cp_nblk);
+  }
+  if (cp->cp_sock != -1) {
+    (void)close(cp->cp_sock);
+  }
+
+  log(LL_DEBUG, false, "frames received by the packet ring: %" PRIu64, cp->cp_nfrm);
+  log(LL_DEBUG, false, "frames with hardware timestamps: %" PRIu64, cp->cp_nhw);
+}
+
+/// Process all frames of a block that was handed over by the kernel.
+/// @return success/failure indication
+///
+/// @param[in] cp  packet capture
+/// @param[in] bd  block descriptor
+/// @param[in] ch  channel
+/// @param[in] hn  local host name
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+/// @param[in] svc histogram of service times (can be NULL)
+/// @param[in] cf  configuration
+static bool
+process_block(struct capture* cp,
+              struct tpacket_block_desc* bd,
+              struct channel* ch,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              struct plugin* pi,
+              const uint64_t npi,
+              struct hist* svc,
+              const struct config* cf)
+{
+  struct tpacket3_hdr* th;
+  struct sockaddr_ll* sll;
+  struct sockaddr_storage ss;
+  const uint8_t* pl;
+  size_t len;
+  uint8_t ttl;
+  uint64_t roff;
+  uint64_t rtm;
+  uint32_t i;
+  bool retb;
+
+  // The ring timestamps follow the real-time clock, and the steady time of
+  // arrival is derived from them using the current offset of the clocks.
+  roff = real_now() - mono_now();
+
+  th = (struct tpacket3_hdr*)((uint8_t*)bd + bd->hdr.bh1.offset_to_first_pkt);
+  for (i = 0; i < bd->hdr.bh1.num_pkts; i++) {
+    sll = (struct sockaddr_ll*)((uint8_t*)th + CAPTURE_SLL_OFF);
+
+    // Skip the frames sent from this host, which are seen on the loopback
+    // interface in addition to their received copies.
+    if (sll->sll_pkttype != PACKET_OUTGOING) {
+      cp->cp_nfrm++;
+
+      // The kernel stamps each frame when it is copied to the ring, unless it
+      // already carries a hardware or software timestamp.
+      if (th->tp_status & TP_STATUS_TS_RAW_HARDWARE) {
+        cp->cp_nhw++;
+      }
+      rtm = (uint64_t)th->tp_sec * 1000000000ULL + (uint64_t)th->tp_nsec;
+
+      retb = parse_packet(&ss, &pl, &len, &ttl, (uint8_t*)th + th->tp_net, th->tp_snaplen);
+      if (retb == false || th->tp_snaplen < th->tp_len) {
+        log(LL_DEBUG, false, "malformed or truncated frame");
+        ch->ch_rall++;
+        ch->ch_resz++;
+      } else {
+        retb = handle_capture(ch, hn, pi, npi, svc, &ss, pl, len, ttl, rtm - roff, rtm,
+                              NULL, cf);
+        if (retb == false) {
+          return false;
+        }
+      }
+    }
+
+    th = (struct tpacket3_hdr*)((uint8_t*)th + th->tp_next_offset);
+  }
+
+  return true;
+}
+
+/// Process all blocks of the ring that are ready, without any system calls.
+/// Each block is returned to the kernel as soon as its frames are processed.
+/// @return success/failure indication
+///
+/// @param[in] cp  packet capture
+/// @param[in] ch  channel
+/// @param[in] hn  local host name
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+/// @param[in] svc histogram of service times (can be NULL)
+/// @param[in] cf  configuration
+bool
+drain_capture(struct capture* cp,
+              struct channel* ch,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              struct plugin* pi,
+              const uint64_t npi,
+              struct hist* svc,
+              const struct config* cf)
+{
+  struct tpacket_block_desc* bd;
+  uint32_t st;
+  bool retb;
+
+  while (true) {
+    bd = (struct tpacket_block_desc*)(cp->cp_ring + cp->cp_cur * cp->cp_bsz);
+    st = __atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+    if ((st & TP_STATUS_USER) == 0) {
+      break;
+    }
+
+    retb = process_block(cp, bd, ch, hn, pi, npi, svc, cf);
+    __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    cp->cp_cur = (cp->cp_cur + 1) % cp->cp_nblk;
+
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+#else
+
+bool
+open_capture(struct capture* cp,
+             const struct channel* ch,
+             const struct config* cf)
+{
+  (void)ch;
+  (void)cf;
+
+  (void)memset(cp, 0, sizeof(*cp));
+  cp->cp_sock = -1;
+  log(LL_WARN, false, "packet rings are not supported on this platform");
+  return false;
+}
+
+void
+close_capture(struct capture* cp)
+{
+  (void)cp;
+}
+
+bool
+drain_capture(struct capture* cp,
+              struct channel* ch,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              struct plugin* pi,
+              const uint64_t npi,
+              struct hist* svc,
+              const struct config* cf)
+{
+  (void)cp;
+  (void)ch;
+  (void)hn;
+  (void)pi;
+  (void)npi;
+  (void)svc;
+  (void)cf;
+
+  return true;
+}
+
+#endif
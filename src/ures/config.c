@@ -4,6 +4,8 @@
 // Distributed under the terms of the 2-clause BSD License. The full
 // license is in the file LICENSE, distributed as part of this software.
 
+#include <arpa/inet.h>
+
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -12,6 +14,7 @@
 #include <inttypes.h>
 
 #include "common/log.h"
+#include "common/now.h"
 #include "common/parse.h"
 #include "ures/funcs.h"
 #include "ures/types.h"
@@ -32,6 +35,12 @@
 #define DEF_TIMEOUT             0
 #define DEF_LENGTH              0
 #define DEF_PROTO_VERSION_4     true
+#define DEF_CLOCK               NOW_CLOCK_SYSTEM
+#define DEF_LOG_BACKEND         LB_STDERR
+#define DEF_STATS               false
+#define DEF_XDP_GENERIC         false
+#define DEF_BUSY                false
+#define DEF_AGGR_PERIOD         0
 
 /// Print the usage information to the standard output stream.
 static void
@@ -41,33 +50,53 @@ print_usage(void)
     "About:\n"
     "  Unicast network responder.\n"
     "  Program version: %d.%d.%d\n"
-    "  Payload version: %d\n\n"
+    "  Payload versions: %d (full), %d (compact)\n\n"
 
     "Usage:\n"
     "  ures [OPTIONS]\n\n"
 
     "Options:\n"
     "  -6      Use the IPv6 protocol.\n"
+    "  -A ADDR Bind to a local address instead of the wildcard (repeatable).\n"
     "  -a OBJ  Attach a plugin from a shared object file.\n"
+    "  -b      Spin on non-blocking receives instead of sleeping (busy mode).\n"
+    "  -C CPU  Pin the responder to a CPU.\n"
     "  -d DUR  Time-out for lack of incoming requests.\n"
     "  -e      Stop the process on first transmission error.\n"
+    "  -f FILE Replay the requests from a pcap or pcapng file.\n"
+    "  -g      Attach the XDP program in the generic mode.\n"
+    "  -G DUR  Report summaries per requester and period DUR instead of requests.\n"
     "  -h      Print this help message.\n"
+    "  -i IF   Receive the requests through a packet ring on interface IF.\n"
     "  -k KEY  Unique key for identification of payloads.\n"
     "  -l LEN  Overall accepted payload length.\n"
+    "  -L BKND Logging back-end service: stderr or syslog. (def=stderr)\n"
     "  -m      Disable responding (monologue mode).\n"
+    "  -M      Publish live statistics in a shared memory segment.\n"
     "  -n      Turn off coloring in the logging output.\n"
-    "  -p NUM  UDP port to use for all endpoints. (def=%d)\n"
+    "  -o FILE Write the responses of the replay to a pcap file.\n"
+    "  -p LIST Comma-separated list of UDP ports to serve. (def=%d)\n"
+    "  -P PATH Serve metrics on a Unix domain socket.\n"
     "  -q      Suppress reporting to standard output.\n"
-    "  -r RBS  Socket receive memory buffer size. (def=2m)\n"
-    "  -s SBS  Socket send memory buffer size. (def=2m)\n"
+    "  -r RBS  Socket receive memory buffer size, or auto[:MAX]. (def=2m)\n"
+    "  -R PRIO Real-time FIFO scheduling priority (1-99).\n"
+    "  -s SBS  Socket send memory buffer size, or auto[:MAX]. (def=2m)\n"
+    "  -S CLK  Clock source for timestamps: sys or tsc. (def=sys)\n"
     "  -t TTL  Outgoing IP Time-To-Live value. (def=%d)\n"
-    "  -v      Increase the verbosity of the logging output.\n",
+    "  -T CNT  Number of requesters tracked by the aggregation and host names. (def=%d)\n"
+    "  -v      Increase the verbosity of the logging output.\n"
+    "  -x IF   Reflect the requests in the kernel with XDP on interface IF.\n"
+    "  -y N    Report every N-th row.\n"
+    "  -Y N    Report the rows of 1 in N requests, sampled by their hash.\n"
+    "  -z RATE Report at most RATE rows per second.\n",
     NEMO_RES_VERSION_MAJOR,
     NEMO_RES_VERSION_MINOR,
     NEMO_RES_VERSION_PATCH,
-    NEMO_PAYLOAD_VERSION,
+    NEMO_PAYLOAD_VERSION_FULL,
+    NEMO_PAYLOAD_VERSION_COMPACT,
     DEF_UDP_PORT,
-    DEF_TIME_TO_LIVE);
+    DEF_TIME_TO_LIVE,
+    AGGR_DEF_SIZE);
 }
 
 /// Select IPv6 protocol only.
@@ -107,6 +136,60 @@ option_a(struct config* cf, const char* in)
   return true;
 }
 
+/// Bind the channels to a particular local address instead of the wildcard
+/// address. The protocol version of each channel follows from its address.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_A(struct config* cf, const char* in)
+{
+  struct in6_addr a6;
+  struct in_addr a4;
+
+  if (cf->cf_naddr >= ADDR_MAX) {
+    log(LL_WARN, false, "too many local addresses, only %d allowed", ADDR_MAX);
+    return false;
+  }
+
+  if (inet_pton(AF_INET, in, &a4) != 1 && inet_pton(AF_INET6, in, &a6) != 1) {
+    log(LL_WARN, false, "invalid local address '%s'", in);
+    return false;
+  }
+
+  cf->cf_addr[cf->cf_naddr] = in;
+  cf->cf_naddr++;
+
+  return true;
+}
+
+/// Spin on non-blocking receives with locked memory and socket busy-polling,
+/// instead of sleeping until a request arrives.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input (unused)
+static bool
+option_b(struct config* cf, const char* in)
+{
+  (void)in;
+  cf->cf_busy = true;
+
+  return true;
+}
+
+/// Set the CPU affinity of the responder.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_C(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_cpu, in, 0, CPU_LIST_MAX * 64);
+}
+
 /// Time-out of inactivity (no requests received).
 /// @return success/failure indication
 ///
@@ -132,6 +215,46 @@ option_e(struct config* cf, const char* in)
   return true;
 }
 
+/// Replay the requests from a capture file instead of receiving them.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_f(struct config* cf, const char* in)
+{
+  cf->cf_rep = in;
+
+  return true;
+}
+
+/// Attach the XDP program in the generic mode, which is supported by all
+/// network interfaces, including the virtual ones.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input (unused)
+static bool
+option_g(struct config* cf, const char* in)
+{
+  (void)in;
+  cf->cf_xgen = true;
+
+  return true;
+}
+
+/// Report the summaries of the requesters over periods of a given duration,
+/// instead of each request.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_G(struct config* cf, const char* in)
+{
+  return parse_scalar(&cf->cf_agp, in, "ns", 1, UINT64_MAX / 2, parse_time_unit);
+}
+
 /// Print the usage help message and exit the process.
 /// @return success/failure indication
 ///
@@ -149,6 +272,19 @@ option_h(struct config* cf, const char* in)
   return true;
 }
 
+/// Receive the requests through a packet ring on a network interface.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_i(struct config* cf, const char* in)
+{
+  cf->cf_cap = in;
+
+  return true;
+}
+
 /// Set a unique key to identify the flow.
 /// @return success/failure indication
 ///
@@ -168,7 +304,18 @@ option_k(struct config* cf, const char* in)
 static bool
 option_l(struct config* cf, const char* in)
 {
-  return parse_scalar(&cf->cf_len, in, "b", NEMO_PAYLOAD_SIZE, 64436, parse_memory_unit);
+  return parse_scalar(&cf->cf_len, in, "b", NEMO_PAYLOAD_COMPACT_SIZE, 64436, parse_memory_unit);
+}
+
+/// Select the back-end service for the logging output.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_L(struct config* cf, const char* in)
+{
+  return parse_log_backend(&cf->cf_lbe, in);
 }
 
 /// Enable monologue mode where no responses are being issued.
@@ -185,6 +332,20 @@ option_m(struct config* cf, const char* in)
   return true;
 }
 
+/// Publish live statistics in a shared memory segment.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input (unused)
+static bool
+option_M(struct config* cf, const char* in)
+{
+  (void)in;
+  cf->cf_stat = true;
+
+  return true;
+}
+
 /// Turn off coloring and highlights in the logging output.
 /// @return success/failure indication
 ///
@@ -199,7 +360,20 @@ option_n(struct config* cf, const char* in)
   return true;
 }
 
-/// Set the UDP port number used for all communication.
+/// Write the responses of the replay to a capture file.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_o(struct config* cf, const char* in)
+{
+  cf->cf_out = in;
+
+  return true;
+}
+
+/// Set the comma-separated list of UDP port numbers to serve.
 /// @return success/failure indication
 ///
 /// @param[out] cf configuration
@@ -207,7 +381,62 @@ option_n(struct config* cf, const char* in)
 static bool
 option_p(struct config* cf, const char* in)
 {
-  return parse_uint64(&cf->cf_port, in, 1, 65535);
+  char cpy[256];
+  char* tok;
+  char* save;
+  bool retb;
+  uint64_t i;
+
+  // The tokenizer modifies the string, and therefore we have to operate on a
+  // copy of the argument.
+  if (strlen(in) >= sizeof(cpy)) {
+    log(LL_WARN, false, "port list '%s' is too long", in);
+    return false;
+  }
+  (void)memset(cpy, '\0', sizeof(cpy));
+  (void)strncpy(cpy, in, sizeof(cpy) - 1);
+
+  cf->cf_nport = 0;
+  for (tok = strtok_r(cpy, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+    if (cf->cf_nport == PORT_MAX) {
+      log(LL_WARN, false, "too many ports, only %d allowed", PORT_MAX);
+      return false;
+    }
+
+    retb = parse_uint64(&cf->cf_port[cf->cf_nport], tok, 1, 65535);
+    if (retb == false) {
+      return false;
+    }
+
+    for (i = 0; i < cf->cf_nport; i++) {
+      if (cf->cf_port[i] == cf->cf_port[cf->cf_nport]) {
+        log(LL_WARN, false, "duplicate port %s", tok);
+        return false;
+      }
+    }
+
+    cf->cf_nport++;
+  }
+
+  if (cf->cf_nport == 0) {
+    log(LL_WARN, false, "empty port list");
+    return false;
+  }
+
+  return true;
+}
+
+/// Serve metrics in the Prometheus text format on a Unix domain socket.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_P(struct config* cf, const char* in)
+{
+  cf->cf_prom = in;
+
+  return true;
 }
 
 /// Suppress reporting to the standard output stream.
@@ -224,7 +453,7 @@ option_q(struct config* cf, const char* in)
   return true;
 }
 
-/// Set the socket receive buffer size.
+/// Set the socket receive buffer size, or its adaptive sizing.
 /// @return success/failure indication
 ///
 /// @param[out] cf configuration
@@ -232,10 +461,21 @@ option_q(struct config* cf, const char* in)
 static bool
 option_r(struct config* cf, const char* in)
 {
-  return parse_scalar(&cf->cf_rbuf, in, "b", NEMO_PAYLOAD_SIZE, SIZE_MAX, parse_memory_unit);
+  return parse_buffer(&cf->cf_rbuf, &cf->cf_rcap, in, NEMO_PAYLOAD_SIZE, CHANNEL_AUTO_CEILING);
+}
+
+/// Schedule the responder with the real-time FIFO policy.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_R(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_prio, in, 1, 99);
 }
 
-/// Set the socket send buffer size.
+/// Set the socket send buffer size, or its adaptive sizing.
 /// @return success/failure indication
 ///
 /// @param[out] cf configuration
@@ -243,7 +483,18 @@ option_r(struct config* cf, const char* in)
 static bool
 option_s(struct config* cf, const char* in)
 {
-  return parse_scalar(&cf->cf_sbuf, in, "b", NEMO_PAYLOAD_SIZE, SIZE_MAX, parse_memory_unit);
+  return parse_buffer(&cf->cf_sbuf, &cf->cf_scap, in, NEMO_PAYLOAD_SIZE, CHANNEL_AUTO_CEILING);
+}
+
+/// Select the clock source for all timestamps.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_S(struct config* cf, const char* in)
+{
+  return parse_clock(&cf->cf_clk, in);
 }
 
 /// Set the IP Time-To-Live value.
@@ -257,6 +508,17 @@ option_t(struct config* cf, const char* in)
   return parse_uint64(&cf->cf_ttl, in, 1, 255);
 }
 
+/// Number of requesters tracked by the aggregation.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_T(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_agn, in, 1, AGGR_MAX_SIZE);
+}
+
 /// Increase the logging verbosity.
 /// @return success/failure indication
 ///
@@ -286,6 +548,55 @@ option_v(struct config* cf, const char* in)
   return true;
 }
 
+/// Reflect the requests in the kernel on a network interface.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_x(struct config* cf, const char* in)
+{
+  cf->cf_xdp = in;
+
+  return true;
+}
+
+/// Report every N-th row of the requests.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_y(struct config* cf, const char* in)
+{
+  cf->cf_smp = SAMPLE_COUNT;
+  return parse_uint64(&cf->cf_sev, in, 1, SAMPLE_MAX);
+}
+
+/// Report the rows of the requests whose key and sequence number hash to one
+/// in N, so that both programs sample the same requests.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_Y(struct config* cf, const char* in)
+{
+  cf->cf_smp = SAMPLE_HASH;
+  return parse_uint64(&cf->cf_sev, in, 1, SAMPLE_MAX);
+}
+
+/// Limit the number of report rows per second.
+/// @return success/failure indication
+///
+/// @param[out] cf configuration
+/// @param[in]  in argument input
+static bool
+option_z(struct config* cf, const char* in)
+{
+  return parse_uint64(&cf->cf_srt, in, 1, SAMPLE_MAX);
+}
+
 /// Assign default values to all options.
 /// @return success/failure indication
 ///
@@ -299,19 +610,44 @@ set_defaults(struct config* cf)
     cf->cf_plgs[i] = NULL;
   }
 
+  for (i = 0; i < ADDR_MAX; i++) {
+    cf->cf_addr[i] = NULL;
+  }
+
   cf->cf_rbuf = DEF_RECEIVE_BUFFER_SIZE;
   cf->cf_sbuf = DEF_SEND_BUFFER_SIZE;
+  cf->cf_rcap = 0;
+  cf->cf_scap = 0;
   cf->cf_err  = DEF_EXIT_ON_ERROR;
-  cf->cf_port = DEF_UDP_PORT;
+  cf->cf_port[0] = DEF_UDP_PORT;
+  cf->cf_nport   = 1;
+  cf->cf_naddr   = 0;
   cf->cf_ttl  = DEF_TIME_TO_LIVE;
   cf->cf_mono = DEF_MONOLOGUE;
   cf->cf_sil  = DEF_SILENT;
   cf->cf_llvl = (log_lvl = DEF_LOG_LEVEL);
   cf->cf_lcol = (log_col = DEF_LOG_COLOR);
   cf->cf_ipv4 = DEF_PROTO_VERSION_4;
+  cf->cf_clk  = DEF_CLOCK;
+  cf->cf_lbe  = DEF_LOG_BACKEND;
+  cf->cf_stat = DEF_STATS;
+  cf->cf_prom = NULL;
+  cf->cf_xdp  = NULL;
+  cf->cf_cap  = NULL;
+  cf->cf_rep  = NULL;
+  cf->cf_out  = NULL;
+  cf->cf_busy = DEF_BUSY;
+  cf->cf_cpu  = CPU_NONE;
+  cf->cf_prio = CPU_PRIO_NONE;
+  cf->cf_xgen = DEF_XDP_GENERIC;
   cf->cf_key  = DEF_KEY;
   cf->cf_ito  = DEF_TIMEOUT;
   cf->cf_len  = DEF_LENGTH;
+  cf->cf_agp  = DEF_AGGR_PERIOD;
+  cf->cf_agn  = AGGR_DEF_SIZE;
+  cf->cf_smp  = SAMPLE_NONE;
+  cf->cf_sev  = 1;
+  cf->cf_srt  = 0;
 
   return true;
 }
@@ -356,28 +692,46 @@ parse_config(struct config* cf, int argc, char* argv[])
   bool retb;
   uint64_t i;
   char optdsl[128];
-  struct option opts[15] = {
+  struct option opts[33] = {
     { '6',  false, option_6 },
     { 'a',  true , option_a },
+    { 'A',  true , option_A },
+    { 'b',  false, option_b },
+    { 'C',  true , option_C },
     { 'd',  true,  option_d },
     { 'e',  false, option_e },
+    { 'f',  true,  option_f },
+    { 'g',  false, option_g },
+    { 'G',  true,  option_G },
     { 'h',  false, option_h },
+    { 'i',  true , option_i },
     { 'k',  true , option_k },
     { 'l',  true , option_l },
+    { 'L',  true,  option_L },
     { 'm',  false, option_m },
+    { 'M',  false, option_M },
     { 'n',  false, option_n },
+    { 'o',  true,  option_o },
     { 'p',  true , option_p },
+    { 'P',  true , option_P },
     { 'q',  false, option_q },
     { 'r',  true , option_r },
+    { 'R',  true , option_R },
     { 's',  true , option_s },
+    { 'S',  true,  option_S },
     { 't',  true , option_t },
-    { 'v',  false, option_v }
+    { 'T',  true , option_T },
+    { 'v',  false, option_v },
+    { 'x',  true , option_x },
+    { 'y',  true , option_y },
+    { 'Y',  true , option_Y },
+    { 'z',  true , option_z }
   };
 
   log(LL_INFO, false, "parsing command-line options");
 
   (void)memset(optdsl, '\0', sizeof(optdsl));
-  generate_getopt_string(optdsl, opts, 15);
+  generate_getopt_string(optdsl, opts, 33);
 
   // Set optional arguments to sensible defaults.
   retb = set_defaults(cf);
@@ -403,7 +757,7 @@ parse_config(struct config* cf, int argc, char* argv[])
     }
 
     // Find the relevant option.
-    for (i = 0; i < 15; i++) {
+    for (i = 0; i < 33; i++) {
       if (opts[i].op_name == (char)opt) {
         retb = opts[i].op_act(cf, optarg);
         if (retb == false) {
@@ -422,6 +776,36 @@ parse_config(struct config* cf, int argc, char* argv[])
     return false;
   }
 
+  // The generic mode only applies to the in-kernel reflection.
+  if (cf->cf_xgen == true && cf->cf_xdp == NULL) {
+    log(LL_WARN, false, "generic mode requires the in-kernel reflection");
+    return false;
+  }
+
+  // The in-kernel reflection and the packet ring filter a single port of a
+  // single protocol on the whole interface.
+  if ((cf->cf_xdp != NULL || cf->cf_cap != NULL)
+   && (cf->cf_nport != 1 || cf->cf_naddr != 0)) {
+    log(LL_WARN, false, "in-kernel reflection and packet ring require a single port");
+    return false;
+  }
+
+  // The replay reads the requests from a file instead of the network.
+  if (cf->cf_out != NULL && cf->cf_rep == NULL) {
+    log(LL_WARN, false, "responses can only be written by the replay");
+    return false;
+  }
+  if (cf->cf_rep != NULL && (cf->cf_xdp != NULL || cf->cf_cap != NULL || cf->cf_busy == true)) {
+    log(LL_WARN, false, "replay excludes the in-kernel reflection, packet ring and busy mode");
+    return false;
+  }
+
+  // The summaries of the aggregation are bounded by the number of requesters.
+  if (cf->cf_agp != 0 && (cf->cf_smp != SAMPLE_NONE || cf->cf_srt != 0)) {
+    log(LL_WARN, false, "sampling does not apply to the aggregation");
+    return false;
+  }
+
   // Assign the logging settings.
   log_lvl = cf->cf_llvl;
   log_col = cf->cf_lcol;
@@ -439,9 +823,13 @@ log_config(const struct config* cf)
   const char* mono;
   const char* ipv;
   const char* err;
+  const char* stat;
+  const char* xmod;
+  const char* busy;
   char key[32];
   char len[32];
   char ito[32];
+  uint64_t i;
 
   // Monologue mode.
   if (cf->cf_mono == true) {
@@ -464,6 +852,27 @@ log_config(const struct config* cf)
     err = "no";
   }
 
+  // Live statistics.
+  if (cf->cf_stat == true) {
+    stat = "yes";
+  } else {
+    stat = "no";
+  }
+
+  // Attachment mode of the in-kernel reflection.
+  if (cf->cf_xgen == true) {
+    xmod = "generic";
+  } else {
+    xmod = "native";
+  }
+
+  // Busy mode.
+  if (cf->cf_busy == true) {
+    busy = "yes";
+  } else {
+    busy = "no";
+  }
+
   // Key.
   if (cf->cf_key == 0) {
     (void)strncpy(key, "any", sizeof(key));
@@ -485,14 +894,52 @@ log_config(const struct config* cf)
     (void)snprintf(ito, sizeof(ito), "%" PRIu64, cf->cf_ito);
   }
 
-  log(LL_DEBUG, false, "UDP port: %" PRIu64, cf->cf_port);
+  for (i = 0; i < cf->cf_nport; i++) {
+    log(LL_DEBUG, false, "UDP port: %" PRIu64, cf->cf_port[i]);
+  }
+  for (i = 0; i < cf->cf_naddr; i++) {
+    log(LL_DEBUG, false, "local address: %s", cf->cf_addr[i]);
+  }
   log(LL_DEBUG, false, "unique key: %s", key);
   log(LL_DEBUG, false, "time-to-live: %" PRIu64, cf->cf_ttl);
   log(LL_DEBUG, false, "inactivity timeout: %s", ito);
   log(LL_DEBUG, false, "payload length: %s", len);
   log(LL_DEBUG, false, "send buffer size: %" PRIu64 "%c", cf->cf_sbuf, 'B');
-  log(LL_DEBUG, false, "receive buffer size: %" PRIu64 "%c", cf->cf_sbuf, 'B');
+  if (cf->cf_scap != 0) {
+    log(LL_DEBUG, false, "send buffer ceiling: %" PRIu64 "%c", cf->cf_scap, 'B');
+  }
+  log(LL_DEBUG, false, "receive buffer size: %" PRIu64 "%c", cf->cf_rbuf, 'B');
+  if (cf->cf_rcap != 0) {
+    log(LL_DEBUG, false, "receive buffer ceiling: %" PRIu64 "%c", cf->cf_rcap, 'B');
+  }
   log(LL_DEBUG, false, "internet protocol version: %s", ipv);
   log(LL_DEBUG, false, "exit on error: %s", err);
   log(LL_DEBUG, false, "monologue mode: %s", mono);
+  log(LL_DEBUG, false, "clock source: %s", clock_name(cf->cf_clk));
+  log(LL_DEBUG, false, "logging back-end: %s", log_backend_name(cf->cf_lbe));
+  log(LL_DEBUG, false, "live statistics: %s", stat);
+  log(LL_DEBUG, false, "metrics socket: %s", cf->cf_prom == NULL ? "none" : cf->cf_prom);
+  log(LL_DEBUG, false, "in-kernel reflection: %s", cf->cf_xdp == NULL ? "none" : cf->cf_xdp);
+  log(LL_DEBUG, false, "in-kernel reflection mode: %s", xmod);
+  log(LL_DEBUG, false, "packet ring: %s", cf->cf_cap == NULL ? "none" : cf->cf_cap);
+  log(LL_DEBUG, false, "busy mode: %s", busy);
+  log(LL_DEBUG, false, "replay: %s", cf->cf_rep == NULL ? "none" : cf->cf_rep);
+  log(LL_DEBUG, false, "replay responses: %s", cf->cf_out == NULL ? "none" : cf->cf_out);
+  if (cf->cf_smp != SAMPLE_NONE) {
+    log(LL_DEBUG, false, "report sampling: %s, 1 in %" PRIu64,
+        sampling_name(cf->cf_smp), cf->cf_sev);
+  }
+  if (cf->cf_srt != 0) {
+    log(LL_DEBUG, false, "report rate limit: %" PRIu64 " rows/s", cf->cf_srt);
+  }
+  if (cf->cf_agp != 0) {
+    log(LL_DEBUG, false, "aggregation period: %" PRIu64 "ns", cf->cf_agp);
+    log(LL_DEBUG, false, "aggregated requesters: %" PRIu64, cf->cf_agn);
+  }
+  if (cf->cf_cpu != CPU_NONE) {
+    log(LL_DEBUG, false, "CPU affinity: %" PRIu64, cf->cf_cpu);
+  }
+  if (cf->cf_prio != CPU_PRIO_NONE) {
+    log(LL_DEBUG, false, "real-time priority: %" PRIu64, cf->cf_prio);
+  }
 }
@@ -10,6 +10,8 @@
 
 #include "common/channel.h"
 #include "common/convert.h"
+#include "common/hist.h"
+#include "common/host.h"
 #include "common/log.h"
 #include "common/now.h"
 #include "common/packet.h"
@@ -23,15 +25,19 @@
 ///
 /// @param[in] pl  payload
 /// @param[in] ttl time-to-live value
+/// @param[in] mtm steady time of arrival
+/// @param[in] rtm system time of arrival
 static void
 fill_payload(struct payload* pl,
-             const uint8_t ttl)
+             const uint8_t ttl,
+             const uint64_t mtm,
+             const uint64_t rtm)
 {
   log(LL_TRACE, false, "updating payload");
 
   pl->pl_type = NEMO_PAYLOAD_TYPE_RESPONSE;
-  pl->pl_mtm2 = mono_now();
-  pl->pl_rtm2 = real_now();
+  pl->pl_mtm2 = mtm;
+  pl->pl_rtm2 = rtm;
   pl->pl_ttl2 = ttl;
 }
 
@@ -48,6 +54,7 @@ update_payload(struct payload* pl,
   pl->pl_key  = cf->cf_key;
   pl->pl_ttl1 = (uint8_t)cf->cf_ttl;
   (void)memcpy(pl->pl_host, hn, NEMO_HOST_NAME_SIZE);
+  pl->pl_hid  = host_id(hn);
 }
 
 /// Create a part of a IPv6 address by converting array of bytes into a
@@ -110,10 +117,114 @@ retrieve_address(uint64_t* la,
   } else {
     s6  = (struct sockaddr_in6*)ss;
     *la = ipv6_part(&s6->sin6_addr.s6_addr[0]);
-    *ha = ipv6_part(&s6->sin6_addr.s6_addr[7]);
+    *ha = ipv6_part(&s6->sin6_addr.s6_addr[8]);
   }
 }
 
+/// Report a received request and respond to it.
+/// @return success/failure indication
+///
+/// @param[in] ch  channel
+/// @param[in] hn  host name
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+/// @param[in] svc histogram of service times (can be NULL)
+/// @param[in] ss  IPv4/IPv6 address of the requester
+/// @param[in] pl  payload
+/// @param[in] ttl time-to-live value
+/// @param[in] mtm steady time of arrival
+/// @param[in] rtm system time of arrival
+/// @param[in] rp  replay of the capture file (can be NULL)
+/// @param[in] cf  configuration
+static bool
+respond(struct channel* ch,
+        const char hn[static NEMO_HOST_NAME_SIZE],
+        struct plugin* pi,
+        const uint64_t npi,
+        struct hist* svc,
+        const struct sockaddr_storage* ss,
+        struct payload* pl,
+        const uint8_t ttl,
+        const uint64_t mtm,
+        const uint64_t rtm,
+        struct replay* rp,
+        const struct config* cf)
+{
+  struct payload req;
+  bool retb;
+  uint16_t pn;
+  uint64_t la;
+  uint64_t ha;
+  uint64_t rdep;
+  uint64_t mdep;
+
+  // Retrieve the port and address of the requester.
+  retrieve_port(&pn, ss);
+  retrieve_address(&la, &ha, ss);
+
+  // Do not respond if a particular key is selected, and the requesters key
+  // does not match.
+  if (cf->cf_key != 0 && (pl->pl_key != cf->cf_key)) {
+    return true;
+  }
+
+  // Do not respond if the overall length of the packet does not match the
+  // expected length.
+  if (cf->cf_len != 0 && (pl->pl_len != cf->cf_len)) {
+    return true;
+  }
+
+  // Fill unassigned fields in the payload.
+  fill_payload(pl, ttl, mtm, rtm);
+
+  // Notify all attached plugins about the payload.
+  notify_plugins(pi, npi, pl);
+
+  // Update the payload by overwriting certain fields. The report describes
+  // the request, and is therefore based on its copy.
+  req = *pl;
+  update_payload(pl, hn, cf);
+
+  // Do not respond if the monologue mode is turned on.
+  if (cf->cf_mono == true) {
+    report_event(&req, hn, la, ha, pn, ch->ch_ipv4, 0, 0, cf);
+    return true;
+  }
+
+  // The departure of the response is only needed by the report.
+  rdep = 0;
+  mdep = 0;
+  if (cf->cf_sil == false) {
+    rdep = real_now();
+    mdep = mono_now();
+  }
+
+  // Send a response back, or hand it over to the replay. The event is
+  // reported afterwards, so that the formatting of the report does not delay
+  // the response.
+  if (rp != NULL) {
+    retb = send_replay(rp, ch, pl, cf);
+  } else {
+    retb = send_packet(ch, pl, *ss, cf->cf_err);
+  }
+  if (retb == false) {
+    log(LL_WARN, false, "unable to send datagram on the socket");
+    report_event(&req, hn, la, ha, pn, ch->ch_ipv4, 0, 0, cf);
+
+    // Following the same logic as in the receive stage.
+    return !cf->cf_err;
+  }
+
+  report_event(&req, hn, la, ha, pn, ch->ch_ipv4, rdep, mdep, cf);
+
+  // Account for the time spent on the request.
+  if (svc != NULL) {
+    update_hist(svc, mono_now() - pl->pl_mtm2);
+  }
+
+  return true;
+}
+
 /// Handle the event of an incoming events.
 /// @return success/failure indication
 ///
@@ -121,21 +232,21 @@ retrieve_address(uint64_t* la,
 /// @param[in] hn  host name
 /// @param[in] pi  array of plugins
 /// @param[in] npi number of plugins
+/// @param[in] svc histogram of service times (can be NULL)
 /// @param[in] cf  configuration
 bool
 handle_event(struct channel* ch,
              const char hn[static NEMO_HOST_NAME_SIZE],
-             const struct plugin* pi,
+             struct plugin* pi,
              const uint64_t npi,
+             struct hist* svc,
              const struct config* cf)
 {
   bool retb;
   struct sockaddr_storage ss;
   struct payload pl;
   uint8_t ttl;
-  uint16_t pn;
-  uint64_t la;
-  uint64_t ha;
+  uint64_t mtm;
 
   log(LL_TRACE, false, "handling event on the %s channel", ch->ch_name);
 
@@ -152,47 +263,143 @@ handle_event(struct channel* ch,
     return !cf->cf_err;
   }
 
-  // Retrieve the port and address of the requester.
-  retrieve_port(&pn, &ss);
-  retrieve_address(&la, &ha, &ss);
+  mtm = mono_now();
+  return respond(ch, hn, pi, npi, svc, &ss, &pl, ttl, mtm, real_now(), NULL, cf);
+}
 
-  // Do not respond if a particular key is selected, and the requesters key
-  // does not match.
-  if (cf->cf_key != 0 && (pl.pl_key != cf->cf_key)) {
-    return true;
+/// Handle a request if one is available on the channel, without waiting for
+/// it.
+/// @return success/failure indication
+///
+/// @param[in]  ch  channel
+/// @param[in]  hn  host name
+/// @param[in]  pi  array of plugins
+/// @param[in]  npi number of plugins
+/// @param[in]  svc histogram of service times (can be NULL)
+/// @param[out] got request was received
+/// @param[in]  cf  configuration
+bool
+poll_event(struct channel* ch,
+           const char hn[static NEMO_HOST_NAME_SIZE],
+           struct plugin* pi,
+           const uint64_t npi,
+           struct hist* svc,
+           bool* got,
+           const struct config* cf)
+{
+  bool retb;
+  struct sockaddr_storage ss;
+  struct payload pl;
+  uint8_t ttl;
+  uint64_t mtm;
+
+  retb = poll_packet(ch, &ss, &pl, &ttl, got, cf->cf_err);
+  if (retb == false) {
+    log(LL_WARN, false, "unable to receive datagram on the socket");
+    return !cf->cf_err;
   }
 
-  // Do not respond if the overall length of the packet does not match the
-  // expected length.
-  if (cf->cf_len != 0 && (pl.pl_len != cf->cf_len)) {
+  if (*got == false) {
     return true;
   }
 
-  // Fill unassigned fields in the payload.
-  fill_payload(&pl, ttl);
+  mtm = mono_now();
+  return respond(ch, hn, pi, npi, svc, &ss, &pl, ttl, mtm, real_now(), NULL, cf);
+}
 
-  // Report the event as a entry in the CSV output.
-  report_event(&pl, hn, la, ha, pn, cf);
+/// Handle a request received through the packet capture ring, or read from a
+/// capture file by the replay. The arrival times are taken from the capture
+/// instead of the clock.
+/// @return success/failure indication
+///
+/// @param[in] ch  channel
+/// @param[in] hn  host name
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+/// @param[in] svc histogram of service times (can be NULL)
+/// @param[in] ss  IPv4/IPv6 address of the requester
+/// @param[in] buf datagram contents
+/// @param[in] len datagram length
+/// @param[in] ttl time-to-live value
+/// @param[in] mtm steady time of arrival
+/// @param[in] rtm system time of arrival
+/// @param[in] rp  replay of the capture file (can be NULL)
+/// @param[in] cf  configuration
+bool
+handle_capture(struct channel* ch,
+               const char hn[static NEMO_HOST_NAME_SIZE],
+               struct plugin* pi,
+               const uint64_t npi,
+               struct hist* svc,
+               const struct sockaddr_storage* ss,
+               const uint8_t* buf,
+               const size_t len,
+               const uint8_t ttl,
+               const uint64_t mtm,
+               const uint64_t rtm,
+               struct replay* rp,
+               const struct config* cf)
+{
+  struct payload pl;
+  uint8_t lvl;
+  bool retb;
 
-  // Notify all attached plugins about the payload.
-  notify_plugins(pi, npi, &pl);
+  log(LL_TRACE, false, "handling capture on the %s channel", ch->ch_name);
 
-  // Update the payload by overwriting certain fields.
-  update_payload(&pl, hn, cf);
+  // Increase the seriousness of the incident in case we are going to fail.
+  if (cf->cf_err == true) {
+    lvl = LL_WARN;
+  } else {
+    lvl = LL_DEBUG;
+  }
 
-  // Do not respond if the monologue mode is turned on.
-  if (cf->cf_mono == true) {
-    return true;
+  // Follow the same error propagation as the socket reception does.
+  ch->ch_rall++;
+  retb = unpack_payload(ch, &pl, buf, len, lvl);
+  if (retb == false) {
+    return !cf->cf_err;
   }
 
-  // Send a response back.
-  retb = send_packet(ch, &pl, ss, cf->cf_err);
+  return respond(ch, hn, pi, npi, svc, ss, &pl, ttl, mtm, rtm, rp, cf);
+}
+
+/// Handle the event of a request that was already answered in the kernel by
+/// the XDP program, so that it is reported and the plugins are notified the
+/// same way as if it arrived on the socket.
+///
+/// @param[in] ch  channel
+/// @param[in] hn  host name
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+/// @param[in] xe  reflected request
+/// @param[in] cf  configuration
+void
+handle_reflection(struct channel* ch,
+                  const char hn[static NEMO_HOST_NAME_SIZE],
+                  struct plugin* pi,
+                  const uint64_t npi,
+                  const struct xdp_event* xe,
+                  const struct config* cf)
+{
+  struct payload pl;
+  bool retb;
+
+  log(LL_TRACE, false, "handling reflection on the %s channel", ch->ch_name);
+
+  // The program has verified the payload before reflecting it, but decoding
+  // it with the common routine keeps the counters and host names consistent.
+  ch->ch_rall++;
+  retb = unpack_payload(ch, &pl, xe->xe_pl, xe->xe_len, LL_DEBUG);
   if (retb == false) {
-    log(LL_WARN, false, "unable to send datagram on the socket");
+    return;
+  }
 
-    // Following the same logic as above in the receive stage.
-    return !cf->cf_err;
+  // The response was sent by the kernel, unless in the monologue mode.
+  if (cf->cf_mono == false) {
+    ch->ch_sall++;
   }
 
-  return true;
+  // The departure of the response from the kernel is not known.
+  report_event(&pl, hn, xe->xe_addr, 0, xe->xe_port, true, 0, 0, cf);
+  notify_plugins(pi, npi, &pl);
 }
@@ -14,9 +14,30 @@
 #include "common/channel.h"
 #include "common/payload.h"
 #include "common/plugin.h"
+#include "common/prom.h"
+#include "common/stats.h"
 #include "ures/types.h"
 
 
+// Capture.
+bool open_capture(struct capture* cp,
+                  const struct channel* ch,
+                  const struct config* cf);
+void close_capture(struct capture* cp);
+bool drain_capture(struct capture* cp,
+                   struct channel* ch,
+                   const char hn[static NEMO_HOST_NAME_SIZE],
+                   struct plugin* pi,
+                   const uint64_t npi,
+                   struct hist* svc,
+                   const struct config* cf);
+bool parse_packet(struct sockaddr_storage* ss,
+                  const uint8_t** pl,
+                  size_t* len,
+                  uint8_t* ttl,
+                  const uint8_t* pkt,
+                  const size_t cap);
+
 // Configuration.
 bool parse_config(struct config* cf, int argc, char* argv[]);
 void log_config(const struct config* cf);
@@ -24,24 +45,94 @@ void log_config(const struct config* cf);
 // Event.
 bool handle_event(struct channel* ch,
                   const char hn[static NEMO_HOST_NAME_SIZE],
-                  const struct plugin* pi,
+                  struct plugin* pi,
                   const uint64_t npi,
+                  struct hist* svc,
                   const struct config* cf);
+bool poll_event(struct channel* ch,
+                const char hn[static NEMO_HOST_NAME_SIZE],
+                struct plugin* pi,
+                const uint64_t npi,
+                struct hist* svc,
+                bool* got,
+                const struct config* cf);
+void handle_reflection(struct channel* ch,
+                       const char hn[static NEMO_HOST_NAME_SIZE],
+                       struct plugin* pi,
+                       const uint64_t npi,
+                       const struct xdp_event* xe,
+                       const struct config* cf);
+bool handle_capture(struct channel* ch,
+                    const char hn[static NEMO_HOST_NAME_SIZE],
+                    struct plugin* pi,
+                    const uint64_t npi,
+                    struct hist* svc,
+                    const struct sockaddr_storage* ss,
+                    const uint8_t* buf,
+                    const size_t len,
+                    const uint8_t ttl,
+                    const uint64_t mtm,
+                    const uint64_t rtm,
+                    struct replay* rp,
+                    const struct config* cf);
 
 // Loop.
 bool respond_loop(struct channel* ch,
+                  const uint64_t nch,
+                  const char hn[static NEMO_HOST_NAME_SIZE],
                   struct plugin* pi,
                   const uint64_t npi,
+                  struct stats* st,
+                  struct hist* svc,
+                  struct xdp* xd,
+                  struct capture* cp,
                   const struct config* cf);
 
+// Metrics.
+void expose_responder(struct prom* pr, void* arg);
+
+// Replay.
+bool open_replay(struct replay* rp, struct channel* ch, const struct config* cf);
+void close_replay(struct replay* rp);
+bool send_replay(struct replay* rp,
+                 struct channel* ch,
+                 const struct payload* pl,
+                 const struct config* cf);
+bool replay_requests(struct replay* rp,
+                     struct channel* ch,
+                     const char hn[static NEMO_HOST_NAME_SIZE],
+                     struct plugin* pi,
+                     const uint64_t npi,
+                     const struct config* cf);
+
 // Report.
+void prepare_report(const struct config* cf);
 void report_header(const struct config* cf);
 void report_event(const struct payload* pl,
                   const char hn[static NEMO_HOST_NAME_SIZE],
                   const uint64_t la,
                   const uint64_t ha,
                   const uint16_t pn,
+                  const bool ipv4,
+                  const uint64_t rdep,
+                  const uint64_t mdep,
                   const struct config* cf);
 bool flush_report_stream(const struct config* cf);
+bool open_aggregation(const struct config* cf);
+uint64_t emit_aggregation(const uint64_t cur, const struct config* cf);
+void close_aggregation(const struct config* cf);
+
+// XDP.
+bool open_xdp(struct xdp* xd,
+              const char hn[static NEMO_HOST_NAME_SIZE],
+              const struct config* cf);
+void close_xdp(struct xdp* xd);
+void update_xdp(struct xdp* xd);
+void drain_xdp(struct xdp* xd,
+               struct channel* ch,
+               const char hn[static NEMO_HOST_NAME_SIZE],
+               struct plugin* pi,
+               const uint64_t npi,
+               const struct config* cf);
 
 #endif
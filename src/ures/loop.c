@@ -16,7 +16,9 @@
 #include "common/convert.h"
 #include "common/log.h"
 #include "common/now.h"
+#include "common/packet.h"
 #include "common/signal.h"
+#include "common/stats.h"
 #include "ures/funcs.h"
 #include "ures/types.h"
 
@@ -29,16 +31,20 @@
 /// @global susr1
 /// @global schld
 ///
-/// @param[in] ch  channel
+/// @param[in] ch  array of channels
+/// @param[in] nch number of channels
 /// @param[in] pi  array of plugins
 /// @param[in] npi number of plugins
 /// @param[in] cf  configuration
 static bool
 handle_interrupt(const struct channel* ch,
+                 const uint64_t nch,
                  struct plugin* pi,
                  const uint64_t npi,
                  const struct config* cf)
 {
+  uint64_t i;
+
   log(LL_TRACE, false, "handling interrupt");
 
   // Exit upon receiving SIGINT.
@@ -67,7 +73,9 @@ handle_interrupt(const struct channel* ch,
   if (susr1 == true) {
     log_config(cf);
     log_plugins(pi, npi);
-    log_channel(ch);
+    for (i = 0; i < nch; i++) {
+      log_channel(&ch[i]);
+    }
 
     // Reset the signal indicator, so that following signal handling will
     // avoid the false positive.
@@ -79,29 +87,146 @@ handle_interrupt(const struct channel* ch,
   return false;
 }
 
-/// Start responding to requests on a channel.
+/// Publish the live statistics of all channels and all plugins.
+///
+/// @param[in] st  statistics
+/// @param[in] ch  array of channels
+/// @param[in] nch number of channels
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+static void
+publish_stats(struct stats* st,
+              const struct channel* ch,
+              const uint64_t nch,
+              const struct plugin* pi,
+              const uint64_t npi)
+{
+  uint64_t val[STATS_FIELD_MAX];
+  uint64_t i;
+
+  for (i = 0; i < nch; i++) {
+    publish_channel(&st->st_sect[i], &ch[i]);
+  }
+
+  for (i = 0; i < npi; i++) {
+    val[SV_PI_STATE]  = pi[i].pi_state;
+    val[SV_PI_PID]    = (uint64_t)pi[i].pi_pid;
+    val[SV_PI_NOTIFY] = pi[i].pi_nnot;
+    val[SV_PI_ERROR]  = pi[i].pi_nerr;
+    publish_section(&st->st_sect[nch + i], val, SV_PI_ERROR + 1);
+  }
+}
+
+/// Spin on non-blocking receives for one polling period. The packet ring and
+/// the ring buffer of the in-kernel reflection are drained instead of the
+/// socket, as these do not require any system calls. Otherwise, all channels
+/// are polled in turn.
+/// @return success/failure indication
+///
+/// @param[in]  ch  array of channels
+/// @param[in]  nch number of channels
+/// @param[in]  hn  local host name
+/// @param[in]  pi  array of plugins
+/// @param[in]  npi number of plugins
+/// @param[in]  svc histogram of service times (can be NULL)
+/// @param[in]  xd  in-kernel reflection (can be NULL)
+/// @param[in]  cp  packet capture (can be NULL)
+/// @param[out] lim inactivity time limit
+/// @param[in]  cf  configuration
+static bool
+spin(struct channel* ch,
+     const uint64_t nch,
+     const char hn[static NEMO_HOST_NAME_SIZE],
+     struct plugin* pi,
+     const uint64_t npi,
+     struct hist* svc,
+     struct xdp* xd,
+     struct capture* cp,
+     uint64_t* lim,
+     const struct config* cf)
+{
+  uint64_t start;
+  uint64_t cur;
+  uint64_t nrcv;
+  uint64_t i;
+  bool got;
+  bool any;
+  bool retb;
+
+  start = mono_now();
+  do {
+    nrcv = ch[0].ch_rall;
+    any  = false;
+
+    if (cp != NULL) {
+      retb = drain_capture(cp, &ch[0], hn, pi, npi, svc, cf);
+      if (retb == false) {
+        return false;
+      }
+    } else {
+      for (i = 0; i < nch; i++) {
+        retb = poll_event(&ch[i], hn, pi, npi, svc, &got, cf);
+        if (retb == false) {
+          return false;
+        }
+
+        any = any || got;
+      }
+    }
+
+    if (xd != NULL) {
+      drain_xdp(xd, &ch[0], hn, pi, npi, cf);
+    }
+
+    cur = mono_now();
+
+    // Replenish the inactivity timeout.
+    if (any == true || ch[0].ch_rall != nrcv) {
+      *lim = cur + cf->cf_ito;
+    }
+  } while (cur - start < POLL_PERIOD);
+
+  return true;
+}
+
+/// Start responding to requests on all channels.
 /// @return success/failure indication
 ///
-/// @param[in] ch  channel
+/// @param[in] ch  array of channels
+/// @param[in] nch number of channels
+/// @param[in] hn  local host name
 /// @param[in] pi  array of plugins
 /// @param[in] npi number of plugins
+/// @param[in] st  statistics
+/// @param[in] svc histogram of service times (can be NULL)
+/// @param[in] xd  in-kernel reflection (can be NULL)
+/// @param[in] cp  packet capture (can be NULL)
 /// @param[in] cf  configuration
 bool
 respond_loop(struct channel* ch,
+             const uint64_t nch,
+             const char hn[static NEMO_HOST_NAME_SIZE],
              struct plugin* pi,
              const uint64_t npi,
+             struct stats* st,
+             struct hist* svc,
+             struct xdp* xd,
+             struct capture* cp,
              const struct config* cf)
 {
   int reti;
   bool retb;
   fd_set rfd;
+  int nfds;
   sigset_t mask;
   struct timespec tout;
   struct timespec* ptout;
   uint64_t lim;
   uint64_t cur;
-  char hn[NEMO_HOST_NAME_SIZE];
-  int err;
+  uint64_t left;
+  uint64_t spub;
+  uint64_t nagg;
+  uint64_t i;
 
   log(LL_INFO, false, "starting the response loop");
   log_config(cf);
@@ -109,58 +234,119 @@ respond_loop(struct channel* ch,
   // Print the CSV header of the standard output.
   report_header(cf);
 
-  // Obtain the host name.
-  (void)memset(hn, 0, sizeof(hn));
-  reti = gethostname(hn, sizeof(hn) - 1);
-  if (reti == -1) {
-    // Save the errno value so that it can be examined later.
-    err = errno;
-
-    log(LL_WARN, true, "unable to obtain host name");
-
-    // Truncation of the host name is acceptable.
-    if (err != ENAMETOOLONG) {
-      return false;
-    }
-  }
-
   // Create the signal mask used for enabling signals during the pselect(2)
   // waiting.
   create_signal_mask(&mask);
 
   // Create the initial timeout.
-  lim = mono_now() + cf->cf_ito;
+  lim  = mono_now() + cf->cf_ito;
+  spub = 0;
 
   while (true) {
     // Compute the remaining time to wait for events.
     cur = mono_now();
 
-    // Check whether the time is up.
+    // Publish the live statistics periodically.
+    if (st->st_head != NULL && cur - spub >= STATS_PERIOD) {
+      publish_stats(st, ch, nch, pi, npi);
+      spub = cur;
+    }
+
+    // Emit the summaries of the requesters at the end of each period.
+    nagg = UINT64_MAX;
+    if (cf->cf_agp != 0 && cf->cf_sil == false) {
+      nagg = emit_aggregation(cur, cf);
+    }
+
+    // Grow the socket buffers that are sized adaptively. The responder does
+    // not know the burst sizes of the requesters in advance.
+    for (i = 0; i < nch; i++) {
+      adapt_channel(&ch[i], 0);
+    }
+
+    // Keep the clock of the in-kernel reflection in line with ours.
+    if (xd != NULL) {
+      update_xdp(xd);
+    }
+
+    // Stop the loop if the timeout was reached due to no incoming requests.
     if (cf->cf_ito != 0 && cur >= lim) {
+      log(LL_WARN, false, "no incoming requests within time limit");
       break;
     }
 
-    // Compute the timeout.
-    if (cf->cf_ito == 0) {
+    // Compute the timeout. The waiting is interrupted periodically in order
+    // to publish the live statistics, to update the in-kernel clock and to
+    // emit the summaries of the requesters.
+    left = UINT64_MAX;
+    if (cf->cf_ito != 0) {
+      left = lim - cur;
+    }
+    if (st->st_head != NULL && left > STATS_PERIOD) {
+      left = STATS_PERIOD;
+    }
+    if (xd != NULL && left > XDP_CLOCK_PERIOD) {
+      left = XDP_CLOCK_PERIOD;
+    }
+    if (nagg != UINT64_MAX && left > nagg - cur) {
+      left = nagg - cur;
+    }
+
+    // In the busy mode, spin on the receives for a while, and then only
+    // check the remaining events without waiting.
+    if (cf->cf_busy == true) {
+      retb = spin(ch, nch, hn, pi, npi, svc, xd, cp, &lim, cf);
+      if (retb == false) {
+        return false;
+      }
+      left = 0;
+    }
+
+    if (left == UINT64_MAX) {
       ptout = NULL;
     } else {
-      fnanos(&tout, lim - cur);
+      fnanos(&tout, left);
       ptout = &tout;
     }
 
-    log(LL_TRACE, false, "waiting for incoming datagrams");
+    if (cf->cf_busy == false) {
+      log(LL_TRACE, false, "waiting for incoming datagrams");
+    }
 
-    // Add the channel socket to the read event list.
+    // Add the channel sockets to the read event list.
     FD_ZERO(&rfd);
-    FD_SET(ch->ch_sock, &rfd);
+    nfds = 0;
+    for (i = 0; i < nch; i++) {
+      FD_SET(ch[i].ch_sock, &rfd);
+      if (ch[i].ch_sock + 1 > nfds) {
+        nfds = ch[i].ch_sock + 1;
+      }
+    }
+
+    // Requests reflected in the kernel are reported through the ring buffer.
+    if (xd != NULL) {
+      FD_SET(xd->xd_ring, &rfd);
+      if (xd->xd_ring + 1 > nfds) {
+        nfds = xd->xd_ring + 1;
+      }
+    }
+
+    // Requests received by the packet ring are processed a block at a time.
+    if (cp != NULL) {
+      FD_SET(cp->cp_sock, &rfd);
+      if (cp->cp_sock + 1 > nfds) {
+        nfds = cp->cp_sock + 1;
+      }
+    }
 
-    // Wait for incoming datagram events. The number of file descriptors is based on the fact
-    // that a standard process has three standard streams open, plus the socket, plus one.
-    reti = pselect(4, &rfd, NULL, NULL, ptout, &mask);
+    // Wait for incoming datagram events. The socket is not necessarily the
+    // first descriptor after the standard streams, e.g. when the system
+    // logging daemon connection is open.
+    reti = pselect(nfds, &rfd, NULL, NULL, ptout, &mask);
     if (reti == -1) {
       // Check for interrupt (possibly due to a signal).
       if (errno == EINTR) {
-        retb = handle_interrupt(ch, pi, npi, cf);
+        retb = handle_interrupt(ch, nch, pi, npi, cf);
         if (retb == true) {
           continue;
         }
@@ -172,23 +358,58 @@ respond_loop(struct channel* ch,
       return false;
     }
 
-    // Stop the loop if the timeout was reached due to no incoming requests.
+    // The inactivity timeout is verified at the start of the next iteration.
     if (reti == 0) {
-      log(LL_WARN, false, "no incoming requests within time limit");
-      return true;
+      continue;
     }
 
-    // Handle incoming datagram.
-    reti = FD_ISSET(ch->ch_sock, &rfd);
-    if (reti > 0) {
-      retb = handle_event(ch, hn, pi, npi, cf);
-      if (retb == false) {
-        return false;
+    // Handle incoming datagrams on all ready channels.
+    for (i = 0; i < nch; i++) {
+      reti = FD_ISSET(ch[i].ch_sock, &rfd);
+      if (reti > 0) {
+        retb = handle_event(&ch[i], hn, pi, npi, svc, cf);
+        if (retb == false) {
+          return false;
+        }
+
+        // Replenish the inactivity timeout.
+        lim = mono_now() + cf->cf_ito;
       }
+    }
 
-      // Replenish the inactivity timeout.
-      lim = mono_now() + cf->cf_ito;
+    // Handle requests reflected in the kernel.
+    if (xd != NULL) {
+      reti = FD_ISSET(xd->xd_ring, &rfd);
+      if (reti > 0) {
+        drain_xdp(xd, &ch[0], hn, pi, npi, cf);
+        lim = mono_now() + cf->cf_ito;
+      }
     }
+
+    // Handle the blocks of the packet ring.
+    if (cp != NULL) {
+      reti = FD_ISSET(cp->cp_sock, &rfd);
+      if (reti > 0) {
+        retb = drain_capture(cp, &ch[0], hn, pi, npi, svc, cf);
+        if (retb == false) {
+          return false;
+        }
+
+        lim = mono_now() + cf->cf_ito;
+      }
+    }
+  }
+
+  if (xd != NULL) {
+    drain_xdp(xd, &ch[0], hn, pi, npi, cf);
+  }
+
+  if (cp != NULL) {
+    (void)drain_capture(cp, &ch[0], hn, pi, npi, svc, cf);
+  }
+
+  if (st->st_head != NULL) {
+    publish_stats(st, ch, nch, pi, npi);
   }
 
   return true;
@@ -4,18 +4,108 @@
 // Distributed under the terms of the 2-clause BSD License. The full
 // license is in the file LICENSE, distributed as part of this software.
 
+#include <arpa/inet.h>
+
+#include <unistd.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
 
 #include "common/channel.h"
+#include "common/cpu.h"
+#include "common/host.h"
 #include "common/plugin.h"
 #include "common/log.h"
+#include "common/now.h"
+#include "common/packet.h"
 #include "common/payload.h"
+#include "common/prom.h"
 #include "common/signal.h"
+#include "common/stats.h"
 #include "ures/funcs.h"
 #include "ures/types.h"
 
 
+/// Obtain the local host name.
+/// @return success/failure indication
+///
+/// @param[out] hn local host name
+static bool
+get_host_name(char hn[static NEMO_HOST_NAME_SIZE])
+{
+  int reti;
+  int err;
+
+  (void)memset(hn, 0, NEMO_HOST_NAME_SIZE);
+  reti = gethostname(hn, NEMO_HOST_NAME_SIZE - 1);
+  if (reti == -1) {
+    // Save the errno value so that it can be examined later.
+    err = errno;
+
+    log(LL_WARN, true, "unable to obtain host name");
+
+    // Truncation of the host name is acceptable.
+    if (err != ENAMETOOLONG) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Create a channel for each combination of the selected local addresses and
+/// ports. Without any local addresses, the channels are bound to the wildcard
+/// address of the selected protocol.
+/// @return success/failure indication
+///
+/// @param[out] ch  array of channels
+/// @param[out] nch number of channels
+/// @param[in]  cf  configuration
+static bool
+open_channels(struct channel* ch, uint64_t* nch, const struct config* cf)
+{
+  struct in_addr a4;
+  const char* addr;
+  uint64_t naddr;
+  uint64_t i;
+  uint64_t k;
+  bool ipv4;
+  bool retb;
+
+  naddr = cf->cf_naddr;
+  if (naddr == 0) {
+    naddr = 1;
+  }
+
+  *nch = 0;
+  for (i = 0; i < naddr; i++) {
+    addr = NULL;
+    ipv4 = cf->cf_ipv4;
+    if (cf->cf_naddr != 0) {
+      addr = cf->cf_addr[i];
+      ipv4 = inet_pton(AF_INET, addr, &a4) == 1;
+    }
+
+    for (k = 0; k < cf->cf_nport; k++) {
+      retb = open_channel(&ch[*nch], ipv4, addr, (uint16_t)cf->cf_port[k],
+                          cf->cf_rbuf, cf->cf_sbuf, (uint8_t)cf->cf_ttl);
+      if (retb == false) {
+        log(LL_WARN, false, "unable to create the %s channel on port %" PRIu64,
+          ch[*nch].ch_name, cf->cf_port[k]);
+        return false;
+      }
+
+      auto_size_channel(&ch[*nch], cf->cf_rcap, cf->cf_scap);
+      (*nch)++;
+    }
+  }
+
+  return true;
+}
+
 /// Unicast network responder.
 int
 main(int argc, char* argv[])
@@ -24,7 +114,20 @@ main(int argc, char* argv[])
   struct config cf;
   struct plugin pi[PLUG_MAX];
   uint64_t npi;
-  struct channel ch;
+  struct channel* ch;
+  uint64_t nch;
+  struct stats st;
+  struct exposure ex;
+  struct prom pr;
+  struct prom* ppr;
+  struct hist* svc;
+  struct xdp xd;
+  struct xdp* pxd;
+  struct capture cp;
+  struct capture* pcp;
+  struct replay* rp;
+  char hn[NEMO_HOST_NAME_SIZE];
+  uint64_t i;
 
   // Parse configuration from command-line options.
   retb = parse_config(&cf, argc, argv);
@@ -33,6 +136,13 @@ main(int argc, char* argv[])
     return EXIT_FAILURE;
   }
 
+  // Move the logging output off the packet-handling threads.
+  retb = start_log(cf.cf_lbe, "ures");
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to start the asynchronous logging");
+    return EXIT_FAILURE;
+  }
+
   // Verify that the compiled payload is exactly the expected size in bytes.
   if (sizeof(struct payload) != NEMO_PAYLOAD_SIZE) {
     log(LL_ERROR, false, "wrong payload size: expected %d, actual %zu",
@@ -40,6 +150,26 @@ main(int argc, char* argv[])
     return EXIT_FAILURE;
   }
 
+  if (sizeof(struct payload_compact) != NEMO_PAYLOAD_COMPACT_SIZE) {
+    log(LL_ERROR, false, "wrong compact payload size: expected %d, actual %zu",
+      NEMO_PAYLOAD_COMPACT_SIZE, sizeof(struct payload_compact));
+    return EXIT_FAILURE;
+  }
+
+  // Select the clock source for all timestamps.
+  retb = select_clock(cf.cf_clk);
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to select the %s clock source", clock_name(cf.cf_clk));
+    return EXIT_FAILURE;
+  }
+
+  // Obtain the host name.
+  retb = get_host_name(hn);
+  if (retb == false) {
+    log(LL_ERROR, false, "unable to obtain the host name");
+    return EXIT_FAILURE;
+  }
+
   // Install the signal handlers.
   retb = install_signal_handlers();
   if (retb == false) {
@@ -61,27 +191,184 @@ main(int argc, char* argv[])
     return EXIT_FAILURE;
   }
 
-  // Initialize the channel used to send and receive payloads.
-  retb = open_channel(&ch, cf.cf_ipv4, (uint16_t)cf.cf_port, cf.cf_rbuf, cf.cf_sbuf, (uint8_t)cf.cf_ttl);
-  if (retb == false) {
-    log(LL_ERROR, false, "unable to create the %s channel", ch.ch_name);
+  // Initialize the channels used to send and receive payloads. The replay
+  // uses one channel without a socket for each protocol.
+  ch = calloc((size_t)(cf.cf_nport * (cf.cf_naddr + 1) + 1), sizeof(*ch));
+  if (ch == NULL) {
+    log(LL_ERROR, true, "unable to allocate memory for channels");
     return EXIT_FAILURE;
   }
 
-  // Start the main responding loop.
-  retb = respond_loop(&ch, pi, npi, &cf);
-  if (retb == false) {
-    log(LL_ERROR, false, "responding loop has been terminated");
+  rp = NULL;
+  if (cf.cf_rep != NULL) {
+    rp = malloc(sizeof(*rp));
+    if (rp == NULL) {
+      log(LL_ERROR, true, "unable to allocate memory for the replay");
+      return EXIT_FAILURE;
+    }
+
+    nch  = 2;
+    retb = open_replay(rp, ch, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to replay the capture file %s", cf.cf_rep);
+      close_replay(rp);
+      return EXIT_FAILURE;
+    }
+  } else {
+    retb = open_channels(ch, &nch, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to create all channels");
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Each channel learns the host names of up to the number of requesters
+  // that the aggregation tracks.
+  for (i = 0; i < nch; i++) {
+    retb = create_host_cache(&ch[i].ch_hc, cf.cf_agn);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to create the host cache of the %s channel",
+          ch[i].ch_name);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Reflect the requests in the kernel. The channel remains open for the
+  // requests that the program passes to the network stack.
+  pxd = NULL;
+  if (cf.cf_xdp != NULL) {
+    retb = open_xdp(&xd, hn, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to attach the XDP program to %s", cf.cf_xdp);
+      close_xdp(&xd);
+      return EXIT_FAILURE;
+    }
+    pxd = &xd;
+  }
+
+  // Receive the requests through the packet ring instead of the socket.
+  pcp = NULL;
+  if (cf.cf_cap != NULL) {
+    retb = open_capture(&cp, &ch[0], &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to open the packet ring on %s", cf.cf_cap);
+      close_capture(&cp);
+      return EXIT_FAILURE;
+    }
+    pcp = &cp;
+  }
+
+  // Publish the live statistics of all channels and all plugins.
+  (void)memset(&st, 0, sizeof(st));
+  if (cf.cf_stat == true) {
+    retb = create_stats(&st, "ures", (uint32_t)(nch + npi));
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to publish live statistics");
+      return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < nch; i++) {
+      (void)init_section(&st, (uint32_t)i, STATS_CHANNEL, (uint32_t)i, ch[i].ch_name);
+    }
+    for (i = 0; i < npi; i++) {
+      (void)init_section(&st, (uint32_t)(nch + i), STATS_PLUGIN, (uint32_t)i, pi[i].pi_name);
+    }
+  }
+
+  // Serve the metrics endpoint.
+  ppr = NULL;
+  svc = NULL;
+  if (cf.cf_prom != NULL) {
+    (void)memset(&ex, 0, sizeof(ex));
+    ex.ex_ch  = ch;
+    ex.ex_nch = nch;
+    ex.ex_pi  = pi;
+    ex.ex_npi = npi;
+
+    retb = open_prom(&pr, cf.cf_prom, expose_responder, &ex);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to serve metrics");
+      return EXIT_FAILURE;
+    }
+    ppr = &pr;
+    svc = &ex.ex_svc;
+  }
+
+  // Pin the responder to a CPU and raise its scheduling priority. The plugins
+  // run in their own processes and are not affected.
+  (void)pin_thread(cf.cf_cpu);
+  (void)raise_priority(cf.cf_prio);
+
+  // Prepare the low-latency operation: the kernel busy-polls the device queue
+  // and no page faults occur while responding.
+  if (cf.cf_busy == true) {
+    for (i = 0; i < nch; i++) {
+      (void)busy_poll_channel(&ch[i], POLL_BUSY_TIME);
+    }
+    (void)lock_memory();
+  }
+
+  // Sample the report rows and limit their rate.
+  prepare_report(&cf);
+
+  // Summarize the requests per requester instead of reporting each of them.
+  if (cf.cf_agp != 0 && cf.cf_sil == false) {
+    retb = open_aggregation(&cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "unable to create the aggregation table");
+      close_aggregation(&cf);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Start the main responding loop, or replay the capture file.
+  if (rp != NULL) {
+    retb = replay_requests(rp, ch, hn, pi, npi, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "replay has been terminated");
+    }
+  } else {
+    retb = respond_loop(ch, nch, hn, pi, npi, &st, svc, pxd, pcp, &cf);
+    if (retb == false) {
+      log(LL_ERROR, false, "responding loop has been terminated");
+    }
   }
 
-  // Delete the socket.
-  close_channel(&ch);
+  // Detach the program, close the packet ring, delete the sockets, the
+  // statistics and the metrics endpoint.
+  if (pxd != NULL) {
+    close_xdp(pxd);
+  }
+  if (pcp != NULL) {
+    close_capture(pcp);
+  }
+  if (rp != NULL) {
+    close_replay(rp);
+    free(rp);
+  } else {
+    for (i = 0; i < nch; i++) {
+      close_channel(&ch[i]);
+    }
+  }
+  for (i = 0; i < nch; i++) {
+    delete_host_cache(&ch[i].ch_hc);
+  }
+  delete_stats(&st);
+  if (ppr != NULL) {
+    close_prom(ppr);
+  }
 
   // Terminate plugins.
   terminate_plugins(pi, npi);
 
   // Print final values of counters.
-  log_channel(&ch);
+  for (i = 0; i < nch; i++) {
+    log_channel(&ch[i]);
+  }
+  free(ch);
+
+  // Emit the summaries of the last period.
+  close_aggregation(&cf);
 
   // Flush the standard output and error streams.
   retb = flush_report_stream(&cf);
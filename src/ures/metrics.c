@@ -0,0 +1,75 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "common/hist.h"
+#include "common/plugin.h"
+#include "common/prom.h"
+#include "ures/funcs.h"
+#include "ures/types.h"
+
+
+/// Render the label set identifying a plugin.
+///
+/// @param[out] lbl label set
+/// @param[in]  len size of the label set
+/// @param[in]  pi  plugin
+/// @param[in]  idx index of the plugin
+static void
+plugin_label(char* lbl, const size_t len, const struct plugin* pi, const uint64_t idx)
+{
+  char name[128];
+
+  escape_label(name, sizeof(name), pi->pi_name);
+  (void)snprintf(lbl, len, "plugin=\"%" PRIu64 "\",name=\"%s\"", idx, name);
+}
+
+/// Render the metrics of the responder. The values are read while the
+/// responding loop keeps updating them, and the loop is never blocked by the
+/// rendering.
+///
+/// @param[in] pr  metrics endpoint
+/// @param[in] arg exposed state of the responder
+void
+expose_responder(struct prom* pr, void* arg)
+{
+  const struct exposure* ex;
+  char lbl[192];
+  uint64_t i;
+
+  ex = arg;
+
+  // A single channel is exposed without the identifying label.
+  expose_channels(pr, ex->ex_ch, sizeof(*ex->ex_ch), ex->ex_nch,
+                  ex->ex_nch == 1 ? NULL : "channel");
+
+  describe_metric(pr, "nemo_service_time_seconds", "histogram",
+                  "Time from the arrival of a request to the departure of its response.");
+  append_hist(pr, "nemo_service_time_seconds", "", &ex->ex_svc);
+
+  describe_metric(pr, "nemo_plugin_queue_depth", "gauge",
+                  "Events waiting to be consumed by the plugin.");
+  for (i = 0; i < ex->ex_npi; i++) {
+    plugin_label(lbl, sizeof(lbl), &ex->ex_pi[i], i);
+    append_metric(pr, "nemo_plugin_queue_depth", lbl, queued_events(&ex->ex_pi[i]));
+  }
+
+  describe_metric(pr, "nemo_plugin_notifications_total", "counter",
+                  "Events sent to the plugin.");
+  for (i = 0; i < ex->ex_npi; i++) {
+    plugin_label(lbl, sizeof(lbl), &ex->ex_pi[i], i);
+    append_metric(pr, "nemo_plugin_notifications_total", lbl, ex->ex_pi[i].pi_nnot);
+  }
+
+  describe_metric(pr, "nemo_plugin_errors_total", "counter",
+                  "Events that could not be sent to the plugin.");
+  for (i = 0; i < ex->ex_npi; i++) {
+    plugin_label(lbl, sizeof(lbl), &ex->ex_pi[i], i);
+    append_metric(pr, "nemo_plugin_errors_total", lbl, ex->ex_pi[i].pi_nerr);
+  }
+}
@@ -0,0 +1,876 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "common/channel.h"
+#include "common/log.h"
+#include "common/now.h"
+#include "common/packet.h"
+#include "common/signal.h"
+#include "ures/funcs.h"
+#include "ures/types.h"
+
+
+// Magic numbers of the classic format, in the byte order of the writer.
+#define PCAP_MAGIC_USEC      0xa1b2c3d4U ///< Microsecond timestamps.
+#define PCAP_MAGIC_USEC_SWAP 0xd4c3b2a1U ///< Microsecond timestamps, swapped.
+#define PCAP_MAGIC_NSEC      0xa1b23c4dU ///< Nanosecond timestamps.
+#define PCAP_MAGIC_NSEC_SWAP 0x4d3cb2a1U ///< Nanosecond timestamps, swapped.
+
+// Lengths of the headers of the classic format.
+#define PCAP_FILE_LEN   24 ///< File header.
+#define PCAP_RECORD_LEN 16 ///< Record header.
+
+// Block types of the pcapng format.
+#define PCAPNG_SHB 0x0a0d0d0aU ///< Section header block.
+#define PCAPNG_IDB 0x00000001U ///< Interface description block.
+#define PCAPNG_SPB 0x00000003U ///< Simple packet block.
+#define PCAPNG_EPB 0x00000006U ///< Enhanced packet block.
+
+// Byte-order magic of the section header block.
+#define PCAPNG_MAGIC      0x1a2b3c4dU
+#define PCAPNG_MAGIC_SWAP 0x4d3c2b1aU
+
+// Option of the interface description block with the timestamp resolution.
+#define PCAPNG_TSRESOL 9
+
+// Link-layer types.
+#define LINK_NULL     0   ///< BSD loopback, host byte order.
+#define LINK_ETHERNET 1   ///< Ethernet.
+#define LINK_RAW      101 ///< Raw IPv4 or IPv6.
+#define LINK_LOOP     108 ///< OpenBSD loopback, network byte order.
+#define LINK_SLL      113 ///< Linux cooked capture.
+#define LINK_IPV4     228 ///< Raw IPv4.
+#define LINK_IPV6     229 ///< Raw IPv6.
+#define LINK_SLL2     276 ///< Linux cooked capture, version 2.
+
+// Ethernet types.
+#define ETHER_IPV4  0x0800 ///< IPv4.
+#define ETHER_IPV6  0x86dd ///< IPv6.
+#define ETHER_VLAN  0x8100 ///< IEEE 802.1Q tag.
+#define ETHER_QINQ  0x88a8 ///< IEEE 802.1ad tag.
+
+/// Read a 16-bit integer from the capture file.
+/// @return integer in host byte order
+///
+/// @param[in] rp  replay
+/// @param[in] off offset in the file
+static uint16_t
+read16(const struct replay* rp, const uint64_t off)
+{
+  uint16_t x;
+
+  __builtin_memcpy(&x, rp->rp_map + off, sizeof(x));
+  if (rp->rp_swap == true) {
+    x = __builtin_bswap16(x);
+  }
+
+  return x;
+}
+
+/// Read a 32-bit integer from the capture file.
+/// @return integer in host byte order
+///
+/// @param[in] rp  replay
+/// @param[in] off offset in the file
+static uint32_t
+read32(const struct replay* rp, const uint64_t off)
+{
+  uint32_t x;
+
+  __builtin_memcpy(&x, rp->rp_map + off, sizeof(x));
+  if (rp->rp_swap == true) {
+    x = __builtin_bswap32(x);
+  }
+
+  return x;
+}
+
+/// Read a 16-bit integer in the network byte order.
+/// @return integer in host byte order
+///
+/// @param[in] buf buffer
+static uint16_t
+load16(const uint8_t* buf)
+{
+  return (uint16_t)(((uint16_t)buf[0] << 8) | (uint16_t)buf[1]);
+}
+
+/// Write a 16-bit integer in the network byte order.
+///
+/// @param[out] buf buffer
+/// @param[in]  x   integer in host byte order
+static void
+store16(uint8_t* buf, const uint64_t x)
+{
+  buf[0] = (uint8_t)(x >> 8);
+  buf[1] = (uint8_t)x;
+}
+
+/// Convert a timestamp to nanoseconds.
+/// @return nanoseconds
+///
+/// @param[in] ts  timestamp
+/// @param[in] tps ticks per second
+static uint64_t
+convert_time(const uint64_t ts, const uint64_t tps)
+{
+  // Resolutions finer than a nanosecond are truncated.
+  if (tps > 1000000000ULL) {
+    return ts / (tps / 1000000000ULL);
+  }
+
+  return (ts / tps) * 1000000000ULL + (ts % tps) * 1000000000ULL / tps;
+}
+
+/// Determine whether a link-layer type is supported.
+/// @return support indication
+///
+/// @param[in] link link-layer type
+static bool
+known_link(const uint64_t link)
+{
+  return link == LINK_NULL || link == LINK_ETHERNET || link == LINK_RAW
+      || link == LINK_LOOP || link == LINK_SLL      || link == LINK_IPV4
+      || link == LINK_IPV6 || link == LINK_SLL2;
+}
+
+/// Parse the header of a file in the classic format.
+/// @return success/failure indication
+///
+/// @param[in] rp replay
+/// @param[in] mg magic number in the host byte order
+static bool
+open_classic(struct replay* rp, const uint32_t mg)
+{
+  if (rp->rp_size < PCAP_FILE_LEN) {
+    log(LL_WARN, false, "truncated file header");
+    return false;
+  }
+
+  rp->rp_ng   = false;
+  rp->rp_swap = mg == PCAP_MAGIC_USEC_SWAP || mg == PCAP_MAGIC_NSEC_SWAP;
+  if (mg == PCAP_MAGIC_USEC || mg == PCAP_MAGIC_USEC_SWAP) {
+    rp->rp_tps = 1000000ULL;
+  } else {
+    rp->rp_tps = 1000000000ULL;
+  }
+
+  // The upper bits carry the presence of the frame check sequence.
+  rp->rp_link = read32(rp, 20) & 0xffff;
+  if (known_link(rp->rp_link) == false) {
+    log(LL_WARN, false, "unsupported link-layer type %" PRIu64, rp->rp_link);
+    return false;
+  }
+
+  rp->rp_off = PCAP_FILE_LEN;
+  return true;
+}
+
+/// Register an interface of the current section of a pcapng file.
+///
+/// @param[in] rp  replay
+/// @param[in] off offset of the block
+/// @param[in] len length of the block
+static void
+add_interface(struct replay* rp, const uint64_t off, const uint64_t len)
+{
+  uint64_t opt;
+  uint64_t olen;
+  uint64_t tps;
+  uint64_t link;
+  uint8_t res;
+  uint8_t i;
+
+  if (rp->rp_nif == REPLAY_IF_MAX) {
+    log(LL_WARN, false, "too many interfaces, only %d allowed", REPLAY_IF_MAX);
+    return;
+  }
+
+  link = read16(rp, off + 8);
+  if (known_link(link) == false) {
+    log(LL_WARN, false, "unsupported link-layer type %" PRIu64, link);
+  }
+
+  // The default resolution is a microsecond. The resolution is either a
+  // negative power of ten, or a negative power of two if the highest bit is
+  // set.
+  tps = 1000000ULL;
+  for (opt = off + 16; opt + 4 <= off + len - 4; opt += 4 + ((olen + 3) & ~3ULL)) {
+    olen = read16(rp, opt + 2);
+    if (read16(rp, opt) != PCAPNG_TSRESOL || olen != 1 || opt + 5 > off + len - 4) {
+      continue;
+    }
+
+    res = rp->rp_map[opt + 4];
+    tps = 1;
+    if (res & 0x80) {
+      tps = 1ULL << ((res & 0x7f) > 63 ? 63 : (res & 0x7f));
+    } else {
+      for (i = 0; i < res && i < 19; i++) {
+        tps *= 10;
+      }
+    }
+  }
+
+  rp->rp_ilink[rp->rp_nif] = link;
+  rp->rp_itps[rp->rp_nif]  = tps;
+  rp->rp_nif++;
+}
+
+/// Find the next packet in a pcapng file, processing the section headers and
+/// interface descriptions on the way.
+/// @return packet availability
+///
+/// @param[in]  rp   replay
+/// @param[out] frm  captured frame
+/// @param[out] cap  captured length
+/// @param[out] len  original length
+/// @param[out] ts   real-time timestamp (0 if not available)
+/// @param[out] link link-layer type
+static bool
+next_block(struct replay* rp,
+           const uint8_t** frm,
+           uint64_t* cap,
+           uint64_t* len,
+           uint64_t* ts,
+           uint64_t* link)
+{
+  uint64_t off;
+  uint64_t blen;
+  uint32_t type;
+  uint32_t mg;
+  uint32_t ifx;
+
+  while (rp->rp_off + 12 <= rp->rp_size) {
+    off  = rp->rp_off;
+    type = read32(rp, off);
+
+    // The byte order of each section follows from its header.
+    if (type == PCAPNG_SHB) {
+      if (off + 16 > rp->rp_size) {
+        break;
+      }
+
+      __builtin_memcpy(&mg, rp->rp_map + off + 8, sizeof(mg));
+      if (mg != PCAPNG_MAGIC && mg != PCAPNG_MAGIC_SWAP) {
+        log(LL_WARN, false, "invalid byte-order magic at offset %" PRIu64, off);
+        return false;
+      }
+
+      rp->rp_swap = mg == PCAPNG_MAGIC_SWAP;
+      rp->rp_nif  = 0;
+    }
+
+    blen = read32(rp, off + 4);
+    if (blen < 12 || blen % 4 != 0 || off + blen > rp->rp_size) {
+      break;
+    }
+    rp->rp_off = off + blen;
+
+    if (type == PCAPNG_IDB && blen >= 20) {
+      add_interface(rp, off, blen);
+      continue;
+    }
+
+    if (type == PCAPNG_EPB && blen >= 32) {
+      ifx  = read32(rp, off + 8);
+      *cap = read32(rp, off + 20);
+      *len = read32(rp, off + 24);
+      if (ifx >= rp->rp_nif || *cap > blen - 32) {
+        log(LL_DEBUG, false, "invalid packet block at offset %" PRIu64, off);
+        continue;
+      }
+
+      *frm  = rp->rp_map + off + 28;
+      *link = rp->rp_ilink[ifx];
+      *ts   = convert_time(((uint64_t)read32(rp, off + 12) << 32) | read32(rp, off + 16),
+                           rp->rp_itps[ifx]);
+      return true;
+    }
+
+    // Simple packets belong to the first interface and carry no timestamp.
+    if (type == PCAPNG_SPB && blen >= 16 && rp->rp_nif > 0) {
+      *len  = read32(rp, off + 8);
+      *cap  = *len < blen - 16 ? *len : blen - 16;
+      *frm  = rp->rp_map + off + 12;
+      *link = rp->rp_ilink[0];
+      *ts   = 0;
+      return true;
+    }
+  }
+
+  if (rp->rp_off != rp->rp_size) {
+    log(LL_WARN, false, "truncated block at offset %" PRIu64, rp->rp_off);
+  }
+
+  return false;
+}
+
+/// Find the next packet in a file of the classic format.
+/// @return packet availability
+///
+/// @param[in]  rp   replay
+/// @param[out] frm  captured frame
+/// @param[out] cap  captured length
+/// @param[out] len  original length
+/// @param[out] ts   real-time timestamp
+/// @param[out] link link-layer type
+static bool
+next_record(struct replay* rp,
+            const uint8_t** frm,
+            uint64_t* cap,
+            uint64_t* len,
+            uint64_t* ts,
+            uint64_t* link)
+{
+  uint64_t off;
+
+  off = rp->rp_off;
+  if (off + PCAP_RECORD_LEN > rp->rp_size) {
+    if (off != rp->rp_size) {
+      log(LL_WARN, false, "truncated record at offset %" PRIu64, off);
+    }
+    return false;
+  }
+
+  *cap = read32(rp, off + 8);
+  *len = read32(rp, off + 12);
+  if (off + PCAP_RECORD_LEN + *cap > rp->rp_size) {
+    log(LL_WARN, false, "truncated record at offset %" PRIu64, off);
+    return false;
+  }
+
+  *frm  = rp->rp_map + off + PCAP_RECORD_LEN;
+  *link = rp->rp_link;
+  *ts   = (uint64_t)read32(rp, off) * 1000000000ULL
+        + convert_time(read32(rp, off + 4), rp->rp_tps);
+  rp->rp_off = off + PCAP_RECORD_LEN + *cap;
+
+  return true;
+}
+
+/// Find the IP header in a captured frame.
+/// @return IP header (or NULL)
+///
+/// @param[in]  frm  captured frame
+/// @param[in]  cap  captured length
+/// @param[in]  link link-layer type
+/// @param[out] ncap captured length of the IP packet
+static const uint8_t*
+locate_network(const uint8_t* frm,
+               const uint64_t cap,
+               const uint64_t link,
+               uint64_t* ncap)
+{
+  uint64_t off;
+  uint16_t et;
+
+  if (link == LINK_RAW || link == LINK_IPV4 || link == LINK_IPV6) {
+    off = 0;
+  } else if (link == LINK_NULL || link == LINK_LOOP) {
+    // The address family is checked by the IP version instead, as its values
+    // differ among the systems.
+    off = 4;
+  } else if (link == LINK_ETHERNET) {
+    off = 12;
+    while (true) {
+      if (off + 2 > cap) {
+        return NULL;
+      }
+
+      et = load16(frm + off);
+      if (et != ETHER_VLAN && et != ETHER_QINQ) {
+        break;
+      }
+      off += 4;
+    }
+
+    if (et != ETHER_IPV4 && et != ETHER_IPV6) {
+      return NULL;
+    }
+    off += 2;
+  } else if (link == LINK_SLL) {
+    if (cap < 16) {
+      return NULL;
+    }
+
+    et = load16(frm + 14);
+    if (et != ETHER_IPV4 && et != ETHER_IPV6) {
+      return NULL;
+    }
+    off = 16;
+  } else if (link == LINK_SLL2) {
+    if (cap < 20) {
+      return NULL;
+    }
+
+    et = load16(frm);
+    if (et != ETHER_IPV4 && et != ETHER_IPV6) {
+      return NULL;
+    }
+    off = 20;
+  } else {
+    return NULL;
+  }
+
+  if (off >= cap) {
+    return NULL;
+  }
+
+  *ncap = cap - off;
+  return frm + off;
+}
+
+/// Determine whether an IP packet is a UDP datagram destined to one of the
+/// served ports. This corresponds to the socket filter of the packet ring.
+/// @return selection indication
+///
+/// @param[in]  pkt  IP packet
+/// @param[in]  cap  captured length of the packet
+/// @param[out] ipv4 usage of the IPv4 protocol
+/// @param[in]  cf   configuration
+static bool
+select_datagram(const uint8_t* pkt,
+                const uint64_t cap,
+                bool* ipv4,
+                const struct config* cf)
+{
+  uint64_t hlen;
+  uint16_t port;
+  uint64_t i;
+
+  if ((pkt[0] >> 4) == 4) {
+    // Fragments other than the first one do not carry the UDP header.
+    hlen = (uint64_t)(pkt[0] & 0x0f) * 4;
+    if (hlen < CAPTURE_IPV4_LEN || cap < hlen + 4 || pkt[9] != IPPROTO_UDP
+     || (load16(pkt + 6) & 0x1fff) != 0) {
+      return false;
+    }
+
+    *ipv4 = true;
+  } else if ((pkt[0] >> 4) == 6) {
+    // Datagrams behind IPv6 extension headers are not recognized.
+    hlen = CAPTURE_IPV6_LEN;
+    if (cap < hlen + 4 || pkt[6] != IPPROTO_UDP) {
+      return false;
+    }
+
+    *ipv4 = false;
+  } else {
+    return false;
+  }
+
+  port = load16(pkt + hlen + 2);
+  for (i = 0; i < cf->cf_nport; i++) {
+    if (cf->cf_port[i] == port) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Create the file of the replayed responses. The responses are stored as raw
+/// IP packets with nanosecond timestamps.
+/// @return success/failure indication
+///
+/// @param[in] rp replay
+/// @param[in] cf configuration
+static bool
+create_output(struct replay* rp, const struct config* cf)
+{
+  uint8_t hdr[PCAP_FILE_LEN];
+  uint32_t u32;
+  uint16_t u16;
+  size_t n;
+
+  rp->rp_out = fopen(cf->cf_out, "w");
+  if (rp->rp_out == NULL) {
+    log(LL_WARN, true, "unable to create the capture file %s", cf->cf_out);
+    return false;
+  }
+
+  // The file is written in the byte order of the host.
+  (void)memset(hdr, 0, sizeof(hdr));
+  u32 = PCAP_MAGIC_NSEC;
+  (void)memcpy(hdr, &u32, sizeof(u32));
+  u16 = 2;
+  (void)memcpy(hdr + 4, &u16, sizeof(u16));
+  u16 = 4;
+  (void)memcpy(hdr + 6, &u16, sizeof(u16));
+  u32 = REPLAY_BUFFER_SIZE;
+  (void)memcpy(hdr + 16, &u32, sizeof(u32));
+  u32 = LINK_RAW;
+  (void)memcpy(hdr + 20, &u32, sizeof(u32));
+
+  n = fwrite(hdr, sizeof(hdr), 1, rp->rp_out);
+  if (n != 1) {
+    log(LL_WARN, true, "unable to write the capture file %s", cf->cf_out);
+    return false;
+  }
+
+  return true;
+}
+
+/// Map the capture file of the requests into memory and recognize its format.
+/// The channels of the replay have no sockets and only keep the counters of
+/// the requests of each protocol.
+/// @return success/failure indication
+///
+/// @param[out] rp replay
+/// @param[out] ch array of two channels
+/// @param[in]  cf configuration
+bool
+open_replay(struct replay* rp, struct channel* ch, const struct config* cf)
+{
+  struct stat sb;
+  void* map;
+  volatile uint8_t sink;
+  uint64_t i;
+  uint32_t mg;
+  int fd;
+  int reti;
+
+  log(LL_INFO, false, "opening the capture file %s", cf->cf_rep);
+
+  (void)memset(rp, 0, sizeof(*rp));
+  for (i = 0; i < 2; i++) {
+    (void)memset(&ch[i], 0, sizeof(ch[i]));
+    ch[i].ch_sock = -1;
+    ch[i].ch_ipv4 = i == 0;
+    ch[i].ch_name = i == 0 ? "IPv4" : "IPv6";
+  }
+
+  fd = open(cf->cf_rep, O_RDONLY);
+  if (fd == -1) {
+    log(LL_WARN, true, "unable to open the capture file %s", cf->cf_rep);
+    return false;
+  }
+
+  reti = fstat(fd, &sb);
+  if (reti == -1 || sb.st_size < 4) {
+    log(LL_WARN, reti == -1, "unable to read the capture file %s", cf->cf_rep);
+    (void)close(fd);
+    return false;
+  }
+
+  map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  (void)close(fd);
+  if (map == MAP_FAILED) {
+    log(LL_WARN, true, "unable to map the capture file %s", cf->cf_rep);
+    return false;
+  }
+
+  rp->rp_map  = map;
+  rp->rp_size = (uint64_t)sb.st_size;
+
+  // Fault the whole file in, so that the replay measures only the handling of
+  // the requests.
+  (void)posix_madvise(map, (size_t)sb.st_size, POSIX_MADV_WILLNEED);
+  for (i = 0; i < rp->rp_size; i += 4096) {
+    sink = rp->rp_map[i];
+  }
+  (void)sink;
+
+  __builtin_memcpy(&mg, rp->rp_map, sizeof(mg));
+  if (mg == PCAPNG_SHB) {
+    rp->rp_ng  = true;
+    rp->rp_off = 0;
+  } else if (mg == PCAP_MAGIC_USEC || mg == PCAP_MAGIC_USEC_SWAP
+          || mg == PCAP_MAGIC_NSEC || mg == PCAP_MAGIC_NSEC_SWAP) {
+    if (open_classic(rp, mg) == false) {
+      return false;
+    }
+  } else {
+    log(LL_WARN, false, "unknown format of the capture file %s", cf->cf_rep);
+    return false;
+  }
+
+  if (cf->cf_out != NULL) {
+    return create_output(rp, cf);
+  }
+
+  return true;
+}
+
+/// Unmap the capture file of the requests and close the file of the
+/// responses.
+///
+/// @param[in] rp replay
+void
+close_replay(struct replay* rp)
+{
+  int reti;
+
+  if (rp->rp_map != NULL) {
+    (void)munmap((void*)rp->rp_map, (size_t)rp->rp_size);
+  }
+
+  if (rp->rp_out != NULL) {
+    reti = fclose(rp->rp_out);
+    if (reti == EOF) {
+      log(LL_WARN, true, "unable to close the capture file of the responses");
+    }
+  }
+}
+
+/// Sum the 16-bit words of a buffer for the Internet checksum.
+/// @return partial sum
+///
+/// @param[in] sum preceding partial sum
+/// @param[in] buf buffer
+/// @param[in] len length of the buffer
+static uint64_t
+sum_words(uint64_t sum, const uint8_t* buf, const size_t len)
+{
+  size_t i;
+
+  for (i = 0; i + 1 < len; i += 2) {
+    sum += load16(buf + i);
+  }
+  if (len % 2 == 1) {
+    sum += (uint64_t)buf[len - 1] << 8;
+  }
+
+  return sum;
+}
+
+/// Fold a partial sum into the Internet checksum.
+/// @return checksum
+///
+/// @param[in] sum partial sum
+static uint16_t
+fold_sum(uint64_t sum)
+{
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+
+  return (uint16_t)~sum;
+}
+
+/// Hand a response over to the replay in place of the socket. The payload is
+/// always encoded, so that the replay accounts for it, but it is only written
+/// if the file of the responses was selected. The IP and UDP headers are those
+/// of the request, with the addresses and the ports swapped.
+/// @return success/failure indication
+///
+/// @param[in] rp replay
+/// @param[in] ch channel
+/// @param[in] pl payload in host byte order
+/// @param[in] cf configuration
+bool
+send_replay(struct replay* rp,
+            struct channel* ch,
+            const struct payload* pl,
+            const struct config* cf)
+{
+  const uint8_t* req;
+  uint8_t* ip;
+  uint8_t* udp;
+  uint32_t rec[4];
+  uint64_t rlen;
+  uint64_t ulen;
+  uint64_t sum;
+  uint16_t csum;
+  size_t n;
+
+  ch->ch_sall++;
+
+  req = rp->rp_req;
+  ip  = rp->rp_buf;
+  if ((req[0] >> 4) == 4) {
+    rlen = (uint64_t)(req[0] & 0x0f) * 4;
+    udp  = ip + CAPTURE_IPV4_LEN;
+  } else {
+    rlen = CAPTURE_IPV6_LEN;
+    udp  = ip + CAPTURE_IPV6_LEN;
+  }
+
+  pack_payload(udp + CAPTURE_UDP_LEN, pl);
+  if (rp->rp_out == NULL) {
+    return true;
+  }
+
+  ulen = CAPTURE_UDP_LEN + (uint64_t)pl->pl_len;
+  (void)memcpy(udp,     req + rlen + 2, 2);
+  (void)memcpy(udp + 2, req + rlen,     2);
+  store16(udp + 4, ulen);
+  store16(udp + 6, 0);
+
+  // The pseudo-header of the checksum consists of the addresses, the protocol
+  // and the length of the datagram.
+  sum = IPPROTO_UDP + ulen;
+  if ((req[0] >> 4) == 4) {
+    (void)memset(ip, 0, CAPTURE_IPV4_LEN);
+    ip[0] = 0x45;
+    ip[1] = req[1];
+    store16(ip + 2, CAPTURE_IPV4_LEN + ulen);
+    ip[8] = (uint8_t)cf->cf_ttl;
+    ip[9] = IPPROTO_UDP;
+    (void)memcpy(ip + 12, req + 16, 4);
+    (void)memcpy(ip + 16, req + 12, 4);
+    store16(ip + 10, fold_sum(sum_words(0, ip, CAPTURE_IPV4_LEN)));
+
+    sum = sum_words(sum, ip + 12, 8);
+  } else {
+    (void)memcpy(ip, req, 4);
+    store16(ip + 4, ulen);
+    ip[6] = IPPROTO_UDP;
+    ip[7] = (uint8_t)cf->cf_ttl;
+    (void)memcpy(ip + 8,  req + 24, 16);
+    (void)memcpy(ip + 24, req + 8,  16);
+
+    sum = sum_words(sum, ip + 8, 32);
+  }
+
+  // The zero checksum denotes its absence.
+  csum = fold_sum(sum_words(sum, udp, (size_t)ulen));
+  store16(udp + 6, csum == 0 ? 0xffff : csum);
+
+  // The record is stamped with the arrival of the request.
+  rec[0] = (uint32_t)(pl->pl_rtm2 / 1000000000ULL);
+  rec[1] = (uint32_t)(pl->pl_rtm2 % 1000000000ULL);
+  rec[2] = (uint32_t)((uint64_t)(udp - ip) + ulen);
+  rec[3] = rec[2];
+
+  n  = fwrite(rec, sizeof(rec), 1, rp->rp_out);
+  n += fwrite(ip, (size_t)rec[2], 1, rp->rp_out);
+  if (n != 2) {
+    log(LL_WARN, true, "unable to write the response");
+    ch->ch_seni++;
+    return false;
+  }
+
+  rp->rp_nout++;
+  return true;
+}
+
+/// Replay all requests of the capture file as fast as possible and report the
+/// achieved rate. The requests go through the same handling as those received
+/// by the packet ring, including the verification, the reporting and the
+/// plugins. The arrival times are taken from the capture file, with the steady
+/// time shifted so that the first request arrives when the replay starts.
+/// @return success/failure indication
+///
+/// @param[in] rp  replay
+/// @param[in] ch  array of two channels
+/// @param[in] hn  local host name
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+/// @param[in] cf  configuration
+bool
+replay_requests(struct replay* rp,
+                struct channel* ch,
+                const char hn[static NEMO_HOST_NAME_SIZE],
+                struct plugin* pi,
+                const uint64_t npi,
+                const struct config* cf)
+{
+  struct sockaddr_storage ss;
+  struct channel* c;
+  const uint8_t* frm;
+  const uint8_t* pkt;
+  const uint8_t* pl;
+  size_t plen;
+  uint64_t cap;
+  uint64_t len;
+  uint64_t ncap;
+  uint64_t link;
+  uint64_t rtm;
+  uint64_t mtm;
+  uint64_t rbase;
+  uint64_t mbase;
+  uint64_t tbeg;
+  uint64_t dur;
+  uint8_t ttl;
+  bool ipv4;
+  bool retb;
+
+  log(LL_INFO, false, "starting the replay");
+  log_config(cf);
+
+  // Print the CSV header of the standard output.
+  report_header(cf);
+
+  rbase = 0;
+  mbase = 0;
+  tbeg  = mono_now();
+
+  while (sint == false && sterm == false) {
+    if (rp->rp_ng == true) {
+      retb = next_block(rp, &frm, &cap, &len, &rtm, &link);
+    } else {
+      retb = next_record(rp, &frm, &cap, &len, &rtm, &link);
+    }
+
+    if (retb == false) {
+      break;
+    }
+    rp->rp_npkt++;
+
+    pkt = locate_network(frm, cap, link, &ncap);
+    if (pkt == NULL || select_datagram(pkt, ncap, &ipv4, cf) == false) {
+      continue;
+    }
+    rp->rp_nreq++;
+    c = ipv4 == true ? &ch[0] : &ch[1];
+
+    // Packets without a timestamp arrive at the time of their replay.
+    if (rtm == 0) {
+      rtm = real_now();
+    }
+    if (rbase == 0) {
+      rbase = rtm;
+      mbase = mono_now();
+    }
+    mtm = rtm > rbase ? mbase + (rtm - rbase) : mbase;
+
+    retb = parse_packet(&ss, &pl, &plen, &ttl, pkt, (size_t)ncap);
+    if (retb == false || cap < len) {
+      log(LL_DEBUG, false, "malformed or truncated packet");
+      c->ch_rall++;
+      c->ch_resz++;
+      continue;
+    }
+
+    rp->rp_req = pkt;
+    retb = handle_capture(c, hn, pi, npi, NULL, &ss, pl, plen, ttl, mtm, rtm, rp, cf);
+    if (retb == false) {
+      return false;
+    }
+  }
+
+  dur = mono_now() - tbeg;
+  if (dur == 0) {
+    dur = 1;
+  }
+
+  log(LL_INFO, false, "skipped %" PRIu64 " packets that are not requests",
+      rp->rp_npkt - rp->rp_nreq);
+  log(LL_INFO, false, "wrote %" PRIu64 " responses", rp->rp_nout);
+
+  // The summary is the purpose of the replay, and is therefore printed
+  // regardless of the logging level.
+  (void)fprintf(stderr, "replayed %" PRIu64 " requests of %" PRIu64 " packets in "
+                "%.3fs: %.1f ns/request, %.0f requests/s\n",
+                rp->rp_nreq, rp->rp_npkt, (double)dur / 1e9,
+                rp->rp_nreq == 0 ? 0.0 : (double)dur / (double)rp->rp_nreq,
+                (double)rp->rp_nreq * 1e9 / (double)dur);
+
+  return true;
+}
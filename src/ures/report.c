@@ -7,16 +7,446 @@
 #include <arpa/inet.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <inttypes.h>
 
 #include "common/convert.h"
 #include "common/log.h"
+#include "common/now.h"
+#include "common/sample.h"
 #include "ures/funcs.h"
 #include "ures/types.h"
 
 
+// Per-requester aggregation and sampling of the reports. The responder
+// handles all requests on a single thread, and therefore neither needs any
+// locking.
+static struct aggregation rep_agg;
+static struct sampler rep_smp;
+
+/// Convert the address of the requester into a string.
+///
+/// @param[out] str  address string
+/// @param[in]  la   low address bits
+/// @param[in]  ha   high address bits
+/// @param[in]  ipv4 address is an IPv4 one
+static void
+format_requester(char str[static INET6_ADDRSTRLEN],
+                 const uint64_t la,
+                 const uint64_t ha,
+                 const bool ipv4)
+{
+  struct in_addr a4;
+  struct in6_addr a6;
+
+  if (ipv4 == true) {
+    a4.s_addr = (uint32_t)la;
+    (void)inet_ntop(AF_INET, &a4, str, INET6_ADDRSTRLEN);
+  } else {
+    tipv6(&a6, la, ha);
+    (void)inet_ntop(AF_INET6, &a6, str, INET6_ADDRSTRLEN);
+  }
+}
+
+/// Hash the identity of a requester.
+/// @return hash value
+///
+/// @param[in] la  low address bits
+/// @param[in] ha  high address bits
+/// @param[in] key key of the requests
+static uint64_t
+hash_requester(const uint64_t la, const uint64_t ha, const uint64_t key)
+{
+  uint64_t h;
+
+  h  = la ^ (ha * 0xff51afd7ed558ccdULL) ^ (key * 0x9e3779b97f4a7c15ULL);
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+/// Convert the counts of the distinct time-to-live values of a requester into
+/// a string of VALUE:COUNT pairs separated by semicolons. The requests with
+/// values beyond the first AGGR_TTLS distinct ones are counted under the
+/// asterisk.
+///
+/// @param[out] str string
+/// @param[in]  len maximal length of the string
+/// @param[in]  ag  aggregate
+static void
+format_ttls(char* str, const size_t len, const struct aggregate* ag)
+{
+  size_t off;
+  uint8_t i;
+
+  off = 0;
+  for (i = 0; i < AGGR_TTLS && ag->ag_tcnt[i] > 0; i++) {
+    off += (size_t)snprintf(str + off, len - off, "%s%" PRIu8 ":%" PRIu64,
+                            i == 0 ? "" : ";", ag->ag_tval[i], ag->ag_tcnt[i]);
+  }
+
+  if (ag->ag_toth > 0) {
+    (void)snprintf(str + off, len - off, ";*:%" PRIu64, ag->ag_toth);
+  }
+}
+
+/// Print the summary of a requester and start its next period. The highest
+/// sequence number is retained, so that the gaps span the periods.
+///
+/// @param[in] ag  aggregate
+/// @param[in] end real time of the end of the period
+static void
+emit_aggregate(struct aggregate* ag, const uint64_t end)
+{
+  char addrstr[INET6_ADDRSTRLEN];
+  char minstr[8];
+  char avgstr[8];
+  char maxstr[8];
+  char cntstr[128];
+
+  (void)memset(addrstr, '\0', sizeof(addrstr));
+  format_requester(addrstr, ag->ag_laddr, ag->ag_haddr, ag->ag_ipv4);
+
+  // Requests without a received TTL do not contribute to its distribution.
+  if (ag->ag_nttl == 0) {
+    (void)strncpy(minstr, "N/A", sizeof(minstr));
+    (void)strncpy(avgstr, "N/A", sizeof(avgstr));
+    (void)strncpy(maxstr, "N/A", sizeof(maxstr));
+    (void)strncpy(cntstr, "N/A", sizeof(cntstr));
+  } else {
+    (void)snprintf(minstr, sizeof(minstr), "%" PRIu8, ag->ag_tmin);
+    (void)snprintf(avgstr, sizeof(avgstr), "%" PRIu64,
+                   (ag->ag_sttl + ag->ag_nttl / 2) / ag->ag_nttl);
+    (void)snprintf(maxstr, sizeof(maxstr), "%" PRIu8, ag->ag_tmax);
+    format_ttls(cntstr, sizeof(cntstr), ag);
+  }
+
+  (void)printf("%" PRIu64 ","   // key
+               "%.*s,"          // host_req
+               "%s,"            // addr_req
+               "%" PRIu64 ","   // reqs
+               "%" PRIu64 ","   // resps
+               "%" PRIu64 ","   // bytes
+               "%s,"            // ttl_min
+               "%s,"            // ttl_mean
+               "%s,"            // ttl_max
+               "%s,"            // ttl_counts
+               "%" PRIu64 ","   // seq_gaps
+               "%" PRIu64 ","   // seq_back
+               "%" PRIu64 ","   // real_first
+               "%" PRIu64 ","   // real_last
+               "%" PRIu64 "\n", // real_end
+               ag->ag_key, NEMO_HOST_NAME_SIZE, ag->ag_host, addrstr,
+               ag->ag_nreq, ag->ag_nres, ag->ag_byte,
+               minstr, avgstr, maxstr, cntstr,
+               ag->ag_gap, ag->ag_back,
+               ag->ag_first, ag->ag_last, end);
+  rep_agg.an_nrow++;
+
+  ag->ag_nreq = 0;
+  ag->ag_nres = 0;
+  ag->ag_byte = 0;
+  ag->ag_nttl = 0;
+  ag->ag_sttl = 0;
+  ag->ag_toth = 0;
+  ag->ag_gap  = 0;
+  ag->ag_back = 0;
+  ag->ag_tmin = UINT8_MAX;
+  ag->ag_tmax = 0;
+  (void)memset(ag->ag_tcnt, 0, sizeof(ag->ag_tcnt));
+}
+
+/// Remove an aggregate from the recency list.
+///
+/// @param[in] idx index of the aggregate
+static void
+unlink_aggregate(const uint32_t idx)
+{
+  struct aggregate* ag;
+
+  ag = &rep_agg.an_ent[idx];
+  if (ag->ag_newer == AGGR_NONE) {
+    rep_agg.an_new = ag->ag_older;
+  } else {
+    rep_agg.an_ent[ag->ag_newer].ag_older = ag->ag_older;
+  }
+
+  if (ag->ag_older == AGGR_NONE) {
+    rep_agg.an_old = ag->ag_newer;
+  } else {
+    rep_agg.an_ent[ag->ag_older].ag_newer = ag->ag_newer;
+  }
+}
+
+/// Insert an aggregate at the front of the recency list.
+///
+/// @param[in] idx index of the aggregate
+static void
+link_aggregate(const uint32_t idx)
+{
+  struct aggregate* ag;
+
+  ag = &rep_agg.an_ent[idx];
+  ag->ag_newer = AGGR_NONE;
+  ag->ag_older = rep_agg.an_new;
+  if (rep_agg.an_new == AGGR_NONE) {
+    rep_agg.an_old = idx;
+  } else {
+    rep_agg.an_ent[rep_agg.an_new].ag_newer = idx;
+  }
+  rep_agg.an_new = idx;
+}
+
+/// Evict the least recently used aggregate, so that its storage can be
+/// reused. Its summary is emitted first, unless it is empty.
+/// @return index of the freed aggregate
+static uint32_t
+evict_aggregate(void)
+{
+  struct aggregate* ag;
+  uint32_t* pos;
+  uint32_t idx;
+  uint64_t bkt;
+
+  idx = rep_agg.an_old;
+  ag  = &rep_agg.an_ent[idx];
+  if (ag->ag_nreq > 0) {
+    emit_aggregate(ag, real_now());
+  }
+
+  // Unlink the aggregate from its hash chain.
+  bkt = hash_requester(ag->ag_laddr, ag->ag_haddr, ag->ag_key) & rep_agg.an_mask;
+  pos = &rep_agg.an_head[bkt];
+  while (*pos != idx) {
+    pos = &rep_agg.an_ent[*pos].ag_next;
+  }
+  *pos = ag->ag_next;
+
+  unlink_aggregate(idx);
+  rep_agg.an_nevi++;
+
+  return idx;
+}
+
+/// Account for a request in the summary of its requester. New requesters
+/// replace the least recently used ones once the table is full.
+///
+/// @param[in] pl   payload
+/// @param[in] la   low address bits of the requester
+/// @param[in] ha   high address bits of the requester
+/// @param[in] ipv4 requester address is an IPv4 one
+/// @param[in] sent response was sent
+static void
+aggregate_event(const struct payload* pl,
+                const uint64_t la,
+                const uint64_t ha,
+                const bool ipv4,
+                const bool sent)
+{
+  struct aggregate* ag;
+  uint64_t bkt;
+  uint32_t idx;
+  uint8_t i;
+
+  bkt = hash_requester(la, ha, pl->pl_key) & rep_agg.an_mask;
+  for (idx = rep_agg.an_head[bkt]; idx != AGGR_NONE; idx = ag->ag_next) {
+    ag = &rep_agg.an_ent[idx];
+    if (ag->ag_laddr == la && ag->ag_haddr == ha
+     && ag->ag_key == pl->pl_key && ag->ag_ipv4 == ipv4) {
+      break;
+    }
+  }
+
+  if (idx == AGGR_NONE) {
+    // Take a new aggregate, or reuse the least recently used one.
+    if (rep_agg.an_cnt < rep_agg.an_cap) {
+      idx = (uint32_t)rep_agg.an_cnt;
+      rep_agg.an_cnt++;
+    } else {
+      idx = evict_aggregate();
+    }
+
+    ag = &rep_agg.an_ent[idx];
+    (void)memset(ag, 0, sizeof(*ag));
+    ag->ag_laddr = la;
+    ag->ag_haddr = ha;
+    ag->ag_key   = pl->pl_key;
+    ag->ag_ipv4  = ipv4;
+    ag->ag_snum  = pl->pl_snum;
+    ag->ag_tmin  = UINT8_MAX;
+
+    ag->ag_next = rep_agg.an_head[bkt];
+    rep_agg.an_head[bkt] = idx;
+  } else {
+    // Account for the gap since the highest sequence number, or for a
+    // request that arrived out of order.
+    if (pl->pl_snum > ag->ag_snum) {
+      ag->ag_gap += pl->pl_snum - ag->ag_snum - 1;
+      ag->ag_snum = pl->pl_snum;
+    } else {
+      ag->ag_back++;
+    }
+
+    unlink_aggregate(idx);
+  }
+
+  link_aggregate(idx);
+
+  // Full-size payloads state the current host name of the requester, whereas
+  // the compact ones carry only the name known to the channel, if any.
+  if (pl->pl_fver == NEMO_PAYLOAD_VERSION_FULL || ag->ag_host[0] == '\0') {
+    (void)memcpy(ag->ag_host, pl->pl_host, sizeof(ag->ag_host));
+  }
+
+  if (ag->ag_nreq == 0) {
+    ag->ag_first = pl->pl_rtm2;
+  }
+  ag->ag_last = pl->pl_rtm2;
+  ag->ag_nreq++;
+  ag->ag_byte += pl->pl_len;
+  if (sent == true) {
+    ag->ag_nres++;
+  }
+
+  // A zero TTL denotes that it was not received.
+  if (pl->pl_ttl2 != 0) {
+    ag->ag_nttl++;
+    ag->ag_sttl += pl->pl_ttl2;
+    if (pl->pl_ttl2 < ag->ag_tmin) {
+      ag->ag_tmin = pl->pl_ttl2;
+    }
+    if (pl->pl_ttl2 > ag->ag_tmax) {
+      ag->ag_tmax = pl->pl_ttl2;
+    }
+
+    // Count the value in its slot, or take the first unused one.
+    for (i = 0; i < AGGR_TTLS; i++) {
+      if (ag->ag_tcnt[i] == 0) {
+        ag->ag_tval[i] = pl->pl_ttl2;
+      }
+      if (ag->ag_tval[i] == pl->pl_ttl2) {
+        ag->ag_tcnt[i]++;
+        break;
+      }
+    }
+    if (i == AGGR_TTLS) {
+      ag->ag_toth++;
+    }
+  }
+}
+
+/// Emit the summaries of all requesters that sent requests within the period.
+/// The recently used aggregates precede all others, so that the idle
+/// requesters are not visited.
+static void
+emit_recent(void)
+{
+  struct aggregate* ag;
+  uint64_t end;
+  uint32_t idx;
+
+  end = real_now();
+  for (idx = rep_agg.an_new; idx != AGGR_NONE; idx = ag->ag_older) {
+    ag = &rep_agg.an_ent[idx];
+    if (ag->ag_nreq == 0) {
+      break;
+    }
+
+    emit_aggregate(ag, end);
+  }
+}
+
+/// Allocate the table of per-requester summaries. The number of buckets is at
+/// least twice the number of aggregates, so that the hash chains remain short.
+/// @return success/failure indication
+///
+/// @param[in] cf configuration
+bool
+open_aggregation(const struct config* cf)
+{
+  uint64_t nbkt;
+
+  (void)memset(&rep_agg, 0, sizeof(rep_agg));
+  rep_agg.an_new = AGGR_NONE;
+  rep_agg.an_old = AGGR_NONE;
+  rep_agg.an_cap = cf->cf_agn;
+  rep_agg.an_due = mono_now() + cf->cf_agp;
+
+  nbkt = 1;
+  while (nbkt < 2 * cf->cf_agn) {
+    nbkt *= 2;
+  }
+  rep_agg.an_mask = nbkt - 1;
+
+  rep_agg.an_ent  = calloc((size_t)cf->cf_agn, sizeof(*rep_agg.an_ent));
+  rep_agg.an_head = malloc((size_t)nbkt * sizeof(*rep_agg.an_head));
+  if (rep_agg.an_ent == NULL || rep_agg.an_head == NULL) {
+    log(LL_WARN, true, "unable to allocate memory for the aggregation");
+    return false;
+  }
+
+  // All bits set denote an empty hash chain.
+  (void)memset(rep_agg.an_head, 0xff, (size_t)nbkt * sizeof(*rep_agg.an_head));
+
+  log(LL_DEBUG, false, "aggregating %" PRIu64 " requesters in %" PRIu64 " buckets",
+      cf->cf_agn, nbkt);
+  return true;
+}
+
+/// Emit the summaries of the period, if it has elapsed.
+/// @return monotonic time of the next emission
+///
+/// @param[in] cur current monotonic time
+/// @param[in] cf  configuration
+uint64_t
+emit_aggregation(const uint64_t cur, const struct config* cf)
+{
+  if (cur < rep_agg.an_due) {
+    return rep_agg.an_due;
+  }
+
+  emit_recent();
+
+  // Skip the periods that were missed altogether.
+  rep_agg.an_due += cf->cf_agp;
+  if (rep_agg.an_due <= cur) {
+    rep_agg.an_due = cur + cf->cf_agp;
+  }
+
+  return rep_agg.an_due;
+}
+
+/// Emit the summaries of the last period and release the table.
+///
+/// @param[in] cf configuration
+void
+close_aggregation(const struct config* cf)
+{
+  // No output to be performed if the silent mode was requested.
+  if (rep_agg.an_ent != NULL && rep_agg.an_head != NULL && cf->cf_sil == false) {
+    emit_recent();
+    log(LL_DEBUG, false, "aggregation: %" PRIu64 " requesters, %" PRIu64
+        " evicted, %" PRIu64 " rows", rep_agg.an_cnt, rep_agg.an_nevi, rep_agg.an_nrow);
+  }
+
+  free(rep_agg.an_ent);
+  free(rep_agg.an_head);
+  (void)memset(&rep_agg, 0, sizeof(rep_agg));
+}
+
+/// Prepare the sampling of the report rows.
+///
+/// @param[in] cf configuration
+void
+prepare_report(const struct config* cf)
+{
+  init_sampler(&rep_smp, cf->cf_smp, cf->cf_sev, cf->cf_srt);
+}
+
 /// Print the CSV header of the reporting output.
 ///
 /// @param[in] cf configuration
@@ -28,12 +458,21 @@ report_header(const struct config* cf)
     return;
   }
 
+  // The aggregation prints one line per requester and period instead.
+  if (cf->cf_agp != 0) {
+    (void)printf("key,host_req,addr_req,reqs,resps,bytes,"
+                 "ttl_min,ttl_mean,ttl_max,ttl_counts,seq_gaps,seq_back,"
+                 "real_first,real_last,real_end\n");
+    return;
+  }
+
   // Print the CSV header of the standard output.
   (void)printf("key,len,seq_num,seq_len,"
                "host_req,addr_req,port_req,host_res,"
                "ttl_dep_req,ttl_arr_res,"
                "real_dep_req,real_arr_res,"
-               "mono_dep_req,mono_arr_res\n");
+               "mono_dep_req,mono_arr_res,"
+               "real_dep_res,mono_dep_res\n");
 }
 
 /// Report the event of the incoming datagram by printing a CSV-formatted line
@@ -43,37 +482,52 @@ report_header(const struct config* cf)
 /// @param[in] hn local host name
 /// @param[in] la low address bits of the requester
 /// @param[in] ha high address bits of the requester
-/// @param[in] pn UDP port of the requester
-/// @param[in] cf configuration
+/// @param[in] pn   UDP port of the requester
+/// @param[in] ipv4 requester address is an IPv4 one
+/// @param[in] rdep real time of the response departure (0 if not sent)
+/// @param[in] mdep monotonic time of the response departure (0 if not sent)
+/// @param[in] cf   configuration
 void
 report_event(const struct payload* pl,
              const char hn[static NEMO_HOST_NAME_SIZE],
              const uint64_t la,
              const uint64_t ha,
              const uint16_t pn,
+             const bool ipv4,
+             const uint64_t rdep,
+             const uint64_t mdep,
              const struct config* cf)
 {
   char addrstr[INET6_ADDRSTRLEN];
-  struct in_addr a4;
-  struct in6_addr a6;
   char ttlstr[8];
+  char slenstr[24];
+  char rdepstr[24];
+  char mdepstr[24];
 
   // No output to be performed if the silent mode was requested.
   if (cf->cf_sil == true) {
     return;
   }
 
+  // Only update the summary of the requester if aggregating.
+  if (cf->cf_agp != 0) {
+    aggregate_event(pl, la, ha, ipv4, rdep != 0);
+    return;
+  }
+
+  // Skip the rows that were not sampled or exceed the rate limit.
+  if (sample_row(&rep_smp, pl->pl_key, pl->pl_snum) == false) {
+    return;
+  }
+
   (void)memset(addrstr, '\0', sizeof(addrstr));
   (void)memset(ttlstr,  '\0', sizeof(ttlstr));
+  (void)memset(slenstr, '\0', sizeof(slenstr));
+  (void)memset(rdepstr, '\0', sizeof(rdepstr));
+  (void)memset(mdepstr, '\0', sizeof(mdepstr));
 
   // Convert the IP address into a string.
-  if (cf->cf_ipv4 == true) {
-    a4.s_addr = (uint32_t)la;
-    (void)inet_ntop(AF_INET, &a4, addrstr, sizeof(addrstr));
-  } else {
-    tipv6(&a6, la, ha);
-    (void)inet_ntop(AF_INET6, &a6, addrstr, sizeof(addrstr));
-  }
+  format_requester(addrstr, la, ha, ipv4);
 
   // If no TTL was received, report it as not available.
   if (pl->pl_ttl2 == 0) {
@@ -82,10 +536,26 @@ report_event(const struct payload* pl,
     (void)snprintf(ttlstr, sizeof(ttlstr), "%" PRIu8, pl->pl_ttl2);
   }
 
+  // Responses that were not sent have no departure.
+  if (rdep == 0) {
+    (void)strncpy(rdepstr, "N/A", sizeof(rdepstr));
+    (void)strncpy(mdepstr, "N/A", sizeof(mdepstr));
+  } else {
+    (void)snprintf(rdepstr, sizeof(rdepstr), "%" PRIu64, rdep);
+    (void)snprintf(mdepstr, sizeof(mdepstr), "%" PRIu64, mdep);
+  }
+
+  // The sequence length is not transmitted in the compact format.
+  if (pl->pl_fver == NEMO_PAYLOAD_VERSION_COMPACT) {
+    (void)strncpy(slenstr, "N/A", sizeof(slenstr));
+  } else {
+    (void)snprintf(slenstr, sizeof(slenstr), "%" PRIu64, pl->pl_slen);
+  }
+
   (void)printf("%" PRIu64 ","   // key
                "%" PRIu16 ","   // len
                "%" PRIu64 ","   // seq_num
-               "%" PRIu64 ","   // seq_len
+               "%s,"            // seq_len
                "%.*s,"          // host_req
                "%s,"            // addr_req
                "%" PRIu16 ","   // port_req
@@ -95,14 +565,17 @@ report_event(const struct payload* pl,
                "%" PRIu64 ","   // real_dep_req
                "%" PRIu64 ","   // real_arr_res
                "%" PRIu64 ","   // mono_dep_req
-               "%" PRIu64 "\n", // mono_arr_res
-               pl->pl_key, pl->pl_len, pl->pl_snum, pl->pl_slen,
+               "%" PRIu64 ","   // mono_arr_res
+               "%s,"            // real_dep_res
+               "%s\n",          // mono_dep_res
+               pl->pl_key, pl->pl_len, pl->pl_snum, slenstr,
                NEMO_HOST_NAME_SIZE, pl->pl_host,
                addrstr, pn,
                NEMO_HOST_NAME_SIZE, hn,
                pl->pl_ttl1, ttlstr,
                pl->pl_rtm1, pl->pl_rtm2,
-               pl->pl_mtm1, pl->pl_mtm2);
+               pl->pl_mtm1, pl->pl_mtm2,
+               rdepstr, mdepstr);
 }
 
 /// Flush all data written to the standard output to their respective device.
@@ -119,6 +592,12 @@ flush_report_stream(const struct config* cf)
     return true;
   }
 
+  // Report rows that were not printed.
+  if (cf->cf_smp != SAMPLE_NONE || cf->cf_srt != 0) {
+    log(LL_DEBUG, false, "unsampled report rows: %" PRIu64, rep_smp.sp_nskip);
+    log(LL_DEBUG, false, "suppressed report rows: %" PRIu64, rep_smp.sp_nsup);
+  }
+
   log(LL_INFO, false, "flushing standard output stream");
 
   // Flush all stdio buffers.
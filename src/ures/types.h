@@ -9,27 +9,193 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
+
+#include "common/channel.h"
+#include "common/cpu.h"
+#include "common/hist.h"
+#include "common/payload.h"
+#include "common/plugin.h"
+#include "common/sample.h"
 
 
 #define PLUG_MAX 32
+#define PORT_MAX 16
+#define ADDR_MAX 8
+
+// Period of the real-time clock offset updates of the in-kernel reflection.
+#define XDP_CLOCK_PERIOD 1000000000ULL
+
+// Geometry of the packet capture ring.
+#define CAPTURE_BLOCK_SIZE (1U << 18) ///< Size of a block of frames.
+#define CAPTURE_BLOCK_MIN  4          ///< Minimal number of blocks.
+#define CAPTURE_FRAME_SIZE 2048       ///< Nominal size of a frame.
+#define CAPTURE_RETIRE     1          ///< Block retirement timeout in ms.
+
+// Lengths of the fixed headers.
+#define CAPTURE_IPV4_LEN 20 ///< IPv4 header without options.
+#define CAPTURE_IPV6_LEN 40 ///< IPv6 header without extension headers.
+#define CAPTURE_UDP_LEN  8  ///< UDP header.
+
+// Maximal number of interfaces in a section of a pcapng file.
+#define REPLAY_IF_MAX 16
+
+// Size of the buffer of a replayed response, including its headers.
+#define REPLAY_BUFFER_SIZE (CAPTURE_IPV6_LEN + CAPTURE_UDP_LEN + CHANNEL_BUFFER_SIZE)
+
+// Default and maximal number of requesters tracked by the aggregation.
+#define AGGR_DEF_SIZE 4096
+#define AGGR_MAX_SIZE (1U << 24)
+
+// Index of no aggregate, terminating the hash chains and the recency list.
+#define AGGR_NONE UINT32_MAX
+
+// Number of distinct time-to-live values counted by each aggregate.
+#define AGGR_TTLS 4
 
 /// Configuration.
 struct config {
   const char* cf_plgs[PLUG_MAX]; ///< Paths to plugin shared object libraries.
-  uint64_t    cf_port;           ///< UDP port number.
+  const char* cf_prom;           ///< Path of the metrics socket.
+  const char* cf_xdp;            ///< Interface of the in-kernel reflection.
+  const char* cf_cap;            ///< Interface of the packet capture ring.
+  const char* cf_rep;            ///< Capture file of the replayed requests.
+  const char* cf_out;            ///< Capture file of the replayed responses.
+  const char* cf_addr[ADDR_MAX]; ///< Local addresses.
+  uint64_t    cf_naddr;          ///< Number of local addresses.
+  uint64_t    cf_port[PORT_MAX]; ///< UDP port numbers.
+  uint64_t    cf_nport;          ///< Number of UDP port numbers.
   uint64_t    cf_rbuf;           ///< Socket receive buffer size.
   uint64_t    cf_sbuf;           ///< Socket send buffer size.
+  uint64_t    cf_rcap;           ///< Ceiling of the receive buffer (0 if fixed).
+  uint64_t    cf_scap;           ///< Ceiling of the send buffer (0 if fixed).
   uint64_t    cf_key;            ///< Unique key.
   uint64_t    cf_ttl;            ///< Time-To-Live for outgoing IP packets.
   uint64_t    cf_ito;            ///< Inactivity timeout.
   uint64_t    cf_len;            ///< Overall packet length.
+  uint64_t    cf_cpu;            ///< CPU affinity of the responder.
+  uint64_t    cf_prio;           ///< Real-time scheduling priority.
+  uint64_t    cf_agp;            ///< Aggregation period (0 if disabled).
+  uint64_t    cf_agn;            ///< Number of aggregated requesters.
+  uint64_t    cf_sev;            ///< Sampling period of the report rows.
+  uint64_t    cf_srt;            ///< Limit of report rows per second (0 if none).
   bool        cf_err;            ///< Early exit on first network error.
   bool        cf_ipv4;           ///< Usage of Internet Protocol version 4.
   uint8_t     cf_llvl;           ///< Minimal log level.
+  uint8_t     cf_clk;            ///< Clock source.
+  uint8_t     cf_lbe;            ///< Log back-end service.
   bool        cf_lcol;           ///< Log coloring policy.
   bool        cf_mono;           ///< Monologue mode (no responses).
   bool        cf_sil;            ///< Standard output presence.
-  uint8_t     cf_pad[2];         ///< Padding (unused).
+  bool        cf_stat;           ///< Publish live statistics.
+  bool        cf_xgen;           ///< Generic mode of the in-kernel reflection.
+  bool        cf_busy;           ///< Spin on non-blocking receives.
+  uint8_t     cf_smp;            ///< Sampling method of the report rows.
+  uint8_t     cf_pad[4];         ///< Padding (unused).
+};
+
+/// Metadata of a request reflected in the kernel, as pushed to the user space
+/// by the XDP program.
+struct xdp_event {
+  uint64_t xe_addr;                  ///< IPv4 address of the requester.
+  uint16_t xe_port;                  ///< UDP port of the requester.
+  uint16_t xe_len;                   ///< Datagram length.
+  uint8_t  xe_pad[4];                ///< Padding (unused).
+  uint8_t  xe_pl[NEMO_PAYLOAD_SIZE]; ///< Filled payload in on-wire format.
+};
+
+/// In-kernel reflection of requests on a network interface.
+struct xdp {
+  uint8_t* xd_cons; ///< Consumer position of the ring buffer.
+  uint8_t* xd_prod; ///< Producer position of the ring buffer.
+  uint8_t* xd_data; ///< Data area of the ring buffer.
+  uint64_t xd_size; ///< Size of the data area.
+  uint64_t xd_clk;  ///< Time of the last real-time clock offset update.
+  uint64_t xd_nrec; ///< Number of received events.
+  int      xd_prog; ///< Program descriptor.
+  int      xd_link; ///< Attachment of the program to the interface.
+  int      xd_ring; ///< Ring buffer map descriptor.
+  int      xd_roff; ///< Real-time clock offset map descriptor.
+};
+
+/// Reception of requests through a memory-mapped packet capture ring.
+struct capture {
+  uint8_t* cp_ring;    ///< Mapped ring of blocks.
+  uint64_t cp_bsz;     ///< Size of a block.
+  uint64_t cp_nblk;    ///< Number of blocks.
+  uint64_t cp_cur;     ///< Index of the next block to process.
+  uint64_t cp_nfrm;    ///< Number of processed frames.
+  uint64_t cp_nhw;     ///< Number of frames with hardware timestamps.
+  int      cp_sock;    ///< Packet socket.
+  uint8_t  cp_pad[4];  ///< Padding (unused).
+};
+
+/// Replay of the requests from a capture file in the pcap or pcapng format.
+/// The file is mapped into memory, so that reading it does not contribute to
+/// the measured time.
+struct replay {
+  const uint8_t* rp_map;   ///< Mapped capture file.
+  uint64_t       rp_size;  ///< Size of the capture file.
+  uint64_t       rp_off;   ///< Offset of the next record or block.
+  uint64_t       rp_tps;   ///< Timestamp ticks per second (classic format).
+  uint64_t       rp_link;  ///< Link-layer type (classic format).
+  uint64_t       rp_itps[REPLAY_IF_MAX];  ///< Ticks per second of the interfaces.
+  uint64_t       rp_ilink[REPLAY_IF_MAX]; ///< Link-layer types of the interfaces.
+  uint64_t       rp_nif;   ///< Number of interfaces in the current section.
+  uint64_t       rp_npkt;  ///< Number of read packets.
+  uint64_t       rp_nreq;  ///< Number of handled datagrams.
+  uint64_t       rp_nout;  ///< Number of written responses.
+  const uint8_t* rp_req;   ///< IP packet of the current request.
+  FILE*          rp_out;   ///< Capture file of the responses (or NULL).
+  bool           rp_ng;    ///< Usage of the pcapng format.
+  bool           rp_swap;  ///< Byte order differs from the host.
+  uint8_t        rp_pad[6]; ///< Padding (unused).
+  uint8_t        rp_buf[REPLAY_BUFFER_SIZE]; ///< Response packet.
+};
+
+/// Summary of the requests of one requester, identified by its address and
+/// key, within the current aggregation period.
+struct aggregate {
+  uint64_t ag_laddr; ///< Low address bits of the requester.
+  uint64_t ag_haddr; ///< High address bits of the requester.
+  uint64_t ag_key;   ///< Key of the requests.
+  uint64_t ag_nreq;  ///< Number of requests.
+  uint64_t ag_nres;  ///< Number of sent responses.
+  uint64_t ag_byte;  ///< Sum of the datagram lengths.
+  uint64_t ag_nttl;  ///< Number of requests with a known time-to-live.
+  uint64_t ag_sttl;  ///< Sum of the known time-to-live values.
+  uint64_t ag_tcnt[AGGR_TTLS]; ///< Number of requests with each distinct time-to-live.
+  uint64_t ag_toth;  ///< Number of requests with other time-to-live values.
+  uint64_t ag_gap;   ///< Number of skipped sequence numbers.
+  uint64_t ag_back;  ///< Number of duplicate or reordered sequence numbers.
+  uint64_t ag_snum;  ///< Highest sequence number (kept across periods).
+  uint64_t ag_first; ///< Real time of the first request.
+  uint64_t ag_last;  ///< Real time of the last request.
+  uint32_t ag_next;  ///< Next aggregate in the hash chain.
+  uint32_t ag_newer; ///< More recently used aggregate.
+  uint32_t ag_older; ///< Less recently used aggregate.
+  uint8_t  ag_tmin;  ///< Lowest known time-to-live.
+  uint8_t  ag_tmax;  ///< Highest known time-to-live.
+  bool     ag_ipv4;  ///< Requester address is an IPv4 one.
+  uint8_t  ag_tval[AGGR_TTLS]; ///< Distinct time-to-live values.
+  uint8_t  ag_pad[5]; ///< Padding (unused).
+  char     ag_host[NEMO_HOST_NAME_SIZE]; ///< Host name of the requester.
+};
+
+/// Bounded table of aggregates with chained buckets. When the table is full,
+/// the least recently used aggregate is emitted and replaced. The recency list
+/// also orders the aggregates updated within the period before all others.
+struct aggregation {
+  struct aggregate* an_ent;  ///< Storage of aggregates.
+  uint32_t*         an_head; ///< Heads of the hash chains.
+  uint64_t          an_cap;  ///< Capacity of the storage.
+  uint64_t          an_mask; ///< Mask of the bucket index.
+  uint64_t          an_cnt;  ///< Number of used aggregates.
+  uint64_t          an_due;  ///< Monotonic time of the next emission.
+  uint64_t          an_nevi; ///< Number of evicted aggregates.
+  uint64_t          an_nrow; ///< Number of emitted rows.
+  uint32_t          an_new;  ///< Most recently used aggregate.
+  uint32_t          an_old;  ///< Least recently used aggregate.
 };
 
 /// Command-line option.
@@ -40,4 +206,13 @@ struct option {
                  const char* inp);
 };
 
+/// Responder state exposed to the metrics endpoint.
+struct exposure {
+  const struct channel* ex_ch;  ///< Array of channels.
+  uint64_t              ex_nch; ///< Number of channels.
+  const struct plugin*  ex_pi;  ///< Array of plugins.
+  uint64_t              ex_npi; ///< Number of plugins.
+  struct hist           ex_svc; ///< Time from a request arrival to the response.
+};
+
 #endif
@@ -0,0 +1,805 @@
+// Copyright (c) 2018-2019 Daniel Lovasko
+// All Rights Reserved
+//
+// Distributed under the terms of the 2-clause BSD License. The full
+// license is in the file LICENSE, distributed as part of this software.
+
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/convert.h"
+#include "common/host.h"
+#include "common/log.h"
+#include "common/now.h"
+#include "common/payload.h"
+#include "ures/funcs.h"
+#include "ures/types.h"
+
+// The eXpress Data Path is only available on Linux.
+#if defined(__linux__)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <unistd.h>
+#include <errno.h>
+
+
+// Program limits.
+#define XDP_INSN_MAX  512 ///< Maximal number of instructions.
+#define XDP_LABEL_MAX 8   ///< Maximal number of jump targets.
+#define XDP_LOG_SIZE  65536 ///< Size of the verifier log.
+
+// Size of the data area of the ring buffer, in bytes.
+#define XDP_RING_SIZE (1U << 22)
+
+// Offsets of the headers within the frame. Only untagged Ethernet frames with
+// IPv4 headers without options are reflected, everything else is passed to
+// the network stack.
+#define XDP_OFF_ETH 0  ///< Ethernet header.
+#define XDP_OFF_IP  14 ///< IPv4 header.
+#define XDP_OFF_UDP 34 ///< UDP header.
+#define XDP_OFF_PL  42 ///< Payload.
+
+// Offsets of the payload fields that are common to both formats.
+#define XDP_PL_MGIC 0  ///< Magic identifier.
+#define XDP_PL_LEN  2  ///< Payload length.
+#define XDP_PL_FVER 4  ///< Format version and message type.
+#define XDP_PL_TTL1 6  ///< Time-To-Live when sent.
+#define XDP_PL_TTL2 7  ///< Time-To-Live when received.
+#define XDP_PL_KEY  24 ///< Responder/requester key.
+#define XDP_PL_MTM2 48 ///< Steady time of response.
+#define XDP_PL_RTM2 56 ///< System time of response.
+
+// Jump targets.
+#define LBL_PASS    0 ///< Hand the frame over to the network stack.
+#define LBL_COMPACT 1 ///< Reflect a compact payload.
+#define LBL_CLOCK   2 ///< Clock offset is available (per format).
+#define LBL_REPORT  4 ///< Event was pushed to the user space (per format).
+
+/// Program under construction.
+struct prog {
+  struct bpf_insn pg_ins[XDP_INSN_MAX]; ///< Instructions.
+  int8_t          pg_jmp[XDP_INSN_MAX]; ///< Jump target of each instruction.
+  int64_t         pg_lbl[XDP_LABEL_MAX]; ///< Position of each jump target.
+  uint64_t        pg_n;                 ///< Number of instructions.
+  bool            pg_ovf;               ///< Instruction limit was exceeded.
+  uint8_t         pg_pad[7];            ///< Padding (unused).
+};
+
+/// Perform a BPF system call.
+/// @return system call result
+///
+/// @param[in] cmd command
+/// @param[in] at  attributes
+static int
+sys_bpf(const int cmd, union bpf_attr* at)
+{
+  return (int)syscall(SYS_bpf, cmd, at, sizeof(*at));
+}
+
+/// Append an instruction to the program.
+///
+/// @param[in] pg   program
+/// @param[in] code operation code
+/// @param[in] dst  destination register
+/// @param[in] src  source register
+/// @param[in] off  offset
+/// @param[in] imm  immediate value
+static void
+emit(struct prog* pg,
+     const uint8_t code,
+     const uint8_t dst,
+     const uint8_t src,
+     const int16_t off,
+     const int32_t imm)
+{
+  struct bpf_insn* in;
+
+  if (pg->pg_n == XDP_INSN_MAX) {
+    pg->pg_ovf = true;
+    return;
+  }
+
+  // The register numbers are always within the range of the 4-bit fields,
+  // which the conversion warnings are unable to deduce.
+  in = &pg->pg_ins[pg->pg_n];
+  in->code    = code;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+  in->dst_reg = dst & 0xf;
+  in->src_reg = src & 0xf;
+#pragma GCC diagnostic pop
+  in->off     = off;
+  in->imm     = imm;
+
+  pg->pg_jmp[pg->pg_n] = -1;
+  pg->pg_n++;
+}
+
+/// Append a conditional jump that compares a register with a constant. The
+/// offset is resolved once all jump targets are placed.
+///
+/// @param[in] pg  program
+/// @param[in] op  comparison (one of BPF_J*, or BPF_JA for unconditional)
+/// @param[in] reg register
+/// @param[in] imm constant
+/// @param[in] lbl jump target
+static void
+jump(struct prog* pg,
+     const uint8_t op,
+     const uint8_t reg,
+     const int32_t imm,
+     const int8_t lbl)
+{
+  emit(pg, (uint8_t)(BPF_JMP | op | BPF_K), reg, 0, 0, imm);
+  if (pg->pg_ovf == false) {
+    pg->pg_jmp[pg->pg_n - 1] = lbl;
+  }
+}
+
+/// Place a jump target at the current position.
+///
+/// @param[in] pg  program
+/// @param[in] lbl jump target
+static void
+label(struct prog* pg, const int8_t lbl)
+{
+  pg->pg_lbl[lbl] = (int64_t)pg->pg_n;
+}
+
+/// Append a load of a 64-bit constant, which occupies two instructions.
+///
+/// @param[in] pg  program
+/// @param[in] reg destination register
+/// @param[in] src pseudo source (BPF_PSEUDO_MAP_FD for map descriptors)
+/// @param[in] val constant
+static void
+load_imm64(struct prog* pg, const uint8_t reg, const uint8_t src, const uint64_t val)
+{
+  emit(pg, BPF_LD | BPF_DW | BPF_IMM, reg, src, 0, (int32_t)(uint32_t)val);
+  emit(pg, 0, 0, 0, 0, (int32_t)(uint32_t)(val >> 32));
+}
+
+/// Append a store of a 64-bit register in the on-wire byte order of the
+/// payload (see htonll), using the second register as a scratch space.
+///
+/// @param[in] pg  program
+/// @param[in] off offset within the frame
+/// @param[in] reg source register
+/// @param[in] tmp scratch register
+static void
+store_wire64(struct prog* pg, const int16_t off, const uint8_t reg, const uint8_t tmp)
+{
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, tmp, reg, 0, 0);
+  emit(pg, BPF_ALU | BPF_END | BPF_TO_BE, tmp, 0, 0, 32);
+  emit(pg, BPF_STX | BPF_MEM | BPF_W, BPF_REG_6, tmp, off, 0);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, tmp, reg, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_RSH | BPF_K, tmp, 0, 0, 32);
+  emit(pg, BPF_ALU | BPF_END | BPF_TO_BE, tmp, 0, 0, 32);
+  emit(pg, BPF_STX | BPF_MEM | BPF_W, BPF_REG_6, tmp, (int16_t)(off + 4), 0);
+}
+
+/// Append the exchange of two memory locations of the frame.
+///
+/// @param[in] pg  program
+/// @param[in] sz  access size (one of BPF_B, BPF_H, BPF_W, BPF_DW)
+/// @param[in] off1 first offset within the frame
+/// @param[in] off2 second offset within the frame
+static void
+swap_fields(struct prog* pg, const uint8_t sz, const int16_t off1, const int16_t off2)
+{
+  emit(pg, (uint8_t)(BPF_LDX | BPF_MEM | sz), BPF_REG_2, BPF_REG_6, off1, 0);
+  emit(pg, (uint8_t)(BPF_LDX | BPF_MEM | sz), BPF_REG_3, BPF_REG_6, off2, 0);
+  emit(pg, (uint8_t)(BPF_STX | BPF_MEM | sz), BPF_REG_6, BPF_REG_3, off1, 0);
+  emit(pg, (uint8_t)(BPF_STX | BPF_MEM | sz), BPF_REG_6, BPF_REG_2, off2, 0);
+}
+
+/// Append the reflection of a request whose format is already known. The
+/// register r6 points to the start of the frame and all accesses up to the
+/// end of the payload were verified.
+///
+/// @param[in] pg   program
+/// @param[in] xd   in-kernel reflection
+/// @param[in] hn   local host name
+/// @param[in] cf   configuration
+/// @param[in] full full-size payload
+static void
+emit_reflect(struct prog* pg,
+             const struct xdp* xd,
+             const char hn[static NEMO_HOST_NAME_SIZE],
+             const struct config* cf,
+             const bool full)
+{
+  uint64_t word;
+  int16_t size;
+  int16_t hid;
+  int8_t lclk;
+  int8_t lrep;
+  int16_t i;
+
+  if (full == true) {
+    size = NEMO_PAYLOAD_SIZE;
+    hid  = (int16_t)offsetof(struct payload, pl_hid);
+    lclk = LBL_CLOCK;
+    lrep = LBL_REPORT;
+  } else {
+    size = NEMO_PAYLOAD_COMPACT_SIZE;
+    hid  = (int16_t)offsetof(struct payload_compact, pc_hid);
+    lclk = LBL_CLOCK + 1;
+    lrep = LBL_REPORT + 1;
+  }
+
+  // Fill the payload the same way as the user space does: mark it as a
+  // response and record the received Time-To-Live value.
+  emit(pg, BPF_LDX | BPF_MEM | BPF_B, BPF_REG_2, BPF_REG_6, XDP_OFF_PL + XDP_PL_FVER, 0);
+  emit(pg, BPF_ALU64 | BPF_OR | BPF_K, BPF_REG_2, 0, 0, 1 << 5);
+  emit(pg, BPF_STX | BPF_MEM | BPF_B, BPF_REG_6, BPF_REG_2, XDP_OFF_PL + XDP_PL_FVER, 0);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_B, BPF_REG_2, BPF_REG_6, XDP_OFF_IP + 8, 0);
+  emit(pg, BPF_STX | BPF_MEM | BPF_B, BPF_REG_6, BPF_REG_2, XDP_OFF_PL + XDP_PL_TTL2, 0);
+
+  // The steady time is the monotonic clock, and the system time is derived
+  // from it by the offset maintained by the user space.
+  emit(pg, BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_ktime_get_ns);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_8, BPF_REG_0, 0, 0);
+  store_wire64(pg, XDP_OFF_PL + XDP_PL_MTM2, BPF_REG_8, BPF_REG_2);
+
+  emit(pg, BPF_ST | BPF_MEM | BPF_W, BPF_REG_10, 0, -4, 0);
+  load_imm64(pg, BPF_REG_1, BPF_PSEUDO_MAP_FD, (uint64_t)xd->xd_roff);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4);
+  emit(pg, BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem);
+  jump(pg, BPF_JEQ, BPF_REG_0, 0, lclk);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_DW, BPF_REG_2, BPF_REG_0, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_ADD | BPF_X, BPF_REG_8, BPF_REG_2, 0, 0);
+  label(pg, lclk);
+  store_wire64(pg, XDP_OFF_PL + XDP_PL_RTM2, BPF_REG_8, BPF_REG_2);
+
+  // Push the event to the user space. In case the ring buffer is full, the
+  // request is still reflected, but it does not get reported.
+  load_imm64(pg, BPF_REG_1, BPF_PSEUDO_MAP_FD, (uint64_t)xd->xd_ring);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_2, 0, 0, (int32_t)sizeof(struct xdp_event));
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, 0);
+  emit(pg, BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_ringbuf_reserve);
+  jump(pg, BPF_JEQ, BPF_REG_0, 0, lrep);
+
+  emit(pg, BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, XDP_OFF_IP + 12, 0);
+  emit(pg, BPF_STX | BPF_MEM | BPF_DW, BPF_REG_0, BPF_REG_2,
+    (int16_t)offsetof(struct xdp_event, xe_addr), 0);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_UDP, 0);
+  emit(pg, BPF_STX | BPF_MEM | BPF_H, BPF_REG_0, BPF_REG_2,
+    (int16_t)offsetof(struct xdp_event, xe_port), 0);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_PL + XDP_PL_LEN, 0);
+  emit(pg, BPF_ALU | BPF_END | BPF_TO_BE, BPF_REG_2, 0, 0, 16);
+  emit(pg, BPF_STX | BPF_MEM | BPF_H, BPF_REG_0, BPF_REG_2,
+    (int16_t)offsetof(struct xdp_event, xe_len), 0);
+  for (i = 0; i < size; i += 8) {
+    emit(pg, BPF_LDX | BPF_MEM | BPF_DW, BPF_REG_2, BPF_REG_6, (int16_t)(XDP_OFF_PL + i), 0);
+    emit(pg, BPF_STX | BPF_MEM | BPF_DW, BPF_REG_0, BPF_REG_2,
+      (int16_t)(offsetof(struct xdp_event, xe_pl) + (size_t)i), 0);
+  }
+
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_1, BPF_REG_0, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_2, 0, 0, 0);
+  emit(pg, BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_ringbuf_submit);
+  label(pg, lrep);
+
+  // Consume the request in the monologue mode.
+  if (cf->cf_mono == true) {
+    emit(pg, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_DROP);
+    emit(pg, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    return;
+  }
+
+  // Update the payload the same way as the user space does. The constants are
+  // encoded into the program in their on-wire representation.
+  load_imm64(pg, BPF_REG_2, 0, htonll(cf->cf_key));
+  emit(pg, BPF_STX | BPF_MEM | BPF_DW, BPF_REG_6, BPF_REG_2, XDP_OFF_PL + XDP_PL_KEY, 0);
+  emit(pg, BPF_ST | BPF_MEM | BPF_B, BPF_REG_6, 0, XDP_OFF_PL + XDP_PL_TTL1, (int32_t)cf->cf_ttl);
+  if (full == true) {
+    for (i = 0; i < NEMO_HOST_NAME_SIZE; i += 8) {
+      (void)memcpy(&word, hn + i, sizeof(word));
+      load_imm64(pg, BPF_REG_2, 0, word);
+      emit(pg, BPF_STX | BPF_MEM | BPF_DW, BPF_REG_6, BPF_REG_2,
+        (int16_t)(XDP_OFF_PL + (int16_t)offsetof(struct payload, pl_host) + i), 0);
+    }
+  }
+  load_imm64(pg, BPF_REG_2, 0, htonll(host_id(hn)));
+  emit(pg, BPF_STX | BPF_MEM | BPF_DW, BPF_REG_6, BPF_REG_2, (int16_t)(XDP_OFF_PL + hid), 0);
+
+  // Address the response to the requester.
+  swap_fields(pg, BPF_W, XDP_OFF_ETH + 0, XDP_OFF_ETH + 6);
+  swap_fields(pg, BPF_H, XDP_OFF_ETH + 4, XDP_OFF_ETH + 10);
+  swap_fields(pg, BPF_W, XDP_OFF_IP + 12, XDP_OFF_IP + 16);
+  swap_fields(pg, BPF_H, XDP_OFF_UDP + 0, XDP_OFF_UDP + 2);
+
+  // The UDP checksum is optional over IPv4, and recomputing it over the whole
+  // datagram is not worth the cost.
+  emit(pg, BPF_ST | BPF_MEM | BPF_H, BPF_REG_6, 0, XDP_OFF_UDP + 6, 0);
+
+  // Replace the Time-To-Live value and update the IPv4 header checksum
+  // incrementally (RFC 1624), which is independent of the byte order as long
+  // as all words are loaded the same way: HC' = ~(~HC + ~m + m').
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_IP + 8, 0);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_3, BPF_REG_2, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_3, 0, 0, 0xff00);
+  emit(pg, BPF_ALU64 | BPF_OR | BPF_K, BPF_REG_3, 0, 0, (int32_t)cf->cf_ttl);
+  emit(pg, BPF_ALU64 | BPF_XOR | BPF_K, BPF_REG_2, 0, 0, 0xffff);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_6, XDP_OFF_IP + 10, 0);
+  emit(pg, BPF_ALU64 | BPF_XOR | BPF_K, BPF_REG_4, 0, 0, 0xffff);
+  emit(pg, BPF_ALU64 | BPF_ADD | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_ADD | BPF_X, BPF_REG_4, BPF_REG_3, 0, 0);
+  for (i = 0; i < 2; i++) {
+    emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_4, 0, 0);
+    emit(pg, BPF_ALU64 | BPF_RSH | BPF_K, BPF_REG_2, 0, 0, 16);
+    emit(pg, BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_4, 0, 0, 0xffff);
+    emit(pg, BPF_ALU64 | BPF_ADD | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0);
+  }
+  emit(pg, BPF_ALU64 | BPF_XOR | BPF_K, BPF_REG_4, 0, 0, 0xffff);
+  emit(pg, BPF_STX | BPF_MEM | BPF_H, BPF_REG_6, BPF_REG_4, XDP_OFF_IP + 10, 0);
+  emit(pg, BPF_ST | BPF_MEM | BPF_B, BPF_REG_6, 0, XDP_OFF_IP + 8, (int32_t)cf->cf_ttl);
+
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_TX);
+  emit(pg, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+}
+
+/// Generate the program that recognizes the requests, verifies them and
+/// reflects them back to the requesters. All constants in comparisons are in
+/// their on-wire representation, as the data is loaded from the frame as-is.
+/// @return success/failure indication
+///
+/// @param[out] pg program
+/// @param[in]  xd in-kernel reflection
+/// @param[in]  hn local host name
+/// @param[in]  cf configuration
+static bool
+generate_program(struct prog* pg,
+                 const struct xdp* xd,
+                 const char hn[static NEMO_HOST_NAME_SIZE],
+                 const struct config* cf)
+{
+  int64_t off;
+  uint64_t i;
+
+  (void)memset(pg, 0, sizeof(*pg));
+
+  // Obtain the frame boundaries and ensure that the smallest payload fits.
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_9, BPF_REG_1, 0, 0);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_W, BPF_REG_6, BPF_REG_9,
+    (int16_t)offsetof(struct xdp_md, data), 0);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_W, BPF_REG_7, BPF_REG_9,
+    (int16_t)offsetof(struct xdp_md, data_end), 0);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_6, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, XDP_OFF_PL + NEMO_PAYLOAD_COMPACT_SIZE);
+  emit(pg, BPF_JMP | BPF_JGT | BPF_X, BPF_REG_2, BPF_REG_7, 0, 0);
+  pg->pg_jmp[pg->pg_n - 1] = LBL_PASS;
+
+  // Accept only unfragmented IPv4 datagrams without options, destined to the
+  // UDP port of the responder.
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_ETH + 12, 0);
+  jump(pg, BPF_JNE, BPF_REG_2, htons(ETH_P_IP), LBL_PASS);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_B, BPF_REG_2, BPF_REG_6, XDP_OFF_IP + 0, 0);
+  jump(pg, BPF_JNE, BPF_REG_2, 0x45, LBL_PASS);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_B, BPF_REG_2, BPF_REG_6, XDP_OFF_IP + 9, 0);
+  jump(pg, BPF_JNE, BPF_REG_2, IPPROTO_UDP, LBL_PASS);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_IP + 6, 0);
+  emit(pg, BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_2, 0, 0, htons(0x3fff));
+  jump(pg, BPF_JNE, BPF_REG_2, 0, LBL_PASS);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_UDP + 2, 0);
+  jump(pg, BPF_JNE, BPF_REG_2, htons((uint16_t)cf->cf_port[0]), LBL_PASS);
+
+  // Verify the magic identifier and that the datagram length matches the
+  // payload length.
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_PL + XDP_PL_MGIC, 0);
+  jump(pg, BPF_JNE, BPF_REG_2, htons(NEMO_PAYLOAD_MAGIC), LBL_PASS);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_UDP + 4, 0);
+  emit(pg, BPF_ALU | BPF_END | BPF_TO_BE, BPF_REG_2, 0, 0, 16);
+  emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_3, BPF_REG_6, XDP_OFF_PL + XDP_PL_LEN, 0);
+  emit(pg, BPF_ALU | BPF_END | BPF_TO_BE, BPF_REG_3, 0, 0, 16);
+  emit(pg, BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_3, 0, 0, 8);
+  emit(pg, BPF_JMP | BPF_JNE | BPF_X, BPF_REG_2, BPF_REG_3, 0, 0);
+  pg->pg_jmp[pg->pg_n - 1] = LBL_PASS;
+
+  // Requests that are to be ignored are left to the user space, so that the
+  // behaviour remains identical to the socket path.
+  if (cf->cf_len != 0) {
+    emit(pg, BPF_LDX | BPF_MEM | BPF_H, BPF_REG_2, BPF_REG_6, XDP_OFF_PL + XDP_PL_LEN, 0);
+    jump(pg, BPF_JNE, BPF_REG_2, htons((uint16_t)cf->cf_len), LBL_PASS);
+  }
+  if (cf->cf_key != 0) {
+    emit(pg, BPF_LDX | BPF_MEM | BPF_DW, BPF_REG_2, BPF_REG_6, XDP_OFF_PL + XDP_PL_KEY, 0);
+    load_imm64(pg, BPF_REG_3, 0, htonll(cf->cf_key));
+    emit(pg, BPF_JMP | BPF_JNE | BPF_X, BPF_REG_2, BPF_REG_3, 0, 0);
+    pg->pg_jmp[pg->pg_n - 1] = LBL_PASS;
+  }
+
+  // Select the format, ensuring that the full-size payload fits.
+  emit(pg, BPF_LDX | BPF_MEM | BPF_B, BPF_REG_2, BPF_REG_6, XDP_OFF_PL + XDP_PL_FVER, 0);
+  emit(pg, BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_2, 0, 0, 0x1f);
+  jump(pg, BPF_JEQ, BPF_REG_2, NEMO_PAYLOAD_VERSION_COMPACT, LBL_COMPACT);
+  jump(pg, BPF_JNE, BPF_REG_2, NEMO_PAYLOAD_VERSION_FULL, LBL_PASS);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_6, 0, 0);
+  emit(pg, BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, XDP_OFF_PL + NEMO_PAYLOAD_SIZE);
+  emit(pg, BPF_JMP | BPF_JGT | BPF_X, BPF_REG_2, BPF_REG_7, 0, 0);
+  pg->pg_jmp[pg->pg_n - 1] = LBL_PASS;
+
+  emit_reflect(pg, xd, hn, cf, true);
+  label(pg, LBL_COMPACT);
+  emit_reflect(pg, xd, hn, cf, false);
+
+  label(pg, LBL_PASS);
+  emit(pg, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS);
+  emit(pg, BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+
+  if (pg->pg_ovf == true) {
+    log(LL_WARN, false, "program exceeds %d instructions", XDP_INSN_MAX);
+    return false;
+  }
+
+  // Resolve the jump offsets, which are relative to the next instruction.
+  for (i = 0; i < pg->pg_n; i++) {
+    if (pg->pg_jmp[i] != -1) {
+      off = pg->pg_lbl[pg->pg_jmp[i]] - (int64_t)i - 1;
+      pg->pg_ins[i].off = (int16_t)off;
+    }
+  }
+
+  return true;
+}
+
+/// Create a map.
+/// @return map descriptor or -1 on failure
+///
+/// @param[in] type map type
+/// @param[in] ksz  key size
+/// @param[in] vsz  value size
+/// @param[in] ent  maximal number of entries
+static int
+create_map(const uint32_t type, const uint32_t ksz, const uint32_t vsz, const uint32_t ent)
+{
+  union bpf_attr at;
+  int fd;
+
+  (void)memset(&at, 0, sizeof(at));
+  at.map_type    = type;
+  at.key_size    = ksz;
+  at.value_size  = vsz;
+  at.max_entries = ent;
+
+  fd = sys_bpf(BPF_MAP_CREATE, &at);
+  if (fd == -1) {
+    log(LL_WARN, true, "unable to create a map");
+  }
+
+  return fd;
+}
+
+/// Load the program into the kernel, printing the verifier log on failure.
+/// @return success/failure indication
+///
+/// @param[in] xd in-kernel reflection
+/// @param[in] pg program
+static bool
+load_program(struct xdp* xd, const struct prog* pg)
+{
+  static char vlog[XDP_LOG_SIZE];
+  union bpf_attr at;
+
+  (void)memset(&at, 0, sizeof(at));
+  (void)memset(vlog, 0, sizeof(vlog));
+  at.prog_type = BPF_PROG_TYPE_XDP;
+  at.insns     = (uint64_t)(uintptr_t)pg->pg_ins;
+  at.insn_cnt  = (uint32_t)pg->pg_n;
+  at.license   = (uint64_t)(uintptr_t)"BSD";
+  at.log_buf   = (uint64_t)(uintptr_t)vlog;
+  at.log_size  = sizeof(vlog);
+  at.log_level = 1;
+  (void)strncpy(at.prog_name, "nemo_reflect", sizeof(at.prog_name) - 1);
+
+  xd->xd_prog = sys_bpf(BPF_PROG_LOAD, &at);
+  if (xd->xd_prog == -1) {
+    log(LL_WARN, true, "unable to load the program");
+    log(LL_DEBUG, false, "verifier log: %s", vlog);
+    return false;
+  }
+
+  return true;
+}
+
+/// Attach the program to the network interface.
+/// @return success/failure indication
+///
+/// @param[in] xd in-kernel reflection
+/// @param[in] cf configuration
+static bool
+attach_program(struct xdp* xd, const struct config* cf)
+{
+  union bpf_attr at;
+  unsigned int ifx;
+
+  ifx = if_nametoindex(cf->cf_xdp);
+  if (ifx == 0) {
+    log(LL_WARN, true, "unable to find the interface %s", cf->cf_xdp);
+    return false;
+  }
+
+  (void)memset(&at, 0, sizeof(at));
+  at.link_create.prog_fd        = (uint32_t)xd->xd_prog;
+  at.link_create.target_ifindex = ifx;
+  at.link_create.attach_type    = BPF_XDP;
+  if (cf->cf_xgen == true) {
+    at.link_create.flags = XDP_FLAGS_SKB_MODE;
+  } else {
+    at.link_create.flags = XDP_FLAGS_DRV_MODE;
+  }
+
+  // The program stays attached for as long as the link descriptor is open,
+  // so that it is detached even if the process crashes.
+  xd->xd_link = sys_bpf(BPF_LINK_CREATE, &at);
+  if (xd->xd_link == -1) {
+    log(LL_WARN, true, "unable to attach the program to the interface %s", cf->cf_xdp);
+    return false;
+  }
+
+  return true;
+}
+
+/// Map the ring buffer into the address space of the process.
+/// @return success/failure indication
+///
+/// @param[in] xd in-kernel reflection
+static bool
+map_ring(struct xdp* xd)
+{
+  long pgsz;
+  void* ptr;
+
+  pgsz = sysconf(_SC_PAGESIZE);
+  xd->xd_size = XDP_RING_SIZE;
+
+  // The consumer position is the only writable part of the ring buffer.
+  ptr = mmap(NULL, (size_t)pgsz, PROT_READ | PROT_WRITE, MAP_SHARED, xd->xd_ring, 0);
+  if (ptr == MAP_FAILED) {
+    log(LL_WARN, true, "unable to map the ring buffer consumer page");
+    return false;
+  }
+  xd->xd_cons = ptr;
+
+  // The data area is mapped twice in a row by the kernel, so that records
+  // wrapping around the end of the area can be read contiguously.
+  ptr = mmap(NULL, (size_t)pgsz + 2 * xd->xd_size, PROT_READ, MAP_SHARED, xd->xd_ring, pgsz);
+  if (ptr == MAP_FAILED) {
+    log(LL_WARN, true, "unable to map the ring buffer data pages");
+    return false;
+  }
+  xd->xd_prod = ptr;
+  xd->xd_data = xd->xd_prod + pgsz;
+
+  return true;
+}
+
+/// Load the XDP program that reflects the requests in the kernel and attach
+/// it to the selected network interface. Requests that the program does not
+/// recognize are passed to the network stack, and therefore arrive on the
+/// socket as usual.
+/// @return success/failure indication
+///
+/// @param[out] xd in-kernel reflection
+/// @param[in]  hn local host name
+/// @param[in]  cf configuration
+bool
+open_xdp(struct xdp* xd,
+         const char hn[static NEMO_HOST_NAME_SIZE],
+         const struct config* cf)
+{
+  static struct prog pg;
+  bool retb;
+
+  log(LL_INFO, false, "attaching the XDP program to interface %s", cf->cf_xdp);
+
+  (void)memset(xd, 0, sizeof(*xd));
+  xd->xd_prog = -1;
+  xd->xd_link = -1;
+  xd->xd_ring = -1;
+  xd->xd_roff = -1;
+
+  if (cf->cf_ipv4 == false) {
+    log(LL_WARN, false, "in-kernel reflection supports only IPv4");
+    return false;
+  }
+
+  xd->xd_ring = create_map(BPF_MAP_TYPE_RINGBUF, 0, 0, XDP_RING_SIZE);
+  if (xd->xd_ring == -1) {
+    return false;
+  }
+
+  xd->xd_roff = create_map(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t), sizeof(uint64_t), 1);
+  if (xd->xd_roff == -1) {
+    return false;
+  }
+
+  retb = map_ring(xd);
+  if (retb == false) {
+    return false;
+  }
+
+  update_xdp(xd);
+
+  retb = generate_program(&pg, xd, hn, cf);
+  if (retb == false) {
+    return false;
+  }
+
+  retb = load_program(xd, &pg);
+  if (retb == false) {
+    return false;
+  }
+
+  return attach_program(xd, cf);
+}
+
+/// Detach the XDP program and release all its resources.
+///
+/// @param[in] xd in-kernel reflection
+void
+close_xdp(struct xdp* xd)
+{
+  long pgsz;
+
+  pgsz = sysconf(_SC_PAGESIZE);
+
+  if (xd->xd_link != -1) {
+    (void)close(xd->xd_link);
+  }
+  if (xd->xd_prog != -1) {
+    (void)close(xd->xd_prog);
+  }
+  if (xd->xd_cons != NULL) {
+    (void)munmap(xd->xd_cons, (size_t)pgsz);
+  }
+  if (xd->xd_prod != NULL) {
+    (void)munmap(xd->xd_prod, (size_t)pgsz + 2 * xd->xd_size);
+  }
+  if (xd->xd_ring != -1) {
+    (void)close(xd->xd_ring);
+  }
+  if (xd->xd_roff != -1) {
+    (void)close(xd->xd_roff);
+  }
+
+  log(LL_DEBUG, false, "XDP events received: %" PRIu64, xd->xd_nrec);
+}
+
+/// Update the offset of the real-time clock from the monotonic clock used by
+/// the program, at most once per period.
+///
+/// @param[in] xd in-kernel reflection
+void
+update_xdp(struct xdp* xd)
+{
+  union bpf_attr at;
+  uint64_t mono;
+  uint64_t roff;
+  uint32_t key;
+  int reti;
+
+  mono = mono_now();
+  if (xd->xd_clk != 0 && mono - xd->xd_clk < XDP_CLOCK_PERIOD) {
+    return;
+  }
+
+  key  = 0;
+  roff = real_now() - mono;
+
+  (void)memset(&at, 0, sizeof(at));
+  at.map_fd = (uint32_t)xd->xd_roff;
+  at.key    = (uint64_t)(uintptr_t)&key;
+  at.value  = (uint64_t)(uintptr_t)&roff;
+  at.flags  = BPF_ANY;
+
+  reti = sys_bpf(BPF_MAP_UPDATE_ELEM, &at);
+  if (reti == -1) {
+    log(LL_DEBUG, true, "unable to update the clock offset");
+  }
+
+  xd->xd_clk = mono;
+}
+
+/// Consume all events pushed by the program to the ring buffer.
+///
+/// @param[in] xd  in-kernel reflection
+/// @param[in] ch  channel
+/// @param[in] hn  local host name
+/// @param[in] pi  array of plugins
+/// @param[in] npi number of plugins
+/// @param[in] cf  configuration
+void
+drain_xdp(struct xdp* xd,
+          struct channel* ch,
+          const char hn[static NEMO_HOST_NAME_SIZE],
+          struct plugin* pi,
+          const uint64_t npi,
+          const struct config* cf)
+{
+  struct xdp_event xe;
+  uint64_t cons;
+  uint64_t prod;
+  uint32_t* hdr;
+  uint32_t len;
+
+  cons = __atomic_load_n((uint64_t*)xd->xd_cons, __ATOMIC_ACQUIRE);
+  prod = __atomic_load_n((uint64_t*)xd->xd_prod, __ATOMIC_ACQUIRE);
+
+  while (cons < prod) {
+    hdr = (uint32_t*)(xd->xd_data + (cons & (xd->xd_size - 1)));
+    len = __atomic_load_n(hdr, __ATOMIC_ACQUIRE);
+
+    // Stop at the first record that is still being written.
+    if (len & BPF_RINGBUF_BUSY_BIT) {
+      break;
+    }
+
+    if ((len & BPF_RINGBUF_DISCARD_BIT) == 0 && len >= sizeof(xe)) {
+      (void)memcpy(&xe, (uint8_t*)hdr + BPF_RINGBUF_HDR_SZ, sizeof(xe));
+      xd->xd_nrec++;
+      handle_reflection(ch, hn, pi, npi, &xe, cf);
+    }
+
+    // Records are aligned to eight bytes, including the header.
+    len &= ~(uint32_t)(BPF_RINGBUF_BUSY_BIT | BPF_RINGBUF_DISCARD_BIT);
+    cons += (len + BPF_RINGBUF_HDR_SZ + 7) & ~7U;
+    __atomic_store_n((uint64_t*)xd->xd_cons, cons, __ATOMIC_RELEASE);
+  }
+}
+
+#else
+
+bool
+open_xdp(struct xdp* xd,
+         const char hn[static NEMO_HOST_NAME_SIZE],
+         const struct config* cf)
+{
+  (void)hn;
+  (void)cf;
+
+  (void)memset(xd, 0, sizeof(*xd));
+  log(LL_WARN, false, "in-kernel reflection is not supported on this platform");
+  return false;
+}
+
+void
+close_xdp(struct xdp* xd)
+{
+  (void)xd;
+}
+
+void
+update_xdp(struct xdp* xd)
+{
+  (void)xd;
+}
+
+void
+drain_xdp(struct xdp* xd,
+          struct channel* ch,
+          const char hn[static NEMO_HOST_NAME_SIZE],
+          struct plugin* pi,
+          const uint64_t npi,
+          const struct config* cf)
+{
+  (void)xd;
+  (void)ch;
+  (void)hn;
+  (void)pi;
+  (void)npi;
+  (void)cf;
+}
+
+#endif